@@ -0,0 +1,12 @@
+precision highp float; 
+
+uniform sampler2D s_baseMap;
+
+varying  vec2 v_texcoord;
+varying  vec4 v_color;
+
+void main(void) 
+{
+   vec4  color = texture2D(s_baseMap, v_texcoord);
+   gl_FragColor =  color * v_color ;
+}
\ No newline at end of file
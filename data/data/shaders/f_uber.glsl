@@ -8,6 +8,7 @@ uniform vec3 lightColorDiffuse;
 uniform vec3 lightColorSpecular;
 uniform float materialShininess;
 uniform vec3 matColorSpecular;
+uniform float flicker;
 
 varying vec3 lightVec; 
 varying vec3 halfVec;
@@ -102,6 +103,9 @@ void main(void)
 		gl_FragColor = vec4( ambientComponent + (diffuseComponent + specularComponent) ,colorSample.a)  ; 
 #endif
 	
+	// Hit enemies flash white
+	gl_FragColor.rgb += vec3(flicker);
+	
 
 	
 	
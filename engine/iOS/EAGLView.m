@@ -737,6 +737,16 @@ void SND_ResumeSoundTrack(void)
 	[audiocontroller resume];
 }
 
+void SND_PrefetchSoundTrack(char* filename)
+{
+	//The audio queue reads the file as it plays.
+}
+
+void SND_SeekSoundTrack(unsigned int ms)
+{
+	//Not supported by the audio queue player, the track keeps its position.
+}
+
 extern char*	FS_GameWritableDir(void);
 int Native_RetrieveListOf(char replayList[10][256])
 {
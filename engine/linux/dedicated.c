@@ -0,0 +1,282 @@
+/*
+SHMUP is a 3D Shoot 'em up game inspired by Treasure Ikaruga
+Copyright (C) 2009 Fabien Sanglard
+
+This file is part of SHMUP.
+
+SHMUP is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SHMUP is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SHMUP.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Dedicated server: the engine without window, renderer, sound or menu,
+ * only the simulation of the sessions it hosts (../src/server.h).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "globals.h"
+#include "dEngine.h"
+#include "timer.h"
+#include "io_interface.h"
+#include "music.h"
+#include "sound_backend.h"
+#include "native_services.h"
+#include "texture.h"
+#include "ItextureLoader.h"
+#include "netsim.h"
+#include "server.h"
+#include "dedicated.h"
+
+#define SCREEN_WIDTH 320
+#define SCREEN_HEIGHT 480
+
+int  Native_RetrieveListOf(char replayList[10][256]) { (void)replayList; /* Unused */ return 0; }
+void Native_UploadFileTo(char path[256]) { (void)path; /* Unused */ }
+void Action_ShowGameCenter(void* tag) { (void)tag; /* Unused */ }
+void Native_UploadScore(uint score) { (void)score; /* Unused */ }
+void Native_LoginGameCenter(void) {}
+
+/* Sounds are still mixed by the engine, nothing plays them. */
+void SND_BACKEND_Init(void) {}
+void SND_BACKEND_Upload(sound_t* sound, int soundID) { (void)sound; (void)soundID; /* Unused */ }
+void SND_BACKEND_Play(int sndId, float gain) { (void)sndId; (void)gain; /* Unused */ }
+
+void SND_PrefetchSoundTrack(char *filename) { (void)filename; /* Unused */ }
+void SND_InitSoundTrack(char *filename, unsigned int startAt) { (void)filename; (void)startAt; /* Unused */ }
+void SND_StartSoundTrack(void) {}
+void SND_StopSoundTrack(void) {}
+void SND_PauseSoundTrack(void) {}
+void SND_ResumeSoundTrack(void) {}
+void SND_SeekSoundTrack(unsigned int ms) { (void)ms; /* Unused */ }
+
+/* Textures are never drawn: they keep their path and no pixels. */
+void loadNativePNG(texture_t* tmpTex)
+{
+    tmpTex->format = TEXTURE_TYPE_UNKNOWN;
+}
+
+static void Null_Void(void) {}
+static void Null_SetTexture(unsigned int textureId) { (void)textureId; /* Unused */ }
+static void Null_Texture(texture_t* texture) { (void)texture; /* Unused */ }
+static void Null_RenderSprites(const xf_sprite_t* vertices, int numQuads, const ushort* quadIndices, const spr_batch_t* batches, int numBatches)
+{
+    (void)vertices; (void)numQuads; (void)quadIndices; (void)batches; (void)numBatches; /* Unused */
+}
+static void Null_RenderInstances(const inst_batch_t* batch) { (void)batch; /* Unused */ }
+static void Null_RenderString(xf_colorless_sprite_t* vertices, ushort* indices, uint numIndices)
+{
+    (void)vertices; (void)indices; (void)numIndices; /* Unused */
+}
+static void Null_GetColorBuffer(uchar* data) { (void)data; /* Unused */ }
+static void Null_UpLoadEntityToGPU(entity_t* entity) { (void)entity; /* Unused */ }
+static uint Null_UploadVerticesToGPU(void* vertices, uint mem_size) { (void)vertices; (void)mem_size; /* Unused */ return 0; }
+static void Null_FreeGPUBuffer(uint buffer) { (void)buffer; /* Unused */ }
+static void Null_RenderColorlessSprites(xf_colorless_sprite_t* vertices, ushort numIndices, ushort* indices)
+{
+    (void)vertices; (void)numIndices; (void)indices; /* Unused */
+}
+static void Null_Float(float value) { (void)value; /* Unused */ }
+static void Null_SetMaterialTextureBlending(char modulate) { (void)modulate; /* Unused */ }
+static int  Null_IsTextureCompressionSupported(int type) { (void)type; /* Unused */ return 0; }
+
+void Dedicated_BindRendererMethods(renderer_t *renderer)
+{
+    renderer->Set3D = Null_Void;
+    renderer->StopRendition = Null_Void;
+    renderer->SetTexture = Null_SetTexture;
+    renderer->RenderEntities = Null_Void;
+    renderer->UpLoadTextureToGpu = Null_Texture;
+    renderer->FreeGPUTexture = Null_Texture;
+    renderer->Set2D = Null_Void;
+    renderer->RenderSprites = Null_RenderSprites;
+    renderer->RenderInstances = Null_RenderInstances;
+    renderer->RenderString = Null_RenderString;
+    renderer->GetColorBuffer = Null_GetColorBuffer;
+    renderer->UpLoadEntityToGPU = Null_UpLoadEntityToGPU;
+    renderer->UploadVerticesToGPU = Null_UploadVerticesToGPU;
+    renderer->FreeGPUBuffer = Null_FreeGPUBuffer;
+    renderer->DrawControls = Null_Void;
+    renderer->StartCleanFrame = Null_Void;
+    renderer->RenderColorlessSprites = Null_RenderColorlessSprites;
+    renderer->FadeScreen = Null_Float;
+    renderer->SetMaterialTextureBlending = Null_SetMaterialTextureBlending;
+    renderer->SetTransparency = Null_Float;
+    renderer->IsTextureCompressionSupported = Null_IsTextureCompressionSupported;
+    renderer->RefreshViewPort = Null_Void;
+}
+
+/*
+ * shmup_server [-p players] [-n sessions] [-u port] frames [latency jitter reorder loss [seed]]
+ * Hosts the sessions of the first level at once, each played by netsim
+ * bots over its own impaired loopback (or over localhost UDP with -u),
+ * and prints what the server spent on them. The time of the bots is not
+ * counted.
+ */
+static int RunSessions(int argc, char **argv)
+{
+    netsim_config_t config;
+    netsim_report_t report;
+    uint *impairment[5];
+    double perFrame;
+    double worstPerFrame;
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    config.sceneId = 1;
+    config.numPlayers = 2;
+    config.numSessions = 1;
+    config.server = 1;
+    config.frames = 3600;
+    config.inputDelay = engine.netInputDelay;
+    config.impairment.seed = 1;
+
+    impairment[0] = &config.impairment.latency;
+    impairment[1] = &config.impairment.jitter;
+    impairment[2] = &config.impairment.reorder;
+    impairment[3] = &config.impairment.loss;
+    impairment[4] = &config.impairment.seed;
+
+    while (argc > 1 && (!strcmp(argv[0], "-p") || !strcmp(argv[0], "-n") || !strcmp(argv[0], "-u")))
+    {
+        if (!strcmp(argv[0], "-p"))
+            config.numPlayers = atoi(argv[1]);
+        else if (!strcmp(argv[0], "-n"))
+            config.numSessions = atoi(argv[1]);
+        else
+            config.udpPort = atoi(argv[1]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc > 0)
+        config.frames = atoi(argv[0]);
+    for (i = 1; i < argc && i <= 5; i++)
+        *impairment[i - 1] = atoi(argv[i]);
+
+    if (!NETSIM_Run(&config, &report))
+    {
+        printf("server: the run did not complete.\n");
+        if (!report.numPlayers)
+            return 1;
+    }
+
+    perFrame = report.serverFrames ? report.serverMicroseconds / (double)report.serverFrames : 0.0;
+    worstPerFrame = report.frames ? report.serverMaxSessionMicroseconds / (double)report.frames : 0.0;
+
+    printf("server: %d sessions of %d players, %u frames each, %u ticks in %d ms\n",
+           report.numSessions, report.numPlayers, report.frames, report.ticks, report.milliseconds);
+    printf("server: %u frames simulated in %llu ms, %.1f us per frame and session (%.1f in the costliest one)\n",
+           report.serverFrames, report.serverMicroseconds / 1000, perFrame, worstPerFrame);
+    printf("server: %u states sent, %u bytes\n", report.serverStatesSent, report.serverBytesSent);
+    if (perFrame > 0)
+        printf("server: about %.0f sessions per core at 60 frames/s\n", 1000000.0 / 60 / perFrame);
+    printf("server: the peers checked %u states, %u differed, %u corrections\n",
+           report.statesChecked, report.desyncs, report.corrections);
+    printf("server: %s\n", report.synchronized ? "synchronized" : "DESYNC");
+
+    return report.synchronized ? 0 : 1;
+}
+
+/*
+ * shmup_server --listen port [-p players] [frames]
+ * Hosts the first level for the players that join over UDP, sessions of
+ * 2 players by default, each stops after frames (never by default). It
+ * runs until killed.
+ */
+static int Listen(int argc, char **argv)
+{
+    server_t *server;
+    ushort port;
+    int numPlayers = 2;
+    uint frames = 0;
+
+    if (argc < 1)
+    {
+        printf("server: --listen needs a port.\n");
+        return 1;
+    }
+
+    port = atoi(argv[0]);
+    argc--;
+    argv++;
+
+    while (argc > 1 && !strcmp(argv[0], "-p"))
+    {
+        numPlayers = atoi(argv[1]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc > 0)
+        frames = atoi(argv[0]);
+
+    if (numPlayers < 2 || numPlayers > MAX_NUM_PLAYERS)
+    {
+        printf("server: %d players, 2 to %d are supported.\n", numPlayers, MAX_NUM_PLAYERS);
+        return 1;
+    }
+
+    dEngine_LoadMultiplayerScene(1, numPlayers);
+
+    server = SERV_New();
+    if (!SERV_Listen(server, port, frames))
+    {
+        printf("server: cannot listen on port %hu.\n", port);
+        SERV_Free(server);
+        return 1;
+    }
+
+    printf("server: listening on port %hu, sessions of %d players\n", port, numPlayers);
+
+    /* Every frame confirmed since the last update runs at once: polling only adds latency. */
+    for (;;)
+    {
+        SERV_Update(server);
+        usleep(1000);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+#ifndef RELEASE
+    setenv("RD", "../..", 1);
+    setenv("WD", "../..", 1);
+#else
+    setenv("RD", ".", 1);
+    setenv("WD", ".", 1);
+#endif
+
+    renderer.statsEnabled    = 0;
+    renderer.materialQuality = MATERIAL_QUALITY_HIGH;
+
+    renderer.glBuffersDimensions[WIDTH]  = SCREEN_WIDTH;
+    renderer.glBuffersDimensions[HEIGHT] = SCREEN_HEIGHT;
+
+    dEngine_Init();
+    renderer.statsEnabled = 0;
+    engine.licenseType = LICENSE_FULL;
+
+    IO_Init();
+
+    dEngine_InitDisplaySystem(GL_11_RENDERER);
+
+    if (argc > 1 && !strcmp(argv[1], "--listen"))
+        return Listen(argc - 2, argv + 2);
+
+    return RunSessions(argc - 1, argv + 1);
+}
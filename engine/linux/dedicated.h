@@ -0,0 +1,29 @@
+/*
+SHMUP is a 3D Shoot 'em up game inspired by Treasure Ikaruga
+Copyright (C) 2009 Fabien Sanglard
+
+This file is part of SHMUP.
+
+SHMUP is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SHMUP is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SHMUP.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEDICATED_H
+#define DEDICATED_H
+
+#include "renderer.h"
+
+/* The dedicated server draws nothing: every method does nothing. */
+void Dedicated_BindRendererMethods(renderer_t *renderer);
+
+#endif
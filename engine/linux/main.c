@@ -18,7 +18,10 @@ You should have received a copy of the GNU General Public License
 along with SHMUP.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <netdb.h>
 
 #include "SDL/SDL.h"
 
@@ -27,10 +30,15 @@ along with SHMUP.  If not, see <https://www.gnu.org/licenses/>.
 #include "../src/timer.h"
 #include "../src/menu.h"
 #include "../src/io_interface.h"
+#include "../src/netsim.h"
+#include "../src/netchannel.h"
 
 #define SCREEN_WIDTH 320
 #define SCREEN_HEIGHT 480
 
+#define JOIN_TRIES       40
+#define JOIN_RETRY_DELAY 250    /* ms */
+
 int quit = 0;
 
 static void SetupMouse(void)
@@ -115,7 +123,141 @@ static void ReadInput(void)
 
 }
 
-int main(void)
+/*
+ * --netsim [-p players] [-s spectators] frames [latency jitter reorder loss [seed]]
+ * Plays the first level as every multiplayer peer (2 by default) over an
+ * impaired loopback and prints whether they stayed synchronized. With
+ * spectators, a relay fans the session out to them.
+ */
+static int RunNetSim(int argc, char **argv)
+{
+    netsim_config_t config;
+    netsim_report_t report;
+    uint *impairment[5];
+    int i;
+
+    memset(&config, 0, sizeof(config));
+    config.sceneId = 1;
+    config.numPlayers = 2;
+    config.frames = 3600;
+    config.inputDelay = engine.netInputDelay;
+    config.impairment.seed = 1;
+
+    impairment[0] = &config.impairment.latency;
+    impairment[1] = &config.impairment.jitter;
+    impairment[2] = &config.impairment.reorder;
+    impairment[3] = &config.impairment.loss;
+    impairment[4] = &config.impairment.seed;
+
+    while (argc > 1 && (!strcmp(argv[0], "-p") || !strcmp(argv[0], "-s")))
+    {
+        if (!strcmp(argv[0], "-p"))
+            config.numPlayers = atoi(argv[1]);
+        else
+            config.numSpectators = atoi(argv[1]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc > 0)
+        config.frames = atoi(argv[0]);
+    for (i = 1; i < argc && i <= 5; i++)
+        *impairment[i - 1] = atoi(argv[i]);
+
+    if (!NETSIM_Run(&config, &report))
+    {
+        printf("netsim: the run did not complete.\n");
+        if (!report.numPlayers)
+            return 1;
+    }
+
+    printf("netsim: %d players, %u frames, %u ticks in %d ms (%.0f frames/s per peer)\n",
+           report.numPlayers, report.frames, report.ticks, report.milliseconds,
+           report.milliseconds ? report.frames * report.numPlayers * 1000.0 / report.milliseconds : 0.0);
+
+    for (i = 0; i < report.numPlayers; i++)
+        printf("netsim: peer %d, %u rollbacks, %u frames re-simulated (at most %u), %u stalls, %u bytes in %u packets, %u lost\n",
+               i, report.rollback[i].rollbacks, report.rollback[i].resimulatedFrames, report.rollback[i].maxRollback,
+               report.rollback[i].stalls, report.bytesSent[i], report.packetsSent[i], report.packetsLost[i]);
+
+    for (i = 0; i < report.numPlayers; i++)
+        printf("netsim: peer %d, state %016llx\n", i, report.hashes[i]);
+
+    if (report.numSpectators)
+    {
+        printf("netsim: relay, %u frames to %d spectators, %u blocks (%u sent again), %u bytes, %d got the whole log\n",
+               report.relayFrames, report.numSpectators, report.relayBlocksSent, report.relayBlocksResent,
+               report.relayBytesSent, report.spectatorsComplete);
+        printf("netsim: last spectator joined at frame %u, caught up in %u frames, state %016llx\n",
+               report.watcherJoinTick, report.watcherCatchUpTicks, report.watcherHash);
+    }
+
+    printf("netsim: %s\n", report.synchronized ? "synchronized" : "DESYNC");
+
+    return report.synchronized ? 0 : 1;
+}
+
+/*
+ * --join host port
+ * Joins a dedicated server (shmup_server --listen) and plays the session
+ * it seats us in. Returns 0 once the session started.
+ */
+static int JoinServer(int argc, char **argv)
+{
+    struct addrinfo hints;
+    struct addrinfo *found;
+    struct sockaddr_in server;
+    netp_welcome_t welcome;
+    uint nonce;
+    int udpSocket;
+    int tries;
+
+    if (argc < 2)
+    {
+        printf("join: --join needs a host and a port.\n");
+        return 1;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(argv[0], argv[1], &hints, &found))
+    {
+        printf("join: cannot resolve %s.\n", argv[0]);
+        return 1;
+    }
+    memcpy(&server, found->ai_addr, sizeof(server));
+    freeaddrinfo(found);
+
+    udpSocket = NETT_OpenUDPSocket(0);
+    if (udpSocket == -1)
+    {
+        printf("join: cannot open a socket.\n");
+        return 1;
+    }
+
+    /* A lost join or welcome is sent again. */
+    nonce = SDL_GetTicks();
+    for (tries = 0; tries < JOIN_TRIES; tries++)
+    {
+        NET_SendJoin(udpSocket, &server, nonce);
+        SDL_Delay(JOIN_RETRY_DELAY);
+
+        if (NET_ReceiveWelcome(udpSocket, &server, nonce, &welcome))
+        {
+            printf("join: player %d of session %u on %s:%s\n", welcome.playerId, welcome.session, argv[0], argv[1]);
+            NET_StartSession(udpSocket, &server, &welcome);
+            return 0;
+        }
+    }
+
+    printf("join: no answer from %s:%s.\n", argv[0], argv[1]);
+    close(udpSocket);
+
+    return 1;
+}
+
+int main(int argc, char **argv)
 {
     int old_time;
     int new_time;
@@ -123,6 +265,7 @@ int main(void)
     int sleep_time;
     SDL_Surface *screen;
     uchar engineParameters = 0;
+    int status;
 
 #ifndef RELEASE
     setenv("RD", "../..", 1);
@@ -160,6 +303,19 @@ int main(void)
 
     dEngine_InitDisplaySystem(engineParameters);
 
+    if (argc > 1 && !strcmp(argv[1], "--netsim"))
+    {
+        status = RunNetSim(argc - 2, argv + 2);
+        SDL_Quit();
+        return status;
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "--join") && JoinServer(argc - 2, argv + 2))
+    {
+        SDL_Quit();
+        return 1;
+    }
+
     old_time = SDL_GetTicks();
 
     while (!quit)
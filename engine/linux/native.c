@@ -19,10 +19,14 @@ along with SHMUP.  If not, see <https://www.gnu.org/licenses/>.
 */
 
 #include "SDL_mixer.h"
+#include "SDL_thread.h"
 #include "libpng/png.h"
 
 #include "globals.h"
 #include "music.h"
+#include "dEngine.h"
+#include "sound_backend.h"
+#include "sound_mixer.h"
 #include "native_services.h"
 #include "texture.h"
 
@@ -32,40 +36,262 @@ void Action_ShowGameCenter(void* tag) {}
 void Native_UploadScore(uint score) {}
 void Native_LoginGameCenter(void) {}
 
-Mix_Music *music = NULL;
-void SND_InitSoundTrack(char* filename, unsigned int startAt)
+/* Sound effects go through the software mixer, added to the SDL_mixer output after the music. */
+#define SND_OUTPUT_CHUNK 1024 /* ~46ms at 22050Hz, the music alone used 4096. */
+
+static snd_mixer_t liveMixer;
+static int liveChannels;
+
+static void SND_BACKEND_PostMix(void *udata, Uint8 *stream, int len)
+{
+    (void)udata; /* Unused */
+
+    SND_MIXER_Render(&liveMixer, (short*)stream, len / (sizeof(short) * liveChannels), liveChannels);
+}
+
+void SND_BACKEND_Init(void)
 {
     int audio_rate = 22050;
     int audio_channels = 2;
-    Uint16 audio_format = AUDIO_S16;
+    Uint16 audio_format = AUDIO_S16SYS;
+
+    if (Mix_OpenAudio(audio_rate, audio_format, audio_channels, SND_OUTPUT_CHUNK) < 0)
+    {
+        Log_Printf("[SND_BACKEND_Init] Could not open audio: %s.\n", Mix_GetError());
+        return;
+    }
+    Mix_QuerySpec(&audio_rate, &audio_format, &audio_channels);
 
-    (void)startAt; /* Unused */
+    SND_MIXER_Init(&liveMixer, audio_rate);
+    liveChannels = audio_channels;
 
-    if (music)
-        Mix_FreeMusic(music);
+    Mix_SetPostMix(SND_BACKEND_PostMix, NULL);
+}
 
-    Log_Printf("[SND_InitSoundTrack] start '%s'.\n", filename);
+void SND_BACKEND_Upload(sound_t* sound, int soundID)
+{
+    SND_MIXER_Upload(sound, soundID);
+}
 
-    Mix_OpenAudio(audio_rate, audio_format, audio_channels, 4096);
-    Mix_QuerySpec(&audio_rate, &audio_format, &audio_channels);
+void SND_BACKEND_Play(int sndId, float gain)
+{
+    if (!engine.soundEnabled || liveChannels == 0)
+        return;
+
+    SND_MIXER_Play(&liveMixer, sndId, gain);
+}
+
+/*
+ * Music: the audio device stays open from SND_BACKEND_Init and SDL_mixer decodes the
+ * track a buffer at a time in its audio callback. Opening a track (Mix_LoadMUS scans
+ * the whole mp3) is done by a worker thread, into a small cache: scene loads never
+ * wait on it and a scene reusing the track of the previous one does not reopen it.
+ * A track that is not open yet when it should start begins late, at the position
+ * it would have reached.
+ */
+#define MUSIC_CACHE_SIZE 2
+
+#define MUSIC_TRACK_EMPTY   0
+#define MUSIC_TRACK_QUEUED  1
+#define MUSIC_TRACK_LOADING 2
+#define MUSIC_TRACK_READY   3
 
-    music = Mix_LoadMUS(filename);
+typedef struct music_track_t
+{
+    char filename[256];
+    int state;
+    Mix_Music *music; /* NULL if the track could not be opened. */
+    unsigned int lastUse;
+} music_track_t;
+
+static music_track_t musicTracks[MUSIC_CACHE_SIZE];
+static unsigned int musicUseCounter;
+
+static SDL_mutex *musicLock;
+static SDL_cond *musicQueued;
+
+static music_track_t *musicCurrent;
+static char musicWanted;            /* Between SND_StartSoundTrack and SND_StopSoundTrack. */
+static double musicStartPosition;   /* In seconds, at musicStartTicks. */
+static Uint32 musicStartTicks;
+
+/* musicLock held. */
+static void SND_MusicPlay(void)
+{
+    double position;
+
+    if (!musicWanted || !musicCurrent || musicCurrent->state != MUSIC_TRACK_READY || !musicCurrent->music)
+        return;
+
+    position = musicStartPosition + (SDL_GetTicks() - musicStartTicks) / 1000.0;
+
+    /* Mix_SetMusicPosition is relative for mp3, restarting at a position is not. */
+    if (Mix_FadeInMusicPos(musicCurrent->music, 0, 0, position) < 0)
+        Log_Printf("[SND_MusicPlay] Could not play '%s': %s.\n", musicCurrent->filename, Mix_GetError());
+}
+
+static int SND_MusicThread(void *unused)
+{
+    music_track_t *track;
+    Mix_Music *music;
+    int i;
+
+    (void)unused; /* Unused */
+
+    SDL_LockMutex(musicLock);
+    for (;;)
+    {
+        track = NULL;
+        for (i = 0; i < MUSIC_CACHE_SIZE && !track; i++)
+            if (musicTracks[i].state == MUSIC_TRACK_QUEUED)
+                track = &musicTracks[i];
+
+        if (!track)
+        {
+            SDL_CondWait(musicQueued, musicLock);
+            continue;
+        }
+
+        track->state = MUSIC_TRACK_LOADING;
+        SDL_UnlockMutex(musicLock);
+
+        music = Mix_LoadMUS(track->filename);
+        if (!music)
+            Log_Printf("[SND_MusicThread] Could not open '%s': %s.\n", track->filename, Mix_GetError());
+
+        SDL_LockMutex(musicLock);
+        track->music = music;
+        track->state = MUSIC_TRACK_READY;
+
+        if (track == musicCurrent)
+            SND_MusicPlay();
+    }
+
+    return 0;
+}
+
+/* musicLock held. The track of filename, queued for the worker if it was not in the cache. */
+static music_track_t *SND_MusicGetTrack(const char *filename)
+{
+    music_track_t *track;
+    music_track_t *victim;
+
+    victim = NULL;
+    for (track = musicTracks; track < musicTracks + MUSIC_CACHE_SIZE; track++)
+    {
+        if (track->state != MUSIC_TRACK_EMPTY && !strcmp(track->filename, filename))
+        {
+            track->lastUse = ++musicUseCounter;
+            return track;
+        }
+
+        /* The worker owns a loading track, the playing one stays. */
+        if (track == musicCurrent || track->state == MUSIC_TRACK_LOADING)
+            continue;
+        if (!victim || track->lastUse < victim->lastUse)
+            victim = track;
+    }
+
+    if (!victim)
+        return NULL;
+
+    if (victim->music)
+        Mix_FreeMusic(victim->music);
+    victim->music = NULL;
+
+    strncpy(victim->filename, filename, sizeof(victim->filename) - 1);
+    victim->filename[sizeof(victim->filename) - 1] = '\0';
+    victim->state = MUSIC_TRACK_QUEUED;
+    victim->lastUse = ++musicUseCounter;
+
+    SDL_CondSignal(musicQueued);
+
+    return victim;
+}
+
+static void SND_MusicInit(void)
+{
+    if (musicLock)
+        return;
+
+    musicLock = SDL_CreateMutex();
+    musicQueued = SDL_CreateCond();
+
+    if (!SDL_CreateThread(SND_MusicThread, NULL))
+        Log_Printf("[SND_MusicInit] Could not start the music thread: %s.\n", SDL_GetError());
+}
+
+void SND_PrefetchSoundTrack(char *filename)
+{
+    SND_MusicInit();
+
+    SDL_LockMutex(musicLock);
+    SND_MusicGetTrack(filename);
+    SDL_UnlockMutex(musicLock);
+}
+
+void SND_InitSoundTrack(char *filename, unsigned int startAt)
+{
+    Log_Printf("[SND_InitSoundTrack] start '%s' at %us.\n", filename, startAt);
+
+    SND_MusicInit();
+
+    SDL_LockMutex(musicLock);
+
+    musicWanted = 0;
+    Mix_HaltMusic();
+
+    musicCurrent = NULL; /* The previous track can be evicted. */
+    musicCurrent = SND_MusicGetTrack(filename);
+    musicStartPosition = startAt;
+
+    SDL_UnlockMutex(musicLock);
 }
 
 void SND_StartSoundTrack(void)
 {
-    if (music == NULL)
+    if (!musicLock)
         return;
 
-    Mix_PlayMusic(music, 0);
+    SDL_LockMutex(musicLock);
+    musicWanted = 1;
+    musicStartTicks = SDL_GetTicks();
+    SND_MusicPlay();
+    SDL_UnlockMutex(musicLock);
 }
 
 void SND_StopSoundTrack(void)
 {
-    if (music == NULL)
+    if (!musicLock)
         return;
 
+    SDL_LockMutex(musicLock);
+    musicWanted = 0;
     Mix_HaltMusic();
+    SDL_UnlockMutex(musicLock);
+}
+
+void SND_PauseSoundTrack(void)
+{
+    Mix_PauseMusic();
+}
+
+void SND_ResumeSoundTrack(void)
+{
+    Mix_ResumeMusic();
+}
+
+void SND_SeekSoundTrack(unsigned int ms)
+{
+    if (!musicLock)
+        return;
+
+    SDL_LockMutex(musicLock);
+    musicStartPosition = ms / 1000.0;
+    musicStartTicks = SDL_GetTicks();
+    if (Mix_PlayingMusic())
+        SND_MusicPlay();
+    SDL_UnlockMutex(musicLock);
 }
 
 void loadNativePNG(texture_t* tmpTex)
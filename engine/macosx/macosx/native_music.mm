@@ -65,6 +65,16 @@ void SND_ResumeSoundTrack(void)
 {
     
 }
+
+void SND_PrefetchSoundTrack(char* filename)
+{
+    
+}
+
+void SND_SeekSoundTrack(unsigned int ms)
+{
+    [sound setCurrentTime:ms / 1000.0];
+}
     
 #ifdef __cplusplus
 }
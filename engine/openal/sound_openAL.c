@@ -168,7 +168,7 @@ void SND_BACKEND_Init(void )
 
 
 
-void SND_BACKEND_Play(int sndId){
+void SND_BACKEND_Play(int sndId, float gain){
     
     //Log_Printf( "[OpenAL] Playing sound %d.\n", sndId);
     
@@ -191,7 +191,7 @@ void SND_BACKEND_Play(int sndId){
 	//alSourceStop(source);
 	
 	//Log_Printf("Uploading sound %d, sampleRate=%ld\n",sndId,sound->metaData.sample_rate);
-	alSourcef( source, AL_GAIN, 0.5f );
+	alSourcef( source, AL_GAIN, gain );
     alSourcef( source, AL_PITCH, 1.0f );
 	alSourcei( source, AL_BUFFER, alBuffer );
 	alSourcei( source, AL_LOOPING, AL_FALSE );
@@ -26,6 +26,7 @@
 #include "ItextureLoader.h"
 #include "filesystem.h"
 #include "math.h"
+#include "texcomp.h"
 
 static char gPVRTexIdentifier[4] = "PVR!";
 
@@ -206,3 +207,87 @@ void loadNativePVRT(texture_t* texture)
 		}
 	}
 }
+
+
+
+void loadNativeKTX(texture_t* texture, const char* path)
+{
+	filehandle_t* file;
+	ktx_header_t* header;
+	ubyte* ktxDataStart;
+	uint imageSize;
+	uint i;
+	
+	texture->format = TEXTURE_TYPE_UNKNOWN;
+	
+	file = FS_OpenFile(path,"rb");
+	if (!file)
+		return;
+	
+	FS_UploadToRAM(file);
+	
+	header = (ktx_header_t*)file->ptrStart;
+	
+	if (file->filesize < sizeof(ktx_header_t) ||
+		memcmp(header->identifier, ktxIdentifier, sizeof(ktxIdentifier)) ||
+		header->endianness != TEXC_KTX_ENDIANNESS)
+	{
+		Log_Printf("[loadNativeKTX] '%s' is not a native endianness KTX file.\n",path);
+		FS_CloseFile(file);
+		return;
+	}
+	
+	if (header->glType != 0 || header->numberOfFaces != 1 || header->numberOfMipmapLevels == 0)
+	{
+		Log_Printf("[loadNativeKTX] '%s' format 0x%X is not supported.\n",path,header->glInternalFormat);
+		FS_CloseFile(file);
+		return;
+	}
+	
+	texture->data =       calloc(header->numberOfMipmapLevels, sizeof(ubyte*)) ;
+	texture->dataLength = calloc(header->numberOfMipmapLevels, sizeof(int));
+	texture->numMipmaps = 0;
+	
+	ktxDataStart = (ubyte*)(header + 1) + header->bytesOfKeyValueData;
+	
+	for (i=0; i < header->numberOfMipmapLevels; i++)
+	{
+		if (ktxDataStart + sizeof(uint) > file->ptrEnd)
+			break;
+		
+		memcpy(&imageSize, ktxDataStart, sizeof(uint));
+		ktxDataStart += sizeof(uint);
+		
+		if (ktxDataStart + imageSize > file->ptrEnd)
+			break;
+		
+		texture->dataLength[texture->numMipmaps] = imageSize;
+		texture->data[texture->numMipmaps] = malloc(imageSize);
+		memcpy(texture->data[texture->numMipmaps], ktxDataStart, imageSize);
+		texture->numMipmaps++;
+		
+		//Levels are 4 bytes aligned.
+		ktxDataStart += (imageSize + 3) & ~3;
+	}
+	
+	//A truncated chain would leave the texture incomplete with the mipmap filters.
+	if (texture->numMipmaps != header->numberOfMipmapLevels)
+	{
+		Log_Printf("[loadNativeKTX] '%s' is truncated.\n",path);
+		for (i=0; i < texture->numMipmaps; i++)
+			free(texture->data[i]);
+		free(texture->data);
+		free(texture->dataLength);
+		texture->data = 0;
+		texture->dataLength = 0;
+		texture->numMipmaps = 0;
+		FS_CloseFile(file);
+		return;
+	}
+	
+	texture->width = header->pixelWidth;
+	texture->height = header->pixelHeight;
+	texture->format = header->glInternalFormat;
+	
+	FS_CloseFile(file);
+}
@@ -31,4 +31,8 @@
 void loadNativePNG(texture_t* tmpTex);
 void loadNativePVRT(texture_t* tmpTex);
 
+// Compressed mip chain from a KTX file (texcomp.h), path may differ from tmpTex->path.
+// The caller checks that the GPU supports the format.
+void loadNativeKTX(texture_t* tmpTex, const char* path);
+
 #endif
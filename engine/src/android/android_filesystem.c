@@ -102,6 +102,11 @@ filehandle_t* FS_OpenFile( const char *filename, char* mode  ){
 	return file;
 }
 
+//Assets are read only and there is no writable directory yet.
+filehandle_t* FS_OpenWritableFile( const char *filename, char* mode  ){
+	return NULL;
+}
+
 int FS_UploadToRAM(filehandle_t *fhandle){
 
 	AAsset* asset = fhandle->hFile;
@@ -141,6 +146,10 @@ SW32 FS_Write( const void * buffer, W32 size, W32 count, filehandle_t * fhandle
 	return 0;
 }
 
+int FS_Seek( filehandle_t *fhandle, SW32 offset, int origin ){
+	return -1;
+}
+
 void *FS_GetLoadedFilePointer( filehandle_t *fhandle, W32 origin )
 {
 	switch( origin )
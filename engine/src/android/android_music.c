@@ -279,6 +279,24 @@ void SND_StopSoundTrack(void){
 void SND_PauseSoundTrack(void){
 	Log_Printf("SND_PauseSoundTrack is not implemented./n");
 }
+
+//The player streams from the asset file descriptor, there is nothing to open ahead.
+void SND_PrefetchSoundTrack(char* filename){
+}
+
+void SND_SeekSoundTrack(unsigned int ms){
+
+	SLSeekItf seekItf;
+	SLresult result;
+
+	if(!musicPlayerInterface)
+		return;
+
+	result = (*musicPlayerInterface)->GetInterface(musicPlayerInterface, SL_IID_SEEK, (void*)&seekItf);
+	assert(SL_RESULT_SUCCESS == result);
+
+	(*seekItf)->SetPosition(seekItf,ms,SL_SEEKMODE_ACCURATE);
+}
 void SND_ResumeSoundTrack(void){
 	Log_Printf("SND_ResumeSoundTrack is not implemented./n");
 }
@@ -411,7 +429,8 @@ void SND_BACKEND_Upload(sound_t* sound, int soundID){
 
 }
 
-void SND_BACKEND_Play(int soundID){
+//The players have no volume interface: coalesced sounds are not louder here.
+void SND_BACKEND_Play(int soundID, float gain){
 
 
 	//Log_Printf("[SND_BACKEND_Play] %d.\n",soundID);
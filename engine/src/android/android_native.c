@@ -6,6 +6,8 @@ void SND_StartSoundTrack(void){}
 void SND_StopSoundTrack(void){}
 void SND_PauseSoundTrack(void){}
 void SND_ResumeSoundTrack(void){}
+void SND_PrefetchSoundTrack(char* filename){}
+void SND_SeekSoundTrack(unsigned int ms){}
 */
 
 
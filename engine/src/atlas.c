@@ -0,0 +1,576 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  atlas.c
+ *  dEngine
+ *
+ *  Sprite textures packed in a few atlas pages.
+ *
+ */
+
+#include "atlas.h"
+#include "filesystem.h"
+
+#ifdef COMPILE_ATLAS
+#include "ItextureLoader.h"
+#include "png.h"
+#endif
+
+static atl_page_t pages[ATL_MAX_PAGES];
+static texture_t pageTextures[ATL_MAX_PAGES];
+static int numPages;
+
+static atl_region_t regions[ATL_MAX_REGIONS];
+static int numRegions;
+
+#ifdef COMPILE_ATLAS
+static char sourcePaths[ATL_MAX_REGIONS][ATL_MAX_PATH];
+static int numSources;
+#endif
+
+void ATL_Init(void)
+{
+	filehandle_t* file;
+	atl_header_t* header;
+	int i;
+
+	numPages = 0;
+	numRegions = 0;
+
+#ifdef COMPILE_ATLAS
+	//While the atlas is being built, the sprites are loaded on their own.
+	numSources = 0;
+	return;
+#endif
+
+	file = FS_OpenFile(ATL_TABLE_PATH, "rb");
+	if (!file)
+	{
+		Log_Printf("[ATL_Init] No sprite atlas, sprites use their own textures.\n");
+		return;
+	}
+
+	FS_UploadToRAM(file);
+
+	header = (atl_header_t*)file->ptrStart;
+
+	if (file->filesize < sizeof(atl_header_t) ||
+		memcmp(header->magic, ATL_MAGIC, 4) ||
+		header->version != ATL_VERSION ||
+		header->numPages > ATL_MAX_PAGES ||
+		header->numRegions > ATL_MAX_REGIONS ||
+		file->filesize != sizeof(atl_header_t) + header->numPages * sizeof(atl_page_t) + header->numRegions * sizeof(atl_region_t))
+	{
+		Log_Printf("[ATL_Init] Found '%s' but it is not a valid sprite atlas.\n",ATL_TABLE_PATH);
+		FS_CloseFile(file);
+		return;
+	}
+
+	numPages = header->numPages;
+	numRegions = header->numRegions;
+
+	memcpy(pages, header + 1, numPages * sizeof(atl_page_t));
+	memcpy(regions, (atl_page_t*)(header + 1) + numPages, numRegions * sizeof(atl_region_t));
+
+	FS_CloseFile(file);
+
+	for (i=0; i < numPages; i++)
+	{
+		memset(&pageTextures[i], 0, sizeof(texture_t));
+		strcpy(pageTextures[i].path, pages[i].path);
+	}
+
+	Log_Printf("[ATL_Init] Sprite atlas: %d texture(s) in %d page(s).\n",numRegions,numPages);
+}
+
+static const atl_region_t* ATL_FindRegion(const char* path)
+{
+	int i;
+
+	for (i=0; i < numRegions; i++)
+		if (!strcmp(regions[i].path, path))
+			return &regions[i];
+
+	return NULL;
+}
+
+#ifdef COMPILE_ATLAS
+static void ATL_AddSource(char* path)
+{
+	int i;
+
+	for (i=0; i < numSources; i++)
+		if (!strcmp(sourcePaths[i], path))
+			return;
+
+	//Compressed textures cannot be repacked.
+	if (strcmp(FS_GetExtensionAddress(path), "png"))
+	{
+		Log_Printf("[ATL_AddSource] '%s' is not a png, it will not be packed.\n",path);
+		return;
+	}
+
+	if (numSources == ATL_MAX_REGIONS || strlen(path) >= ATL_MAX_PATH)
+	{
+		Log_Printf("[ATL_AddSource] Cannot pack '%s'.\n",path);
+		return;
+	}
+
+	strcpy(sourcePaths[numSources++], path);
+}
+#endif
+
+void ATL_MakeStaticAvailable(texture_t* texture)
+{
+	const atl_region_t* region;
+	const atl_page_t* page;
+	texture_t* pageTexture;
+
+	if (!texture)
+		return;
+
+#ifdef COMPILE_ATLAS
+	ATL_AddSource(texture->path);
+#endif
+
+	region = ATL_FindRegion(texture->path);
+	if (region == NULL)
+	{
+		TEX_MakeStaticAvailable(texture);
+		return;
+	}
+
+	page = &pages[region->page];
+	pageTexture = &pageTextures[region->page];
+
+	if (pageTexture->memLocation != TEXT_MEM_LOC_VRAM)
+		TEX_MakeStaticAvailable(pageTexture);
+
+	texture->textureId = pageTexture->textureId;
+	texture->width = region->width;
+	texture->height = region->height;
+	texture->bpp = pageTexture->bpp;
+	texture->format = pageTexture->format;
+	texture->cachable = 0;
+	texture->memStatic = 1;
+	texture->memLocation = TEXT_MEM_LOC_VRAM;
+
+	texture->inAtlas = 1;
+	texture->atlasRect[0] = region->x * SHRT_MAX / page->width;
+	texture->atlasRect[1] = region->y * SHRT_MAX / page->height;
+	texture->atlasRect[2] = region->width * SHRT_MAX / page->width;
+	texture->atlasRect[3] = region->height * SHRT_MAX / page->height;
+}
+
+void ATL_RemapUV(const texture_t* texture, vec2short_t text)
+{
+	if (!texture->inAtlas)
+		return;
+
+	text[U] = texture->atlasRect[0] + text[U] * texture->atlasRect[2] / SHRT_MAX;
+	text[V] = texture->atlasRect[1] + text[V] * texture->atlasRect[3] / SHRT_MAX;
+}
+
+#ifdef COMPILE_ATLAS
+
+/*
+	Skyline bottom-left packer: the top edge of the packed area is kept as a
+	list of horizontal segments, each texture goes where its bottom is the
+	lowest. Every texture reserves ATL_PADDING more texels on its right and
+	bottom, the page is virtually enlarged by the same amount so that a
+	texture can touch the right and bottom edges.
+*/
+
+typedef struct atl_skyline_node_t
+{
+	int x;
+	int y;
+	int width;
+} atl_skyline_node_t;
+
+static atl_skyline_node_t skyline[ATL_MAX_REGIONS*2+1];
+static int numSkylineNodes;
+static int skylineWidth;
+static int skylineHeight;
+
+static texture_t sources[ATL_MAX_REGIONS];
+static short sourcePage[ATL_MAX_REGIONS];
+static int sourceX[ATL_MAX_REGIONS];
+static int sourceY[ATL_MAX_REGIONS];
+
+static void ATL_ResetSkyline(int width, int height)
+{
+	skylineWidth = width + ATL_PADDING;
+	skylineHeight = height + ATL_PADDING;
+
+	skyline[0].x = 0;
+	skyline[0].y = 0;
+	skyline[0].width = skylineWidth;
+	numSkylineNodes = 1;
+}
+
+// Lowest y where a width x height rectangle fits starting on node i, -1 if it does not.
+static int ATL_SkylineFit(int i, int width, int height)
+{
+	int y, remaining;
+
+	if (skyline[i].x + width > skylineWidth)
+		return -1;
+
+	y = 0;
+	for (remaining = width; remaining > 0; remaining -= skyline[i].width, i++)
+	{
+		if (skyline[i].y > y)
+			y = skyline[i].y;
+
+		if (y + height > skylineHeight)
+			return -1;
+	}
+
+	return y;
+}
+
+static char ATL_SkylineInsert(int width, int height, int* x, int* y)
+{
+	int i, j, fitY, bestIndex, bestY, shrink;
+
+	width += ATL_PADDING;
+	height += ATL_PADDING;
+
+	bestIndex = -1;
+	bestY = skylineHeight;
+	for (i=0; i < numSkylineNodes; i++)
+	{
+		fitY = ATL_SkylineFit(i, width, height);
+		if (fitY != -1 && fitY < bestY)
+		{
+			bestIndex = i;
+			bestY = fitY;
+		}
+	}
+
+	if (bestIndex == -1 || numSkylineNodes == sizeof(skyline)/sizeof(skyline[0]))
+		return 0;
+
+	*x = skyline[bestIndex].x;
+	*y = bestY;
+
+	memmove(&skyline[bestIndex+1], &skyline[bestIndex], (numSkylineNodes - bestIndex) * sizeof(atl_skyline_node_t));
+	skyline[bestIndex].y = bestY + height;
+	skyline[bestIndex].width = width;
+	numSkylineNodes++;
+
+	//Cut the segments now under the new one.
+	for (j=bestIndex+1; j < numSkylineNodes; )
+	{
+		shrink = skyline[bestIndex].x + skyline[bestIndex].width - skyline[j].x;
+		if (shrink <= 0)
+			break;
+
+		skyline[j].x += shrink;
+		skyline[j].width -= shrink;
+
+		if (skyline[j].width > 0)
+			break;
+
+		memmove(&skyline[j], &skyline[j+1], (numSkylineNodes - j - 1) * sizeof(atl_skyline_node_t));
+		numSkylineNodes--;
+	}
+
+	//Merge segments at the same height.
+	for (j=0; j < numSkylineNodes-1; )
+	{
+		if (skyline[j].y != skyline[j+1].y)
+		{
+			j++;
+			continue;
+		}
+
+		skyline[j].width += skyline[j+1].width;
+		memmove(&skyline[j+1], &skyline[j+2], (numSkylineNodes - j - 2) * sizeof(atl_skyline_node_t));
+		numSkylineNodes--;
+	}
+
+	return 1;
+}
+
+// Places the sources of the list (tallest first) in a page, returns how many fit.
+static int ATL_PackPage(const int* list, int count, int page, int width, int height)
+{
+	int i, placed;
+
+	ATL_ResetSkyline(width, height);
+
+	placed = 0;
+	for (i=0; i < count; i++)
+	{
+		if (sourcePage[list[i]] != -1)
+			continue;
+
+		if (ATL_SkylineInsert(sources[list[i]].width, sources[list[i]].height, &sourceX[list[i]], &sourceY[list[i]]))
+		{
+			sourcePage[list[i]] = page;
+			placed++;
+		}
+	}
+
+	return placed;
+}
+
+static void ATL_UnpackPage(const int* list, int count, int page)
+{
+	int i;
+
+	for (i=0; i < count; i++)
+		if (sourcePage[list[i]] == page)
+			sourcePage[list[i]] = -1;
+}
+
+// Copies a source in the page and extends its edges over half the padding, so filtering never reads a neighbour.
+static void ATL_BlitSource(ubyte* pixels, int pageWidth, int pageHeight, const texture_t* source, int x, int y)
+{
+	int px, py, sx, sy, startX, startY, endX, endY;
+	const ubyte* src;
+	ubyte* dst;
+
+	startX = x - ATL_PADDING/2 < 0 ? 0 : x - ATL_PADDING/2;
+	startY = y - ATL_PADDING/2 < 0 ? 0 : y - ATL_PADDING/2;
+	endX = x + (int)source->width + ATL_PADDING/2 > pageWidth ? pageWidth : x + (int)source->width + ATL_PADDING/2;
+	endY = y + (int)source->height + ATL_PADDING/2 > pageHeight ? pageHeight : y + (int)source->height + ATL_PADDING/2;
+
+	for (py=startY; py < endY; py++)
+	{
+		sy = py - y;
+		if (sy < 0)
+			sy = 0;
+		if (sy >= (int)source->height)
+			sy = source->height - 1;
+
+		for (px=startX; px < endX; px++)
+		{
+			sx = px - x;
+			if (sx < 0)
+				sx = 0;
+			if (sx >= (int)source->width)
+				sx = source->width - 1;
+
+			src = source->data[0] + (sy * source->width + sx) * source->bpp;
+			dst = pixels + (py * pageWidth + px) * 4;
+
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+			dst[3] = source->bpp == 4 ? src[3] : 255;
+		}
+	}
+}
+
+static char ATL_WritePNG(const char* path, ubyte* pixels, int width, int height)
+{
+	filehandle_t* file;
+	png_structp png_ptr;
+	png_infop info_ptr;
+	int y;
+
+	file = FS_OpenFile(path, "wb");
+	if (!file)
+		return 0;
+
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+
+	if (info_ptr == NULL || setjmp(png_jmpbuf(png_ptr)))
+	{
+		Log_Printf("[ATL_WritePNG] Could not encode '%s'.\n",path);
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+		FS_CloseFile(file);
+		return 0;
+	}
+
+	png_init_io(png_ptr, (FILE*)file->hFile);
+	png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	png_write_info(png_ptr, info_ptr);
+
+	for (y=0; y < height; y++)
+		png_write_row(png_ptr, pixels + y * width * 4);
+
+	png_write_end(png_ptr, NULL);
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+
+	FS_CloseFile(file);
+
+	return 1;
+}
+
+void ATL_Compile(const char* tablePath)
+{
+	int list[ATL_MAX_REGIONS];
+	int count, remaining, placed;
+	int i, j, tmp, width, height, page;
+	char baseName[ATL_MAX_PATH-8];	//Room for the page number and extension.
+	ubyte* pixels;
+	filehandle_t* file;
+	atl_header_t header;
+	atl_region_t* region;
+
+	if (strlen(tablePath) >= sizeof(baseName))
+	{
+		Log_Printf("[ATL_Compile] Atlas path '%s' is too long.\n",tablePath);
+		return;
+	}
+
+	//Decode the sources.
+	count = 0;
+	for (i=0; i < numSources; i++)
+	{
+		memset(&sources[i], 0, sizeof(texture_t));
+		strcpy(sources[i].path, sourcePaths[i]);
+		loadNativePNG(&sources[i]);
+
+		sourcePage[i] = -1;
+
+		if (sources[i].format == TEXTURE_TYPE_UNKNOWN || sources[i].width > ATL_MAX_PAGE_SIZE || sources[i].height > ATL_MAX_PAGE_SIZE)
+		{
+			Log_Printf("[ATL_Compile] Skipping '%s'.\n",sources[i].path);
+			continue;
+		}
+
+		list[count++] = i;
+	}
+
+	//Tallest first, then widest.
+	for (i=1; i < count; i++)
+	{
+		for (j=i; j > 0; j--)
+		{
+			if (sources[list[j]].height < sources[list[j-1]].height ||
+				(sources[list[j]].height == sources[list[j-1]].height && sources[list[j]].width <= sources[list[j-1]].width))
+				break;
+
+			tmp = list[j];
+			list[j] = list[j-1];
+			list[j-1] = tmp;
+		}
+	}
+
+	//Each page is the smallest power of two that holds everything left, or the largest one filled as much as possible.
+	numPages = 0;
+	remaining = count;
+	while (remaining > 0 && numPages < ATL_MAX_PAGES)
+	{
+		placed = 0;
+		for (width=64; width <= ATL_MAX_PAGE_SIZE; width *= 2)
+		{
+			for (height=width/2; height <= width; height *= 2)
+			{
+				placed = ATL_PackPage(list, count, numPages, width, height);
+				if (placed == remaining || (width == ATL_MAX_PAGE_SIZE && height == width))
+					break;
+
+				ATL_UnpackPage(list, count, numPages);
+			}
+
+			if (height <= width)
+				break;
+		}
+
+		if (placed == 0)
+			break;
+
+		pages[numPages].width = width;
+		pages[numPages].height = height;
+		numPages++;
+
+		remaining -= placed;
+	}
+
+	//Page images, named after the table.
+	strcpy(baseName, tablePath);
+	*(FS_GetExtensionAddress(baseName) - 1) = '\0';
+
+	numRegions = 0;
+	for (page=0; page < numPages; page++)
+	{
+		sprintf(pages[page].path, "%s%d.png", baseName, page);
+
+		pixels = calloc(pages[page].width * pages[page].height, 4);
+
+		for (i=0; i < count; i++)
+		{
+			if (sourcePage[list[i]] != page)
+				continue;
+
+			ATL_BlitSource(pixels, pages[page].width, pages[page].height, &sources[list[i]], sourceX[list[i]], sourceY[list[i]]);
+
+			region = &regions[numRegions++];
+			memset(region, 0, sizeof(atl_region_t));
+			strcpy(region->path, sources[list[i]].path);
+			region->page = page;
+			region->x = sourceX[list[i]];
+			region->y = sourceY[list[i]];
+			region->width = sources[list[i]].width;
+			region->height = sources[list[i]].height;
+		}
+
+		if (!ATL_WritePNG(pages[page].path, pixels, pages[page].width, pages[page].height))
+			Log_Printf("[ATL_Compile] Could not create '%s'.\n",pages[page].path);
+
+		free(pixels);
+
+		Log_Printf("[ATL_Compile] Page %d: %dx%d.\n",page,pages[page].width,pages[page].height);
+	}
+
+	for (i=0; i < count; i++)
+		if (sourcePage[list[i]] == -1)
+			Log_Printf("[ATL_Compile] '%s' did not fit, it will stay on its own.\n",sources[list[i]].path);
+
+	for (i=0; i < numSources; i++)
+	{
+		if (sources[i].data)
+		{
+			free(sources[i].data[0]);
+			free(sources[i].data);
+		}
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ATL_MAGIC, 4);
+	header.version = ATL_VERSION;
+	header.numPages = numPages;
+	header.numRegions = numRegions;
+
+	file = FS_OpenFile(tablePath, "wb");
+	if (!file)
+	{
+		Log_Printf("[ATL_Compile] Could not create '%s'.\n",tablePath);
+		return;
+	}
+
+	FS_Write(&header, sizeof(header), 1, file);
+	FS_Write(pages, sizeof(atl_page_t), numPages, file);
+	FS_Write(regions, sizeof(atl_region_t), numRegions, file);
+
+	FS_CloseFile(file);
+
+	Log_Printf("[ATL_Compile] Wrote '%s': %d texture(s) in %d page(s).\n",tablePath,numRegions,numPages);
+
+	//This session keeps running on the standalone textures.
+	numPages = 0;
+	numRegions = 0;
+}
+
+#endif
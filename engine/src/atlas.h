@@ -0,0 +1,100 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  atlas.h
+ *  dEngine
+ *
+ *  Sprite textures packed in a few atlas pages.
+ *
+ */
+
+#ifndef DE_ATLAS
+#define DE_ATLAS
+
+#include "globals.h"
+#include "math.h"
+#include "texture.h"
+
+/*
+	The textures of the 2D pass (fx, bullets, pointers, font) are packed into
+	one or a few pages so the sprite batch rarely has to switch texture. The
+	atlas is written by a build with COMPILE_ATLAS defined, from every texture
+	requested through ATL_MakeStaticAvailable during the display init, and is
+	stored as ATL_TABLE_PATH plus one png per page.
+
+	File layout (native endianness, like the bundles):
+
+		atl_header_t
+		atl_page_t        [numPages]
+		atl_region_t      [numRegions]
+
+	Sprite code keeps its UVs relative to the original texture (0-SHRT_MAX).
+	A texture found in the table takes the textureId of its page and the
+	rectangle it occupies, ATL_RemapUV moves the local UVs into the page.
+	Without a table every texture is loaded on its own, as before.
+*/
+
+#define ATL_MAGIC			"ATL1"
+#define ATL_VERSION			1
+
+#define ATL_TABLE_PATH		"data/atlas/sprites.atl"
+
+#define ATL_MAX_PATH		128
+#define ATL_MAX_PAGES		4
+#define ATL_MAX_REGIONS		32
+
+#define ATL_MAX_PAGE_SIZE	2048
+#define ATL_PADDING			8		// Texels between two regions, filled with their edges.
+
+typedef struct atl_header_t
+{
+	char magic[4];
+	int version;
+	int numPages;
+	int numRegions;
+} atl_header_t;
+
+typedef struct atl_page_t
+{
+	char path[ATL_MAX_PATH];
+	ushort width;
+	ushort height;
+} atl_page_t;
+
+typedef struct atl_region_t
+{
+	char path[ATL_MAX_PATH];	// Path of the source texture, as requested by the game.
+	ushort page;
+	ushort x;
+	ushort y;
+	ushort width;
+	ushort height;
+} atl_region_t;
+
+void ATL_Init(void);
+
+// Same as TEX_MakeStaticAvailable but binds the atlas page when the texture was packed.
+void ATL_MakeStaticAvailable(texture_t* texture);
+
+// Texture local UVs to page UVs, does nothing if the texture is not in an atlas.
+void ATL_RemapUV(const texture_t* texture, vec2short_t text);
+
+#ifdef COMPILE_ATLAS
+void ATL_Compile(const char* tablePath);
+#endif
+
+#endif
@@ -0,0 +1,377 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  bundle.c
+ *  dEngine
+ *
+ *  Compiled binary scene and material bundles.
+ *
+ */
+
+#include "bundle.h"
+#include "filesystem.h"
+#include "renderer.h"
+#include "camera.h"
+#include "titles.h"
+#include "music.h"
+
+void BDL_GetBundlePath(const char* sourcePath, char* bundlePath)
+{
+	strcpy(bundlePath, sourcePath);
+	strcat(bundlePath, BDL_EXTENSION);
+}
+
+static int BDL_SceneLayoutSize(void)
+{
+	return sizeof(bdl_header_t) + sizeof(bdl_scene_t) + sizeof(bdl_entity_t) + sizeof(event_t);
+}
+
+static int BDL_MaterialsLayoutSize(void)
+{
+	return sizeof(bdl_materials_header_t) + sizeof(bdl_material_t);
+}
+
+static void BDL_ApplyScene(bdl_scene_t* scene)
+{
+	int i;
+
+	if (scene->sections & BDL_SECTION_FOG)
+	{
+		engine.fogEnabled = scene->fogEnabled;
+		renderer.fogDensity = scene->fogDensity;
+		renderer.fogStartAt = scene->fogStartAt;
+		renderer.fogStopAt = scene->fogStopAt;
+		vector4Copy(scene->fogColor, renderer.fogColor);
+	}
+
+	if (scene->sections & BDL_SECTION_PLAYER)
+	{
+		for (i=0; i < SCENE_NUM_PLAYERS; i++)
+			if (scene->playersMask & (1 << i))
+				matrixCopy(scene->playerMatrices[i], players[i].entity.matrix);
+	}
+
+	if (scene->sections & BDL_SECTION_LIGHT)
+		light = scene->light;
+
+	if (scene->sections & BDL_SECTION_CAMERA)
+	{
+		strcpy(camera.pathFilename, scene->cameraPath);
+		camera.fov = scene->cameraFov;
+		camera.zNear = scene->cameraZNear;
+		camera.zFar = scene->cameraZFar;
+		camera.aspect = 320/(float)480;
+	}
+
+	if (scene->sections & BDL_SECTION_MUSIC)
+	{
+		if (scene->musicTrack[0] != '\0')
+		{
+			engine.musicFilename[0] = '\0';
+			strcat(engine.musicFilename, FS_Gamedir());
+			strcat(engine.musicFilename,"/");
+			strcat(engine.musicFilename, scene->musicTrack);
+			
+			//Opens in the background while the rest of the scene loads.
+			SND_PrefetchSoundTrack(engine.musicFilename);
+		}
+		engine.musicStartAt = scene->musicStartAt;
+	}
+
+	if (scene->sections & BDL_SECTION_PLAYBACK)
+		engine.playback = scene->playback;
+
+	if (scene->sections & BDL_SECTION_DEFAULT_MENU)
+		engine.scenes[engine.sceneId].defaultMenuId = scene->defaultMenuId;
+
+	if (scene->sections & BDL_SECTION_SHOW_FINGERS)
+		engine.showFingers = scene->showFingers;
+
+	if (scene->sections & BDL_SECTION_TITLE && scene->titlePath[0] != '\0')
+	{
+		strcpy(titleTexture.path, scene->titlePath);
+		TEX_MakeStaticAvailable(&titleTexture);
+	}
+
+	if (scene->sections & BDL_SECTION_MAP)
+	{
+		num_map_entities = 0;
+		numBackgroundEntities = scene->numBackgroundEntities;
+	}
+}
+
+char BDL_LoadScene(const char* bundlePath)
+{
+	filehandle_t* file;
+	bdl_header_t* header;
+	bdl_scene_t* scene;
+	bdl_entity_t* entities;
+	event_t* sceneEvents;
+	int i;
+
+	file = FS_OpenFile(bundlePath, "rb");
+	if (!file)
+		return 0;
+
+	FS_UploadToRAM(file);
+
+	header = (bdl_header_t*)file->ptrStart;
+
+	if (file->filesize < sizeof(bdl_header_t) ||
+		memcmp(header->magic, BDL_SCENE_MAGIC, 4) ||
+		header->version != BDL_VERSION ||
+		header->layoutSize != BDL_SceneLayoutSize())
+	{
+		Log_Printf("[BDL_LoadScene] Found '%s' but magic number or version check failed.\n",bundlePath);
+		FS_CloseFile(file);
+		return 0;
+	}
+
+	if (header->numEntities < 0 || header->numEntities >= MAX_NUM_ENTITIES || header->numEvents < 0 ||
+		file->filesize != sizeof(bdl_header_t) + sizeof(bdl_scene_t) + header->numEntities * sizeof(bdl_entity_t) + header->numEvents * sizeof(event_t))
+	{
+		Log_Printf("[BDL_LoadScene] '%s' is truncated or corrupted.\n",bundlePath);
+		FS_CloseFile(file);
+		return 0;
+	}
+
+	scene       = (bdl_scene_t*)(header + 1);
+	entities    = (bdl_entity_t*)(scene + 1);
+	sceneEvents = (event_t*)(entities + header->numEntities);
+
+	for (i=0; i < header->numEvents; i++)
+	{
+		if (sceneEvents[i].type > EV_CLEAR_TITLE)
+		{
+			Log_Printf("[BDL_LoadScene] '%s' has an unknown event type %d.\n",bundlePath,sceneEvents[i].type);
+			FS_CloseFile(file);
+			return 0;
+		}
+	}
+
+	BDL_ApplyScene(scene);
+
+	for (i=0; i < header->numEntities; i++)
+		World_AddMapEntity(entities[i].model, entities[i].matrix);
+
+	EV_AddEvents(sceneEvents, header->numEvents);
+
+	Log_Printf("[BDL_LoadScene] Loaded %d entities and %d events.\n",header->numEntities,header->numEvents);
+
+	FS_CloseFile(file);
+	return 1;
+}
+
+char BDL_LoadMaterials(const char* bundlePath)
+{
+	filehandle_t* file;
+	bdl_materials_header_t* header;
+	bdl_material_t* bdlMaterials;
+	material_t* materials;
+	material_t* material;
+	int i,j;
+
+	file = FS_OpenFile(bundlePath, "rb");
+	if (!file)
+		return 0;
+
+	FS_UploadToRAM(file);
+
+	header = (bdl_materials_header_t*)file->ptrStart;
+
+	if (file->filesize < sizeof(bdl_materials_header_t) ||
+		memcmp(header->magic, BDL_MATERIALS_MAGIC, 4) ||
+		header->version != BDL_VERSION ||
+		header->layoutSize != BDL_MaterialsLayoutSize() ||
+		file->filesize != sizeof(bdl_materials_header_t) + header->numMaterials * sizeof(bdl_material_t))
+	{
+		Log_Printf("[BDL_LoadMaterials] Found '%s' but it is not a valid material bundle.\n",bundlePath);
+		FS_CloseFile(file);
+		return 0;
+	}
+
+	bdlMaterials = (bdl_material_t*)(header + 1);
+	materials = (material_t*)calloc(header->numMaterials, sizeof(material_t));
+
+	for (i=0; i < header->numMaterials; i++)
+	{
+		material = &materials[i];
+
+		strcpy(material->name, bdlMaterials[i].name);
+		material->shininess = bdlMaterials[i].shininess;
+		vectorCopy(bdlMaterials[i].specularColor, material->specularColor);
+		material->prop = bdlMaterials[i].prop;
+		material->hasAlpha = bdlMaterials[i].hasAlpha;
+
+		for (j=0; j < 3; j++)
+		{
+			strcpy(material->textures[j].path, bdlMaterials[i].texturePaths[j]);
+			material->textures[j].cachable = 1;
+		}
+	}
+
+	MATLIB_AddMaterials(materials, header->numMaterials);
+
+	Log_Printf("[BDL_LoadMaterials] Loaded %d materials from '%s'.\n",header->numMaterials,bundlePath);
+
+	FS_CloseFile(file);
+	return 1;
+}
+
+#ifdef COMPILE_BUNDLES
+
+static bdl_entity_t compiledEntities[MAX_NUM_ENTITIES];
+static char compileFailed;
+
+void BDL_BeginScene(void)
+{
+	compileFailed = 0;
+}
+
+void BDL_AddMapEntity(ushort uid, const char* model, matrix_t matrix)
+{
+	if (strlen(model) >= BDL_MAX_MODEL_PATH)
+	{
+		Log_Printf("[BDL_AddMapEntity] Model path '%s' is too long (> %d), scene will not be compiled.\n",model,BDL_MAX_MODEL_PATH-1);
+		compileFailed = 1;
+		return;
+	}
+
+	strcpy(compiledEntities[uid].model, model);
+	matrixCopy(matrix, compiledEntities[uid].matrix);
+}
+
+void BDL_CompileScene(const char* bundlePath, int sections, uchar playersMask)
+{
+	filehandle_t* file;
+	bdl_header_t header;
+	bdl_scene_t scene;
+	const event_t* sceneEvents;
+	int gamedirLength;
+	int i;
+
+	if (compileFailed)
+		return;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BDL_SCENE_MAGIC, 4);
+	header.version = BDL_VERSION;
+	header.layoutSize = BDL_SceneLayoutSize();
+	header.numEntities = num_map_entities;
+
+	memset(&scene, 0, sizeof(scene));
+	scene.sections = sections;
+
+	scene.fogEnabled = engine.fogEnabled;
+	scene.fogDensity = renderer.fogDensity;
+	scene.fogStartAt = renderer.fogStartAt;
+	scene.fogStopAt = renderer.fogStopAt;
+	vector4Copy(renderer.fogColor, scene.fogColor);
+
+	scene.playersMask = playersMask;
+	for (i=0; i < SCENE_NUM_PLAYERS; i++)
+		matrixCopy(players[i].entity.matrix, scene.playerMatrices[i]);
+
+	scene.light = light;
+
+	strcpy(scene.cameraPath, camera.pathFilename);
+	scene.cameraFov = camera.fov;
+	scene.cameraZNear = camera.zNear;
+	scene.cameraZFar = camera.zFar;
+
+	// The text loader prepends the game directory, bundles must stay relocatable.
+	gamedirLength = strlen(FS_Gamedir());
+	if (!strncmp(engine.musicFilename, FS_Gamedir(), gamedirLength) && engine.musicFilename[gamedirLength] == '/')
+		strcpy(scene.musicTrack, engine.musicFilename + gamedirLength + 1);
+	scene.musicStartAt = engine.musicStartAt;
+
+	scene.playback = engine.playback;
+	scene.defaultMenuId = engine.scenes[engine.sceneId].defaultMenuId;
+	scene.showFingers = engine.showFingers;
+
+	if (sections & BDL_SECTION_TITLE)
+		strcpy(scene.titlePath, titleTexture.path);
+
+	scene.numBackgroundEntities = numBackgroundEntities;
+
+	sceneEvents = EV_GetTimeline(&header.numEvents);
+
+	file = FS_OpenFile(bundlePath, "wb");
+	if (!file)
+	{
+		Log_Printf("[BDL_CompileScene] Could not create '%s'.\n",bundlePath);
+		return;
+	}
+
+	FS_Write(&header, sizeof(header), 1, file);
+	FS_Write(&scene, sizeof(scene), 1, file);
+	FS_Write(compiledEntities, sizeof(bdl_entity_t), header.numEntities, file);
+	FS_Write(sceneEvents, sizeof(event_t), header.numEvents, file);
+
+	FS_CloseFile(file);
+
+	Log_Printf("[BDL_CompileScene] Wrote '%s': %d entities, %d events.\n",bundlePath,header.numEntities,header.numEvents);
+}
+
+void BDL_CompileMaterials(const char* bundlePath)
+{
+	filehandle_t* file;
+	bdl_materials_header_t header;
+	bdl_material_t bdlMaterial;
+	material_t** materials;
+	int i,j;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BDL_MATERIALS_MAGIC, 4);
+	header.version = BDL_VERSION;
+	header.layoutSize = BDL_MaterialsLayoutSize();
+	header.numMaterials = MATLIB_CollectMaterials(NULL, 0);
+
+	materials = (material_t**)calloc(header.numMaterials, sizeof(material_t*));
+	MATLIB_CollectMaterials(materials, header.numMaterials);
+
+	file = FS_OpenFile(bundlePath, "wb");
+	if (!file)
+	{
+		Log_Printf("[BDL_CompileMaterials] Could not create '%s'.\n",bundlePath);
+		free(materials);
+		return;
+	}
+
+	FS_Write(&header, sizeof(header), 1, file);
+
+	for (i=0; i < header.numMaterials; i++)
+	{
+		memset(&bdlMaterial, 0, sizeof(bdlMaterial));
+		strcpy(bdlMaterial.name, materials[i]->name);
+		bdlMaterial.shininess = materials[i]->shininess;
+		vectorCopy(materials[i]->specularColor, bdlMaterial.specularColor);
+		bdlMaterial.prop = materials[i]->prop;
+		bdlMaterial.hasAlpha = materials[i]->hasAlpha;
+		for (j=0; j < 3; j++)
+			strcpy(bdlMaterial.texturePaths[j], materials[i]->textures[j].path);
+
+		FS_Write(&bdlMaterial, sizeof(bdlMaterial), 1, file);
+	}
+
+	FS_CloseFile(file);
+	free(materials);
+
+	Log_Printf("[BDL_CompileMaterials] Wrote '%s': %d materials.\n",bundlePath,header.numMaterials);
+}
+
+#endif
@@ -0,0 +1,157 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  bundle.h
+ *  dEngine
+ *
+ *  Compiled binary scene and material bundles.
+ *
+ */
+
+#ifndef DE_BUNDLE
+#define DE_BUNDLE
+
+#include "globals.h"
+#include "math.h"
+#include "world.h"
+#include "event.h"
+#include "dEngine.h"
+#include "player.h"
+#include "material.h"
+
+/*
+	A scene bundle is the binary image of a .scene file and everything it pulls
+	in (map, enemies, texts and events). It is written by a build with
+	COMPILE_BUNDLES defined, after the text scene has been parsed, and is
+	stored next to the scene as <scene>.bdl.
+
+	File layout (native endianness, like cp2b):
+
+		bdl_header_t
+		bdl_scene_t
+		bdl_entity_t      [numEntities]
+		event_t           [numEvents]		already sorted by time, payloads inline
+
+	A material bundle holds every material of one quality level:
+
+		bdl_materials_header_t
+		bdl_material_t    [numMaterials]
+*/
+
+#define BDL_SCENE_MAGIC		"SCB1"
+#define BDL_MATERIALS_MAGIC	"MTB1"
+#define BDL_VERSION			2
+
+#define BDL_EXTENSION		".bdl"
+
+//Top level blocks found in the scene file.
+#define BDL_SECTION_MAP				0x0001
+#define BDL_SECTION_FOG				0x0002
+#define BDL_SECTION_PLAYER			0x0004
+#define BDL_SECTION_LIGHT			0x0008
+#define BDL_SECTION_CAMERA			0x0010
+#define BDL_SECTION_MUSIC			0x0020
+#define BDL_SECTION_PLAYBACK		0x0040
+#define BDL_SECTION_DEFAULT_MENU	0x0080
+#define BDL_SECTION_SHOW_FINGERS	0x0100
+#define BDL_SECTION_TITLE			0x0200
+
+#define BDL_MAX_MODEL_PATH	128
+
+typedef struct bdl_header_t
+{
+	char magic[4];
+	int version;
+	int layoutSize;			//Sum of the record sizes: rejects bundles written by a build with different structs.
+
+	int numEntities;
+	int numEvents;
+} bdl_header_t;
+
+typedef struct bdl_scene_t
+{
+	int sections;
+
+	uchar fogEnabled;
+	float fogDensity;
+	uint fogStartAt;
+	uint fogStopAt;
+	vec4_t fogColor;
+
+	uchar playersMask;
+	matrix_t playerMatrices[SCENE_NUM_PLAYERS];
+
+	light_t light;
+
+	char cameraPath[256];
+	float cameraFov;
+	float cameraZNear;
+	float cameraZFar;
+
+	char musicTrack[256];	//Relative to the game directory.
+	uint musicStartAt;
+
+	playback_t playback;
+
+	short defaultMenuId;
+	uchar showFingers;
+
+	char titlePath[256];
+
+	int numBackgroundEntities;
+} bdl_scene_t;
+
+typedef struct bdl_entity_t
+{
+	char model[BDL_MAX_MODEL_PATH];
+	matrix_t matrix;
+} bdl_entity_t;
+
+typedef struct bdl_materials_header_t
+{
+	char magic[4];
+	int version;
+	int layoutSize;
+	int numMaterials;
+} bdl_materials_header_t;
+
+typedef struct bdl_material_t
+{
+	char name[MAX_MATERIAL_NAME_LENGTH];
+	float shininess;
+	float specularColor[3];
+	uchar prop;
+	uchar hasAlpha;
+	char texturePaths[3][256];
+} bdl_material_t;
+
+void BDL_GetBundlePath(const char* sourcePath, char* bundlePath);
+
+//Scene bundles
+char BDL_LoadScene(const char* bundlePath);
+
+//Material bundles, one per material quality.
+char BDL_LoadMaterials(const char* bundlePath);
+
+#ifdef COMPILE_BUNDLES
+void BDL_BeginScene(void);
+void BDL_AddMapEntity(ushort uid, const char* model, matrix_t matrix);
+void BDL_CompileScene(const char* bundlePath, int sections, uchar playersMask);
+void BDL_CompileMaterials(const char* bundlePath);
+#endif
+
+#endif
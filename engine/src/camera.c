@@ -77,19 +77,19 @@ void CAM_FreeCameraFrame(camera_frame_t* toDelete)
 	free(toDelete);
 }
 
+// Frames are kept until the scene is unloaded: a restored snapshot (snapshot.h) may point back at any of them.
 void CAM_ClearAllRemainingCameraVS(void)
 {
 	camera_frame_t* toDelete;
 	
-	if (camera.currentFrame == NULL)
-		return;
-	
-	while (camera.currentFrame->next != NULL && camera.currentFrame->next->time <= simulationTime)
+	while (camera.path != NULL)
 	{
-		toDelete =  camera.currentFrame;
-		camera.currentFrame = camera.currentFrame->next;
+		toDelete = camera.path;
+		camera.path = camera.path->next;
 		CAM_FreeCameraFrame(toDelete);
 	}
+	
+	camera.currentFrame = NULL;
 }
 
 void CAM_Update(void)
@@ -98,7 +98,6 @@ void CAM_Update(void)
 	quat4_t			interpolatedQuaterion;
 	matrix3x3_t		interpolatedOrientationMatrix;
 	camera_frame_t* nextFrame = 0;
-	camera_frame_t* toDelete = 0;
 	
 	if (!camera.playing)
 		return;
@@ -115,9 +114,7 @@ void CAM_Update(void)
 		//Log_Printf("Jumping into vis_update().\n");
 		VIS_Update();
 		
-		toDelete = camera.currentFrame;
 		camera.currentFrame = camera.currentFrame->next;
-		CAM_FreeCameraFrame(toDelete);
 	}	
 		
 	//Log_Printf("frame t=%d.\n",camera.currentFrame->time);
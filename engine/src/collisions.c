@@ -139,6 +139,7 @@
 #include "sounds.h"
 #include "dEngine.h"
 #include "enemy_particules.h"
+#include "rollback.h"
 
 plan_t unitCubePlans[6];
 
@@ -345,13 +346,13 @@ void Spawn_BulletParticules(bullet_t* bullet, int type)
 	
 	
 	//Particule here
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
 	random[X] /= 4;
 	random[Y] =  1;
 	normalize2(random);
 	FX_GetParticule(enemy->ss_position,random 	,0.01*PARTICULE_SIZE_GLOBAL*ENTITY_EX_PARTICULE_RATIO	,PARTICULE_TRAVEL_DIST/1.4f,PARTICULE_TYPE_EXPLOSION, PARTICULE_COLOR_BLUE,PARTICULE_DEFAULT_STRECH-1);
 	
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
 	random[X] /= 2;
 	random[Y] = 1;	
 	normalize2(random);
@@ -375,8 +376,8 @@ void Spawn_EntityParticules(vec2_t ss_position)
 {
 	vec2_t random ;
 	
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
-	random[Y] = (rand() - RAND_MAX ) / (float)RAND_MAX;
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
+	random[Y] = (randomNext() - RANDOM_MAX ) / (float)RANDOM_MAX;
 	normalize2(random);
 	FX_GetParticule(ss_position,random		,0.012*PARTICULE_SIZE_GLOBAL*ENTITY_EX_PARTICULE_RATIO	,PARTICULE_TRAVEL_DIST,PARTICULE_TYPE_EXPLOSION, PARTICULE_COLOR_YELLOW,PARTICULE_DEFAULT_STRECH-1);
 	random[X]+=0.1f;
@@ -386,13 +387,13 @@ void Spawn_EntityParticules(vec2_t ss_position)
 	
 	
 	
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
-	random[Y] = (rand() - RAND_MAX ) / (float)RAND_MAX;
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
+	random[Y] = (randomNext() - RANDOM_MAX ) / (float)RANDOM_MAX;
 	normalize2(random);
 	FX_GetParticule(ss_position,random 	,0.014*PARTICULE_SIZE_GLOBAL*ENTITY_EX_PARTICULE_RATIO	,PARTICULE_TRAVEL_DIST,PARTICULE_TYPE_EXPLOSION, PARTICULE_COLOR_YELLOW,PARTICULE_DEFAULT_STRECH-1);
 	
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
-	random[Y] = -(rand() - RAND_MAX ) / (float)RAND_MAX;
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
+	random[Y] = -(randomNext() - RANDOM_MAX ) / (float)RANDOM_MAX;
 	normalize2(random);
 	FX_GetParticule(ss_position, random	,0.012*PARTICULE_SIZE_GLOBAL*ENTITY_EX_PARTICULE_RATIO	,PARTICULE_TRAVEL_DIST,PARTICULE_TYPE_EXPLOSION, PARTICULE_COLOR_YELLOW,PARTICULE_DEFAULT_STRECH);
 	random[X]+=0.1f;
@@ -401,36 +402,169 @@ void Spawn_EntityParticules(vec2_t ss_position)
 	FX_GetParticule(ss_position, random	,0.015*PARTICULE_SIZE_GLOBAL*ENTITY_EX_PARTICULE_RATIO	,PARTICULE_TRAVEL_DIST+PARTICULE_TRAVEL_DIST*15/100,PARTICULE_TYPE_EXPLOSION, PARTICULE_COLOR_YELLOW,PARTICULE_DEFAULT_STRECH-1);
 }
 
-void COLL_CheckPlayers(void)
+static void COLL_CheckPlayerAgainstBullets(int playerId)
 {
 	int j;
 	
 	// User in invulnerable
-	if (players[controlledPlayer].invulnerableFor > 0)
+	if (players[playerId].invulnerableFor > 0)
 		return;
 		
 	for (j=0; j < partLib.numParticules; j++) 
 	{
-		if (players[controlledPlayer].ss_boudaries[DOWN]  >  partLib.particules[j].ss_boudaries[UP]    ||
-			players[controlledPlayer].ss_boudaries[UP]    <  partLib.particules[j].ss_boudaries[DOWN]  ||
-			players[controlledPlayer].ss_boudaries[LEFT]  >  partLib.particules[j].ss_boudaries[RIGHT] ||
-			players[controlledPlayer].ss_boudaries[RIGHT] <  partLib.particules[j].ss_boudaries[LEFT]
+		if (players[playerId].ss_boudaries[DOWN]  >  partLib.particules[j].ss_boudaries[UP]    ||
+			players[playerId].ss_boudaries[UP]    <  partLib.particules[j].ss_boudaries[DOWN]  ||
+			players[playerId].ss_boudaries[LEFT]  >  partLib.particules[j].ss_boudaries[RIGHT] ||
+			players[playerId].ss_boudaries[RIGHT] <  partLib.particules[j].ss_boudaries[LEFT]
 		)
 			continue;
 		
 		//We have a collision here
 		
-		P_Die(controlledPlayer);
+		P_Die(playerId);
 		partLib.particules[j].ttl = 0;
 	}
+}
+
+static void COLL_CheckPlayerAgainstEnemies(int playerId)
+{
+	enemy_t* enemy;
 	
+	// User in invulnerable
+	if (players[playerId].invulnerableFor > 0)
+		return;
+	
+	
+	enemy = ENE_GetFirstEnemy();
+	while (enemy != NULL) 
+	{
+		
+		if (enemy->ss_boudaries[DOWN]  >  players[playerId].ss_boudaries[UP] ||
+			enemy->ss_boudaries[UP]    <  players[playerId].ss_boudaries[DOWN] ||
+			enemy->ss_boudaries[LEFT]  >  players[playerId].ss_boudaries[RIGHT] ||
+			enemy->ss_boudaries[RIGHT] <  players[playerId].ss_boudaries[LEFT]
+			)
+		{
+			enemy = enemy->next;
+			continue;
+		}
+		else 
+		{
+			P_Die(playerId);
+			break;
+		}
+	}
+}
+
+// With rollback both peers simulate every player, otherwise the remote one reports its own death.
+void COLL_CheckPlayers(void)
+{
+	int i;
+	
+	if (!RB_IsRunning())
+	{
+		COLL_CheckPlayerAgainstBullets(controlledPlayer);
+		return;
+	}
+	
+	for (i=0; i < numPlayers; i++)
+		COLL_CheckPlayerAgainstBullets(i);
+}
+
+// Live bullets and ghosts of every player, gathered once per frame in the order the enemies used to scan them.
+typedef struct coll_shot_t
+{
+	void* shot;				// bullet_t or ghost_t
+	uchar playerId;
+} coll_shot_t;
+
+#define COLL_MAX_SHOTS (MAX_NUM_PLAYERS * MAX_PLAYER_BULLETS)	// There are fewer ghosts than bullets.
+
+typedef struct coll_shots_t
+{
+	int num;
+	coll_shot_t shots[COLL_MAX_SHOTS];
+	short ss_boudaries[4];	// Of all of them: an enemy outside skips the list.
+} coll_shots_t;
+
+static coll_shots_t liveBullets;
+static coll_shots_t liveGhosts;
+
+static void COLL_AddShot(coll_shots_t* shots, void* shot, uchar playerId, short up, short down, short left, short right)
+{
+	if (shots->num == 0)
+	{
+		shots->ss_boudaries[UP] = up;
+		shots->ss_boudaries[DOWN] = down;
+		shots->ss_boudaries[LEFT] = left;
+		shots->ss_boudaries[RIGHT] = right;
+	}
+	else 
+	{
+		shots->ss_boudaries[UP] = MAX(shots->ss_boudaries[UP], up);
+		shots->ss_boudaries[DOWN] = MIN(shots->ss_boudaries[DOWN], down);
+		shots->ss_boudaries[LEFT] = MIN(shots->ss_boudaries[LEFT], left);
+		shots->ss_boudaries[RIGHT] = MAX(shots->ss_boudaries[RIGHT], right);
+	}
+	
+	shots->shots[shots->num].shot = shot;
+	shots->shots[shots->num].playerId = playerId;
+	shots->num++;
+}
+
+// A bullet stays live for the whole frame (a hit sets its expiration to now), a ghost has its energy checked again on use.
+static void COLL_GatherShots(void)
+{
+	player_t* player;
+	bullet_t* bullet;
+	ghost_t* ghost;
+	int i,j;
+	
+	liveBullets.num = 0;
+	liveGhosts.num = 0;
+	
+	for(i=0 ; i < numPlayers ; i++)
+	{
+		player = &players[i];
+		
+		for (j=0; j< MAX_PLAYER_BULLETS; j++) 
+		{
+			bullet = &player->bullets[j];
+			if (bullet->expirationTime < simulationTime)
+				continue;
+			
+			COLL_AddShot(&liveBullets, bullet, i, bullet->ss_boudaries[UP], bullet->ss_boudaries[DOWN], bullet->ss_boudaries[LEFT], bullet->ss_boudaries[RIGHT]);
+		}
+	}
+	
+	for(i=0 ; i < numPlayers ; i++)
+	{
+		player = &players[i];
+		
+		for (j=0; j < GHOSTS_NUM; j++) 
+		{
+			ghost = &player->ghosts[j];
+			if (ghost->timeCounter >= GHOST_TTL_MS || ghost->energy <= 0)
+				continue;
+			
+			COLL_AddShot(&liveGhosts, ghost, i, ghost->short_ss_position[Y], ghost->short_ss_position[Y], ghost->short_ss_position[X], ghost->short_ss_position[X]);
+		}
+	}
+}
+
+static char COLL_OutsideShots(const short* ss_enemy_boudaries, const coll_shots_t* shots)
+{
+	return shots->num == 0 ||
+		   ss_enemy_boudaries[DOWN]  >  shots->ss_boudaries[UP]    ||
+		   ss_enemy_boudaries[UP]    <  shots->ss_boudaries[DOWN]  ||
+		   ss_enemy_boudaries[LEFT]  >  shots->ss_boudaries[RIGHT] ||
+		   ss_enemy_boudaries[RIGHT] <  shots->ss_boudaries[LEFT];
 }
 
 void COLL_CheckEnemies(void)
 {
 	enemy_t* enemy;
-	player_t* player;
-	bullet_t* bullets;
+	bullet_t* bullet;
 	ghost_t* ghost;
 	const short* ss_bullet_boudaries;
 	const short* ss_enemy_boudaries;
@@ -438,6 +572,7 @@ void COLL_CheckEnemies(void)
 	ushort tmpEnergy;
 	
     
+	COLL_GatherShots();
     
 	enemy = ENE_GetFirstEnemy();
 	
@@ -447,17 +582,14 @@ void COLL_CheckEnemies(void)
 		
 		
 		// Enenemy VS Player's bullet
-		for(i=0 ; i < numPlayers ; i++)
+		if (!COLL_OutsideShots(ss_enemy_boudaries, &liveBullets))
 		{
-			player = &players[i];
-			bullets = player->bullets;
-			
-			for (j=0; j< MAX_PLAYER_BULLETS; j++) 
+			for (j=0; j < liveBullets.num; j++) 
 			{
-				if (bullets[j].expirationTime < simulationTime)
-					continue;
+				bullet = (bullet_t*)liveBullets.shots[j].shot;
+				i = liveBullets.shots[j].playerId;
 				
-				ss_bullet_boudaries= bullets[j].ss_boudaries;
+				ss_bullet_boudaries= bullet->ss_boudaries;
 				
 				if (ss_enemy_boudaries[DOWN]  >  ss_bullet_boudaries[UP]    ||
 					ss_enemy_boudaries[UP]    <  ss_bullet_boudaries[DOWN]  ||
@@ -471,15 +603,15 @@ void COLL_CheckEnemies(void)
 				//We have a collision here
 				enemy->shouldFlicker = 1;
 				
-				tmpEnergy = bullets[j].energy ;
-				bullets[j].energy -= MAX(enemy->energy,0);
+				tmpEnergy = bullet->energy ;
+				bullet->energy -= MAX(enemy->energy,0);
 				enemy->energy -= MAX(tmpEnergy,0);		
 				
-				if (bullets[j].energy <= 0)
+				if (bullet->energy <= 0)
 				{
 
-					bullets[j].expirationTime = simulationTime ;
-					Spawn_BulletParticules(&bullets[j],i);
+					bullet->expirationTime = simulationTime ;
+					Spawn_BulletParticules(bullet,i);
 				}
 				
 				if (enemy->energy <= 0)
@@ -487,24 +619,21 @@ void COLL_CheckEnemies(void)
 					engine.playerStats.enemyDestroyed[i]++;
 					players[i].score += enemy->score * 2;
 				}
-								
 			}
-			
 		}
 		
 	
 		
 		
 		//Enemy Vs Player's GHOST
-		for(i=0 ; i < numPlayers ; i++)
+		if (!COLL_OutsideShots(ss_enemy_boudaries, &liveGhosts))
 		{
-			player = &players[i];
-			
-			for (j=0; j < GHOSTS_NUM; j++) 
+			for (j=0; j < liveGhosts.num; j++) 
 			{
-				ghost = &player->ghosts[j];
+				ghost = (ghost_t*)liveGhosts.shots[j].shot;
+				i = liveGhosts.shots[j].playerId;
 				
-				if (ghost->timeCounter >= GHOST_TTL_MS || ghost->energy <= 0)
+				if (ghost->energy <= 0)
 					continue;
 				
 				
@@ -549,8 +678,8 @@ void COLL_CheckEnemies(void)
 			
 			// spawn an explosion
 			FX_GetExplosion(enemy->ss_position,IMPACT_TYPE_YELLOW,1,0);
-			//enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
-			//enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
+			//enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
+			//enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
 			//FX_GetExplosion(enemy);
 			
 			
@@ -559,8 +688,8 @@ void COLL_CheckEnemies(void)
 			// spwan smoke
 			
 			FX_GetSmoke(enemy->ss_position, 0.3, 0.3);
-			enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
-			enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
+			enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
+			enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
 			FX_GetSmoke(enemy->ss_position, 0.2, 0.2);
 			
 			ENE_Release(enemy);
@@ -574,32 +703,14 @@ void COLL_CheckEnemies(void)
 	
 	
 	//Now Check local player's collisions
-	
-	
-	// User in invulnerable
-	if (players[controlledPlayer].invulnerableFor > 0)
-		return;
-	
-	
-	enemy = ENE_GetFirstEnemy();
-	while (enemy != NULL) 
+	if (!RB_IsRunning())
 	{
-		
-		if (enemy->ss_boudaries[DOWN]  >  players[controlledPlayer].ss_boudaries[UP] ||
-			enemy->ss_boudaries[UP]    <  players[controlledPlayer].ss_boudaries[DOWN] ||
-			enemy->ss_boudaries[LEFT]  >  players[controlledPlayer].ss_boudaries[RIGHT] ||
-			enemy->ss_boudaries[RIGHT] <  players[controlledPlayer].ss_boudaries[LEFT]
-			)
-		{
-			enemy = enemy->next;
-			continue;
-		}
-		else 
-		{
-			P_Die(controlledPlayer);
-			break;
-		}
+		COLL_CheckPlayerAgainstEnemies(controlledPlayer);
+		return;
 	}
+	
+	for (i=0; i < numPlayers; i++)
+		COLL_CheckPlayerAgainstEnemies(i);
 }		
 
 
@@ -30,15 +30,11 @@
 #include "filesystem.h"
 #include "dEngine.h"
 #include "titles.h"
+#include "record.h"
+#include "rollback.h"
 
 command_buffer_t commandsBuffers[MAX_NUM_PLAYERS];
 
-command_t* currentRecordCommand;
-command_t* lastRecordCommand;
-
-#define NUM_RECORD_FRAMES (240*60*2)
-command_t recordCommands[NUM_RECORD_FRAMES];
-
 command_t toSend;
 
 touch_t touches[NUM_BUTTONS];
@@ -476,7 +472,7 @@ void COM_ExecCommand(command_t* command)
 			
 			//Log_Printf("engine.showFingers=%d\n",engine.showFingers);
 			
-			if (engine.showFingers)
+			if (engine.showFingers && !RB_IsResimulating())
 				COM_PrepareFingerSprites(command);
 			
 			//Check the commands
@@ -539,29 +535,15 @@ void COM_UpdateRecord(void)
 {
 	int i;
 	int numCmds;
-	command_t* command;
 	
 	if (!engine.playback.record)
 		return;
-		
-	if (lastRecordCommand < currentRecordCommand)
-	{
-		Log_Printf("Command buffer overflow: stop recording !!\n");
-		engine.playback.record = 0;
-		return;
-	}
 	
-			
 	for(i = 0 ; i < numPlayers ; i++)
 	for (numCmds=0; numCmds < commandsBuffers[i].numCommands; numCmds++) 
 	{
-		command = &commandsBuffers[i].cmds[numCmds];
-		memcpy(currentRecordCommand, command, sizeof(command_t));
-		currentRecordCommand++;
+		REC_RecordCommand(&commandsBuffers[i].cmds[numCmds]);
 	}
-			
-			
-	
 }
 
 void COM_Update(void)
@@ -578,17 +560,29 @@ void COM_Update(void)
 	
 	COM_UpdateGhostButton();
 	
+	//Rollback runs the commands itself, on the frame they apply to.
+	if (RB_IsRunning())
+	{
+		if (commandsBuffers[controlledPlayer].numCommands)
+			RB_AddLocalCommand(&commandsBuffers[controlledPlayer].cmds[commandsBuffers[controlledPlayer].numCommands-1]);
+		
+		for(i = 0 ; i < numPlayers ; i++)
+			commandsBuffers[i].numCommands = 0;
+		
+		return;
+	}
+	
 	//If playing we need to play the commands in the buffer
 	if (engine.playback.play)
 	{
-		//printf("Next command t=%u.\n",currentRecordCommand->time);
-		while (lastRecordCommand > currentRecordCommand && currentRecordCommand->time <= simulationTime) 
+		//Commands are decoded lazily from the record, one at a time.
+		while ((command = REC_PeekCommand()) != NULL && command->time <= simulationTime) 
 		{
 			//TO REMOVE This is only here to record a multiplayer game
-			memcpy(&toSend, currentRecordCommand, sizeof(command_t));
+			memcpy(&toSend, command, sizeof(command_t));
 			//TO REMOVE
-			COM_ExecCommand(currentRecordCommand);
-			currentRecordCommand++;
+			COM_ExecCommand(command);
+			REC_NextCommand();
 		}
 	}
 	else 
@@ -619,6 +613,18 @@ void COM_Update(void)
 }
 
 
+void COM_ExecRollbackFrame(void)
+{
+	int i;
+	
+	if (!RB_IsRunning() || !entitiesAttachedToCamera)
+		return;
+	
+	for (i=0; i < numPlayers; i++) 
+		COM_ExecCommand((command_t*)RB_GetCommand(i));
+}
+
+
 void COM_ClearBuffers(void)
 {
 	int i;
@@ -638,39 +644,13 @@ void COM_ClearBuffers(void)
 
 void COM_StopRecording(void)
 {
-	filehandle_t* ioFileHandle;
-	int int_numPlayers;
-	
 	if (!engine.playback.record)
 		return;
 		
 	engine.playback.record = 0;
 	
-    Log_Printf("[COM_StopRecording] WARNING Writing command record to disk is DISABLED !!!\n");
-    
-	/*
-	Log_Printf("[COM_StopRecording] Writing command record to disk.\n");
-	//printf("[COM_StartScene] Allocating %lu kb for inputs recording.\n",NUM_RECORD_FRAMES*sizeof(commandHistoryElem_t)/1024);
-	
-    
-    
-	ioFileHandle = FS_OpenFile(engine.playback.filename,"wb");
-	FS_UploadToRAM(ioFileHandle);
-
-	if (!ioFileHandle)
-	{
-		Log_Printf("[COM_StopRecording] Unable to create commandHistory file: %s.\n",engine.playback.filename);
-		return;
-	}
-	
-	int_numPlayers = numPlayers;
-	Log_Printf("Writing numPlayer=%d to file record\n",int_numPlayers);
-	FS_Write(&int_numPlayers,sizeof(int),1, ioFileHandle);
-	FS_Write(recordCommands, sizeof(command_t), NUM_RECORD_FRAMES, ioFileHandle);
-	FS_CloseFile(ioFileHandle);
-*/
-	
-	
+	//Flushes the last chunk and waits for the writer thread.
+	REC_StopRecording();
 }
 
 
@@ -678,9 +658,10 @@ void COM_StopRecording(void)
 void COM_StartScene(void)
 {
 	static char filename[1024];
-	//Check if we need to play or record
-	filehandle_t* ioFileHandle;
+	int recordNumPlayers;
 
+	REC_ClosePlayback();
+	
 	if (engine.playback.play && engine.playback.record)
 	{
 		Log_Printf("[COM_StartScene] Unable to play and record at the same time: Giving priority to playback.\n");
@@ -695,46 +676,31 @@ void COM_StartScene(void)
 		filename[0] = '\0';
 		strcat(filename,"/data/commandRecord/");
 		strcat(filename,engine.playback.filename);
-		ioFileHandle = FS_OpenFile(filename,"rb"); 
-		FS_UploadToRAM(ioFileHandle);
 		
-		if (!ioFileHandle)
+		recordNumPlayers = REC_OpenPlayback(filename);
+		
+		if (recordNumPlayers < 0)
 		{
 			engine.playback.play = 0;
-			//FS_CloseFile(ioFileHandle);
 			Log_Printf("[COM_StartScene] Cannot start playback: io file missing.\n");
 			return;
 		}
 		
-		numPlayers = *((int*)ioFileHandle->ptrStart);
+		numPlayers = recordNumPlayers;
 		
 		Log_Printf("Found %d players in this playback.\n",numPlayers);
-		
-		//recordCommands = calloc(NUM_RECORD_FRAMES, sizeof(command_t));
-		currentRecordCommand = recordCommands;
-		memcpy(recordCommands, ioFileHandle->ptrStart+4, sizeof(command_t)*NUM_RECORD_FRAMES);
-		//recordCommands = (command_t*)(ioFileHandle->ptrStart+1);
-		lastRecordCommand = currentRecordCommand + NUM_RECORD_FRAMES-1 ;
-		
-		
-		
-		FS_CloseFile(ioFileHandle);
 	}
 	
 	if (engine.playback.record)
 	{
-		//recordCommands = calloc(NUM_RECORD_FRAMES, sizeof(command_t));
-		currentRecordCommand = recordCommands;
-		
-		lastRecordCommand = currentRecordCommand + NUM_RECORD_FRAMES-1 ;
+		if (!REC_StartRecording(engine.playback.filename, numPlayers))
+			engine.playback.record = 0;
 	}	
 }
 
 void COM_EndtScene(void)
 {
-	
-	//free(recordCommands);
-	//recordCommands = 0;
+	REC_ClosePlayback();
 }
 
 
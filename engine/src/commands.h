@@ -77,6 +77,7 @@ void COM_Init(void);
 void COM_StartScene(void);
 void COM_EndtScene(void);
 void COM_Update(void) ;
+void COM_ExecRollbackFrame(void);
 void COM_StopRecording(void);
 void COM_InitPlayback(char* filename);
 
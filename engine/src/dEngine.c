@@ -53,6 +53,9 @@
 #include "enemy_particules.h"
 #include "text.h"
 #include "event.h"
+#include "atlas.h"
+#include "snapshot.h"
+#include "rollback.h"
 
 engine_info_t engine;
 
@@ -153,6 +156,28 @@ bool dEngine_ReadConfig(void)
 				}
 			}
 		}
+		else if (!strcmp("net", LE_getCurrentToken()))
+		{
+			LE_readToken(); //{
+			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
+			{
+				LE_readToken();
+				
+				if (!strcmp("inputDelay", LE_getCurrentToken()))
+					engine.netInputDelay = LE_readReal();
+			}
+		}
+		else if (!strcmp("renderer", LE_getCurrentToken()))
+		{
+			LE_readToken(); //{
+			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
+			{
+				LE_readToken();
+				
+				if (!strcmp("shadowUpdatePeriod", LE_getCurrentToken()))
+					renderer.shadowUpdatePeriod = LE_readReal();
+			}
+		}
 		/*
 		else if (!strcmp("video", LE_getCurrentToken()))
 		{
@@ -326,6 +351,7 @@ bool dEngine_Init(void)
 	ENT_InitCacheSystem();
 	TEXT_InitCacheSystem();
 	MAT_InitCacheSystem();
+	ATL_Init();
 
 #ifdef GENERATE_VIDEO	
 	dEngine_INIT_ScreenshotBuffer();
@@ -343,6 +369,8 @@ bool dEngine_Init(void)
 	engine.soundEnabled = 1;
 	engine.musicEnabled = 1;
 	engine.gameCenterEnabled = 0;
+	engine.netInputDelay = RB_DEFAULT_INPUT_DELAY;
+	renderer.shadowUpdatePeriod = SHADOW_UPDATE_PERIOD;
 	
 	ENPAR_Init();
 	
@@ -386,13 +414,18 @@ void dEngine_InitDisplaySystem(uchar rendererType)
 	
 	P_CreatePointerCoordinates();
 	
+#ifdef COMPILE_ATLAS
+	//Every sprite texture has been requested by now.
+	ATL_Compile(ATL_TABLE_PATH);
+#endif
+	
 	engine.menuVisible = 0;
 	MENU_Set(MENU_HOME);
 }
 
 void dEngine_LoadScene(int sceneId)
 {
-	event_t* ev;
+	event_t ev;
 	
 	COM_StopRecording();
 
@@ -419,6 +452,7 @@ void dEngine_LoadScene(int sceneId)
 	
 	// Now actually start loading things
 	World_OpenScene(engine.scenes[engine.sceneId].path);
+	P_PlaceExtraPlayers();
 	
 	MENU_Set(engine.scenes[engine.sceneId].defaultMenuId);
 	
@@ -447,6 +481,10 @@ void dEngine_LoadScene(int sceneId)
 	
 	Timer_resetTime();
 	
+	//Every run of a scene draws the same random numbers, earlier snapshots point into freed data.
+	randomSeed(sceneId + 1);
+	SNAP_NewScene();
+	
 	//In single player we start right away, in multiplayer the go is given by the netchannel
 	if (engine.mode == DE_MODE_SINGLEPLAYER)
 		Timer_Resume();
@@ -455,10 +493,10 @@ void dEngine_LoadScene(int sceneId)
 	
 	if (engine.sceneId == 1 && engine.licenseType == LICENSE_LIMITED)
 	{
-		ev = calloc(1, sizeof(event_t));
-		ev->time = 130000;
-		ev->type = EV_LIMITED_EVENT;
-		EV_AddEvent(ev);
+		memset(&ev, 0, sizeof(event_t));
+		ev.time = 130000;
+		ev.type = EV_LIMITED_EVENT;
+		EV_AddEvent(&ev);
 	}
     
     //We are back to main menu, init a few things
@@ -495,6 +533,7 @@ void dEngine_FreeSceneRessources(void)
 	World_ClearWorldMap();
 	
 	COM_ClearBuffers();
+	COM_EndtScene();
 	
 	TITLE_FreeRessources();
 }
@@ -503,8 +542,6 @@ int timeJumpCounter =0;//;
 int timeJumpTarget = 19250;
 void dEngine_JumpInTime(void)
 {
-	event_t* event;
-	event_t* toDelete;
 	int i;
 	
 	if (timeJumpCounter >0)
@@ -513,25 +550,8 @@ void dEngine_JumpInTime(void)
 		Timer_Pause();
 		renderer.enabled=0;
 		
-		//Remove all futur enemy spawning events.
-		event = EV_GetNextEvent();
-		
-		while (event != NULL) 
-		{			
-			while (event->next != NULL && event->next->time <= timeJumpTarget && event->next->type == EV_SPAWN_ENEMY)
-			{
-				//Log_Printf("[dEngine_JumpInTime] Cleaning EV_SPAWN_ENEMY events t=%d.\n",event->next->time);
-				
-				toDelete = event->next;
-				event->next = event->next->next;
-				
-				free(toDelete->payload);
-				free(toDelete);
-			}
-			
-			
-			event = event->next;
-		}
+		//Skip all enemy spawning events until the target.
+		EV_CancelSpawnsUntil(timeJumpTarget);
 		
 	//	Log_Printf("[dEngine_JumpInTime] events cleaned.\n");
 		
@@ -551,6 +571,9 @@ void dEngine_JumpInTime(void)
 			players[i].showPointer = 0;
 		}
 		
+		//The music played in real time during the jump, move it to the simulation.
+		SND_SeekSoundTrack(engine.musicStartAt * 1000 + simulationTime);
+		
 		//Resume the timer
 		Timer_Resume();
 		renderer.enabled = 1;
@@ -584,44 +607,37 @@ void dEngine_CheckState(void)
 	
 }
 
-void dEngine_HostFrame(void)
+// Every peer of a session and its server start from the scene loaded this way.
+void dEngine_LoadMultiplayerScene(int sceneId, uchar sessionPlayers)
 {
-	// Load a new scene/menu if needed
-	dEngine_CheckState();
-	
-	
-	Timer_tick();
-	
-	
-	diverSpriteLib.numVertices=0;
-	diverSpriteLib.numIndices=0;
-	
-#ifdef GENERATE_VIDEO	
-	if (MENU_Get() == 0 && simulationTime > 57000 && !MENU_GetCurrentButtonTouches()[0].down)
-		MENU_GetCurrentButtonTouches()[0].down = 1 ;
-	
-	SND_UpdateRecord();
-#endif	
+	int i;
 	
-	NET_Setup();
+	//Set before loading: P_PlaceExtraPlayers lines up the ships past the second one.
+	numPlayers = sessionPlayers;
 	
-	NET_Receive();
-	COM_Update();
-	NET_Send();
+	engine.mode = DE_MODE_MULTIPLAYER;
+	engine.difficultyLevel = DIFFICULTY_NORMAL;
+	PL_ResetPlayersScore();
 	
+	for (i=0; i < MAX_NUM_PLAYERS; i++)
+		players[i].respawnCounter = numPlayerRespawn[DIFFICULTY_NORMAL];
 	
+	dEngine_RequireSceneId(sceneId);
+	dEngine_CheckState();
 	
+	numPlayers = sessionPlayers;
+}
+
+// Everything the peers must agree on, rollback.c runs it again for re-simulated frames.
+void dEngine_SimulateFrame(void)
+{
+	COM_ExecRollbackFrame();
 	
 	//Init the enemy FX system 
 	ENPAR_StartEnemyFX();
 	
-
-	
 	EV_Update();
-	TITLE_Update();
 	CAM_Update();
-	DYN_TEXT_Update();
-	//NET_Update();
 	
 	//Check collisions.
     COLL_CheckEnemies();
@@ -635,10 +651,10 @@ void dEngine_HostFrame(void)
 	FX_UpdateExplosions();
 	FX_UpdateParticules();
 	FX_UpdateSmoke();
+}
 
-	
-
-	//Rendition
+static void dEngine_RenderFrame(void)
+{
 	P_PrepareBulletSprites();
 	P_PrepareGhostSprites();
 	FX_PrepareSmokeSprites();
@@ -646,10 +662,55 @@ void dEngine_HostFrame(void)
 	
 	SCR_RenderFrame();
 	
-	
-	
 	if (engine.menuVisible)
 		MENU_HandleTouches();
+}
+
+void dEngine_HostFrame(void)
+{
+	// Load a new scene/menu if needed
+	dEngine_CheckState();
+	
+	NET_Setup();
+	NET_Receive();
+	
+	//Waiting on the remote inputs: show the same frame again.
+	if (!RB_CanAdvance())
+	{
+		NET_Send();
+		diverSpriteLib.numVertices=0;
+		diverSpriteLib.numIndices=0;
+		dEngine_RenderFrame();
+		return;
+	}
+	
+	Timer_tick();
+	
+	
+	diverSpriteLib.numVertices=0;
+	diverSpriteLib.numIndices=0;
+	
+#ifdef GENERATE_VIDEO	
+	if (MENU_Get() == 0 && simulationTime > 57000 && !MENU_GetCurrentButtonTouches()[0].down)
+		MENU_GetCurrentButtonTouches()[0].down = 1 ;
+	
+	SND_UpdateRecord();
+#endif	
+	
+	COM_Update();
+	RB_BeginFrame();
+	NET_Send();
+	
+	dEngine_SimulateFrame();
+	
+	TITLE_Update();
+	DYN_TEXT_Update();
+	
+	//Play the sounds triggered by this frame.
+	SND_Update();
+
+	//Rendition
+	dEngine_RenderFrame();
 	
 #ifdef GENERATE_VIDEO
 		dEngine_WriteScreenshot(screenShotDirectory);
@@ -122,6 +122,8 @@ typedef struct engine_info_t
 	
 	uchar difficultyLevel ;
 	
+	int netInputDelay;		// Frames, rollback.h.
+	
 }  engine_info_t;
 
 extern engine_info_t engine;
@@ -134,7 +136,9 @@ bool dEngine_Init(void);
 void dEngine_InitDisplaySystem(uchar rendererType);
 void dEngine_RequireSceneId(int sceneId);
 void dEngine_HostFrame(void);
+void dEngine_SimulateFrame(void);
 void dEngine_CheckState(void);
+void dEngine_LoadMultiplayerScene(int sceneId, uchar sessionPlayers);
 void dEngine_WriteScreenshot(char* directory);
 void dEngine_Pause(void);
 void dEngine_Resume(void);
@@ -171,24 +171,25 @@ entity_t dummy;
 
 void ENE_Precache(void)
 {
-	event_t* precacheEvent;
-	event_spawnEnemy_payload_t* eventEnemyPayload;
+	const event_t* precacheEvent;
+	const event_spawnEnemy_payload_t* eventEnemyPayload;
+	int numEvents;
+	int i;
 	
 	engine.playerStats.numEnemies=0;
 	
-	precacheEvent = &events;
+	precacheEvent = EV_GetTimeline(&numEvents);
 	
-	while (precacheEvent != NULL)
+	for (i=0; i < numEvents; i++, precacheEvent++)
 	{
 		if (precacheEvent->type == EV_SPAWN_ENEMY)
 		{
 			engine.playerStats.numEnemies++;
 			//Log_Printf("precache t=%denemy count %f.\n",precacheEvent->time,engine.playerStats.numEnemies);
-			eventEnemyPayload = precacheEvent->payload;
+			eventEnemyPayload = &precacheEvent->payload.spawnEnemy;
 			//Log_Printf("Precaching entity: %s.\n",enemyTypePath[eventEnemyPayload->type]);
-			ENT_LoadEntity(&dummy, enemyTypePath[eventEnemyPayload->type],ENT_FULL_DRAW);
+			ENT_LoadEntity(&dummy, enemyTypePath[eventEnemyPayload->type],ENT_INSTANCED_DRAW);
 		}
-		precacheEvent = precacheEvent->next;
 	}
 	
 
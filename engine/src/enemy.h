@@ -113,6 +113,13 @@ extern updateFunction_t enemyTypeUpdateFct[];
 extern ushort enemyTypeEnergy[];
 extern uint enemyScore[];
 
+// Pool: live enemies are linked after rootEnemy, the others are in freeEnemies.
+extern enemy_t rootEnemy;
+extern enemy_t enemies[MAX_NUM_ENEMIES];
+extern uchar numFreeEnemies;
+extern enemy_t* freeEnemies[MAX_NUM_ENEMIES];
+extern int uniqueIdGenerator;
+
 void ENE_Mem_Init(void);
 void ENE_Precache(void);
 void ENE_Update(void);
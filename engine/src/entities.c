@@ -26,6 +26,7 @@
 #include "entities.h"
 #include <float.h>
 #include "renderer.h"
+#include "vcache.h"
 
 //Variable used to make entities stick to screen
 float distanceZFromCamera; 
@@ -259,6 +260,27 @@ void ENT_ClearModelsLibrary(void)
 	}
 }
 
+// Map meshes keep the face order of the md5 file: baked visibility deltas address their faces by position.
+static void ENT_OptimizeIndices(md5_mesh_t* mesh, const char* filename, uchar usage)
+{
+#ifdef REPORT_ACMR
+	float acmr;
+	
+	acmr = VCACHE_ComputeACMR(mesh->indices, mesh->numIndices, mesh->numVertices);
+#endif
+	
+	if (usage != ENT_PARTIAL_DRAW)
+		VCACHE_Optimize(mesh->indices, mesh->numIndices, mesh->numVertices, NULL);
+	
+#ifdef REPORT_ACMR
+	Log_Printf("[ACMR] %s: %d triangles, %.3f -> %.3f%s.\n",filename, mesh->numIndices/3, acmr,
+			   VCACHE_ComputeACMR(mesh->indices, mesh->numIndices, mesh->numVertices),
+			   usage == ENT_PARTIAL_DRAW ? " (map mesh, visibility sets are optimized by the baker)" : "");
+#else
+	(void)filename;
+#endif
+}
+
 char ENT_LoadEntity(entity_t* entity, const char* filename, uchar usage)
 {
 	md5_mesh_t* meshCache = NULL;
@@ -285,6 +307,8 @@ char ENT_LoadEntity(entity_t* entity, const char* filename, uchar usage)
 		}
 		
 		ENT_Put(entity->model,filename);
+		
+		ENT_OptimizeIndices(entity->model, filename, usage);
 	}
 
 	entity->usage = usage;
@@ -304,6 +328,10 @@ char ENT_LoadEntity(entity_t* entity, const char* filename, uchar usage)
 		memcpy(entity->indices, entity->model->indices, entity->numIndices * sizeof(ushort));
 	}
 	
+	//The instances are expanded from the RAM copy of the vertices.
+	if (usage == ENT_INSTANCED_DRAW)
+		entity->model->keepVertices = 1;
+	
 	MATLIB_MakeAvailable(entity->material);
 	renderer.UpLoadEntityToGPU(entity);
 	
@@ -320,6 +348,11 @@ char ENT_LoadEntity(entity_t* entity, const char* filename, uchar usage)
 
 
 
+void ENT_InvalidateRenderCache(entity_t* entity)
+{
+	entity->renderCache.valid = 0;
+}
+
 void ENT_GenerateWorldSpaceBBox(entity_t* entity)
 {
 	//Transform the bbox from modelSpace to WorldSpace.
@@ -38,6 +38,15 @@
 
 typedef enum { UP, DOWN, LEFT, RIGHT} ScreenSpaceBoundaries_e;
 
+//Derived data of entities whose matrix does not change every frame (map entities).
+typedef struct entity_render_cache_t
+{
+	uchar valid;				//Cleared by ENT_InvalidateRenderCache when the matrix changes.
+	matrix_t invModelMatrix;
+	vec4_t modelSpaceLightPos;
+	uint lightVersion;			//Value of lightVersion when modelSpaceLightPos was computed.
+} entity_render_cache_t;
+
 typedef struct entity_t {
 
 	md5_mesh_t* model;
@@ -67,13 +76,17 @@ typedef struct entity_t {
 	
 	uchar mouvementPatternType;
 	
+	entity_render_cache_t renderCache;
+	
 } entity_t;
 
 void ENT_GenerateWorldSpaceBBox(entity_t* entity);
+void ENT_InvalidateRenderCache(entity_t* entity);
 
 
 #define ENT_FULL_DRAW 0
 #define ENT_PARTIAL_DRAW 1
+#define ENT_INSTANCED_DRAW 2		//Full draw, batched with the entities sharing its mesh (see instancing.h).
 
 char ENT_LoadEntity(entity_t* entity, const char* filename, uchar usage);
 void ENT_InitCacheSystem(void);
@@ -42,6 +42,9 @@
 #include "native_services.h"
 #include "enemy_particules.h"
 
+// Set while rollback.c re-simulates frames.
+static char replaying;
+
 void EV_StopPlayback(event_t* event)
 {	
 	engine.playback.play = 0;
@@ -90,14 +93,14 @@ void EV_SpawnEnemy(event_t* event)
 	
 	
 	
-	eventPayload = (event_spawnEnemy_payload_t*)event->payload;
+	eventPayload = &event->payload.spawnEnemy;
 
 	//spawn a devil
 	enemy = ENE_Get();
 	
 	
 	
-	ENT_LoadEntity(&enemy->entity, enemyTypePath[eventPayload->type],ENT_FULL_DRAW);
+	ENT_LoadEntity(&enemy->entity, enemyTypePath[eventPayload->type],ENT_INSTANCED_DRAW);
 
 	enemy->type = eventPayload->type  ;
 	enemy->timeCounter = 0;
@@ -190,7 +193,7 @@ void EV_SpawnText(event_t* event)
 	event_text_payload_t* payload;
 	
 	
-	payload = (event_text_payload_t*)event->payload;
+	payload = &event->payload.text;
 	
 	DYN_TEXT_AddText(payload->ss_start_pos, payload->ss_end_pos, payload->duration,payload->size, payload->text);
 	
@@ -205,7 +208,7 @@ void EV_ShowProlog(event_t* event)
 {
 	//Log_Printf("EV_ShowProlog()\n");
 	event_title_payload_t* pl;
-	pl = event->payload;
+	pl = &event->payload.title;
 	TITLE_Show_prolog(pl->duration);
 }
 
@@ -213,7 +216,7 @@ void EV_ShowEpilog(event_t* event)
 {
 	//Log_Printf("EV_ShowEpilog()\n");
 	event_title_payload_t* pl;
-	pl = event->payload;
+	pl = &event->payload.title;
 	TITLE_Show_epilog(pl->duration);
 }
 
@@ -227,7 +230,7 @@ void EV_RequestScene(event_t* event)
 	
 	event_req_scene_t* payload;
 	
-	payload = event->payload;
+	payload = &event->payload.reqScene;
 	
 	
 	
@@ -241,7 +244,7 @@ void EV_RequestMenu(event_t* event)
 	
 	event_req_menu_t* payload;
 	
-	payload = event->payload;
+	payload = &event->payload.reqMenu;
 	
 	MENU_Set(payload->menuId);
     
@@ -278,11 +281,9 @@ void EV_SaveScore(event_t* event)
 void EV_LimitedEdition_Action(event_t* event)
 {
 	enemy_t* enemy;
-	event_t* toDelete;
+	event_t runtimeEvent;
 	vec2short_t ss_start_pos;
 	vec2short_t ss_end_pos;
-	event_req_scene_t* payloadScene;
-	event_req_menu_t* payloadMenu;
 	
 	
 	
@@ -293,8 +294,8 @@ void EV_LimitedEdition_Action(event_t* event)
 	{
 		// spawn an explosion
 		FX_GetExplosion(enemy->ss_position,IMPACT_TYPE_YELLOW,1,0);
-		//enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
-		//enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
+		//enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
+		//enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
 		//FX_GetExplosion(enemy);
 		
 		
@@ -303,8 +304,8 @@ void EV_LimitedEdition_Action(event_t* event)
 		// spwan smoke
 		
 		FX_GetSmoke(enemy->ss_position, 0.3, 0.3);
-		enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
-		enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
+		enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
+		enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
 		FX_GetSmoke(enemy->ss_position, 0.2, 0.2);
 		
 		ENE_Release(enemy);
@@ -325,60 +326,42 @@ void EV_LimitedEdition_Action(event_t* event)
 	 
 	/// TEXT VERIFIED GOOD
 	// Display text
-	ss_start_pos[X] = ss_end_pos[X] = 0 ;
-	ss_end_pos[Y] = ss_start_pos[Y] = 150;
-	DYN_TEXT_AddText(ss_start_pos, ss_end_pos, 10000,2.5f,"Thanks for trying:");
+	if (!replaying)
+	{
+		ss_start_pos[X] = ss_end_pos[X] = 0 ;
+		ss_end_pos[Y] = ss_start_pos[Y] = 150;
+		DYN_TEXT_AddText(ss_start_pos, ss_end_pos, 10000,2.5f,"Thanks for trying:");
 
-	ss_start_pos[X] = ss_end_pos[X] = 0 ;
-	ss_end_pos[Y] = ss_start_pos[Y] = 80;
-	DYN_TEXT_AddText(ss_start_pos, ss_end_pos, 10000,2.5f,"\"Shmup Lite\"");
+		ss_start_pos[X] = ss_end_pos[X] = 0 ;
+		ss_end_pos[Y] = ss_start_pos[Y] = 80;
+		DYN_TEXT_AddText(ss_start_pos, ss_end_pos, 10000,2.5f,"\"Shmup Lite\"");
 	
 	
-	ss_start_pos[X] = ss_end_pos[X] = 0 ;
-	ss_end_pos[Y] = ss_start_pos[Y] = -10;
-	DYN_TEXT_AddText(ss_start_pos, ss_end_pos, 10000,2.5f,"Check out the full version.");
+		ss_start_pos[X] = ss_end_pos[X] = 0 ;
+		ss_end_pos[Y] = ss_start_pos[Y] = -10;
+		DYN_TEXT_AddText(ss_start_pos, ss_end_pos, 10000,2.5f,"Check out the full version.");
+	}
 	
 	
 	
 	
 	//Add a return to main menu even set at simulationTime+10000
-	payloadScene = calloc(1, sizeof(event_req_scene_t));
-	payloadScene->sceneId = 0;
-	event = calloc(1, sizeof(event_t));
-	event->time = simulationTime+10000;
-	event->type = EV_REQUEST_SCENE;
-	event->payload = payloadScene;
-	EV_AddEvent(event);
+	memset(&runtimeEvent, 0, sizeof(event_t));
+	runtimeEvent.time = simulationTime+10000;
+	runtimeEvent.type = EV_REQUEST_SCENE;
+	runtimeEvent.payload.reqScene.sceneId = 0;
+	EV_AddEvent(&runtimeEvent);
 	
-	payloadMenu = calloc(1, sizeof(event_req_menu_t));
-	payloadMenu->menuId = MENU_HOME;
-	event = calloc(1, sizeof(event_t));
-	event->time = simulationTime+10000;
-	event->type = EV_REQUEST_MENU;
-	event->payload = payloadMenu;
-	EV_AddEvent(event);	
+	memset(&runtimeEvent, 0, sizeof(event_t));
+	runtimeEvent.time = simulationTime+10000;
+	runtimeEvent.type = EV_REQUEST_MENU;
+	runtimeEvent.payload.reqMenu.menuId = MENU_HOME;
+	EV_AddEvent(&runtimeEvent);	
 	
 	
 	
 	//Remove all futur enemy spawning events.
-	event = EV_GetNextEvent();
-	
-	while (event != NULL) 
-	{			
-		while (event->next != NULL && event->next->type == EV_SPAWN_ENEMY)
-		{
-			//Log_Printf("[dEngine_JumpInTime] Cleaning EV_SPAWN_ENEMY events t=%d.\n",event->next->time);
-			
-			toDelete = event->next;
-			event->next = event->next->next;
-			
-			free(toDelete->payload);
-			free(toDelete);
-		}
-		
-		
-		event = event->next;
-	}
+	EV_CancelSpawnsUntil(INT_MAX);
 	 
 }
 
@@ -386,11 +369,33 @@ void EV_ClearTitle(event_t* event){
     TITLE_Clear();
 }
 
-typedef void (*eventProcessor_ft)(event_t*) ;
+// Events that only touch the screen, menus or the score board, they already ran before a rollback.
+static char EV_IsPresentation(uchar type)
+{
+	switch (type)
+	{
+		case EV_DISPLAY_STATS:
+		case EV_MASK_STATS:
+		case EV_SHOW_PROLOG:
+		case EV_SHOW_EPILOG:
+		case EV_REQUEST_SCENE:
+		case EV_SPAWN_TEXT:
+		case EV_STOP_PLAYBACK:
+		case EV_REQUEST_MENU:
+		case EV_SAVE_SCORE:
+		case EV_CLEAR_TITLE:
+			return 1;
+		default:
+			return 0;
+	}
+}
 
+void EV_SetReplay(char replay)
+{
+	replaying = replay;
+}
 
-event_t events;
-event_t* nextEvent = NULL;
+typedef void (*eventProcessor_ft)(event_t*) ;
 
 eventProcessor_ft eventToFunction[32] = 
 {
@@ -413,98 +418,249 @@ eventProcessor_ft eventToFunction[32] =
 };
 
 
+// Scene timeline: built while the scene loads, sorted once, then read with a cursor.
+event_t* timeline = NULL;
+int      timelineSize = 0;
+int      timelineCapacity = 0;
+int      timelineCursor = 0;
+uchar    timelineBuilt = 0;
+
+// EV_SPAWN_ENEMY timeline events up to this time are skipped (time jumps, limited edition).
+int      cancelSpawnsUntil = INT_MIN;
+
+// Events added while the scene runs go into a small binary heap ordered on (time,sequence).
+ev_runtime_event_t runtimeEvents[EV_MAX_RUNTIME_EVENTS];
+int  numRuntimeEvents = 0;
+uint runtimeSequence = 0;
+
 
 void EV_InitForScene(void)
 {
-	events.time = 0;
-	events.next = NULL;
-	events.type = EV_ROOT;
-	events.payload = NULL;
+	timelineSize = 0;
+	timelineCursor = 0;
+	timelineBuilt = 0;
+	cancelSpawnsUntil = INT_MIN;
 	
-	nextEvent = &events;
+	numRuntimeEvents = 0;
+	runtimeSequence = 0;
 	
 	Log_Printf("EV_InitForScene\n");
 }
 
-event_t*  EV_GetNextEvent(void)
+static void EV_AppendToTimeline(const event_t* sceneEvents, int numEvents)
 {
-	return nextEvent;
+	if (timelineSize + numEvents > timelineCapacity)
+	{
+		timelineCapacity = timelineCapacity ? timelineCapacity : 256;
+		while (timelineSize + numEvents > timelineCapacity)
+			timelineCapacity *= 2;
+		
+		timeline = realloc(timeline, timelineCapacity * sizeof(event_t));
+	}
+	
+	memcpy(&timeline[timelineSize], sceneEvents, numEvents * sizeof(event_t));
+	timelineSize += numEvents;
 }
-void EV_AddEvent(event_t* event)
+
+static char EV_RuntimeEventBefore(const ev_runtime_event_t* a, const ev_runtime_event_t* b)
 {
-	event_t* cEvent;
-	event_t* tmp;
+	if (a->event.time != b->event.time)
+		return a->event.time < b->event.time;
 	
-	cEvent = nextEvent;
+	return a->sequence < b->sequence;
+}
+
+static void EV_PushRuntimeEvent(const event_t* event)
+{
+	ev_runtime_event_t tmp;
+	int i, parent;
 	
-	//Search
-	while (cEvent->next != NULL && cEvent->next->time <= event->time) {
-		cEvent = cEvent->next;
+	if (numRuntimeEvents == EV_MAX_RUNTIME_EVENTS)
+	{
+		Log_Printf("[EV_PushRuntimeEvent] Too many runtime events, dropping event type %d.\n",event->type);
+		return;
 	}
 	
+	i = numRuntimeEvents++;
+	runtimeEvents[i].sequence = runtimeSequence++;
+	runtimeEvents[i].event = *event;
 	
-	// Insert
-	if (cEvent->next == NULL)
-		cEvent->next = event;
-	else 
+	while (i > 0) 
 	{
-		tmp = cEvent->next;
-		cEvent->next = event;
-		event->next = tmp;
+		parent = (i-1) >> 1;
+		if (!EV_RuntimeEventBefore(&runtimeEvents[i], &runtimeEvents[parent]))
+			break;
+		
+		tmp = runtimeEvents[i];
+		runtimeEvents[i] = runtimeEvents[parent];
+		runtimeEvents[parent] = tmp;
+		i = parent;
 	}
-
 }
 
-void EV_Update(void)
+static void EV_PopRuntimeEvent(event_t* event)
 {
-	event_t* toDelete;
+	ev_runtime_event_t tmp;
+	int i, child;
 	
-	//if (nextEvent != NULL)
-	//	Log_Printf("next event t=%d.\n",nextEvent->time);
+	*event = runtimeEvents[0].event;
+	runtimeEvents[0] = runtimeEvents[--numRuntimeEvents];
 	
-	while (nextEvent != NULL && nextEvent->time < simulationTime) 
+	i = 0;
+	while ((child = 2*i+1) < numRuntimeEvents) 
 	{
-		//Log_Printf("Triggering event t=%d type: %d.\n",nextEvent->time,nextEvent->type);
-		eventToFunction[nextEvent->type](nextEvent);
-		
-		toDelete = nextEvent;
-		
-		nextEvent = nextEvent->next;
-		
+		if (child+1 < numRuntimeEvents && EV_RuntimeEventBefore(&runtimeEvents[child+1], &runtimeEvents[child]))
+			child++;
 		
+		if (!EV_RuntimeEventBefore(&runtimeEvents[child], &runtimeEvents[i]))
+			break;
 		
-		if (toDelete != &events)
-		{
-		   free(toDelete->payload);
-		   free(toDelete);
-		}
-		 
-		//? Freeing nextevent ?
+		tmp = runtimeEvents[i];
+		runtimeEvents[i] = runtimeEvents[child];
+		runtimeEvents[child] = tmp;
+		i = child;
 	}
 }
 
-void EV_CleanAllRemainingEvents(void)
+void EV_AddEvent(const event_t* event)
+{
+	if (timelineBuilt)
+		EV_PushRuntimeEvent(event);
+	else
+		EV_AppendToTimeline(event, 1);
+}
+
+void EV_AddEvents(const event_t* sceneEvents, int numEvents)
 {
-	event_t* toDelete;
+	EV_AppendToTimeline(sceneEvents, numEvents);
+}
+
+// Stable merge sort: events sharing a time keep their insertion order, as with the old linked list.
+static void EV_SortTimeline(event_t* src, event_t* tmp, int numEvents)
+{
+	int width, left, middle, right;
+	int i, j, k;
+	event_t* swap;
 	
-	while (nextEvent != NULL) 
+	for (width = 1; width < numEvents; width *= 2) 
 	{
-		toDelete = nextEvent;
-		nextEvent = nextEvent->next;
-		
-		if (toDelete != &events)
+		for (left = 0; left < numEvents; left += 2*width) 
 		{
-			free(toDelete->payload);
-			free(toDelete);
+			middle = left + width < numEvents ? left + width : numEvents;
+			right  = left + 2*width < numEvents ? left + 2*width : numEvents;
+			
+			i = left; j = middle; k = left;
+			while (i < middle && j < right) 
+				tmp[k++] = (src[j].time < src[i].time) ? src[j++] : src[i++];
+			while (i < middle)
+				tmp[k++] = src[i++];
+			while (j < right)
+				tmp[k++] = src[j++];
 		}
+		
+		swap = src; src = tmp; tmp = swap;
 	}
 	
+	if (src != timeline)
+		memcpy(timeline, src, numEvents * sizeof(event_t));
+}
+
+void EV_BuildTimeline(void)
+{
+	event_t* tmp;
+	int i;
+	
+	for (i=1; i < timelineSize; i++) 
+		if (timeline[i].time < timeline[i-1].time)
+			break;
+	
+	//Compiled bundles are already sorted.
+	if (i < timelineSize)
+	{
+		tmp = malloc(timelineSize * sizeof(event_t));
+		EV_SortTimeline(timeline, tmp, timelineSize);
+		free(tmp);
+	}
+	
+	timelineCursor = 0;
+	timelineBuilt = 1;
+}
+
+const event_t* EV_GetTimeline(int* numEvents)
+{
+	*numEvents = timelineSize;
+	return timeline;
+}
+
+void EV_CancelSpawnsUntil(int time)
+{
+	if (time > cancelSpawnsUntil)
+		cancelSpawnsUntil = time;
+}
+
+void EV_Update(void)
+{
+	event_t* event;
+	event_t runtimeEvent;
 	
+	while (1) 
+	{
+		if (timelineCursor < timelineSize && 
+			(numRuntimeEvents == 0 || timeline[timelineCursor].time <= runtimeEvents[0].event.time))
+		{
+			event = &timeline[timelineCursor];
+			if (event->time >= simulationTime)
+				break;
+			
+			timelineCursor++;
+			
+			if (event->type == EV_SPAWN_ENEMY && event->time <= cancelSpawnsUntil)
+				continue;
+		}
+		else if (numRuntimeEvents > 0)
+		{
+			if (runtimeEvents[0].event.time >= simulationTime)
+				break;
+			
+			//Handlers may add runtime events: pop before dispatching.
+			EV_PopRuntimeEvent(&runtimeEvent);
+			event = &runtimeEvent;
+		}
+		else
+			break;
+		
+		if (replaying && EV_IsPresentation(event->type))
+			continue;
+		
+		//Log_Printf("Triggering event t=%d type: %d.\n",event->time,event->type);
+		eventToFunction[event->type](event);
+	}
+}
+
+void EV_CleanAllRemainingEvents(void)
+{
+	timelineSize = 0;
+	timelineCursor = 0;
+	timelineBuilt = 0;
+	numRuntimeEvents = 0;
 }
 
+
+enum
+{
+	EN_KW_CLOSE_BLOCK, EN_KW_SETTIME, EN_KW_ADDTIME, EN_KW_SETTTL, EN_KW_AT,
+	EN_KW_SPAWN_ENEMY_WAVE, EN_KW_CIRCLE, EN_KW_SPAWN_ENEMY
+};
+static const char* enemiesWords[] = 
+{
+	"}", "settime", "addtime", "setttl", "at",
+	"spawnEnemyWave", "circle", "spawnEnemy"
+};
+static le_keywords_t enemiesKeywords;
+
 void EV_ReadEnemiesEvents(void)
 {
-	event_t*                     event;
+	event_t                      event;
 	event_spawnEnemy_payload_t*  eventPayload;
 	int                          at;
 	int                          numEnemies;
@@ -515,72 +671,71 @@ void EV_ReadEnemiesEvents(void)
 	float                        percentageInvulnerable;
 	float                        angleoffset;
 	uchar                        defaultSubType;
+	int                          keyword;
 	
-	nextEvent = &events;
+	if (!enemiesKeywords.numKeywords)
+		LE_InitKeywords(&enemiesKeywords, enemiesWords, sizeof(enemiesWords)/sizeof(char*));
 
-	LE_readToken() ; //{
+	LE_skipToken() ; //{
 
-	LE_readToken(); 	//at or }
-	while (LE_hasMoreData() && strcmp(LE_getCurrentToken(), "}")) 
+	keyword = LE_readKeyword(&enemiesKeywords); 	//at or }
+	while (LE_hasMoreData() && keyword != EN_KW_CLOSE_BLOCK) 
 	{
-		if (!strcmp("settime", LE_getCurrentToken()))
+		if (keyword == EN_KW_SETTIME)
 		{
 			time = LE_readReal();
 			//Log_Printf("settime=%d.\n",time);
 		}
 		else
-		if (!strcmp("addtime", LE_getCurrentToken())) 
+		if (keyword == EN_KW_ADDTIME) 
 		{
 			time += LE_readReal();
 		}
-		if (!strcmp("setttl", LE_getCurrentToken()))
+		if (keyword == EN_KW_SETTTL)
 		{
 			ttl = LE_readReal();
 			//Log_Printf("ttl=%.2f.\n",ttl);
 		}		
-		else if (!strcmp("at", LE_getCurrentToken()))
+		else if (keyword == EN_KW_AT)
 		{
 			at = time + LE_readReal();
 		
 			//Log_Printf("Fount enemy at %d.\n",at);
 		
-			LE_readToken();
+			keyword = LE_readKeyword(&enemiesKeywords);
 		
 
 			//at  50000 spawnEnemyWave circle enemyNum 16 enemyType 1
-			if (!strcmp("spawnEnemyWave", LE_getCurrentToken()))
+			if (keyword == EN_KW_SPAWN_ENEMY_WAVE)
 			{
-				LE_readToken();
-			
-				if (!strcmp("circle", LE_getCurrentToken()))
+				if (LE_readKeyword(&enemiesKeywords) == EN_KW_CIRCLE)
 				{
 					//enemyNum
-					LE_readToken();
+					LE_skipToken();
 					numEnemies= LE_readReal();
 					//Log_Printf("Fount %d enemies.\n",numEnemies);
 				
 					//enemyType
-					LE_readToken();
+					LE_skipToken();
 					enemyType = LE_readReal();
 					//Log_Printf("Fount enemyType %d.\n",enemyType);
 				
 					//percentageInvulnerable
-					LE_readToken();
+					LE_skipToken();
 					percentageInvulnerable = LE_readReal()/100.0f;
 					
-					LE_readToken();
+					LE_skipToken();
 					angleoffset  = LE_readReal() * 2*M_PI/360 ;
 					
-					LE_readToken();
+					LE_skipToken();
 					defaultSubType = LE_readReal();
 					
 					for(i=0 ; i < numEnemies ; i++)
 					{
-						event = calloc(1, sizeof(event_t));
-						event->time = at;
-						event->type = EV_SPAWN_ENEMY;
-						eventPayload = calloc(1, sizeof(event_spawnEnemy_payload_t));
-						event->payload = eventPayload;
+						memset(&event, 0, sizeof(event_t));
+						event.time = at;
+						event.type = EV_SPAWN_ENEMY;
+						eventPayload = &event.payload.spawnEnemy;
 						eventPayload->type = enemyType;
 						//eventPayload->zAxisRot = 2*3.1415/numEnemies * i;
 						
@@ -600,24 +755,23 @@ void EV_ReadEnemiesEvents(void)
 						
 						eventPayload->subType = (i/(float)numEnemies < percentageInvulnerable)? ENEMY_SUBTYPE_IMPOSSIBLE : defaultSubType ;
 						
-						EV_AddEvent(event);
+						EV_AddEvent(&event);
 					}
 				}
 			}	
 			else
 			//at 0 spawnEnemy enemyType 3 startPos -1 -1 endPos -0.5 0.5 controlPoint -1 1 initialRoll 90
-			if (!strcmp("spawnEnemy", LE_getCurrentToken()))
+			if (keyword == EN_KW_SPAWN_ENEMY)
 			{
-				event = calloc(1, sizeof(event_t));
-				event->time = at;
-				event->type = EV_SPAWN_ENEMY;
-				eventPayload = calloc(1, sizeof(event_spawnEnemy_payload_t));
-				event->payload = eventPayload;
+				memset(&event, 0, sizeof(event_t));
+				event.time = at;
+				event.type = EV_SPAWN_ENEMY;
+				eventPayload = &event.payload.spawnEnemy;
 				
 				eventPayload->ttl =  ttl;
 				
 				//mouvement
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->mouvementPatternType = LE_readReal();
 				
 				
@@ -626,19 +780,19 @@ void EV_ReadEnemiesEvents(void)
 				 
 				switch (eventPayload->mouvementPatternType) {
 					case MVMT_X_SIN:
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_FHT_X_POS] = LE_readReal();
 						
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_FHT_X_WIDTH] = LE_readReal();
 						break;
 						
 					case MVMT_CIRCLE:
 						//startAngle 0    fireFrequency 100
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_LEE_START_ANGLE] = 2*M_PI/360 * LE_readReal();
 					//	Log_Printf("eventPayload->parameters[PARAMETER_LEE_START_ANGLE]=%.2f\n",eventPayload->parameters[PARAMETER_LEE_START_ANGLE]);
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_LEE_FIRE_FREQUENCY] = LE_readReal();
 						
 						
@@ -649,40 +803,40 @@ void EV_ReadEnemiesEvents(void)
 				
 				
 				//enemyType
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->type = LE_readReal();
 				
 				
 				//startPos
-				LE_readToken(); 
+				LE_skipToken(); 
 				eventPayload->startPosition[X] = LE_readReal();
 				eventPayload->startPosition[Y] = LE_readReal();
 
 				//endPos
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->endPosition[X] = LE_readReal();
 				eventPayload->endPosition[Y] = LE_readReal();
 
 				//controlPoint
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->controlPoint[X] = LE_readReal();
 				eventPayload->controlPoint[Y] = LE_readReal();
 				
 				//Initial roll
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->zAxisRot = 2*M_PI/360 *  LE_readReal();
 
 				//Initial pitch
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->xAxisRot = 2*M_PI/360 *  LE_readReal();
 
 				
 				//Initial yaw
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->yAxisRot = 2*M_PI/360 *  LE_readReal();
 				
 				//subType
-				LE_readToken();
+				LE_skipToken();
 				eventPayload->subType = LE_readReal();
 				
 				
@@ -691,28 +845,28 @@ void EV_ReadEnemiesEvents(void)
 					case ENEMY_LEE:
 						eventPayload->parameters[PARAMETER_LEE_FIRING_TYPE] = LE_readReal();
 						
-						LE_readToken();						
+						LE_skipToken();						
 						eventPayload->parameters[PARAMETER_LEE_BULLET_SPEED_FACTOR]= LE_readReal();												
 						break;
 						
 					case ENEMY_SHAB:
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_SHAB_FIRING_ANGLE1]    = 2*M_PI/360 *LE_readReal();
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_SHAB_FIRING_ANGLE2]    = 2*M_PI/360 *LE_readReal();
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_SHAB_FIRING_NUM_THREAD]= LE_readReal();						
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_SHAB_FIRING_ROT_ANGLE] = 2*M_PI/360 *LE_readReal();												
 						break;
 						
 					case ENEMY_THA :
 						//fireDirection
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_THA_FIRING_DIRECTION] = LE_readReal();
 						
 						//firingTime
-						LE_readToken();
+						LE_skipToken();
 						eventPayload->parameters[PARAMETER_THA_FIRING_TIME] = LE_readReal();
 						
 					default:
@@ -723,11 +877,11 @@ void EV_ReadEnemiesEvents(void)
 				
 				
 				
-				EV_AddEvent(event);
+				EV_AddEvent(&event);
 			}
-			//Log_Printf("t=%d enemyType=%d\n",event->time,eventPayload->type);
+			//Log_Printf("t=%d enemyType=%d\n",event.time,eventPayload->type);
 		}
-		LE_readToken(); 
+		keyword = LE_readKeyword(&enemiesKeywords); 
 	}
 	
 
@@ -737,7 +891,7 @@ void EV_ReadEnemiesEvents(void)
 	
 void EV_ReadTextsEvents(void)
 {
-	event_t* event;
+	event_t event;
 	event_text_payload_t* payload;
 	int currentTime=0;
 	
@@ -748,11 +902,10 @@ void EV_ReadTextsEvents(void)
 	{
 		if (!strcmp("at", LE_getCurrentToken()))
 		{
-			event = (event_t*)calloc(1, sizeof(event_t));
-			event->time = currentTime + LE_readReal();
-			event->type = EV_SPAWN_TEXT;
-			payload = (event_text_payload_t*)calloc(1, sizeof(event_text_payload_t));
-			event->payload = payload;
+			memset(&event, 0, sizeof(event_t));
+			event.time = currentTime + LE_readReal();
+			event.type = EV_SPAWN_TEXT;
+			payload = &event.payload.text;
 			
 			//at 0000 display -Welcome_To_"Shump"_tutorial-	 size 2	for 2000 starting 0   0 ending  0 0
 			LE_readToken(); //display
@@ -779,8 +932,8 @@ void EV_ReadTextsEvents(void)
 			
 			
 			//Acquired event
-		//	Log_Printf("[EV_ReadTextsEvents] at %d: %s\n",event->time,payload->text);
-			EV_AddEvent(event);
+		//	Log_Printf("[EV_ReadTextsEvents] at %d: %s\n",event.time,payload->text);
+			EV_AddEvent(&event);
 		}
 		else
 		if (!strcmp("settime",LE_getCurrentToken())){
@@ -47,15 +47,6 @@
 #define EV_LIMITED_EVENT	0xE
 #define EV_CLEAR_TITLE      0xF
 
-typedef struct event_t
-{
-	int time;
-	ushort type;
-	struct event_t* next;
-	void* payload;
-	
-} event_t ;
-
 typedef struct event_spawnEnemy_payload_t
 {
 	uchar type;
@@ -101,13 +92,57 @@ typedef struct event_req_menu_t
 	int menuId;
 } event_req_menu_t;
 
+typedef union event_payload_t
+{
+	event_spawnEnemy_payload_t spawnEnemy;
+	event_title_payload_t title;
+	event_text_payload_t text;
+	event_req_scene_t reqScene;
+	event_req_menu_t reqMenu;
+} event_payload_t;
+
+// Payloads are stored inline: a scene timeline is one flat array sorted by time.
+typedef struct event_t
+{
+	int time;
+	ushort type;
+	event_payload_t payload;
+	
+} event_t ;
+
+#define EV_MAX_RUNTIME_EVENTS 32
+
+typedef struct ev_runtime_event_t
+{
+	uint sequence;
+	event_t event;
+} ev_runtime_event_t;
+
+// Playback state, the timeline itself does not change once the scene is loaded.
+extern int timelineCursor;
+extern int cancelSpawnsUntil;
+extern ev_runtime_event_t runtimeEvents[EV_MAX_RUNTIME_EVENTS];
+extern int numRuntimeEvents;
+extern uint runtimeSequence;
+
 void EV_InitForScene(void);
 void EV_ReadEnemiesEvents(void);
 void EV_ReadTextsEvents(void);
 void EV_Update(void);
 void EV_CleanAllRemainingEvents(void);
-void EV_AddEvent(event_t* event);
-event_t*  EV_GetNextEvent(void);
-extern event_t events;
+
+// While the scene loads events are appended to the timeline, EV_BuildTimeline sorts it.
+// Afterward EV_AddEvent goes to the runtime heap (EV_MAX_RUNTIME_EVENTS).
+void EV_AddEvent(const event_t* event);
+void EV_AddEvents(const event_t* sceneEvents, int numEvents);
+void EV_BuildTimeline(void);
+const event_t* EV_GetTimeline(int* numEvents);
+
+// A time jump still simulates every frame up to its target (dEngine_JumpInTime): the other
+// events fire and the camera moves, only the spawns are skipped. Rewinds restore a snapshot.
+void EV_CancelSpawnsUntil(int time);
+
+// Re-simulated frames skip the events that only touch the screen (rollback.h).
+void EV_SetReplay(char replay);
 
 #endif
\ No newline at end of file
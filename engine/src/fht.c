@@ -106,13 +106,13 @@ void updateCircle(enemy_t* enemy)
 	
 	if (enemy->timeCounter > enemy->ttl)
 	{
-		enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
-		enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
+		enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
+		enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
 		FX_GetExplosion(enemy->ss_position,IMPACT_TYPE_YELLOW,1,0);
 		Spawn_EntityParticules(enemy->ss_position);
 		FX_GetSmoke(enemy->ss_position, 0.3, 0.3);
-		enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.2 ;
-		enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.2 ;
+		enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.2 ;
+		enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.2 ;
 		FX_GetSmoke(enemy->ss_position, 0.3, 0.3);
 		SND_PlaySound(SND_EXPLOSION);
 		ENE_Release(enemy);
@@ -83,6 +83,9 @@ char*	FS_Gamedir(void);
 
 filehandle_t* FS_OpenFile( const char *filename, char* mode  );
 
+// Relative to the writable directory whatever the mode, NULL without a log if it cannot be opened (cache probes).
+filehandle_t* FS_OpenWritableFile( const char *filename, char* mode  );
+
 int FS_UploadToRAM(filehandle_t *fhandle);
 
 void FS_CloseFile( filehandle_t *fhandle );
@@ -91,6 +94,9 @@ SW32 FS_Read( void *buffer, W32 size, W32 count, filehandle_t *fhandle );
 
 SW32 FS_Write( const void * buffer, W32 size, W32 count, filehandle_t * stream );
 
+// Files opened for writing only, same arguments and return as fseek.
+int FS_Seek( filehandle_t *fhandle, SW32 offset, int origin );
+
 
 void *FS_GetLoadedFilePointer( filehandle_t *fhandle, W32 origin );
 
@@ -132,6 +132,34 @@ filehandle_t* FS_OpenFile( const char *filename, char* mode  )
 	
 		
 
+	return hFile;
+}
+
+filehandle_t* FS_OpenWritableFile( const char *filename, char* mode  )
+{
+	char			netpath[ MAX_OSPATH ];
+	filehandle_t	*hFile;
+	FILE*	fd;
+	int		end;
+	
+	sprintf( netpath, "%s/%s", FS_GameWritableDir(), filename );
+	
+	fd = fopen( netpath, mode );
+	if ( !fd  )
+		return NULL;
+	
+	hFile = (filehandle_t*) calloc(1, sizeof( filehandle_t ) );
+	
+	if (strchr(mode, 'w') || strchr(mode, 'a'))
+		hFile->isWritable = 1;
+	
+	fseek (fd, 0, SEEK_END);
+	end = ftell (fd);
+	fseek (fd, 0, SEEK_SET);
+	hFile->filesize = end;
+	
+	hFile->hFile = fd;
+	
 	return hFile;
 }
 
@@ -170,6 +198,14 @@ SW32 FS_Write( const void * buffer, W32 size, W32 count, filehandle_t * stream )
 	return fwrite(buffer,size,count,stream->hFile);
 }
 
+int FS_Seek( filehandle_t *fhandle, SW32 offset, int origin )
+{
+	if (fhandle->bLoaded)
+		return -1;
+	
+	return fseek(fhandle->hFile,offset,origin);
+}
+
 SW32 FS_Read( void *buffer, W32 size, W32 count, filehandle_t *fhandle )
 {		
 	W8	*buf = (PW8)buffer;
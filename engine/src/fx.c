@@ -26,6 +26,7 @@
 #include "fx.h"
 #include "enemy.h"
 #include "texture.h"
+#include "atlas.h"
 #include "timer.h"
 #include "renderer.h"
 #include <limits.h>
@@ -82,7 +83,7 @@ void FX_InitMem(void)
 	
 	
 	// INIT EXPLOSIONS
-	TEX_MakeStaticAvailable(&explosionTexture);
+	ATL_MakeStaticAvailable(&explosionTexture);
 	//renderer.UpLoadTextureToGpu(&explosionTexture);
 	
 	for (i=0; i < MAX_NUM_EXPLOSIONS; i++) 
@@ -203,7 +204,7 @@ void FX_InitMem(void)
 	//Smoke
 	//smokeTexture.path = calloc(1, strlen("data/texturesPVR/sprites/explosion512.pvr")+1);
 	//strcpy(smokeTexture.path,"data/texturesPVR/sprites/explosion512.pvr");
-	TEX_MakeStaticAvailable(&smokeTexture);
+	ATL_MakeStaticAvailable(&smokeTexture);
 	//renderer.UpLoadTextureToGpu(&smokeTexture);
 	
 	for (numFreeSmokes=0; numFreeSmokes < MAX_NUM_SMOKE; numFreeSmokes++) 
@@ -816,12 +817,12 @@ smoke_t* FX_GetSmoke(vec2_t ss_position,float ss_sizeX, float ss_sizeY)
 	}
 	
 	//Randomize slightly size
-	ss_sizeX += ss_sizeX * rand()/RAND_MAX*0.5f;
-	ss_sizeY += ss_sizeY * rand()/RAND_MAX*0.5f;
+	ss_sizeX += ss_sizeX * randomNext()/RANDOM_MAX*0.5f;
+	ss_sizeY += ss_sizeY * randomNext()/RANDOM_MAX*0.5f;
 	
 	//Randomize slightly ttl
 	smoke->ttl = 1000;
-	smoke->ttl += smoke->ttl * rand()/RAND_MAX*0.5f;//0-0.1
+	smoke->ttl += smoke->ttl * randomNext()/RANDOM_MAX*0.5f;//0-0.1
 	
 	// Generate start and end texture positions.
 	// Disregard ss_sizeX/Y for now, consum a LOT of bloody fillrate but maybe it will do it anyway.
@@ -849,7 +850,7 @@ smoke_t* FX_GetSmoke(vec2_t ss_position,float ss_sizeX, float ss_sizeY)
 	
 	//Save textures coordinates
 	//Randomize upside-down and leftside-right
-	type = rand() & 3 ;
+	type = randomNext() & 3 ;
 	rotation = type * M_PI/2.0f ;
 	
 	smoke->text_coo[0][X] = -SHRT_MAX/16;
@@ -879,7 +880,7 @@ smoke_t* FX_GetSmoke(vec2_t ss_position,float ss_sizeX, float ss_sizeY)
 	}
 		
 	// flip it
-	shouldFlip = rand() & 1 ;
+	shouldFlip = randomNext() & 1 ;
 	if (shouldFlip) //Yes we are flipping
 	{ 
 		if (type == 0 || type == 2) //vertical flip 
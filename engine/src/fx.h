@@ -175,4 +175,21 @@ smoke_t* FX_GetSmoke(vec2_t ss_position,float ss_sizeX, float ss_sizeY);
 smoke_t* FX_GetFirstSmoke(void);
 void FX_ReleaseSmoke(smoke_t* smoke);
 
+
+//Pools: live elements are linked after the root, the others are in the free arrays.
+extern explosion_t rootExplosion;
+extern explosion_t explosions[MAX_NUM_EXPLOSIONS];
+extern ushort numFreeExplosions;
+extern explosion_t* freeExplosions[MAX_NUM_EXPLOSIONS];
+
+extern particule_t rootParticule;
+extern particule_t particules[MAX_NUM_PARTICULES];
+extern ushort numFreeParticules;
+extern particule_t* freeParticules[MAX_NUM_PARTICULES];
+
+extern smoke_t rootSmoke;
+extern smoke_t smokes[MAX_NUM_SMOKE];
+extern ushort numFreeSmokes;
+extern smoke_t* freeSmokes[MAX_NUM_SMOKE];
+
 #endif
\ No newline at end of file
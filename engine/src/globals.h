@@ -89,6 +89,18 @@ enum {WIDTH, HEIGHT}  ;
 
 // #define GENERATE_VIDEO
 
+// Write binary bundles (<scene>.bdl, materials.*.bdl) to the writable directory after parsing text scenes.
+// #define COMPILE_BUNDLES
+
+// Pack the sprite textures into atlas pages (atlas.h) written to the writable directory during the display init.
+// #define COMPILE_ATLAS
+
+// Write the S3TC/ETC1 versions of the material textures (texcomp.h) to the writable directory as they are loaded.
+// #define COMPILE_TEXTURES
+
+// Log the vertex cache miss ratio of meshes and baked visibility sets before and after reordering (vcache.h).
+// #define REPORT_ACMR
+
 //Here are the Shmup active surface legacy dimensions.
 #define SS_COO_SYST_WIDTH  320
 #define SS_COO_SYST_HEIGHT 480
@@ -0,0 +1,220 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  instancing.c
+ *  dEngine
+ *
+ *  Draws the entities sharing a mesh and a material in a few calls.
+ *
+ */
+
+#include "instancing.h"
+#include "renderer.h"
+#include "renderqueue.h"
+
+typedef struct inst_group_t
+{
+	md5_mesh_t* mesh;
+	material_t* material;
+	uchar flags;
+	int numInstances;
+	inst_instance_t instances[INST_MAX_INSTANCES];
+} inst_group_t;
+
+static inst_group_t groups[INST_MAX_GROUPS];
+static int numGroups;
+
+static vertex_t stream[INST_MAX_VERTICES];
+static uchar streamColors[INST_MAX_VERTICES*4];
+static ushort streamIndices[INST_MAX_INDICES];
+
+char INST_CanInstance(const entity_t* entity)
+{
+	md5_mesh_t* mesh;
+
+	mesh = entity->model;
+
+	return entity->usage == ENT_INSTANCED_DRAW &&
+		   mesh != NULL && mesh->vertexArray != NULL &&
+		   mesh->numVertices <= INST_MAX_VERTICES &&
+		   mesh->numIndices <= INST_MAX_INDICES;
+}
+
+void INST_Begin(void)
+{
+	numGroups = 0;
+}
+
+static short INST_RotateShort(float value)
+{
+	if (value > DE_SHRT_MAX)
+		return DE_SHRT_MAX;
+
+	if (value < -DE_SHRT_MAX)
+		return -DE_SHRT_MAX;
+
+	return (short)value;
+}
+
+// Model space to world space. Matrices are rotation and translation only, like in ComputeInvModelMatrix.
+static void INST_TransformVertex(const matrix_t m, const vertex_t* src, vertex_t* dst)
+{
+	*dst = *src;
+
+	dst->pos[X] = m[0] * src->pos[X] + m[4] * src->pos[Y] + m[ 8] * src->pos[Z] + m[12];
+	dst->pos[Y] = m[1] * src->pos[X] + m[5] * src->pos[Y] + m[ 9] * src->pos[Z] + m[13];
+	dst->pos[Z] = m[2] * src->pos[X] + m[6] * src->pos[Y] + m[10] * src->pos[Z] + m[14];
+
+	dst->normal[X] = INST_RotateShort(m[0] * src->normal[X] + m[4] * src->normal[Y] + m[ 8] * src->normal[Z]);
+	dst->normal[Y] = INST_RotateShort(m[1] * src->normal[X] + m[5] * src->normal[Y] + m[ 9] * src->normal[Z]);
+	dst->normal[Z] = INST_RotateShort(m[2] * src->normal[X] + m[6] * src->normal[Y] + m[10] * src->normal[Z]);
+
+	dst->tangent[X] = INST_RotateShort(m[0] * src->tangent[X] + m[4] * src->tangent[Y] + m[ 8] * src->tangent[Z]);
+	dst->tangent[Y] = INST_RotateShort(m[1] * src->tangent[X] + m[5] * src->tangent[Y] + m[ 9] * src->tangent[Z]);
+	dst->tangent[Z] = INST_RotateShort(m[2] * src->tangent[X] + m[6] * src->tangent[Y] + m[10] * src->tangent[Z]);
+}
+
+// Expands instances [first, first+count[ of a group and draws them.
+static void INST_DrawInstances(const inst_group_t* group, int first, int count)
+{
+	md5_mesh_t* mesh;
+	const inst_instance_t* instance;
+	vertex_t* vertex;
+	uchar* color;
+	ushort* index;
+	int i, j;
+	inst_batch_t batch;
+
+	mesh = group->mesh;
+
+	vertex = stream;
+	color = streamColors;
+	index = streamIndices;
+
+	instance = &group->instances[first];
+	for (i=0; i < count; i++,instance++)
+	{
+		for (j=0; j < mesh->numVertices; j++,vertex++,color += 4)
+		{
+			INST_TransformVertex(instance->matrix, &mesh->vertexArray[j], vertex);
+			color[R] = instance->color[R];
+			color[G] = instance->color[G];
+			color[B] = instance->color[B];
+			color[A] = instance->color[A];
+		}
+
+		for (j=0; j < mesh->numIndices; j++)
+			*index++ = mesh->indices[j] + i * mesh->numVertices;
+	}
+
+	batch.mesh = mesh;
+	batch.material = group->material;
+	batch.flags = group->flags;
+	batch.numInstances = count;
+	batch.vertices = stream;
+	batch.colors = streamColors;
+	batch.numVertices = count * mesh->numVertices;
+	batch.indices = streamIndices;
+	batch.numIndices = count * mesh->numIndices;
+
+	renderer.RenderInstances(&batch);
+}
+
+static void INST_FlushGroup(inst_group_t* group)
+{
+	int perDraw;
+	int first;
+	int count;
+
+	perDraw = INST_MAX_VERTICES / group->mesh->numVertices;
+	if (perDraw > INST_MAX_INDICES / group->mesh->numIndices)
+		perDraw = INST_MAX_INDICES / group->mesh->numIndices;
+
+	for (first=0; first < group->numInstances; first += count)
+	{
+		count = group->numInstances - first;
+		if (count > perDraw)
+			count = perDraw;
+
+		INST_DrawInstances(group, first, count);
+	}
+
+	group->numInstances = 0;
+}
+
+void INST_Add(entity_t* entity, uchar flags)
+{
+	inst_group_t* group;
+	inst_instance_t* instance;
+	int i;
+
+	group = groups;
+	for (i=0; i < numGroups; i++,group++)
+		if (group->mesh == entity->model && group->material == entity->material && group->flags == flags)
+			break;
+
+	if (i == numGroups)
+	{
+		if (numGroups == INST_MAX_GROUPS)
+		{
+			INST_Flush();
+			group = groups;
+		}
+
+		group->mesh = entity->model;
+		group->material = entity->material;
+		group->flags = flags;
+		group->numInstances = 0;
+		numGroups++;
+	}
+
+	if (group->numInstances == INST_MAX_INSTANCES)
+		INST_FlushGroup(group);
+
+	instance = &group->instances[group->numInstances++];
+
+	matrixCopy(entity->matrix, instance->matrix);
+
+	//Flickering is an additive white on the fixed pipeline.
+	if (flags & RQ_FLAG_FLICKER)
+	{
+		instance->color[R] = instance->color[G] = instance->color[B] = instance->color[A] = 255;
+	}
+	else
+	{
+		for (i=0; i < 4; i++)
+		{
+			if (entity->color[i] <= 0)
+				instance->color[i] = 0;
+			else if (entity->color[i] >= 1)
+				instance->color[i] = 255;
+			else
+				instance->color[i] = (uchar)(entity->color[i] * 255);
+		}
+	}
+}
+
+void INST_Flush(void)
+{
+	int i;
+
+	for (i=0; i < numGroups; i++)
+		if (groups[i].numInstances != 0)
+			INST_FlushGroup(&groups[i]);
+
+	numGroups = 0;
+}
@@ -0,0 +1,81 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  instancing.h
+ *  dEngine
+ *
+ *  Draws the entities sharing a mesh and a material in a few calls.
+ *
+ */
+
+#ifndef DE_INSTANCING
+#define DE_INSTANCING
+
+#include "globals.h"
+#include "math.h"
+#include "matrix.h"
+#include "entities.h"
+
+/*
+	Enemies of one type share the same cached md5_mesh_t and material. During a
+	pass the renderer gives them to INST_Add instead of drawing them, each one
+	becomes an instance (matrix and color) in the group of its mesh, material
+	and flags. INST_Flush expands every group into a world space vertex stream,
+	INST_MAX_VERTICES at most, and hands it to renderer.RenderInstances: one
+	draw call for as many instances as fit.
+
+	Neither GLES 2.0 nor the fixed pipeline have instanced draw calls, so the
+	instance buffer is applied on the CPU. It requires the vertices of the mesh
+	to stay in RAM after the GPU upload: entities loaded with ENT_INSTANCED_DRAW.
+*/
+
+#define INST_MAX_GROUPS		16
+#define INST_MAX_INSTANCES	64			// Per group, INST_Add flushes when full.
+#define INST_MAX_VERTICES	16384		// Per draw call.
+#define INST_MAX_INDICES	(INST_MAX_VERTICES*3)
+
+typedef struct inst_instance_t
+{
+	matrix_t matrix;
+	uchar color[4];
+} inst_instance_t;
+
+// One draw call.
+typedef struct inst_batch_t
+{
+	md5_mesh_t* mesh;
+	material_t* material;
+	uchar flags;				// RQ_FLAG_* of the instances.
+
+	int numInstances;
+
+	const vertex_t* vertices;	// World space.
+	const uchar* colors;		// RGBA per vertex, the color of its instance.
+	int numVertices;
+
+	const ushort* indices;
+	int numIndices;
+} inst_batch_t;
+
+// Mesh vertices are still in RAM and small enough to be batched.
+char INST_CanInstance(const entity_t* entity);
+
+void INST_Begin(void);
+void INST_Add(entity_t* entity, uchar flags);
+void INST_Flush(void);
+
+#endif
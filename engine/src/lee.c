@@ -250,10 +250,10 @@ void updatePrepareBullet(enemy_t* enemy)
 		
 		
 		
-		random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
-		random[Y] = (rand() - RAND_MAX ) / (float)RAND_MAX;
+		random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
+		random[Y] = (randomNext() - RANDOM_MAX ) / (float)RANDOM_MAX;
 		normalize2(random);
-		FX_GetParticule(enemy->ss_position,random		,0.02*PARTICULE_SIZE_GLOBAL*LEE_PARTICULE_IMPLOSION_RATION	,PARTICULE_TRAVEL_DIST/2.5f*rand()/(float)RAND_MAX,PARTICULE_TYPE_IMPLOSION, PARTICULE_COLOR_WHITE,3);
+		FX_GetParticule(enemy->ss_position,random		,0.02*PARTICULE_SIZE_GLOBAL*LEE_PARTICULE_IMPLOSION_RATION	,PARTICULE_TRAVEL_DIST/2.5f*randomNext()/(float)RANDOM_MAX,PARTICULE_TYPE_IMPLOSION, PARTICULE_COLOR_WHITE,3);
 		
 	}
 	else 
@@ -384,13 +384,13 @@ void updateLEECircle(enemy_t* enemy)
 	
 	if (f > 0.85f)
 	{
-		enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
-		enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.1 ;
+		enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
+		enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.1 ;
 		FX_GetExplosion(enemy->ss_position,IMPACT_TYPE_YELLOW,1,0);
 		Spawn_EntityParticules(enemy->ss_position);
 		FX_GetSmoke(enemy->ss_position, 0.3, 0.3);
-		enemy->ss_position[X] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.2 ;
-		enemy->ss_position[Y] += (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1) * 0.2 ;
+		enemy->ss_position[X] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.2 ;
+		enemy->ss_position[Y] += (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1) * 0.2 ;
 		FX_GetSmoke(enemy->ss_position, 0.3, 0.3);
 		SND_PlaySound(SND_EXPLOSION);
 		ENE_Release(enemy);
@@ -25,29 +25,54 @@
 
 #include "lexer.h"
 #include "log.h"
+#include <stdlib.h>
 
 #define STACK_SIZE 6
 #define MAX_TOKEN_SIZE 256
 
 filehandle_t fileParsed;
-char token[MAX_TOKEN_SIZE];
 
-#define TOKEN_BUFFER_HAS_ONE_MORE_SLOT (tokenChar < &token[MAX_TOKEN_SIZE-1])
-#define TOKEN_BUFFER_HAS_TWO_MORE_SLOT (tokenChar < &token[MAX_TOKEN_SIZE-2])
+// The current token is a span in the file. It is only copied to token[] when the
+// legacy char* API asks for it.
+le_span_t currentSpan;
+char tokenMaterialized = 1;
+char token[MAX_TOKEN_SIZE];
 
 unsigned int stackPointer=0;
 filehandle_t filesStack[STACK_SIZE];
 
 
-char whiteCharacters[128] ;
-
-
+char whiteCharacters[256] ;
+char whiteCharactersInitialized = 0;
 
 
 
+static void LE_materializeToken(void)
+{
+	int length;
+	
+	if (tokenMaterialized)
+		return;
+	
+	length = currentSpan.length;
+	if (length > MAX_TOKEN_SIZE-2)
+		length = MAX_TOKEN_SIZE-2;
+	
+	memcpy(token, currentSpan.ptr, length);
+	
+	//Unterminated string literal: the legacy lexer always closed it.
+	if (length > 0 && token[0] == '"' && (length == 1 || token[length-1] != '"'))
+		token[length++] = '"';
+	
+	token[length] = '\0';
+	tokenMaterialized = 1;
+}
 
 void LE_popLexer()
 {
+	//The current span may point into the file that is about to be closed.
+	LE_materializeToken();
+	
 	stackPointer--;
 	fileParsed = filesStack[stackPointer] ;
 	
@@ -95,10 +120,14 @@ char LE_Peek(void)
 
 void LE_init(filehandle_t* textFile)
 {
+	LE_materializeToken();
+	
 	fileParsed = *textFile;	
 	
+	if (whiteCharactersInitialized)
+		return;
 	
-	memset(whiteCharacters,0,128*sizeof(char));
+	memset(whiteCharacters,0,sizeof(whiteCharacters));
 	
 	whiteCharacters['\0'] = 1;
 	whiteCharacters[' '] = 1;
@@ -112,7 +141,7 @@ void LE_init(filehandle_t* textFile)
 	whiteCharacters[':'] = 1;
 	whiteCharacters[';'] = 1;
 
-
+	whiteCharactersInitialized = 1;
 }
 
 
@@ -177,61 +206,270 @@ void LE_skipWhiteSpace(void)
 	}
 }
 
-char* LE_readToken(void)
+le_span_t LE_readSpan(void)
 {
-	char* tokenChar = NULL;
-    //tokenChat always point to the slot that will be written. It is used as a "write and move" pointer (as opposite to "move and write).
-
+	const uchar* start;
+	
 	LE_skipWhiteSpace();
 	
-	tokenChar = token;
-	*tokenChar = '\0';
+	tokenMaterialized = 0;
+	
+	start = fileParsed.ptrCurrent;
+	currentSpan.ptr = (const char*)start;
+	currentSpan.length = 0;
 	
 	if (!LE_hasMoreData())
-		return token;
+		return currentSpan;
 
-	//String literal
+	//String literal, the span includes the double quotes.
 	if (*fileParsed.ptrCurrent == '"')
 	{
-		*tokenChar++ = *fileParsed.ptrCurrent++;
-		while(TOKEN_BUFFER_HAS_TWO_MORE_SLOT && LE_hasMoreData() && *fileParsed.ptrCurrent != '"')
-		{
-			//			previousChar = *fileParsed.ptrCurrent;
-			*tokenChar++ = *fileParsed.ptrCurrent++;
-		}
-		
 		fileParsed.ptrCurrent++;
+		while(LE_hasMoreData() && *fileParsed.ptrCurrent != '"')
+			fileParsed.ptrCurrent++;
 		
-		*tokenChar++ = '"';
+		fileParsed.ptrCurrent++;
 	}
 	else
 	{
-		while(!prtCurrentIsWhiteChar() && LE_hasMoreData() && TOKEN_BUFFER_HAS_ONE_MORE_SLOT  )
-			*tokenChar++ = *fileParsed.ptrCurrent++;
+		while(!prtCurrentIsWhiteChar() && LE_hasMoreData())
+			fileParsed.ptrCurrent++;
 	}
 	
-	*tokenChar++ = '\0';
+	currentSpan.length = (int)(fileParsed.ptrCurrent - start);
+
+	return currentSpan;
+}
+
+le_span_t LE_getCurrentSpan(void)
+{
+	return currentSpan;
+}
 
-//	printf("%s\n",token);
+//Consume a token that is only here to help reading the file (labels such as "vert", "tri"...).
+void LE_skipToken(void)
+{
+	LE_readSpan();
+}
+
+char* LE_readToken(void)
+{
+	LE_readSpan();
+	LE_materializeToken();
 
 	return token;
 }
 
+int LE_spanEquals(le_span_t span, const char* string)
+{
+	int i;
+	
+	for (i=0; i < span.length; i++)
+		if (string[i] != span.ptr[i] || string[i] == '\0')
+			return 0;
+	
+	return string[span.length] == '\0';
+}
+
+
+static const double powersOfTen[] = 
+{
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//Locale independent decimal parser working directly on the file data. 
+//Anything it does not understand (inf, nan, hexadecimal, huge exponents) falls back to strtod.
+float LE_parseReal(const char* ptr, int length)
+{
+	const char* cursor = ptr;
+	const char* end = ptr + length;
+	unsigned long long mantissa = 0;
+	int numDigits = 0;
+	int exponent = 0;
+	int explicitExponent = 0;
+	int exponentSign = 1;
+	char negative = 0;
+	char sawDigit = 0;
+	char buffer[64];
+	double value;
+	
+	if (cursor < end && (*cursor == '-' || *cursor == '+'))
+		negative = (*cursor++ == '-');
+	
+	while (cursor < end && *cursor >= '0' && *cursor <= '9')
+	{
+		if (numDigits < 19)
+		{
+			mantissa = mantissa * 10 + (*cursor - '0');
+			if (mantissa) numDigits++;
+		}
+		else
+			exponent++;
+		cursor++;
+		sawDigit = 1;
+	}
+	
+	if (cursor < end && *cursor == '.')
+	{
+		cursor++;
+		while (cursor < end && *cursor >= '0' && *cursor <= '9')
+		{
+			if (numDigits < 19)
+			{
+				mantissa = mantissa * 10 + (*cursor - '0');
+				if (mantissa) numDigits++;
+				exponent--;
+			}
+			cursor++;
+			sawDigit = 1;
+		}
+	}
+	
+	if (cursor < end && (*cursor == 'e' || *cursor == 'E') && cursor+1 < end)
+	{
+		const char* exponentStart = cursor;
+		
+		cursor++;
+		if (*cursor == '-' || *cursor == '+')
+			exponentSign = (*cursor++ == '-') ? -1 : 1;
+		
+		if (cursor < end && *cursor >= '0' && *cursor <= '9')
+		{
+			while (cursor < end && *cursor >= '0' && *cursor <= '9')
+			{
+				if (explicitExponent < 10000)
+					explicitExponent = explicitExponent * 10 + (*cursor - '0');
+				cursor++;
+			}
+			exponent += exponentSign * explicitExponent;
+		}
+		else
+			cursor = exponentStart;	// "1e" is read as 1 by atof.
+	}
+	
+	if (!sawDigit || (cursor < end && (*cursor == 'x' || *cursor == 'X' || *cursor == 'n' || *cursor == 'N' || *cursor == 'i' || *cursor == 'I')) || exponent > 22 || exponent < -22 || mantissa >> 53)
+	{
+		if (length > (int)sizeof(buffer)-1)
+			length = sizeof(buffer)-1;
+		memcpy(buffer, ptr, length);
+		buffer[length] = '\0';
+		return (float)strtod(buffer, NULL);
+	}
+	
+	value = (double)mantissa;
+	if (exponent < 0)
+		value /= powersOfTen[-exponent];
+	else
+		value *= powersOfTen[exponent];
+	
+	return (float)(negative ? -value : value);
+}
+
 float LE_readReal(void)
 {
-	LE_readToken();
+	LE_readSpan();
 	
-	return (float)atof(token);
+	return LE_parseReal(currentSpan.ptr, currentSpan.length);
 }
 
 char* LE_getCurrentToken()
 {
 	//Log_Printf("LE_getCurrentToken = %s.\n",token);
+	LE_materializeToken();
 	return token;
 }
 
 
 
+static uint LE_hashSpan(const char* ptr, int length, uint seed)
+{
+	uint hash = 2166136261u ^ seed;
+	int i;
+	
+	for (i=0; i < length; i++)
+	{
+		hash ^= (uchar)ptr[i];
+		hash *= 16777619u;
+	}
+	
+	return hash ^ (hash >> 15);
+}
+
+void LE_InitKeywords(le_keywords_t* keywords, const char** words, int numWords)
+{
+	int i;
+	uint slot;
+	
+	if (numWords > LE_MAX_KEYWORDS)
+	{
+		Log_Printf("[LE_InitKeywords] Too many keywords (%d).\n",numWords);
+		numWords = LE_MAX_KEYWORDS;
+	}
+	
+	keywords->numKeywords = numWords;
+	for (i=0; i < numWords; i++)
+	{
+		keywords->keywords[i] = words[i];
+		keywords->lengths[i] = (uchar)strlen(words[i]);
+	}
+	
+	//Search for a seed without collision. A dozen keywords take a few tries, LE_MAX_KEYWORDS in LE_KEYWORDS_TABLE_SIZE
+	//slots about twenty thousand; a duplicate keyword would never fit.
+	keywords->linear = 0;
+	for (keywords->seed=0; keywords->seed < LE_KEYWORDS_MAX_SEEDS; keywords->seed++)
+	{
+		memset(keywords->slots, LE_KEYWORD_UNKNOWN, sizeof(keywords->slots));
+		
+		for (i=0; i < numWords; i++)
+		{
+			slot = LE_hashSpan(words[i], keywords->lengths[i], keywords->seed) & (LE_KEYWORDS_TABLE_SIZE-1);
+			if (keywords->slots[slot] != LE_KEYWORD_UNKNOWN)
+				break;
+			keywords->slots[slot] = i;
+		}
+		
+		if (i == numWords)
+			return;
+	}
+	
+	Log_Printf("[LE_InitKeywords] No perfect hash for %d keywords (starting with '%s'), comparing them one by one.\n",numWords,numWords ? words[0] : "");
+	keywords->linear = 1;
+}
+
+int LE_findKeyword(const le_keywords_t* keywords, le_span_t span)
+{
+	int id;
+	
+	if (keywords->linear)
+	{
+		for (id=0; id < keywords->numKeywords; id++)
+			if (keywords->lengths[id] == span.length && !memcmp(keywords->keywords[id], span.ptr, span.length))
+				return id;
+		
+		return LE_KEYWORD_UNKNOWN;
+	}
+	
+	id = keywords->slots[LE_hashSpan(span.ptr, span.length, keywords->seed) & (LE_KEYWORDS_TABLE_SIZE-1)];
+	
+	if (id == LE_KEYWORD_UNKNOWN || keywords->lengths[id] != span.length || memcmp(keywords->keywords[id], span.ptr, span.length))
+		return LE_KEYWORD_UNKNOWN;
+	
+	return id;
+}
+
+int LE_readKeyword(const le_keywords_t* keywords)
+{
+	return LE_findKeyword(keywords, LE_readSpan());
+}
+
+int LE_currentKeyword(const le_keywords_t* keywords)
+{
+	return LE_findKeyword(keywords, currentSpan);
+}
+
+
+
 void LE_cleanUpDoubleQuotes(char* string)
 {
 	char* cursor;
@@ -28,6 +28,31 @@
 
 #include "filesystem.h"
 
+// A token as a (pointer, length) window into the file loaded in RAM: nothing is copied.
+// The span is only valid as long as the file parsed is not closed.
+typedef struct le_span_t
+{
+	const char* ptr;
+	int length;
+} le_span_t;
+
+#define LE_MAX_KEYWORDS 48
+#define LE_KEYWORDS_TABLE_SIZE 128	// Power of two
+#define LE_KEYWORD_UNKNOWN (-1)
+#define LE_KEYWORDS_MAX_SEEDS 65536	// Tries before falling back to comparing every keyword.
+
+// Perfect hash of a fixed set of keywords: one hash and one memcmp per lookup instead of a strcmp ladder.
+// Keyword ids are the indices in the array given to LE_InitKeywords.
+typedef struct le_keywords_t
+{
+	uint seed;
+	char linear;				// No seed was found (duplicate keywords?): every keyword is compared.
+	int numKeywords;
+	const char* keywords[LE_MAX_KEYWORDS];
+	uchar lengths[LE_MAX_KEYWORDS];
+	signed char slots[LE_KEYWORDS_TABLE_SIZE];
+} le_keywords_t;
+
 void LE_init( filehandle_t *textFile);
 
 char* LE_readToken(void);
@@ -35,6 +60,17 @@ char* LE_getCurrentToken();
 float LE_readReal(void);
 int LE_hasMoreData(void);
 
+le_span_t LE_readSpan(void);
+le_span_t LE_getCurrentSpan(void);
+void LE_skipToken(void);
+int LE_spanEquals(le_span_t span, const char* string);
+float LE_parseReal(const char* ptr, int length);
+
+void LE_InitKeywords(le_keywords_t* keywords, const char** words, int numWords);
+int LE_findKeyword(const le_keywords_t* keywords, le_span_t span);
+int LE_readKeyword(const le_keywords_t* keywords);
+int LE_currentKeyword(const le_keywords_t* keywords);
+
 void LE_popLexer();
 void LE_pushLexer();
 
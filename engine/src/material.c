@@ -28,6 +28,7 @@
 #include "lexer.h"
 #include "texture.h"
 #include "renderer.h"
+#include "bundle.h"
 
 
 
@@ -39,6 +40,7 @@ typedef struct mat_bucket_t {
 
 #define SIZE_MAT_HASHTABLE 256
 mat_bucket_t** mat_hashtable;
+static ushort mat_count;
 
 void MAT_InitCacheSystem(void)
 {
@@ -88,6 +90,50 @@ void MAT_Put(material_t* material)
 	
 	bucket->material = material;
 	bucket->next = NULL;
+	
+	material->index = mat_count++;
+}
+
+// Bulk insert used by the compiled material bundles: one allocation for all buckets.
+void MATLIB_AddMaterials(material_t* materials, int numMaterials)
+{
+	mat_bucket_t* buckets;
+	mat_bucket_t** slot;
+	int i;
+	
+	buckets = (mat_bucket_t*)calloc(numMaterials,sizeof(mat_bucket_t));
+	
+	for (i=0; i < numMaterials; i++) 
+	{
+		slot = &mat_hashtable[Get_Mat_HashValue(materials[i].name)];
+		while (*slot)
+			slot = &(*slot)->next;
+		
+		buckets[i].material = &materials[i];
+		*slot = &buckets[i];
+		
+		materials[i].index = mat_count++;
+	}
+}
+
+int MATLIB_CollectMaterials(material_t** materials, int maxMaterials)
+{
+	int i;
+	int numMaterials;
+	mat_bucket_t* curr;
+	
+	numMaterials = 0;
+	for (i=0; i< SIZE_MAT_HASHTABLE; i++) 
+	{
+		for (curr = mat_hashtable[i]; curr != NULL; curr=curr->next) 
+		{
+			if (numMaterials < maxMaterials)
+				materials[numMaterials] = curr->material;
+			numMaterials++;
+		}
+	}
+	
+	return numMaterials;
 }
 
 material_t* MATLIB_Get(char* materialName)
@@ -207,7 +253,7 @@ material_t* MATLIB_Create(char* materialName)
  #define PROP_BUMP      1
  #define PROP_SPEC      2
  #define PROP_DIFF	   4
- #define PROP_UNDEF1    8
+ #define PROP_COMPACT   8
  #define PROP_UNDEF2   16
  #define PROP_UNDEF3   32
  #define PROP_UNDEF    64
@@ -223,7 +269,7 @@ void MATLIB_printProp(uchar props)
 		   (props & PROP_BUMP) >> 6,
 		   (props & PROP_UNDEF3) >> 5,
 		   (props & PROP_UNDEF2) >> 4,
-		   (props & PROP_UNDEF1) >> 3,
+		   (props & PROP_COMPACT) >> 3,
 		   (props & PROP_DIFF) >> 2,
 		   (props & PROP_SPEC) >> 1,
 		   (props & PROP_BUMP)
@@ -231,7 +277,7 @@ void MATLIB_printProp(uchar props)
 	if ((props & PROP_BUMP) == PROP_BUMP) Log_Printf("PROP_BUMP\n");
 	if ((props & PROP_SPEC) == PROP_SPEC) Log_Printf("PROP_SPEC\n");
 	if ((props & PROP_DIFF) == PROP_DIFF) Log_Printf("PROP_DIFF\n");
-	if ((props & PROP_UNDEF1) == PROP_UNDEF1) Log_Printf("PROP_UNDEF1\n");
+	if ((props & PROP_COMPACT) == PROP_COMPACT) Log_Printf("PROP_COMPACT\n");
 	if ((props & PROP_UNDEF2) == PROP_UNDEF2) Log_Printf("PROP_UNDEF2\n");
 	if ((props & PROP_UNDEF3) == PROP_UNDEF3) Log_Printf("PROP_UNDEF3\n");
 	if ((props & PROP_BUMP) == PROP_BUMP) Log_Printf("PROP_BUMP\\n");
@@ -244,11 +290,21 @@ void MATLIB_LoadLibraries(void)
 {
 	int i;
 	filehandle_t* library;
+	char* bundlePath;
 	
 	Log_Printf("Initalizing material library.\n");
 	
 	for (i=0 ; i < SIZE_MAT_HASHTABLE ; i++)
 		mat_hashtable[i] = 0;
+	mat_count = 0;
+	
+	if (renderer.materialQuality == MATERIAL_QUALITY_LOW)
+		bundlePath = "data/materials.lq.bdl";
+	else
+		bundlePath = "data/materials.hq.bdl";
+	
+	if (BDL_LoadMaterials(bundlePath))
+		return;
 	
 	library = FS_OpenFile("data/materials.lbr","rt");
 	FS_UploadToRAM(library);
@@ -307,9 +363,17 @@ void MATLIB_LoadLibraries(void)
 	}
 
 	FS_CloseFile(library);
+	
+#ifdef COMPILE_BUNDLES
+	BDL_CompileMaterials(bundlePath);
+#endif
 	//MATLIB_PrintCache();
 }
 
+enum { MTL_KW_NEWMTL, MTL_KW_MAP_KD, MTL_KW_BUMP_KD, MTL_KW_SPEC_KD, MTL_KW_KS, MTL_KW_ILLUM, MTL_KW_HAS_ALPHA };
+static const char* mtlWords[] = { "newmtl", "map_Kd", "BumpKd", "SpecKd", "Ks", "illum", "hasAlpha" };
+static le_keywords_t mtlKeywords;
+
 void MATLIB_LoadLibrary(char* mtlPath)
 {
 	filehandle_t*	mtlFile			;
@@ -327,66 +391,65 @@ void MATLIB_LoadLibrary(char* mtlPath)
 		return;
 	}
 	
+	if (!mtlKeywords.numKeywords)
+		LE_InitKeywords(&mtlKeywords, mtlWords, sizeof(mtlWords)/sizeof(char*));
+	
 	LE_pushLexer();
 	LE_init(mtlFile);
 	
 	while(LE_hasMoreData())
 	{
-		LE_readToken();
-		if (!strcmp("newmtl",LE_getCurrentToken()))
+		switch (LE_readKeyword(&mtlKeywords))
 		{
+		case MTL_KW_NEWMTL:
 			LE_readToken();
 			currentMaterial = MATLIB_Create(LE_getCurrentToken());
 			currentMaterial->hasAlpha  = 0;
-		}
-		else 
-		if (!strcmp("map_Kd",LE_getCurrentToken()))
-		{
+			break;
+		
+		case MTL_KW_MAP_KD:
 			//currentMaterial->textures[TEXTURE_DIFFUSE] = calloc(1,sizeof(texture_t));
 			LE_readToken();
 //			currentMaterial->textures[TEXTURE_DIFFUSE].path = malloc((strlen(LE_getCurrentToken())+1)*sizeof(char));
 			strcpy(currentMaterial->textures[TEXTURE_DIFFUSE].path, LE_getCurrentToken());
 				
 			currentMaterial->prop |= PROP_DIFF ;
-		}
-		else 
-		if (!strcmp("BumpKd",LE_getCurrentToken()))
-		{
+			break;
+		
+		case MTL_KW_BUMP_KD:
 			LE_readToken();
 	//		currentMaterial->textures[TEXTURE_BUMP].path = malloc((strlen(LE_getCurrentToken())+1)*sizeof(char));
 			strcpy(currentMaterial->textures[TEXTURE_BUMP].path, LE_getCurrentToken());
 				
 			currentMaterial->prop |= PROP_BUMP;
-			
-		}	
-		else 
-		if (!strcmp("SpecKd",LE_getCurrentToken()))
-		{
+			break;
+		
+		case MTL_KW_SPEC_KD:
 			LE_readToken();
 	//		currentMaterial->textures[TEXTURE_SPECULAR].path = malloc((strlen(LE_getCurrentToken())+1)*sizeof(char));
 			strcpy(currentMaterial->textures[TEXTURE_SPECULAR].path, LE_getCurrentToken());
 				
 			currentMaterial->prop |= PROP_SPEC;
-		}
-		else 
-		if (!strcmp("Ks",LE_getCurrentToken()))
-		{
+			break;
+		
+		case MTL_KW_KS:
 			for(i=0;i<3 ; i++)
 			{
 				currentMaterial->specularColor[i] = LE_readReal();
 			}
-		}
-		else 
-		if (!strcmp("illum",LE_getCurrentToken()))
-		{
+			break;
+		
+		case MTL_KW_ILLUM:
 			currentMaterial->shininess = LE_readReal();
-		}
-		else 
-		if (!strcmp("hasAlpha",LE_getCurrentToken()))
-		{
+			break;
+		
+		case MTL_KW_HAS_ALPHA:
 			currentMaterial->hasAlpha = LE_readReal();
+			break;
+		
+		default:
+			break;
 		}
-		 
 	}
 	
 	LE_popLexer();
@@ -405,6 +468,8 @@ void MATLIB_MakeAvailable(material_t* material)
 	if ((material->prop & PROP_DIFF) == PROP_DIFF &&
 		material->textures[TEXTURE_DIFFUSE].memLocation != TEXT_MEM_LOC_VRAM)
 	{
+		//Normal maps stay png: block compression of the normals is visible in the lighting.
+		material->textures[TEXTURE_DIFFUSE].compressible = 1;
 		TEX_MakeAvailable(&material->textures[TEXTURE_DIFFUSE]);
 		
 		if (
@@ -429,6 +494,7 @@ void MATLIB_MakeAvailable(material_t* material)
 	if ((material->prop & PROP_SPEC) == PROP_SPEC &&
 		material->textures[TEXTURE_SPECULAR].memLocation != TEXT_MEM_LOC_VRAM )
 	{
+		material->textures[TEXTURE_SPECULAR].compressible = 1;
 		TEX_MakeAvailable(&material->textures[TEXTURE_SPECULAR]);
 
 		
@@ -37,7 +37,7 @@
 #define PROP_BUMP      0x01
 #define PROP_SPEC      0x02
 #define PROP_DIFF	   0x04
-#define PROP_UNDEF1    0x08
+#define PROP_COMPACT   0x08		// Mesh uploaded as vertex_compact_t, not a material property.
 #define PROP_UNDEF2    0x10
 #define PROP_UNDEF3	   0x20
 #define PROP_FOG	   0x40	
@@ -56,6 +56,8 @@ typedef struct material_t
 	
 	uchar hasAlpha;
 	
+	ushort index;		// In the order the library was loaded, render queue keys sort on it.
+	
 	texture_t textures[3];
 	
 	
@@ -72,6 +74,9 @@ material_t* MATLIB_Get(char* materialName);
 void MATLIB_MakeAvailable(material_t* material);
 void MAT_MarkMaterialResident(material_t* material);
 
+void MATLIB_AddMaterials(material_t* materials, int numMaterials);
+int  MATLIB_CollectMaterials(material_t** materials, int maxMaterials);
+
 void MATLIB_LoadLibrary(char* mtlPath);
 void MATLIB_LoadLibraries(void);
 
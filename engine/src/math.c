@@ -107,3 +107,20 @@ void strReplace(char* string,char toReplace, char replacment)
 			string[i] = replacment;
 	}
 }
+
+unsigned int randomState = 1;
+
+void randomSeed(unsigned int seed)
+{
+	randomState = seed ? seed : 1;
+}
+
+// xorshift32, the high bits are the best ones.
+int randomNext(void)
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	
+	return (randomState >> 16) & RANDOM_MAX;
+}
@@ -99,6 +99,7 @@ typedef  struct svertex_t {
 #define	vector2Scale( v, s, o )		( (o)[ 0 ] = (v)[ 0 ] * (s),(o)[ 1 ] = (v)[ 1 ] * (s) )
 
 void vectorCrossProduct( const vec3_t v1, const vec3_t v2, vec3_t cross );
+float InvSqrt(float x);
 void normalize(vec3_t v);
 void normalize2(vec2_t v);
 void vectorLinearInterpolate(const vec3_t v1,const vec3_t v2,float t,vec3_t dest);
@@ -114,4 +115,10 @@ void vectorCosinuInterpolate(const vec3_t v1,const vec3_t v2,float t,vec3_t dest
 
 void strReplace(char* string,char toReplace, char replacment);
 
+// Simulation random numbers: same sequence on every platform and, unlike rand(), a state the snapshots can save.
+#define RANDOM_MAX 0x7FFF
+extern unsigned int randomState;
+void randomSeed(unsigned int seed);
+int  randomNext(void);
+
 #endif
\ No newline at end of file
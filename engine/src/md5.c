@@ -258,6 +258,14 @@ void MD5_GenerateSkin (md5_mesh_t* mesh, md5_bone_t* bones)
     }
 }
 
+enum { MD5_KW_SHADER, MD5_KW_NUMVERTS, MD5_KW_NUMTRIS, MD5_KW_NUMWEIGHTS };
+static const char* md5MeshWords[] = { "shader", "numverts", "numtris", "numweights" };
+static le_keywords_t md5MeshKeywords;
+
+enum { MD5_KW_VERSION, MD5_KW_NUMJOINTS, MD5_KW_MESH, MD5_KW_NUMMESHES, MD5_KW_JOINTS };
+static const char* md5FileWords[] = { "MD5Version", "numJoints", "mesh", "numMeshes", "joints" };
+static le_keywords_t md5FileKeywords;
+
 void MD5_ReadMesh(md5_mesh_t* mesh)
 {
 	int j ;
@@ -267,21 +275,22 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 
 	
 	
-	LE_readToken(); // {
+	LE_skipToken(); // {
 	
-	while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken())) 
+	while (LE_hasMoreData() && !LE_spanEquals(LE_getCurrentSpan(), "}")) 
 	{
-		LE_readToken();
-		
-		if (!strcmp("shader", LE_getCurrentToken()))
+		switch (LE_readKeyword(&md5MeshKeywords))
+		{
+		case MD5_KW_SHADER:
 		{
 			LE_readToken();
 			LE_cleanUpDoubleQuotes(LE_getCurrentToken());
 			mesh->materialName = calloc(strlen(LE_getCurrentToken())+1, sizeof(char));
 			strcpy(mesh->materialName, LE_getCurrentToken());
 		}
-		else
-		if (!strcmp("numverts", LE_getCurrentToken()))
+		break;
+		
+		case MD5_KW_NUMVERTS:
 		{
 		
 			mesh->numVertices = LE_readReal();
@@ -290,8 +299,8 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 			vertex = mesh->vertices;
 			for(j=0; j< mesh->numVertices ; j++,vertex++)
 			{
-				LE_readToken() ; //vert
-				LE_readReal();	// id
+				LE_skipToken() ; //vert
+				LE_skipToken();	// id
 				vertex->st[0] = LE_readReal() * 32767;
 				vertex->st[1] = LE_readReal() * 32767;
 				vertex->start = LE_readReal();
@@ -302,8 +311,9 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 			}
 			
 		}
-		else
-		if (!strcmp("numtris", LE_getCurrentToken()))
+		break;
+		
+		case MD5_KW_NUMTRIS:
 		{
 			
 			mesh->numTriangles = LE_readReal();
@@ -313,8 +323,8 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 			triangle = mesh->triangles;
 			for(j=0; j< mesh->numTriangles ; j++,triangle++)
 			{
-				LE_readToken() ; //tri
-				LE_readReal();	// id
+				LE_skipToken() ; //tri
+				LE_skipToken();	// id
 				triangle->index[0] = LE_readReal();
 				triangle->index[1] = LE_readReal();
 				triangle->index[2] = LE_readReal();
@@ -322,8 +332,9 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 				//Log_Printf("MD5 Read tri: [%hu,%hu,%hu]\n",triangle->index[0],triangle->index[1],triangle->index[2]);
 			}
 		}
-		else
-		if (!strcmp("numweights", LE_getCurrentToken()))
+		break;
+		
+		case MD5_KW_NUMWEIGHTS:
 		{
 			
 			mesh->numWeights = LE_readReal();
@@ -333,8 +344,8 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 			weight = mesh->weights;
 			for(j=0;j<mesh->numWeights ; j++,weight++)
 			{
-				LE_readToken() ; //tri
-				LE_readReal();	// id
+				LE_skipToken() ; //weight
+				LE_skipToken();	// id
 				weight->boneId = LE_readReal();
 				weight->bias = LE_readReal();
 				weight->boneSpacePos[0] = LE_readReal();
@@ -344,8 +355,11 @@ void MD5_ReadMesh(md5_mesh_t* mesh)
 				//Log_Printf("MD5 Read weight: Boneid[%d] f[%.2f]  boneSpace[%.2f,%.2f,%.2f]\n",weight->boneId,weight->bias,weight->boneSpacePos[0],weight->boneSpacePos[1],weight->boneSpacePos[2]);
 			}
 		}
+		break;
 		
-	
+		default:
+		break;
+		}
 	}
 	
 }
@@ -431,6 +445,12 @@ char MD5_LoadMesh(md5_mesh_t* mesh, const char* filename)
 		return 0;
 	}
 	
+	if (!md5FileKeywords.numKeywords)
+	{
+		LE_InitKeywords(&md5FileKeywords, md5FileWords, sizeof(md5FileWords)/sizeof(char*));
+		LE_InitKeywords(&md5MeshKeywords, md5MeshWords, sizeof(md5MeshWords)/sizeof(char*));
+	}
+	
 	LE_pushLexer();
 	LE_init(fhandle);
 	
@@ -443,47 +463,45 @@ char MD5_LoadMesh(md5_mesh_t* mesh, const char* filename)
 	
 	while (LE_hasMoreData()) 
 	{
-		LE_readToken();
-		
-		if(!strcmp("MD5Version", LE_getCurrentToken()))
+		switch (LE_readKeyword(&md5FileKeywords))
 		{
+		case MD5_KW_VERSION:
 			versionNumber = LE_readReal();
 			if (versionNumber != 10)
 			{
 				Log_Printf ("[MD5_Loader ERROR] : %s has a bad model version (%d)\n",filename,versionNumber);
 				return 0;
 			}
-		}
-		else
-		if (!strcmp("numJoints", LE_getCurrentToken()))
-		{
+			break;
+		
+		case MD5_KW_NUMJOINTS:
 			mesh->numBones = LE_readReal();
 			mesh->bones = (md5_bone_t*)calloc(mesh->numBones,sizeof(md5_bone_t));
 			//Log_Printf("[MD5_LoadEntity] Found numJoints: %d.\n",mesh->numBones);
-		}
-		else
-		if (!strcmp("mesh", LE_getCurrentToken()))
-		{
+			break;
+		
+		case MD5_KW_MESH:
 			//Log_Printf("[MD5_LoadEntity] Found mesh.\n");
 			MD5_ReadMesh(mesh);  
-		}
-		else
-		if (!strcmp("numMeshes", LE_getCurrentToken()))
-		{
+			break;
+		
+		case MD5_KW_NUMMESHES:
 			//Log_Printf("[MD5_LoadEntity] Found numMeshes.\n");
 			if(LE_readReal() > 1)
 			{
 				Log_Printf("[MD5_Loader ERROR] %s has more than one mesh: Not supported.\n",filename);
 				return 0;
 			}
-		}		   
-		else
-		if (!strcmp("joints", LE_getCurrentToken()))
-		{
+			break;
+		
+		case MD5_KW_JOINTS:
 			//Log_Printf("[MD5_LoadEntity] Found joints.\n");
 			MD5_ReadJoints(mesh->bones,mesh->numBones);
-		}		   
-		   
+			break;
+		
+		default:
+			break;
+		}
 	}
 	
 
@@ -576,12 +594,125 @@ char MD5_LoadMesh(md5_mesh_t* mesh, const char* filename)
 
 
 
+static float MD5_Abs(float value)
+{
+	return value < 0 ? -value : value;
+}
+
+static short MD5_QuantizeShort(float value)
+{
+	value *= DE_SHRT_MAX;
+	
+	if (value >= DE_SHRT_MAX)
+		return DE_SHRT_MAX;
+	if (value <= -DE_SHRT_MAX)
+		return -DE_SHRT_MAX;
+	
+	return (short)(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+static char MD5_QuantizeByte(float value)
+{
+	value *= 127;
+	
+	if (value >= 127)
+		return 127;
+	if (value <= -127)
+		return -127;
+	
+	return (char)(value < 0 ? value - 0.5f : value + 0.5f);
+}
+
+// Unit vector projected on the octahedron |x|+|y|+|z|=1, the lower half folded over the upper one.
+static void MD5_OctahedralEncode(const vec3short_t v, char* dest)
+{
+	float x, y, z;
+	float length;
+	float folded;
+	
+	x = v[X];
+	y = v[Y];
+	z = v[Z];
+	
+	length = MD5_Abs(x) + MD5_Abs(y) + MD5_Abs(z);
+	if (length == 0)
+	{
+		dest[0] = dest[1] = 0;
+		return;
+	}
+	
+	x /= length;
+	y /= length;
+	
+	if (z < 0)
+	{
+		folded = (1 - MD5_Abs(y)) * (x >= 0 ? 1 : -1);
+		y      = (1 - MD5_Abs(x)) * (y >= 0 ? 1 : -1);
+		x = folded;
+	}
+	
+	dest[0] = MD5_QuantizeByte(x);
+	dest[1] = MD5_QuantizeByte(y);
+}
+
+vertex_compact_t* MD5_CompactVertices(md5_mesh_t* mesh, uchar normalsEncoding)
+{
+	vertex_compact_t* compactVertices;
+	vertex_compact_t* compact;
+	vertex_t* vertex;
+	float scale;
+	int i;
+	
+	for (i=0; i < 3; i++)
+	{
+		mesh->dequantization[i] = (mesh->modelSpacebbox.min[i] + mesh->modelSpacebbox.max[i]) / 2;
+		
+		scale = (mesh->modelSpacebbox.max[i] - mesh->modelSpacebbox.min[i]) / 2;
+		if (i == 0 || scale > mesh->dequantization[W])
+			mesh->dequantization[W] = scale;
+	}
+	
+	if (mesh->dequantization[W] <= 0)
+		mesh->dequantization[W] = 1;
+	
+	compactVertices = (vertex_compact_t*)calloc(mesh->numVertices, sizeof(vertex_compact_t));
+	
+	compact = compactVertices;
+	vertex = mesh->vertexArray;
+	for (i=0; i < mesh->numVertices; i++,vertex++,compact++)
+	{
+		compact->pos[X] = MD5_QuantizeShort((vertex->pos[X] - mesh->dequantization[X]) / mesh->dequantization[W]);
+		compact->pos[Y] = MD5_QuantizeShort((vertex->pos[Y] - mesh->dequantization[Y]) / mesh->dequantization[W]);
+		compact->pos[Z] = MD5_QuantizeShort((vertex->pos[Z] - mesh->dequantization[Z]) / mesh->dequantization[W]);
+		
+		compact->text[X] = vertex->text[X];
+		compact->text[Y] = vertex->text[Y];
+		
+		if (normalsEncoding == MD5_NORMALS_OCTAHEDRAL)
+		{
+			MD5_OctahedralEncode(vertex->normal, &compact->normal[0]);
+			MD5_OctahedralEncode(vertex->tangent, &compact->normal[2]);
+		}
+		else
+		{
+			compact->normal[X] = MD5_QuantizeByte(vertex->normal[X] / (float)DE_SHRT_MAX);
+			compact->normal[Y] = MD5_QuantizeByte(vertex->normal[Y] / (float)DE_SHRT_MAX);
+			compact->normal[Z] = MD5_QuantizeByte(vertex->normal[Z] / (float)DE_SHRT_MAX);
+		}
+	}
+	
+	return compactVertices;
+}
+
 void MD5_FreeMesh(md5_mesh_t* mesh)
 {
 		//If GPU resident, free it as well
 	if (mesh->memLocation == MD5_MEMLOC_VRAM)
 	{
 		renderer.FreeGPUBuffer(mesh->vboId);
+		
+		if (mesh->keepVertices)
+			free(mesh->vertexArray);
 	}
 	else {
 		free(mesh->vertexArray);
@@ -79,6 +79,25 @@ typedef struct md5_bbox_t
 	
 } md5_bbox_t;
 
+/*
+	Compact layout of the static (map) meshes, 16 bytes instead of 28-32. The
+	position is quantized to the mesh bbox with one scale for all axes, so the
+	dequantization (md5_mesh_t.dequantization: model = xyz + w * normalized
+	short) is a uniform scale plus translation that folds into the model matrix
+	without touching the lighting. The normal field depends on the renderer:
+	MD5_NORMALS_OCTAHEDRAL packs normal and tangent in 2 bytes each, decoded by
+	the shader; the fixed pipeline gets MD5_NORMALS_XYZ, a plain byte normal.
+*/
+typedef struct vertex_compact_t
+{
+	vec4short_t pos;		// w unused, keeps the following attributes 4 bytes aligned.
+	vec2short_t text;
+	char normal[4];
+} vertex_compact_t;
+
+#define MD5_NORMALS_XYZ				0
+#define MD5_NORMALS_OCTAHEDRAL		1
+
 #define MD5_MEMLOC_DISK 0
 #define MD5_MEMLOC_RAM 1
 #define MD5_MEMLOC_VRAM 2
@@ -114,6 +133,10 @@ typedef struct md5_mesh_t
 	uint indicesVboId;
 	
 	uchar memStatic;			//This mesh should never be freed, even between levels.
+	uchar keepVertices;			//vertexArray is not freed by the GPU upload.
+	
+	uchar isCompact;			//Uploaded as vertex_compact_t.
+	vec4_t dequantization;
 	
 } md5_mesh_t;
 
@@ -121,6 +144,9 @@ typedef struct md5_mesh_t
 
 char MD5_LoadMesh(md5_mesh_t* mesh, const char* filename);
 void MD5_FreeMesh(md5_mesh_t* mesh);
+
+// Converts vertexArray, the returned array is to be freed by the caller once uploaded.
+vertex_compact_t* MD5_CompactVertices(md5_mesh_t* mesh, uchar normalsEncoding);
 #endif
 
 
@@ -26,9 +26,15 @@
 #ifndef DE_SOUND
 #define DE_SOUND
 
+// startAt is in seconds.
 void SND_InitSoundTrack(char* filename,unsigned int startAt);
 void SND_StartSoundTrack(void);
 void SND_StopSoundTrack(void);
 void SND_PauseSoundTrack(void);
 void SND_ResumeSoundTrack(void);
+
+// A track SND_InitSoundTrack will ask for soon: platforms streaming in the background start opening it.
+void SND_PrefetchSoundTrack(char* filename);
+// Moves the playing track to ms from its beginning.
+void SND_SeekSoundTrack(unsigned int ms);
 #endif
\ No newline at end of file
@@ -24,20 +24,19 @@
  */
 
 #include "netchannel.h"
+#include "rollback.h"
+#include "netpacket.h"
 
 // The network version was designed on iOS with Unix socket. This part still needs to be ported using winsock32.
 #if defined(WIN32) || defined(ANDROID) || defined(LINUX)
 	int NET_Init(void){return 1;}
 	void NET_Setup(void){}
-	void NET_Receive(void){}
-	void NET_Send(void){}
 	void NET_Free(void){}
 	char NET_IsInitialized(){return 1;}
 	void Net_SendDie(command_t* command){}
 	void NET_OnActLoaded(void){}
 	void NET_OnNextLevelLoad(void){}
 	char NET_IsRunning(void){return 0;}
-	uint NET_GetDropedPackets(void){return 0;}
 
 	net_channel_t net;
 #else
@@ -113,26 +112,10 @@ typedef struct net_packet_t
 	
 } net_packet_t;
 
-
-// PREDICTION
-#define MAX_CMD_HISTORY 4
-typedef struct cmdHistory
-{
-	command_t array [MAX_CMD_HISTORY];
-	uchar ptr;
-} cmdHistory_t;
-cmdHistory_t cmdHistory;
-
-#define MAX_FAKE_CMD_HISTORY 16
-typedef struct fakeCmdHistory_t
-{
-	command_t stack[MAX_FAKE_CMD_HISTORY];
-	uchar num;
-} fakeCmdHistory_t ;
-
-fakeCmdHistory_t fakeCmdHistory;
-
-// END PREDICTION
+//RUNTIME_PACKET are encoded by netpacket.c, only their first byte is shared.
+#if RUNTIME_PACKET != NETP_TYPE_INPUT
+	#error "RUNTIME_PACKET and NETP_TYPE_INPUT must match"
+#endif
 
 
 void NET_Free(void)
@@ -151,8 +134,16 @@ void NET_Free(void)
 	
 	net.lastReceivedSequenceNumber = 0;
 	net.lastSentSequenceNumber = 1;
+	memset(net.lastReceivedInputSequence, 0, sizeof(net.lastReceivedInputSequence));
 	
 	net.numDropedPackets = 0 ;
+	memset(&net.stats, 0, sizeof(net.stats));
+	memset(&net.counting, 0, sizeof(net.counting));
+	
+	RB_Stop();
+	
+	if (net.transport.Close)
+		net.transport.Close(&net.transport);
 	
 	//free(buffer);
 	
@@ -795,6 +786,8 @@ void Net_ProcessSetupPacket(void)
 		SND_ResumeSoundTrack();
 		Timer_resetTime();
 		Timer_Resume();
+		NETT_InitUDP(&net.transport, net.udpSocket, &net.peerAddr);
+		RB_Start(controlledPlayer, numPlayers, engine.netInputDelay);
 		
 		Log_Printf("Server Received NET_CMD_NOTIFY_LOADED, starting and asking client to start as well: NET_CMD_START_LEVEL.\n");
 		
@@ -820,6 +813,8 @@ void Net_ProcessSetupPacket(void)
 		SND_ResumeSoundTrack();
 		Timer_resetTime();
 		Timer_Resume();
+		NETT_InitUDP(&net.transport, net.udpSocket, &net.peerAddr);
+		RB_Start(controlledPlayer, numPlayers, engine.netInputDelay);
 		
 		Log_Printf("Client Received NET_CMD_START_LEVEL, starting.\n");
 		
@@ -940,11 +935,6 @@ void NET_Setup(void)
 	{
 		Log_Printf("Stoping setup, as we reached NET_RUNNING\n");
 		net.setupRequested = 0;
-		
-		memset(&fakeCmdHistory,0,sizeof(fakeCmdHistory_t));
-		
-		memset(&cmdHistory,0,sizeof(cmdHistory_t));
-
 	}
 	
 	
@@ -955,297 +945,219 @@ char NET_IsInitialized()
 	return isInitialized;
 }
 
-uint outSequenceNumber;
-uint inSequenceNumber;
-typedef struct net_message_t
+void Net_SendDie(command_t* command)
 {
-	uint sequenceNumber;
-	uchar playerId;
-	uchar type;
-	void* payload;
-	
-} net_message_t;
 
-#define deltaT 2
-command_t* NET_GenerateFakeCMD(void)
-{
-	static command_t cmd;
-	command_t* last;
-	command_t* lastMinusOne;
-	command_t* lastMinusTwo;
-	vec3_t delta1;
-	vec3_t delta2;
-	float sumDelta;
-	
-	last = &cmdHistory.array[(cmdHistory.ptr -1) & (MAX_CMD_HISTORY-1) ];
-	lastMinusOne = &cmdHistory.array[(cmdHistory.ptr -2) & (MAX_CMD_HISTORY-1) ];
-	lastMinusTwo = &cmdHistory.array[(cmdHistory.ptr -3) & (MAX_CMD_HISTORY-1) ];
-	
-	delta1[X] =      lastMinusOne->delta[X] - lastMinusTwo->delta[X];
-	delta1[Y] =      lastMinusOne->delta[Y] - lastMinusTwo->delta[Y];
-	delta1[deltaT] = lastMinusOne->time     - lastMinusTwo->time;
-	
-	delta2[X] =      last->delta[X] - lastMinusOne->delta[X];
-	delta2[Y] =      last->delta[Y] - lastMinusOne->delta[Y];
-	delta2[deltaT] = last->time     - lastMinusOne->time;
-	
-	sumDelta = delta1[deltaT]+delta2[deltaT];
-	if (sumDelta == 0)
-	{
-		delta1[X]=0;
-		delta1[Y]=0;
-		delta2[X]=0;
-		delta2[Y]=0;
-		sumDelta=0.001f;
-	}
-	//Need need to use the three previous cmds to generate two deltas.
+	net_packet_t send_packet;
+
+	Log_Printf("Net_SendDie\n");
 	
+	send_packet.type = NET_RUNNING;
+	send_packet.sequenceNumber = net.lastSentSequenceNumber++;
+	send_packet.ackSequenceNumber = net.lastReceivedSequenceNumber;
+	memcpy(&send_packet.command,command,sizeof(command_t));
 	
-	cmd.type = NET_RTM_COMMAND;
-	cmd.time = simulationTime;
-	cmd.playerId = !controlledPlayer;
-	cmd.buttons = 0;
-	cmd.delta[X] = delta1[X]*delta1[deltaT]/sumDelta + delta2[X]*delta2[deltaT] /sumDelta;
-	cmd.delta[Y] = delta1[Y]*delta1[deltaT]/sumDelta + delta2[Y]*delta2[deltaT] /sumDelta;
-	cmd.buttons = last->buttons;
+	sendto(net.udpSocket, &send_packet, sizeof(net_packet_t), 0, (struct sockaddr*)&net.peerAddr, sizeof(net.peerAddr));	
 	
-	return &cmd;
 }
 
-void NET_AddFakeToHistory(command_t* cmd)
+int NET_Init(void)
 {
-	if (fakeCmdHistory.num == MAX_FAKE_CMD_HISTORY-1)
-		return;
-	
-	fakeCmdHistory.stack[fakeCmdHistory.num].delta[X] = cmd->delta[X];
-	fakeCmdHistory.stack[fakeCmdHistory.num].delta[Y] = cmd->delta[Y];
-	fakeCmdHistory.stack[fakeCmdHistory.num].time = cmd->time;
+	Log_Printf("NET_Init\n");
+	NET_Free();
+	net.setupRequested = 1;
+	return 1;
+}
+
+void NET_OnNextLevelLoad(void)
+{
+	Log_Printf("NET_OnNextLevelLoad\n");
+	RB_Stop();
 	
-	fakeCmdHistory.num++;
+	//The setup packets of the next level are read by NET_Setup.
+	if (net.transport.Close)
+		net.transport.Close(&net.transport);
+	net.setupRequested = 1;
+	net.state = NET_STARTED;	
 }
 
-void NET_AddCMDToHistory(command_t* cmd)
+char NET_IsRunning(void)
 {
-	command_t* emptySlot;
-	
-	emptySlot = &cmdHistory.array[cmdHistory.ptr];
-	emptySlot->delta[X] = cmd->delta[X];
-	emptySlot->delta[Y] = cmd->delta[Y];
-	emptySlot->time = simulationTime;
-	emptySlot->buttons = cmd->buttons;
-	cmdHistory.ptr = (cmdHistory.ptr + 1) & (MAX_CMD_HISTORY-1);
+	Log_Printf("NET_IsRunning\n");
+	return (net.state == NET_RUNNING);
 }
 
+#endif
+
+//
+// Runtime packets, common to every platform: they go through net.transport.
+//
 
-void NET_Receive(void)
+static void NET_UpdateStats(void)
 {
-	int byteReceived = 0;
-	socklen_t len ;
-	net_packet_t rcv_packet;
-	command_buffer_t* cmdBuffer;
-	uchar numDeltaUpdateRecv=0;
-	int i;
-	command_t* cmd;
-	
-	//Log_Printf("NET_Receive\n");
+	int now;
 	
-	if (!isInitialized)
+	now = E_Sys_Milliseconds();
+	if (now - net.countingSince < 1000)
 		return;
 	
-	cmdBuffer = &commandsBuffers[!controlledPlayer];
-	commandsBuffers[!controlledPlayer].numCommands = 0;
+	net.stats = net.counting;
+	memset(&net.counting, 0, sizeof(net.counting));
+	net.countingSince = now;
+}
 
+void NET_Receive(void)
+{
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	netp_input_packet_t packet;
+	netp_relay_ack_t relayAck;
+	rb_state_t state;
+	uint* lastSequence;
+	int numReceived;
+	int i,j;
+	
+	if (!net.transport.Receive)
+		return;
 	
-	while (1)
+	do
 	{
-		byteReceived = recvfrom(net.udpSocket,&rcv_packet,sizeof(net_packet_t),0, NULL, &len );
+		numReceived = net.transport.Receive(&net.transport, buffers, sizes, NETT_RECV_BATCH);
 		
-		if (byteReceived == -1)
-		{
-			if (errno != EAGAIN )
-				sprintf(MENU_GetMultiplayerTextLine(4),"Error recvfrom:%d %s.\n",errno,strerror( errno ));
-			break;
-		}	
-		if (rcv_packet.sequenceNumber <= net.lastReceivedSequenceNumber)
+		for (i=0; i < numReceived; i++) 
 		{
-			Log_Printf("Old packet.\n");
-			continue;
-		}
+			net.counting.bytesReceived += sizes[i];
+			net.counting.packetsReceived++;
 			
+			if (NETP_DecodeRelayAck(&relayAck, buffers[i], sizes[i]))
+			{
+				if (controlledPlayer < relayAck.numPlayers)
+					RB_SetRelayAck(relayAck.nextFrames[controlledPlayer]);
+				continue;
+			}
 			
-		net.numDropedPackets +=  (rcv_packet.sequenceNumber - (1 + net.lastReceivedSequenceNumber));
+			if (NETP_DecodeState(&state, buffers[i], sizes[i]))
+			{
+				RB_SetAuthority(&state);
+				continue;
+			}
 			
-		net.lastReceivedSequenceNumber = rcv_packet.sequenceNumber;
+			//Safe guard against data corruption
+			if (!NETP_Decode(&packet, buffers[i], sizes[i]) || packet.playerId == controlledPlayer)
+				continue;
 			
-		
-		rcv_packet.command.time = simulationTime;
-		
-		//Log_Printf("Receiving packet for player id= %d\n",rcv_packet.command.playerId);
-		
-		
-		
-		//Safe guard against data corruption
-		if(rcv_packet.command.playerId < 2 && commandsBuffers[!controlledPlayer].numCommands < COMMAND_BUFFER_SIZE-1)
-		{
-			memcpy(&commandsBuffers[!controlledPlayer].cmds[commandsBuffers[!controlledPlayer].numCommands], &rcv_packet.command, sizeof(command_t));
+			//Out of order: the commands are still useful, rollback ignores the ones it has.
+			//The setup packets took the first sequence numbers of the sender (iOS).
+			lastSequence = &net.lastReceivedInputSequence[packet.playerId];
+			if (*lastSequence == 0)
+				*lastSequence = packet.sequence - 1;
 			
-			/*
-			Log_Printf("t=%d rcv: t=%d d=[%.2f %.2f] %d%d%d\n",
-				   simulationTime,
-				   rcv_packet.type,rcv_packet.command.delta[X],
-				   rcv_packet.command.delta[Y],
-				   rcv_packet.command.buttons & BUTTON_MOVE_PRESSED,
-				   rcv_packet.command.buttons & BUTTON_FIRE_PRESSED,
-				   rcv_packet.command.buttons & BUTTON_GHOST_PRESSED
-				   );
-			*/
-			//Need to add this command to history
-			if (rcv_packet.type == NET_RTM_COMMAND)
+			if (packet.sequence > *lastSequence)
 			{
-				NET_AddCMDToHistory(&rcv_packet.command);
-				numDeltaUpdateRecv += 1;
+				net.numDropedPackets +=  (packet.sequence - (1 + *lastSequence));
+				net.counting.packetsLost += (packet.sequence - (1 + *lastSequence));
+				*lastSequence = packet.sequence;
 			}
 			
-		
-			cmdBuffer->cmds[commandsBuffers[!controlledPlayer].numCommands].time = simulationTime;
-			commandsBuffers[!controlledPlayer].numCommands++;
-		}
-	}
-	
-	
-	Log_Printf("t=%d,numDeltaUpdateRecv=%d\n",simulationTime,numDeltaUpdateRecv);
-	
-	return;
-	
-	// If no update was received, we need to create a fake one in order to avoid jerky mouvments.
-	if (numDeltaUpdateRecv == 0)
-	{
-		
-		//Gen fake command based on extrapolation
-		cmd = NET_GenerateFakeCMD();
-		
-		//Add it to history
-		NET_AddFakeToHistory(cmd);
-		
-		//Log_Printf("t=%d, missing deltaCmd: fake=%.4f,%.4f\n",simulationTime,cmd->delta[X],cmd->delta[Y]);
-		if (commandsBuffers[!controlledPlayer].numCommands < COMMAND_BUFFER_SIZE-1)
-		{
-			memcpy(&commandsBuffers[!controlledPlayer].cmds[commandsBuffers[!controlledPlayer].numCommands], cmd, sizeof(command_t));
-			cmdBuffer->cmds[commandsBuffers[!controlledPlayer].numCommands].time = simulationTime;
-			commandsBuffers[!controlledPlayer].numCommands++;
-		}
-		
-	}
-	else 
-	{
-		//Log_Printf("t=%d: %d deltaCmd(s).\n",simulationTime,numDeltaUpdateRecv);
-		// If we have received more than 1 update, we can undo that many fake commands previously generated
-		for (i=1; i < numDeltaUpdateRecv && fakeCmdHistory.num >0 && commandsBuffers[!controlledPlayer].numCommands < COMMAND_BUFFER_SIZE-1; i++) 
-		{
-			//Log_Printf("t=%d: Undoing 1 fake deltaCmd.\n",simulationTime);
-			cmd = &cmdBuffer->cmds[commandsBuffers[!controlledPlayer].numCommands];
-			cmd->time = simulationTime;
-			cmd->type = NET_RTM_COMMAND;
-			cmd->delta[X] = -fakeCmdHistory.stack[fakeCmdHistory.num-1].delta[X];
-			cmd->delta[Y] = -fakeCmdHistory.stack[fakeCmdHistory.num-1].delta[Y];
-			cmd->buttons = 0;
-			cmd->playerId = !controlledPlayer;
-			commandsBuffers[!controlledPlayer].numCommands++;
-			
+			RB_SetRemoteSync(packet.playerId, &packet.sync);
 			
-			
-			fakeCmdHistory.num--;
-		} 
-	}
- 
-	
-	
+			for (j=0; j < packet.numCommands; j++) 
+				RB_AddRemoteCommand(packet.firstFrame + j, &packet.commands[j]);
+		}
+	} while (numReceived == NETT_RECV_BATCH);
 	
+	NET_UpdateStats();
 }
 
-int lastFullUpdateTime = 0;
-void NET_Send()
+void NET_Send(void)
 {
-	net_packet_t send_packet;
+	netp_input_packet_t packet;
+	uchar buffer[NETP_MAX_SIZE];
+	uint size;
 	
-	//Log_Printf("NET_Send\n");
-	
-	if (!isInitialized)
+	if (!net.transport.Send)
 		return;
 	
-	//Log_Printf("To send contains playerId= %X\n",toSend.playerId);
-	
+	packet.playerId = controlledPlayer;
+	packet.sequence = net.lastSentSequenceNumber++;
 	
+	//Resending the unacked commands in every packet makes up for the lost ones.
+	RB_GetSync(&packet.sync);
+	packet.numCommands = RB_GetLocalCommands(packet.commands, NETP_MAX_COMMANDS, &packet.firstFrame);
 	
-	send_packet.type = RUNTIME_PACKET;
-	send_packet.command.type = NET_RTM_COMMAND;
-	send_packet.sequenceNumber = net.lastSentSequenceNumber++;
-	//Log_Printf("net.lastSentSequenceNumber=%d\n",net.lastSentSequenceNumber);
-	send_packet.ackSequenceNumber = net.lastReceivedSequenceNumber;
-	memcpy(&send_packet.command,&toSend,sizeof(command_t));
+	size = NETP_Encode(&packet, buffer, sizeof(buffer));
 	
-	//send_packet.command.playerId = controlledPlayer;
+	net.transport.Send(&net.transport, buffer, size);
 	
-	//Log_Printf("Sending packet for player id= %X\n",send_packet.command.playerId);
-	//Log_Printf("Controlled player = %X\n",controlledPlayer);
-	
-	sendto(net.udpSocket, &send_packet, sizeof(net_packet_t), 0, (struct sockaddr*)&net.peerAddr, sizeof(net.peerAddr));	
-	
-	
-	
-	if (simulationTime - lastFullUpdateTime > 1000)
-	{
-		// We are reusing the delta field to contain absolute position :/ No clean I know.
-		send_packet.command.type = NET_RTM_ABS_UPDATE;
-		send_packet.command.delta[X] = players[controlledPlayer].ss_position[X];
-		send_packet.command.delta[Y] = players[controlledPlayer].ss_position[Y];
-		send_packet.sequenceNumber = net.lastSentSequenceNumber++;
-		sendto(net.udpSocket, &send_packet, sizeof(net_packet_t), 0, (struct sockaddr*)&net.peerAddr, sizeof(net.peerAddr));	
-		lastFullUpdateTime= simulationTime;
-	}
+	net.counting.bytesSent += size;
+	net.counting.packetsSent++;
 }
-		
-void Net_SendDie(command_t* command)
+
+uint NET_GetDropedPackets(void)
 {
+	return net.numDropedPackets;
+}
 
-	net_packet_t send_packet;
+#ifndef WIN32
 
-	Log_Printf("Net_SendDie\n");
-	
-	send_packet.type = NET_RUNNING;
-	send_packet.sequenceNumber = net.lastSentSequenceNumber++;
-	send_packet.ackSequenceNumber = net.lastReceivedSequenceNumber;
-	memcpy(&send_packet.command,command,sizeof(command_t));
-	
-	sendto(net.udpSocket, &send_packet, sizeof(net_packet_t), 0, (struct sockaddr*)&net.peerAddr, sizeof(net.peerAddr));	
-	
-}
+//
+// Joining a dedicated server, on every platform with Unix sockets.
+//
 
-int NET_Init(void)
-{
-	Log_Printf("NET_Init\n");
-	NET_Free();
-	net.setupRequested = 1;
-	return 1;
-}
+#include <sys/types.h>
+#include <sys/socket.h>
 
-void NET_OnNextLevelLoad(void)
+void NET_SendJoin(int udpSocket, const struct sockaddr_in* server, uint nonce)
 {
-	Log_Printf("NET_OnNextLevelLoad\n");
-	net.setupRequested = 1;
-	net.state = NET_STARTED;	
+	uchar buffer[NETP_MAX_JOIN_SIZE];
+	
+	sendto(udpSocket, buffer, NETP_EncodeJoin(nonce, buffer), 0, (const struct sockaddr*)server, sizeof(*server));
 }
 
-char NET_IsRunning(void)
+char NET_ReceiveWelcome(int udpSocket, const struct sockaddr_in* server, uint nonce, netp_welcome_t* welcome)
 {
-	Log_Printf("NET_IsRunning\n");
-	return (net.state == NET_RUNNING);
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	struct sockaddr_in senders[NETT_RECV_BATCH];
+	int numReceived;
+	int i;
+	
+	//The input packets of the players seated earlier are dropped: they are resent until acked.
+	do
+	{
+		numReceived = NETT_ReceiveFrom(udpSocket, buffers, sizes, senders, NETT_RECV_BATCH);
+		
+		for (i=0; i < numReceived; i++) 
+			if (senders[i].sin_addr.s_addr == server->sin_addr.s_addr && senders[i].sin_port == server->sin_port &&
+				NETP_DecodeWelcome(welcome, buffers[i], sizes[i]) && welcome->nonce == nonce)
+				return 1;
+	} while (numReceived == NETT_RECV_BATCH);
+	
+	return 0;
 }
 
-uint NET_GetDropedPackets(void)
+void NET_StartSession(int udpSocket, const struct sockaddr_in* server, const netp_welcome_t* welcome)
 {
-	return net.numDropedPackets;
+	engine.netInputDelay = welcome->inputDelay;
+	dEngine_LoadMultiplayerScene(welcome->sceneId, welcome->numPlayers);
+	controlledPlayer = welcome->playerId;
+	
+	memset(&net, 0, sizeof(net));
+	net.udpSocket = udpSocket;
+	net.state = NET_RUNNING;
+	net.lastSentSequenceNumber = 1;
+	NETT_InitUDP(&net.transport, udpSocket, server);
+	
+	RB_Start(controlledPlayer, numPlayers, engine.netInputDelay);
+	
+	//The welcome is the go: until the session is full, the players seated first stall on the missing inputs.
+	SND_ResumeSoundTrack();
+	Timer_resetTime();
+	Timer_Resume();
+	
+	Log_Printf("[NET_StartSession] Player %d of session %u, %d players.\n",controlledPlayer,welcome->session,numPlayers);
+	
+	MENU_Set(MENU_NONE);
 }
 
-
-#endif
\ No newline at end of file
+#endif
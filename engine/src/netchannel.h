@@ -42,6 +42,7 @@
 #include "timer.h"
 #include "dEngine.h"
 #include "player.h"
+#include "nettransport.h"
 
 
 
@@ -63,6 +64,16 @@ int NET_Init(void);
 
 #define BUFFER_SIZE 1024
 
+// Counted over one second, STATS_Render shows them.
+typedef struct net_stats_t
+{
+	uint bytesSent;
+	uint bytesReceived;
+	uint packetsSent;
+	uint packetsReceived;
+	uint packetsLost;
+} net_stats_t;
+
 #if !defined(WIN32) && !defined(ANDROID) && !defined(LINUX) && !defined(__EMSCRIPTEN__)
 #include <dns_sd.h>
 #include <netdb.h>
@@ -98,9 +109,16 @@ int				state;
 	
 	unsigned int lastReceivedSequenceNumber;
 	unsigned int lastSentSequenceNumber;
+	unsigned int lastReceivedInputSequence[MAX_NUM_PLAYERS];	// By sender, the input packets.
 	
 	uint numDropedPackets;
 	
+	net_stats_t stats;			// Last full second.
+	net_stats_t counting;		// Current second.
+	int countingSince;
+	
+	net_transport_t transport;	// Runtime packets, set while running.
+	
 } net_channel_t;
 #else
 	
@@ -126,9 +144,16 @@ int				state;
 	
 	unsigned int lastReceivedSequenceNumber;
 	unsigned int lastSentSequenceNumber;
+	unsigned int lastReceivedInputSequence[MAX_NUM_PLAYERS];	// By sender, the input packets.
 	
 	uint numDropedPackets;
 	
+	net_stats_t stats;			// Last full second.
+	net_stats_t counting;		// Current second.
+	int countingSince;
+	
+	net_transport_t transport;	// Runtime packets, set while running.
+	
 } net_channel_t;
 	
 #endif
@@ -155,4 +180,15 @@ void NET_OnNextLevelLoad(void);
 char NET_IsRunning(void);
 
 uint NET_GetDropedPackets(void);
+
+#ifndef WIN32
+#include "netpacket.h"
+
+// Joining a dedicated server (server.h): send the join again until a welcome with its nonce comes back.
+void NET_SendJoin(int udpSocket, const struct sockaddr_in* server, uint nonce);
+char NET_ReceiveWelcome(int udpSocket, const struct sockaddr_in* server, uint nonce, netp_welcome_t* welcome);
+
+// Loads the scene of the session and plays it through the server. The socket stays open while it runs.
+void NET_StartSession(int udpSocket, const struct sockaddr_in* server, const netp_welcome_t* welcome);
+#endif
 #endif
\ No newline at end of file
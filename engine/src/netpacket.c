@@ -0,0 +1,498 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  netpacket.c
+ *  dEngine
+ *
+ *  Wire format of the multiplayer input packets.
+ *
+ */
+
+#include "netpacket.h"
+
+#define NETP_FNV_PRIME	0x100000001b3ULL
+
+static int NETP_Quantize(float value)
+{
+	int quantized;
+
+	quantized = (int)(value * NETP_DELTA_SCALE + (value >= 0 ? 0.5f : -0.5f));
+
+	if (quantized > NETP_MAX_DELTA)
+		return NETP_MAX_DELTA;
+	if (quantized < -NETP_MAX_DELTA)
+		return -NETP_MAX_DELTA;
+
+	return quantized;
+}
+
+void NETP_QuantizeCommand(command_t* command)
+{
+	command->delta[X] = NETP_Quantize(command->delta[X]) / NETP_DELTA_SCALE;
+	command->delta[Y] = NETP_Quantize(command->delta[Y]) / NETP_DELTA_SCALE;
+}
+
+static uint NETP_ZigZag(int value)
+{
+	return ((uint)value << 1) ^ (uint)(value >> 31);
+}
+
+static int NETP_UnZigZag(uint value)
+{
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+static uint NETP_WriteVarint(uchar* dst, uint value)
+{
+	uint size = 0;
+
+	while (value >= 0x80)
+	{
+		dst[size++] = (uchar)(value | 0x80);
+		value >>= 7;
+	}
+	dst[size++] = (uchar)value;
+
+	return size;
+}
+
+//Return the number of bytes consumed, 0 if the varint is truncated.
+static uint NETP_ReadVarint(const uchar* src, const uchar* end, uint* value)
+{
+	uint size = 0;
+	int shift = 0;
+	uint result = 0;
+	uchar b;
+
+	while (src + size < end && shift < 35)
+	{
+		b = src[size++];
+		result |= (uint)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+		{
+			*value = result;
+			return size;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+// Deltas are written as differences with previous, the last ones written for this player.
+static uint NETP_WriteCommand(uchar* dst, const command_t* command, int* previous)
+{
+	uchar* cursor = dst;
+	int quantized[2];
+	uchar header;
+
+	quantized[X] = NETP_Quantize(command->delta[X]);
+	quantized[Y] = NETP_Quantize(command->delta[Y]);
+
+	header = command->buttons & NETP_HEADER_BUTTONS;
+	if (quantized[X] != previous[X] || quantized[Y] != previous[Y])
+		header |= NETP_HEADER_DELTA;
+
+	*cursor++ = header;
+
+	if (header & NETP_HEADER_DELTA)
+	{
+		cursor += NETP_WriteVarint(cursor, NETP_ZigZag(quantized[X] - previous[X]));
+		cursor += NETP_WriteVarint(cursor, NETP_ZigZag(quantized[Y] - previous[Y]));
+		previous[X] = quantized[X];
+		previous[Y] = quantized[Y];
+	}
+
+	return (uint)(cursor - dst);
+}
+
+//Return the number of bytes consumed, 0 if the command is truncated or corrupted.
+static uint NETP_ReadCommand(const uchar* src, const uchar* end, command_t* command, uchar playerId, int* previous)
+{
+	const uchar* cursor = src;
+	uint value;
+	uint read;
+	uchar header;
+	int j;
+
+	if (cursor >= end)
+		return 0;
+
+	header = *cursor++;
+
+	if (header & NETP_HEADER_DELTA)
+	{
+		for (j=0; j < 2; j++)
+		{
+			read = NETP_ReadVarint(cursor, end, &value);
+			if (!read || value > 4 * NETP_MAX_DELTA)
+				return 0;
+			cursor += read;
+			previous[j] += NETP_UnZigZag(value);
+		}
+	}
+
+	memset(command, 0, sizeof(command_t));
+	command->type = NET_RTM_COMMAND;
+	command->playerId = playerId;
+	command->buttons = header & NETP_HEADER_BUTTONS;
+	command->delta[X] = previous[X] / NETP_DELTA_SCALE;
+	command->delta[Y] = previous[Y] / NETP_DELTA_SCALE;
+
+	return (uint)(cursor - src);
+}
+
+uint NETP_Encode(const netp_input_packet_t* packet, uchar* buffer, uint capacity)
+{
+	uchar* cursor = buffer;
+	int previous[2] = {0, 0};
+	int i;
+
+	if (capacity < NETP_MAX_SIZE || packet->numCommands > NETP_MAX_COMMANDS)
+		return 0;
+
+	*cursor++ = NETP_TYPE_INPUT;
+	*cursor++ = packet->playerId;
+	cursor += NETP_WriteVarint(cursor, packet->sequence);
+	cursor += NETP_WriteVarint(cursor, packet->sync.frame);
+	cursor += NETP_WriteVarint(cursor, NETP_ZigZag(packet->sync.advantage));
+	cursor += NETP_WriteVarint(cursor, packet->sync.ackFrame);
+	cursor += NETP_WriteVarint(cursor, NETP_ZigZag((int)(packet->sync.frame - packet->firstFrame)));
+	*cursor++ = packet->numCommands;
+
+	for (i=0; i < packet->numCommands; i++)
+		cursor += NETP_WriteCommand(cursor, &packet->commands[i], previous);
+
+	return (uint)(cursor - buffer);
+}
+
+char NETP_Decode(netp_input_packet_t* packet, const uchar* buffer, uint size)
+{
+	const uchar* cursor = buffer;
+	const uchar* end = buffer + size;
+	uint* fields[4];
+	uint advantage;
+	uint firstFrame;
+	uint read;
+	int previous[2] = {0, 0};
+	int i;
+
+	if (size < 2 || *cursor++ != NETP_TYPE_INPUT || *cursor >= MAX_NUM_PLAYERS)
+		return 0;
+	packet->playerId = *cursor++;
+
+	fields[0] = &packet->sequence;
+	fields[1] = &packet->sync.frame;
+	fields[2] = &advantage;
+	fields[3] = &packet->sync.ackFrame;
+
+	for (i=0; i < 4; i++)
+	{
+		read = NETP_ReadVarint(cursor, end, fields[i]);
+		if (!read)
+			return 0;
+		cursor += read;
+	}
+	packet->sync.advantage = NETP_UnZigZag(advantage);
+
+	read = NETP_ReadVarint(cursor, end, &firstFrame);
+	if (!read)
+		return 0;
+	cursor += read;
+	packet->firstFrame = packet->sync.frame - NETP_UnZigZag(firstFrame);
+
+	if (cursor >= end || *cursor > NETP_MAX_COMMANDS)
+		return 0;
+	packet->numCommands = *cursor++;
+
+	for (i=0; i < packet->numCommands; i++)
+	{
+		read = NETP_ReadCommand(cursor, end, &packet->commands[i], packet->playerId, previous);
+		if (!read)
+			return 0;
+		cursor += read;
+	}
+
+	return cursor == end;
+}
+
+uint NETP_EncodeRelayAck(const netp_relay_ack_t* ack, uchar* buffer, uint capacity)
+{
+	uchar* cursor = buffer;
+	int i;
+
+	if (capacity < NETP_MAX_RELAY_ACK_SIZE || ack->numPlayers > MAX_NUM_PLAYERS)
+		return 0;
+
+	*cursor++ = NETP_TYPE_RELAY_ACK;
+	*cursor++ = ack->numPlayers;
+
+	for (i=0; i < ack->numPlayers; i++)
+		cursor += NETP_WriteVarint(cursor, ack->nextFrames[i]);
+
+	return (uint)(cursor - buffer);
+}
+
+char NETP_DecodeRelayAck(netp_relay_ack_t* ack, const uchar* buffer, uint size)
+{
+	const uchar* cursor = buffer;
+	const uchar* end = buffer + size;
+	uint read;
+	int i;
+
+	if (size < 2 || *cursor++ != NETP_TYPE_RELAY_ACK || *cursor > MAX_NUM_PLAYERS)
+		return 0;
+	ack->numPlayers = *cursor++;
+
+	for (i=0; i < ack->numPlayers; i++)
+	{
+		read = NETP_ReadVarint(cursor, end, &ack->nextFrames[i]);
+		if (!read)
+			return 0;
+		cursor += read;
+	}
+
+	return cursor == end;
+}
+
+void NETP_BeginBlock(netp_block_writer_t* writer, uchar* buffer, uint capacity, uchar numPlayers, uint index, uint firstFrame)
+{
+	memset(writer, 0, sizeof(netp_block_writer_t));
+	writer->buffer = buffer;
+	writer->capacity = capacity;
+	writer->numPlayers = numPlayers;
+
+	buffer[0] = NETP_TYPE_BLOCK;
+	buffer[1] = numPlayers;
+	buffer[2] = 0;
+	writer->size = 3;
+	writer->size += NETP_WriteVarint(buffer + writer->size, index);
+	writer->size += NETP_WriteVarint(buffer + writer->size, firstFrame);
+}
+
+char NETP_AppendBlockFrame(netp_block_writer_t* writer, const command_t* commands)
+{
+	int i;
+
+	if (writer->numFrames == NETP_MAX_BLOCK_FRAMES ||
+		writer->size + writer->numPlayers * NETP_MAX_COMMAND_SIZE > writer->capacity)
+		return 0;
+
+	for (i=0; i < writer->numPlayers; i++)
+		writer->size += NETP_WriteCommand(writer->buffer + writer->size, &commands[i], writer->previous[i]);
+
+	writer->buffer[2] = ++writer->numFrames;
+
+	return 1;
+}
+
+char NETP_DecodeBlock(netp_block_t* block, const uchar* buffer, uint size)
+{
+	const uchar* cursor = buffer;
+	const uchar* end = buffer + size;
+	int previous[MAX_NUM_PLAYERS][2];
+	uint read;
+	int i, j;
+
+	if (size < 3 || cursor[0] != NETP_TYPE_BLOCK || cursor[1] == 0 || cursor[1] > MAX_NUM_PLAYERS || cursor[2] > NETP_MAX_BLOCK_FRAMES)
+		return 0;
+	block->numPlayers = cursor[1];
+	block->numFrames = cursor[2];
+	cursor += 3;
+
+	read = NETP_ReadVarint(cursor, end, &block->index);
+	if (!read)
+		return 0;
+	cursor += read;
+
+	read = NETP_ReadVarint(cursor, end, &block->firstFrame);
+	if (!read)
+		return 0;
+	cursor += read;
+
+	memset(previous, 0, sizeof(previous));
+
+	for (i=0; i < block->numFrames; i++)
+	{
+		for (j=0; j < block->numPlayers; j++)
+		{
+			read = NETP_ReadCommand(cursor, end, &block->commands[i][j], j, previous[j]);
+			if (!read)
+				return 0;
+			cursor += read;
+		}
+	}
+
+	return cursor == end;
+}
+
+char NETP_DecodeBlockIndex(uint* index, const uchar* buffer, uint size)
+{
+	if (size < 4 || buffer[0] != NETP_TYPE_BLOCK)
+		return 0;
+
+	return NETP_ReadVarint(buffer + 3, buffer + size, index) != 0;
+}
+
+uint NETP_EncodeBlockAck(uint nextBlock, uchar* buffer)
+{
+	buffer[0] = NETP_TYPE_BLOCK_ACK;
+
+	return 1 + NETP_WriteVarint(buffer + 1, nextBlock);
+}
+
+char NETP_DecodeBlockAck(uint* nextBlock, const uchar* buffer, uint size)
+{
+	if (size < 2 || buffer[0] != NETP_TYPE_BLOCK_ACK)
+		return 0;
+
+	return NETP_ReadVarint(buffer + 1, buffer + size, nextBlock) == size - 1;
+}
+
+uint NETP_EncodeState(const rb_state_t* state, uchar* buffer)
+{
+	uchar* cursor = buffer;
+	int i;
+
+	*cursor++ = NETP_TYPE_STATE;
+	*cursor++ = state->numPlayers;
+	cursor += NETP_WriteVarint(cursor, state->frame);
+
+	for (i=0; i < 8; i++)
+		*cursor++ = (uchar)(state->hash >> (8 * i));
+
+	for (i=0; i < state->numPlayers; i++)
+	{
+		cursor += NETP_WriteVarint(cursor, state->scores[i]);
+		cursor += NETP_WriteVarint(cursor, NETP_ZigZag(state->lives[i]));
+	}
+
+	return (uint)(cursor - buffer);
+}
+
+char NETP_DecodeState(rb_state_t* state, const uchar* buffer, uint size)
+{
+	const uchar* cursor = buffer;
+	const uchar* end = buffer + size;
+	uint lives;
+	uint read;
+	int i;
+
+	if (size < 2 || *cursor++ != NETP_TYPE_STATE || *cursor > MAX_NUM_PLAYERS)
+		return 0;
+
+	memset(state, 0, sizeof(rb_state_t));
+	state->numPlayers = *cursor++;
+
+	read = NETP_ReadVarint(cursor, end, &state->frame);
+	if (!read || end - (cursor + read) < 8)
+		return 0;
+	cursor += read;
+
+	for (i=0; i < 8; i++)
+		state->hash |= (unsigned long long)*cursor++ << (8 * i);
+
+	for (i=0; i < state->numPlayers; i++)
+	{
+		read = NETP_ReadVarint(cursor, end, &state->scores[i]);
+		if (!read)
+			return 0;
+		cursor += read;
+
+		read = NETP_ReadVarint(cursor, end, &lives);
+		if (!read)
+			return 0;
+		cursor += read;
+		state->lives[i] = (char)NETP_UnZigZag(lives);
+	}
+
+	return cursor == end;
+}
+
+uint NETP_EncodeJoin(uint nonce, uchar* buffer)
+{
+	buffer[0] = NETP_TYPE_JOIN;
+
+	return 1 + NETP_WriteVarint(buffer + 1, nonce);
+}
+
+char NETP_DecodeJoin(uint* nonce, const uchar* buffer, uint size)
+{
+	if (size < 2 || buffer[0] != NETP_TYPE_JOIN)
+		return 0;
+
+	return NETP_ReadVarint(buffer + 1, buffer + size, nonce) == size - 1;
+}
+
+uint NETP_EncodeWelcome(const netp_welcome_t* welcome, uchar* buffer)
+{
+	uchar* cursor = buffer;
+
+	*cursor++ = NETP_TYPE_WELCOME;
+	cursor += NETP_WriteVarint(cursor, welcome->nonce);
+	cursor += NETP_WriteVarint(cursor, welcome->session);
+	*cursor++ = welcome->playerId;
+	*cursor++ = welcome->numPlayers;
+	*cursor++ = welcome->sceneId;
+	*cursor++ = welcome->inputDelay;
+
+	return (uint)(cursor - buffer);
+}
+
+char NETP_DecodeWelcome(netp_welcome_t* welcome, const uchar* buffer, uint size)
+{
+	const uchar* cursor = buffer;
+	const uchar* end = buffer + size;
+	uint read;
+
+	if (size < 2 || *cursor++ != NETP_TYPE_WELCOME)
+		return 0;
+
+	read = NETP_ReadVarint(cursor, end, &welcome->nonce);
+	if (!read)
+		return 0;
+	cursor += read;
+
+	read = NETP_ReadVarint(cursor, end, &welcome->session);
+	if (!read || end - (cursor + read) != 4)
+		return 0;
+	cursor += read;
+
+	welcome->playerId = *cursor++;
+	welcome->numPlayers = *cursor++;
+	welcome->sceneId = *cursor++;
+	welcome->inputDelay = *cursor++;
+
+	return welcome->numPlayers >= 2 && welcome->numPlayers <= MAX_NUM_PLAYERS && welcome->playerId < welcome->numPlayers;
+}
+
+unsigned long long NETP_HashCommands(unsigned long long hash, const command_t* commands, uint count)
+{
+	uchar fields[1 + 2 * sizeof(float)];
+	uint i, j;
+
+	for (i=0; i < count; i++)
+	{
+		fields[0] = commands[i].buttons;
+		memcpy(fields + 1, commands[i].delta, 2 * sizeof(float));
+
+		for (j=0; j < sizeof(fields); j++)
+			hash = (hash ^ fields[j]) * NETP_FNV_PRIME;
+	}
+
+	return hash;
+}
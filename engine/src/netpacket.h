@@ -0,0 +1,216 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  netpacket.h
+ *  dEngine
+ *
+ *  Wire format of the multiplayer input packets.
+ *
+ */
+
+#ifndef DE_NETPACKET
+#define DE_NETPACKET
+
+#include "globals.h"
+#include "commands.h"
+#include "rollback.h"
+
+/*
+	An input packet carries every local command the peers have not acked
+	yet (rollback.h), so a lost packet is covered by the next one:
+
+		uchar  type			NETP_TYPE_INPUT
+		uchar  playerId		Of the sender, and of the commands
+		varint sequence
+		varint frame		rb_sync_t
+		varint advantage	zigzag
+		varint ackFrame
+		varint firstFrame	zigzag difference with frame
+		uchar  numCommands
+
+	Then, for each command of firstFrame, firstFrame + 1...
+
+		uchar  header		bits 0-2 buttons, bit 7 delta follows (otherwise the previous one is kept)
+		varint deltaX		(optional) zigzag difference with the previous quantized deltaX
+		varint deltaY		(optional) zigzag difference with the previous quantized deltaY
+
+	Deltas travel as integers in 1/NETP_DELTA_SCALE of the screen space.
+	NETP_QuantizeCommand has to be applied before the local simulation uses
+	a command: both peers then simulate exactly the same floats.
+
+	A held direction costs 1 byte per frame, a full packet of idle frames
+	about 30 bytes instead of sizeof(command_t) per frame.
+
+	The spectator relay (relay.h) receives the input packets like a peer
+	and acks them to every player at once:
+
+		uchar  type			NETP_TYPE_RELAY_ACK
+		uchar  numPlayers
+		varint nextFrame	For each player, the first frame the relay misses a command of
+
+	It sends the confirmed commands on to the spectators in blocks of
+	consecutive frames, each block on its own:
+
+		uchar  type			NETP_TYPE_BLOCK
+		uchar  numPlayers
+		uchar  numFrames
+		varint index		Blocks are numbered from 0, frames too
+		varint firstFrame
+
+	Then, for each frame, the command of each player, coded as in the input
+	packets (the previous delta being the one of the same player in the
+	block). Spectators ack the blocks they have, in order:
+
+		uchar  type			NETP_TYPE_BLOCK_ACK
+		varint nextBlock	First block the spectator misses
+
+	A dedicated server (server.h) acks the input packets like the relay
+	and sends the state it confirms of a frame (rb_state_t) to every
+	player:
+
+		uchar  type			NETP_TYPE_STATE
+		uchar  numPlayers
+		varint frame
+		uchar  hash[8]		Little endian
+
+	Then, for each player:
+
+		varint score
+		varint lives		zigzag
+
+	Players join a dedicated server by sending, until it answers:
+
+		uchar  type			NETP_TYPE_JOIN
+		varint nonce		Picked by the player, the welcome repeats it
+
+	The server seats the player in a session and welcomes it:
+
+		uchar  type			NETP_TYPE_WELCOME
+		varint nonce
+		varint session
+		uchar  playerId
+		uchar  numPlayers
+		uchar  sceneId
+		uchar  inputDelay	Every player of a session has the server's
+
+	From then on the player sends its input packets to the server only,
+	the server forwards them to the other players of the session.
+*/
+
+#define NETP_TYPE_INPUT		2
+#define NETP_TYPE_RELAY_ACK	3
+#define NETP_TYPE_BLOCK		4
+#define NETP_TYPE_BLOCK_ACK	5
+#define NETP_TYPE_STATE		6
+#define NETP_TYPE_JOIN		7
+#define NETP_TYPE_WELCOME	8
+
+#define NETP_MAX_COMMANDS	16
+#define NETP_MAX_COMMAND_SIZE	(1 + 2 * 5)
+#define NETP_MAX_SIZE		(3 + 5 * 5 + NETP_MAX_COMMANDS * NETP_MAX_COMMAND_SIZE)
+#define NETP_MAX_RELAY_ACK_SIZE	(2 + MAX_NUM_PLAYERS * 5)
+#define NETP_MAX_BLOCK_FRAMES	32
+#define NETP_MAX_BLOCK_ACK_SIZE	(1 + 5)
+#define NETP_MAX_STATE_SIZE	(2 + 5 + 8 + MAX_NUM_PLAYERS * 2 * 5)
+#define NETP_MAX_JOIN_SIZE	(1 + 5)
+#define NETP_MAX_WELCOME_SIZE	(1 + 2 * 5 + 4)
+#define NETP_MAX_DELTA		(1 << 20)		// Quantized, far beyond a frame of movement.
+#define NETP_DELTA_SCALE	8192.0f		// Power of two: dequantized deltas are exact.
+
+#define NETP_HEADER_BUTTONS	0x07
+#define NETP_HEADER_DELTA	0x80
+
+typedef struct netp_input_packet_t
+{
+	uchar playerId;
+	uint sequence;
+	rb_sync_t sync;
+	uint firstFrame;
+	uchar numCommands;
+	command_t commands[NETP_MAX_COMMANDS];
+} netp_input_packet_t;
+
+typedef struct netp_relay_ack_t
+{
+	uchar numPlayers;
+	uint nextFrames[MAX_NUM_PLAYERS];
+} netp_relay_ack_t;
+
+typedef struct netp_block_t
+{
+	uchar numPlayers;
+	uchar numFrames;
+	uint index;
+	uint firstFrame;
+	command_t commands[NETP_MAX_BLOCK_FRAMES][MAX_NUM_PLAYERS];	// By frame, then by player.
+} netp_block_t;
+
+typedef struct netp_welcome_t
+{
+	uint nonce;
+	uint session;
+	uchar playerId;
+	uchar numPlayers;
+	uchar sceneId;
+	uchar inputDelay;
+} netp_welcome_t;
+
+// A block is written one frame at a time, straight into its datagram.
+typedef struct netp_block_writer_t
+{
+	uchar* buffer;
+	uint capacity;
+	uint size;
+	uchar numPlayers;
+	uchar numFrames;
+	int previous[MAX_NUM_PLAYERS][2];
+} netp_block_writer_t;
+
+// Rounds the deltas to what the wire carries.
+void NETP_QuantizeCommand(command_t* command);
+
+// Returns the size written, 0 if capacity is too small (NETP_MAX_SIZE always fits).
+uint NETP_Encode(const netp_input_packet_t* packet, uchar* buffer, uint capacity);
+
+// Returns 0 if the datagram is truncated or corrupted. Commands are NET_RTM_COMMAND of packet->playerId.
+char NETP_Decode(netp_input_packet_t* packet, const uchar* buffer, uint size);
+
+// Same conventions for the relay packets.
+uint NETP_EncodeRelayAck(const netp_relay_ack_t* ack, uchar* buffer, uint capacity);
+char NETP_DecodeRelayAck(netp_relay_ack_t* ack, const uchar* buffer, uint size);
+
+void NETP_BeginBlock(netp_block_writer_t* writer, uchar* buffer, uint capacity, uchar numPlayers, uint index, uint firstFrame);
+char NETP_AppendBlockFrame(netp_block_writer_t* writer, const command_t* commands);	// One per player. 0 if the block is full.
+char NETP_DecodeBlock(netp_block_t* block, const uchar* buffer, uint size);
+char NETP_DecodeBlockIndex(uint* index, const uchar* buffer, uint size);	// Without decoding the commands.
+
+uint NETP_EncodeBlockAck(uint nextBlock, uchar* buffer);	// NETP_MAX_BLOCK_ACK_SIZE always fits.
+char NETP_DecodeBlockAck(uint* nextBlock, const uchar* buffer, uint size);
+
+uint NETP_EncodeState(const rb_state_t* state, uchar* buffer);		// NETP_MAX_STATE_SIZE always fits.
+char NETP_DecodeState(rb_state_t* state, const uchar* buffer, uint size);
+
+uint NETP_EncodeJoin(uint nonce, uchar* buffer);					// NETP_MAX_JOIN_SIZE always fits.
+char NETP_DecodeJoin(uint* nonce, const uchar* buffer, uint size);
+uint NETP_EncodeWelcome(const netp_welcome_t* welcome, uchar* buffer);	// NETP_MAX_WELCOME_SIZE always fits.
+char NETP_DecodeWelcome(netp_welcome_t* welcome, const uchar* buffer, uint size);
+
+// FNV-1a of what the wire carries of the commands, to compare two copies of a log.
+#define NETP_HASH_OFFSET	0xcbf29ce484222325ULL
+unsigned long long NETP_HashCommands(unsigned long long hash, const command_t* commands, uint count);
+
+#endif
@@ -0,0 +1,691 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  netsim.c
+ *  dEngine
+ *
+ *  Multiplayer peers in one process.
+ *
+ */
+
+#include "netsim.h"
+#include "netchannel.h"
+#include "relay.h"
+#include "spectator.h"
+#include "server.h"
+#include "snapshot.h"
+#include "dEngine.h"
+#include "player.h"
+#include "timer.h"
+#include "event.h"
+#include "sounds.h"
+#include "renderer.h"
+
+#ifndef WIN32
+#include <unistd.h>
+#include <arpa/inet.h>
+#endif
+
+#define NETSIM_BOT_SPEED		0.015f	// Screen space per frame.
+#define NETSIM_BOT_HEADING		30		// Frames between two changes of direction.
+#define NETSIM_MAX_SETTLE_TICKS	10000
+#define NETSIM_MAX_JOIN_TRIES	100
+
+typedef struct netsim_peer_t
+{
+	int session;
+	uchar* snapshot;
+	rollback_t* rollback;
+	net_channel_t net;
+	int udpSocket;					// -1 over a loopback.
+	uint bytesSent;
+	unsigned long long hash;		// Of the last frame.
+} netsim_peer_t;
+
+static netsim_peer_t* peers;			// By session, then by player.
+static int numPeers;
+static uint snapshotCapacity;
+static server_t* server;
+
+// The last spectator to join simulates what it watches, the others only receive it.
+typedef struct netsim_audience_t
+{
+	relay_t* relay;
+	spectator_t** spectators;
+	int numJoined;
+
+	uchar* watcherSnapshot;		// The scene as loaded until the watcher joins.
+	rollback_t* watcherRollback;	// Started as RB_SPECTATOR.
+	uint caughtUpFrame;
+} netsim_audience_t;
+
+static netsim_audience_t audience;
+
+// Not randomNext: the bot must not touch the simulation random state.
+static uint NETSIM_Mix(uint value)
+{
+	value ^= value >> 16;
+	value *= 0x7FEB352D;
+	value ^= value >> 15;
+	value *= 0x846CA68B;
+	value ^= value >> 16;
+
+	return value;
+}
+
+static void NETSIM_BotCommand(int session, uchar playerId, uint frame, command_t* command)
+{
+	uint heading;
+
+	memset(command, 0, sizeof(command_t));
+	command->type = NET_RTM_COMMAND;
+	command->playerId = playerId;
+
+	heading = NETSIM_Mix(((frame / NETSIM_BOT_HEADING) * MAX_NUM_PLAYERS + playerId) ^ NETSIM_Mix(session));
+	command->delta[X] = ((int)(heading % 3) - 1) * NETSIM_BOT_SPEED;
+	command->delta[Y] = ((int)(heading / 3 % 3) - 1) * NETSIM_BOT_SPEED;
+
+	command->buttons = BUTTON_FIRE_PRESSED;
+	if (command->delta[X] != 0 || command->delta[Y] != 0)
+		command->buttons |= BUTTON_MOVE_PRESSED;
+
+	if (frame % 240 == 120 + playerId * 60u)
+		command->buttons |= BUTTON_GHOST_PRESSED;
+}
+
+static void NETSIM_SwapIn(netsim_peer_t* peer)
+{
+	SNAP_Restore(peer->snapshot);
+	RB_SetContext(peer->rollback);
+	net = peer->net;
+}
+
+static void NETSIM_SwapOut(netsim_peer_t* peer)
+{
+	SNAP_Save(peer->snapshot, snapshotCapacity);
+	peer->net = net;
+}
+
+static void NETSIM_Send(netsim_peer_t* peer)
+{
+	uint before;
+
+	before = net.counting.bytesSent;
+	NET_Send();
+	peer->bytesSent += net.counting.bytesSent - before;
+}
+
+// One frame of the virtual clock for one peer. Returns the next frame of that peer.
+static uint NETSIM_Tick(netsim_peer_t* peer, uint targetFrame)
+{
+	command_t command;
+	rb_sync_t sync;
+
+	NETSIM_SwapIn(peer);
+
+	NET_Receive();
+
+	RB_GetSync(&sync);
+	if (sync.frame < targetFrame && RB_CanAdvance())
+	{
+		Timer_Step();
+
+		NETSIM_BotCommand(peer->session, controlledPlayer, sync.frame, &command);
+		RB_AddLocalCommand(&command);
+
+		RB_BeginFrame();
+		NETSIM_Send(peer);
+
+		EV_SetReplay(1);
+		dEngine_SimulateFrame();
+		SND_ClearPendingSounds();
+
+		diverSpriteLib.numVertices = 0;
+		diverSpriteLib.numIndices = 0;
+
+		sync.frame++;
+	}
+	else
+		NETSIM_Send(peer);
+
+	NETSIM_SwapOut(peer);
+
+	return sync.frame;
+}
+
+// Every input up to targetFrame reached this peer.
+static char NETSIM_Settled(netsim_peer_t* peer, uint targetFrame)
+{
+	rb_sync_t sync;
+
+	RB_SetContext(peer->rollback);
+	RB_GetSync(&sync);
+
+	return sync.frame >= targetFrame && sync.ackFrame >= targetFrame;
+}
+
+static void NETSIM_OpenAudience(const netsim_config_t* config, net_transport_t* playersLink, const nett_impairment_t* impairment)
+{
+	nett_impairment_t linkImpairment;
+	net_transport_t impaired;
+
+	memset(&audience, 0, sizeof(audience));
+
+	if (!config->numSpectators)
+		return;
+
+	linkImpairment = *impairment;
+	linkImpairment.seed = config->impairment.seed * 2 + numPlayers;
+	NETT_InitImpaired(&impaired, playersLink, &linkImpairment);
+
+	audience.relay = RELAY_New(numPlayers, &impaired);
+	audience.spectators = calloc(config->numSpectators, sizeof(spectator_t*));
+
+	audience.watcherSnapshot = malloc(snapshotCapacity);
+	SNAP_Save(audience.watcherSnapshot, snapshotCapacity);
+	audience.watcherRollback = RB_NewContext();
+	RB_SetContext(audience.watcherRollback);
+	RB_Start(RB_SPECTATOR, numPlayers, 0);
+}
+
+// Spectators join one after the other, the last one half way through.
+static void NETSIM_Join(const netsim_config_t* config, const nett_impairment_t* impairment, uint frame, netsim_report_t* report)
+{
+	nett_impairment_t linkImpairment;
+	net_transport_t link[2];
+	net_transport_t impaired[2];
+	int i;
+
+	while (audience.numJoined < config->numSpectators &&
+		   frame >= (audience.numJoined + 1) * config->frames / (2 * config->numSpectators))
+	{
+		NETT_InitLoopback(link, 2);
+
+		linkImpairment = *impairment;
+		for (i=0; i < 2; i++)
+		{
+			linkImpairment.seed = (config->impairment.seed + audience.numJoined + 1) * 2 + i + MAX_NUM_PLAYERS;
+			NETT_InitImpaired(&impaired[i], &link[i], &linkImpairment);
+		}
+
+		RELAY_AddSpectator(audience.relay, &impaired[0]);
+		audience.spectators[audience.numJoined++] = SPEC_New(&impaired[1]);
+
+		if (audience.numJoined == config->numSpectators)
+		{
+			report->watcherJoinTick = frame;
+			audience.caughtUpFrame = frame;
+		}
+	}
+}
+
+// Plays every frame received so far, as fast as it can.
+static void NETSIM_Watch(spectator_t* watcher, uint targetFrame, netsim_report_t* report)
+{
+	if (SPEC_GetFrame(watcher) >= targetFrame || !SPEC_GetPendingFrames(watcher))
+		return;
+
+	SNAP_Restore(audience.watcherSnapshot);
+	RB_SetContext(audience.watcherRollback);
+
+	EV_SetReplay(1);
+
+	while (SPEC_GetFrame(watcher) < targetFrame && SPEC_SimulateFrame(watcher))
+	{
+		SND_ClearPendingSounds();
+
+		diverSpriteLib.numVertices = 0;
+		diverSpriteLib.numIndices = 0;
+	}
+
+	SNAP_Save(audience.watcherSnapshot, snapshotCapacity);
+
+	if (SPEC_GetFrame(watcher) >= audience.caughtUpFrame && !report->watcherCatchUpTicks)
+		report->watcherCatchUpTicks = report->ticks - report->watcherJoinTick + 1;
+}
+
+static void NETSIM_UpdateAudience(const netsim_config_t* config, const nett_impairment_t* impairment, uint clock, netsim_report_t* report)
+{
+	command_t commands[MAX_NUM_PLAYERS];
+	int i;
+
+	if (!audience.relay)
+		return;
+
+	NETSIM_Join(config, impairment, report->ticks, report);
+
+	RELAY_Update(audience.relay, clock);
+
+	//The players are done: the last frames do not wait for a full block.
+	if (RELAY_GetStats(audience.relay)->frames >= config->frames)
+		RELAY_Flush(audience.relay);
+
+	for (i=0; i < audience.numJoined; i++)
+	{
+		SPEC_Update(audience.spectators[i]);
+
+		if (i == config->numSpectators - 1)
+			NETSIM_Watch(audience.spectators[i], config->frames, report);
+		else
+			while (SPEC_NextFrame(audience.spectators[i], commands));
+	}
+}
+
+// The whole log reached every spectator.
+static char NETSIM_AudienceSettled(const netsim_config_t* config)
+{
+	int i;
+
+	if (!audience.relay)
+		return 1;
+
+	if (audience.numJoined < config->numSpectators || RELAY_GetStats(audience.relay)->frames < config->frames)
+		return 0;
+
+	for (i=0; i < audience.numJoined; i++)
+		if (!RELAY_SpectatorIsDone(audience.relay, i) || SPEC_GetFrame(audience.spectators[i]) < config->frames)
+			return 0;
+
+	return 1;
+}
+
+static void NETSIM_CloseAudience(const netsim_config_t* config, netsim_report_t* report)
+{
+	const relay_stats_t* stats;
+	spectator_t* spectator;
+	int i;
+
+	if (!audience.relay)
+		return;
+
+	stats = RELAY_GetStats(audience.relay);
+
+	report->numSpectators = audience.numJoined;
+	report->relayFrames = stats->frames;
+	report->relayBytesSent = stats->bytesSent;
+	report->relayBlocksSent = stats->blocksSent;
+	report->relayBlocksResent = stats->blocksResent;
+
+	for (i=0; i < audience.numJoined; i++)
+	{
+		spectator = audience.spectators[i];
+
+		if (i == config->numSpectators - 1)
+		{
+			SNAP_Restore(audience.watcherSnapshot);
+			report->watcherHash = SNAP_Hash();
+		}
+		else if (SPEC_GetFrame(spectator) == stats->frames && SPEC_GetHash(spectator) == stats->logHash)
+			report->spectatorsComplete++;
+
+		SPEC_Free(spectator);
+	}
+
+	RELAY_Free(audience.relay);
+	RB_FreeContext(audience.watcherRollback);
+	free(audience.watcherSnapshot);
+	free(audience.spectators);
+}
+
+// The peer joins the server over localhost, as a remote player would. Returns the socket, -1 on error.
+static int NETSIM_JoinServer(ushort port, int session, uchar playerId, net_transport_t* transport)
+{
+#ifndef WIN32
+	struct sockaddr_in address;
+	netp_welcome_t welcome;
+	uint nonce;
+	int udpSocket;
+	int tries;
+
+	udpSocket = NETT_OpenUDPSocket(0);
+	if (udpSocket == -1)
+		return -1;
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	nonce = session * MAX_NUM_PLAYERS + playerId;
+
+	for (tries=0; tries < NETSIM_MAX_JOIN_TRIES; tries++)
+	{
+		NET_SendJoin(udpSocket, &address, nonce);
+		SERV_Update(server);
+		if (NET_ReceiveWelcome(udpSocket, &address, nonce, &welcome))
+			break;
+	}
+
+	//Sessions fill in the order the players join.
+	if (tries == NETSIM_MAX_JOIN_TRIES || welcome.session != (uint)session || welcome.playerId != playerId)
+	{
+		Log_Printf("[NETSIM_JoinServer] Player %d of session %d was not seated.\n", playerId, session);
+		close(udpSocket);
+		return -1;
+	}
+
+	NETT_InitUDP(transport, udpSocket, &address);
+
+	return udpSocket;
+#else
+	Log_Printf("[NETSIM_JoinServer] No UDP on WIN32.\n");
+	return -1;
+#endif
+}
+
+// Every session has its own loopback, the relay or the server is its last endpoint. Returns 0 if a peer could not join.
+static char NETSIM_OpenSessions(const netsim_config_t* config, int numSessions, nett_impairment_t* impairment)
+{
+	net_transport_t loopback[MAX_NUM_PLAYERS+1];
+	net_transport_t impaired;
+	net_transport_t udp;
+	netsim_peer_t* peer;
+	int session;
+	int i;
+
+	numPeers = numSessions * numPlayers;
+	peers = calloc(numPeers, sizeof(netsim_peer_t));
+
+	if (config->server)
+		server = SERV_New();
+
+#ifndef WIN32
+	if (config->udpPort && !SERV_Listen(server, config->udpPort, config->frames))
+		return 0;
+#endif
+
+	for (session=0; session < numSessions; session++)
+	{
+		if (!config->udpPort)
+			NETT_InitLoopback(loopback, config->numSpectators || config->server ? numPlayers + 1 : numPlayers);
+
+		if (session == 0)
+			NETSIM_OpenAudience(config, &loopback[numPlayers], impairment);
+
+		if (server && !config->udpPort)
+		{
+			impairment->seed = config->impairment.seed * 2 + session * (MAX_NUM_PLAYERS + 1) + numPlayers;
+			NETT_InitImpaired(&impaired, &loopback[numPlayers], impairment);
+			SERV_AddSession(server, &impaired, config->frames);
+		}
+
+		for (i=0; i < numPlayers; i++)
+		{
+			peer = &peers[session * numPlayers + i];
+			peer->session = session;
+			peer->snapshot = malloc(snapshotCapacity);
+			peer->rollback = RB_NewContext();
+
+			memset(&net, 0, sizeof(net));
+			net.state = NET_RUNNING;
+			net.lastSentSequenceNumber = 1;
+			impairment->seed = config->impairment.seed * 2 + session * (MAX_NUM_PLAYERS + 1) + i;
+			peer->udpSocket = -1;
+			if (config->udpPort)
+			{
+				peer->udpSocket = NETSIM_JoinServer(config->udpPort, session, i, &udp);
+				if (peer->udpSocket == -1)
+					return 0;
+				NETT_InitImpaired(&net.transport, &udp, impairment);
+			}
+			else
+				NETT_InitImpaired(&net.transport, &loopback[i], impairment);
+
+			//Every peer starts from the scene as loaded.
+			controlledPlayer = i;
+			RB_SetContext(peer->rollback);
+			RB_Start(i, numPlayers, config->inputDelay);
+			NETSIM_SwapOut(peer);
+		}
+	}
+
+	return 1;
+}
+
+// What NETSIM_OpenSessions set up before a peer failed to join.
+static void NETSIM_AbortSessions(void)
+{
+	int i;
+
+	for (i=0; i < numPeers; i++)
+	{
+		if (!peers[i].rollback)
+			continue;
+
+		RB_FreeContext(peers[i].rollback);
+		if (peers[i].net.transport.Close)
+			peers[i].net.transport.Close(&peers[i].net.transport);
+#ifndef WIN32
+		if (peers[i].udpSocket != -1)
+			close(peers[i].udpSocket);
+#endif
+		free(peers[i].snapshot);
+	}
+
+	free(peers);
+	peers = NULL;
+
+	if (server)
+		SERV_Free(server);
+	server = NULL;
+
+	RB_SetContext(NULL);
+}
+
+static void NETSIM_UpdateServer(void)
+{
+	if (server)
+		SERV_Update(server);
+}
+
+static char NETSIM_ServerSettled(void)
+{
+	int i;
+
+	if (!server)
+		return 1;
+
+	for (i=0; i < SERV_GetNumSessions(server); i++)
+		if (!SERV_SessionIsDone(server, i))
+			return 0;
+
+	return 1;
+}
+
+static void NETSIM_CloseServer(netsim_report_t* report)
+{
+	const serv_session_stats_t* stats;
+	int i;
+
+	if (!server)
+		return;
+
+	for (i=0; i < SERV_GetNumSessions(server); i++)
+	{
+		stats = SERV_GetSessionStats(server, i);
+
+		report->serverFrames += stats->frames;
+		report->serverStatesSent += stats->statesSent;
+		report->serverBytesSent += stats->bytesSent;
+		report->serverMicroseconds += stats->microseconds;
+		if (stats->microseconds > report->serverMaxSessionMicroseconds)
+			report->serverMaxSessionMicroseconds = stats->microseconds;
+
+		report->synchronized &= stats->hash == peers[i * numPlayers].hash;
+	}
+
+	SERV_Free(server);
+	server = NULL;
+}
+
+char NETSIM_Run(const netsim_config_t* config, netsim_report_t* report)
+{
+	net_channel_t savedNet;
+	nett_impairment_t impairment;
+	netsim_peer_t* peer;
+	uint clock = 0;
+	uint settleTicks = 0;
+	int numSessions;
+	char running;
+	int start;
+	int i;
+
+	memset(report, 0, sizeof(netsim_report_t));
+
+	if (config->numPlayers < 2 || config->numPlayers > MAX_NUM_PLAYERS)
+	{
+		Log_Printf("[NETSIM_Run] %d players, 2 to %d are supported.\n", config->numPlayers, MAX_NUM_PLAYERS);
+		return 0;
+	}
+
+	if (config->server && config->numSpectators)
+	{
+		Log_Printf("[NETSIM_Run] Spectators do not go along with a server.\n");
+		return 0;
+	}
+
+	if (config->udpPort && !config->server)
+	{
+		Log_Printf("[NETSIM_Run] Only a server listens on a UDP port.\n");
+		return 0;
+	}
+
+	numSessions = config->numSessions > 1 ? config->numSessions : 1;
+
+	dEngine_LoadMultiplayerScene(config->sceneId, config->numPlayers);
+
+	savedNet = net;
+	snapshotCapacity = SNAP_MaxSize();
+
+	impairment = config->impairment;
+	impairment.clock = &clock;
+
+	if (!NETSIM_OpenSessions(config, numSessions, &impairment))
+	{
+		NETSIM_AbortSessions();
+		net = savedNet;
+		return 0;
+	}
+
+	Log_Printf("[NETSIM_Run] Scene %d, %d sessions of %d players%s, %u frames, latency %ums jitter %ums reorder %u%% loss %u%%.\n",
+			   config->sceneId, numSessions, numPlayers, server ? " on a server" : "", config->frames, impairment.latency, impairment.jitter, impairment.reorder, impairment.loss);
+
+	start = E_Sys_Milliseconds();
+
+	do
+	{
+		running = 0;
+		for (i=0; i < numPeers; i++)
+			running |= NETSIM_Tick(&peers[i], config->frames) < config->frames;
+
+		NETSIM_UpdateServer();
+		NETSIM_UpdateAudience(config, &impairment, clock, report);
+
+		report->ticks++;
+		clock = report->ticks * 1000 / 60;
+	}
+	while (running);
+
+	//The impairment still holds the last inputs back: keep exchanging until every one arrived, at the spectators and the server too.
+	do
+	{
+		running = 0;
+		for (i=0; i < numPeers; i++)
+			running |= !NETSIM_Settled(&peers[i], config->frames);
+		running |= !NETSIM_AudienceSettled(config);
+		running |= !NETSIM_ServerSettled();
+
+		if (!running || ++settleTicks > NETSIM_MAX_SETTLE_TICKS)
+			break;
+
+		for (i=0; i < numPeers; i++)
+			NETSIM_Tick(&peers[i], config->frames);
+
+		NETSIM_UpdateServer();
+		NETSIM_UpdateAudience(config, &impairment, clock, report);
+
+		report->ticks++;
+		clock = report->ticks * 1000 / 60;
+	}
+	while (running);
+
+	//Correct the last predictions, the hashes are then all of frame config->frames.
+	for (i=0; i < numPeers; i++)
+	{
+		NETSIM_SwapIn(&peers[i]);
+		RB_BeginFrame();
+		peers[i].hash = SNAP_Hash();
+		NETSIM_SwapOut(&peers[i]);
+	}
+
+	report->milliseconds = E_Sys_Milliseconds() - start;
+	report->frames = config->frames;
+	report->numPlayers = numPlayers;
+	report->numSessions = numSessions;
+	report->synchronized = 1;
+
+	for (i=0; i < numPeers; i++)
+	{
+		peer = &peers[i];
+
+		RB_SetContext(peer->rollback);
+		report->statesChecked += RB_GetStats()->statesChecked;
+		report->desyncs += RB_GetStats()->desyncs;
+		report->corrections += RB_GetStats()->corrections;
+		report->synchronized &= peer->hash == peers[peer->session * numPlayers].hash;
+
+		if (peer->session == 0)
+		{
+			report->rollback[i] = *RB_GetStats();
+			report->bytesSent[i] = peer->bytesSent;
+			report->packetsSent[i] = peer->net.lastSentSequenceNumber - 1;
+			report->packetsLost[i] = peer->net.numDropedPackets;
+			report->hashes[i] = peer->hash;
+		}
+	}
+
+	NETSIM_CloseServer(report);
+
+	for (i=0; i < numPeers; i++)
+	{
+		RB_FreeContext(peers[i].rollback);
+		peers[i].net.transport.Close(&peers[i].net.transport);
+#ifndef WIN32
+		if (peers[i].udpSocket != -1)
+			close(peers[i].udpSocket);
+#endif
+	}
+
+	NETSIM_CloseAudience(config, report);
+	if (report->numSpectators)
+		report->synchronized &= report->watcherHash == report->hashes[0] && report->spectatorsComplete == report->numSpectators - 1;
+
+	RB_SetContext(NULL);
+	EV_SetReplay(0);
+	SNAP_Restore(peers[0].snapshot);
+	net = savedNet;
+
+	for (i=0; i < numPeers; i++)
+		free(peers[i].snapshot);
+	free(peers);
+	peers = NULL;
+
+	Log_Printf("[NETSIM_Run] %u frames in %u ticks, %dms: %s.\n",
+			   report->frames, report->ticks, report->milliseconds, report->synchronized ? "synchronized" : "DESYNC");
+
+	return settleTicks <= NETSIM_MAX_SETTLE_TICKS;
+}
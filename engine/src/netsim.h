@@ -0,0 +1,122 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  netsim.h
+ *  dEngine
+ *
+ *  Multiplayer peers in one process.
+ *
+ */
+
+#ifndef DE_NETSIM
+#define DE_NETSIM
+
+#include "globals.h"
+#include "nettransport.h"
+#include "rollback.h"
+#include "player.h"
+
+/*
+	Loads a multiplayer scene and plays it as every peer, over a loopback
+	transport with the same impairment on what each peer sends. Each peer
+	keeps its own snapshot (snapshot.h), rollback context and net channel,
+	they are swapped in turn, one frame at a time, on a virtual clock: the
+	run is repeatable and goes as fast as the simulation.
+
+	Players are driven by a bot that only depends on the frame and the
+	player, so any desync shows in the hashes: once every input reached
+	every peer, they simulate the last frame again and have to agree.
+
+	With spectators, a relay (relay.h) is one more endpoint of the
+	loopback. The spectators join one after the other until half way
+	through, each over its own impaired link. The last one to join
+	replays the whole log from the scene as loaded and has to end on the
+	state of the peers, the others only check they got the whole log.
+
+	Several sessions can be played at once, each with its own peers and
+	loopback, their bots differ. With a dedicated server (server.h), the
+	server is one more endpoint of every session and hosts them all: it
+	has to end on the state of the peers, and the peers check its states
+	on the way. The relay and its spectators only follow the first
+	session, they do not go along with a server.
+
+	With a UDP port, the server listens on it and the peers join it over
+	localhost as remote players would (server.h): their impaired link is
+	a socket to the server, which forwards what they send.
+
+	Nothing is rendered and the presentation events are skipped. The scene
+	stays loaded afterward.
+*/
+
+typedef struct netsim_config_t
+{
+	int sceneId;
+	uchar numPlayers;				// 2 to MAX_NUM_PLAYERS peers, one player each.
+	uint frames;					// Simulated by each peer.
+	int inputDelay;
+	int numSpectators;				// 0 for no relay.
+	int numSessions;				// 0 for one.
+	char server;					// Hosts the sessions.
+	ushort udpPort;					// 0 for a loopback, needs a server. Not on WIN32.
+	nett_impairment_t impairment;	// Its clock is set by NETSIM_Run. The spectator links have the same.
+} netsim_config_t;
+
+typedef struct netsim_report_t
+{
+	uint frames;
+	uchar numPlayers;
+	uint ticks;						// Frames of the virtual clock, stalls included.
+	int milliseconds;				// Real time of the run.
+	int numSessions;
+
+	// By peer of the first session.
+	rb_stats_t rollback[MAX_NUM_PLAYERS];
+	uint bytesSent[MAX_NUM_PLAYERS];
+	uint packetsSent[MAX_NUM_PLAYERS];
+	uint packetsLost[MAX_NUM_PLAYERS];
+
+	unsigned long long hashes[MAX_NUM_PLAYERS];
+
+	int numSpectators;
+	int spectatorsComplete;			// Got the whole log, the watcher not counted.
+	uint relayFrames;
+	uint relayBytesSent;			// To the spectators.
+	uint relayBlocksSent;
+	uint relayBlocksResent;
+	uint watcherJoinTick;
+	uint watcherCatchUpTicks;		// To simulate what was played before it joined.
+	unsigned long long watcherHash;
+
+	// Every peer of every session.
+	uint statesChecked;
+	uint desyncs;
+	uint corrections;
+
+	// The server, every session together.
+	uint serverFrames;
+	uint serverStatesSent;
+	uint serverBytesSent;
+	unsigned long long serverMicroseconds;
+	unsigned long long serverMaxSessionMicroseconds;	// Of the costliest session.
+
+	char synchronized;				// Every hash matches in each session, server included, every spectator got the whole log.
+} netsim_report_t;
+
+// Returns 0 if the run could not complete (the inputs never settled).
+char NETSIM_Run(const netsim_config_t* config, netsim_report_t* report);
+
+#endif
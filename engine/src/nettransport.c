@@ -0,0 +1,445 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  nettransport.c
+ *  dEngine
+ *
+ *  Datagram transports of the netchannel.
+ *
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+	#define _GNU_SOURCE		// recvmmsg
+#endif
+
+#include "nettransport.h"
+#include "timer.h"
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#endif
+
+#ifndef WIN32
+
+//
+// UDP
+//
+
+typedef struct nett_udp_t
+{
+	int udpSocket;
+	struct sockaddr_in peer;
+} nett_udp_t;
+
+int NETT_OpenUDPSocket(ushort port)
+{
+	struct sockaddr_in address;
+	int udpSocket;
+
+	udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (udpSocket == -1)
+	{
+		Log_Printf("[NETT_OpenUDPSocket] socket failed: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if (fcntl(udpSocket, F_SETFL, O_NONBLOCK) == -1)
+	{
+		Log_Printf("[NETT_OpenUDPSocket] fcntl failed: %s\n", strerror(errno));
+		close(udpSocket);
+		return -1;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+	if (bind(udpSocket, (struct sockaddr*)&address, sizeof(address)) == -1)
+	{
+		Log_Printf("[NETT_OpenUDPSocket] bind on port %hu failed: %s\n", port, strerror(errno));
+		close(udpSocket);
+		return -1;
+	}
+
+	return udpSocket;
+}
+
+static char NETT_UDP_Send(net_transport_t* transport, const uchar* data, uint size)
+{
+	nett_udp_t* udp = (nett_udp_t*)transport->state;
+
+	return sendto(udp->udpSocket, data, size, 0, (struct sockaddr*)&udp->peer, sizeof(udp->peer)) == (int)size;
+}
+
+// Reads up to maxDatagrams datagrams, one system call on linux.
+int NETT_ReceiveFrom(int udpSocket, uchar buffers[][NETT_MTU], int* sizes, struct sockaddr_in* senders, int maxDatagrams)
+{
+#ifdef __linux__
+	struct mmsghdr messages[NETT_RECV_BATCH];
+	struct iovec iovecs[NETT_RECV_BATCH];
+	int received;
+	int i;
+
+	if (maxDatagrams > NETT_RECV_BATCH)
+		maxDatagrams = NETT_RECV_BATCH;
+
+	memset(messages, 0, sizeof(messages));
+	for (i=0; i < maxDatagrams; i++)
+	{
+		iovecs[i].iov_base = buffers[i];
+		iovecs[i].iov_len = NETT_MTU;
+		messages[i].msg_hdr.msg_iov = &iovecs[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		if (senders)
+		{
+			messages[i].msg_hdr.msg_name = &senders[i];
+			messages[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		}
+	}
+
+	received = recvmmsg(udpSocket, messages, maxDatagrams, MSG_DONTWAIT, NULL);
+	if (received == -1)
+	{
+		if (errno != EAGAIN)
+			Log_Printf("[NETT_ReceiveFrom] recvmmsg failed: %s\n", strerror(errno));
+		return 0;
+	}
+
+	for (i=0; i < received; i++)
+		sizes[i] = messages[i].msg_len;
+
+	return received;
+#else
+	socklen_t senderSize;
+	int received;
+	int size;
+
+	for (received=0; received < maxDatagrams; received++)
+	{
+		senderSize = sizeof(struct sockaddr_in);
+		size = recvfrom(udpSocket, buffers[received], NETT_MTU, 0, senders ? (struct sockaddr*)&senders[received] : NULL, senders ? &senderSize : NULL);
+		if (size == -1)
+		{
+			if (errno != EAGAIN)
+				Log_Printf("[NETT_ReceiveFrom] recvfrom failed: %s\n", strerror(errno));
+			break;
+		}
+		sizes[received] = size;
+	}
+
+	return received;
+#endif
+}
+
+static int NETT_UDP_Receive(net_transport_t* transport, uchar buffers[][NETT_MTU], int* sizes, int maxDatagrams)
+{
+	nett_udp_t* udp = (nett_udp_t*)transport->state;
+
+	return NETT_ReceiveFrom(udp->udpSocket, buffers, sizes, NULL, maxDatagrams);
+}
+
+static void NETT_UDP_Close(net_transport_t* transport)
+{
+	free(transport->state);
+	memset(transport, 0, sizeof(net_transport_t));
+}
+
+void NETT_InitUDP(net_transport_t* transport, int udpSocket, const struct sockaddr_in* peer)
+{
+	nett_udp_t* udp;
+
+	udp = calloc(1, sizeof(nett_udp_t));
+	udp->udpSocket = udpSocket;
+	udp->peer = *peer;
+
+	transport->Send = NETT_UDP_Send;
+	transport->Receive = NETT_UDP_Receive;
+	transport->Close = NETT_UDP_Close;
+	transport->state = udp;
+}
+
+#endif
+
+//
+// Loopback
+//
+
+typedef struct nett_queue_t
+{
+	uchar datagrams[NETT_LOOPBACK_QUEUE][NETT_MTU];
+	int sizes[NETT_LOOPBACK_QUEUE];
+	uint head;
+	uint tail;
+} nett_queue_t;
+
+// Shared by every endpoint, freed with the last one.
+typedef struct nett_loopback_t
+{
+	nett_queue_t* inboxes;
+	int count;
+	int references;
+} nett_loopback_t;
+
+// Endpoint i receives in inboxes[i].
+typedef struct nett_endpoint_t
+{
+	nett_loopback_t* loopback;
+	int side;
+} nett_endpoint_t;
+
+static char NETT_Loopback_Send(net_transport_t* transport, const uchar* data, uint size)
+{
+	nett_endpoint_t* endpoint = (nett_endpoint_t*)transport->state;
+	nett_queue_t* inbox;
+	char delivered = 1;
+	int i;
+
+	if (size > NETT_MTU)
+		return 0;
+
+	for (i=0; i < endpoint->loopback->count; i++)
+	{
+		if (i == endpoint->side)
+			continue;
+
+		inbox = &endpoint->loopback->inboxes[i];
+
+		// A full inbox drops, as a socket buffer would.
+		if (inbox->tail - inbox->head >= NETT_LOOPBACK_QUEUE)
+		{
+			delivered = 0;
+			continue;
+		}
+
+		memcpy(inbox->datagrams[inbox->tail % NETT_LOOPBACK_QUEUE], data, size);
+		inbox->sizes[inbox->tail % NETT_LOOPBACK_QUEUE] = size;
+		inbox->tail++;
+	}
+
+	return delivered;
+}
+
+static int NETT_Loopback_Receive(net_transport_t* transport, uchar buffers[][NETT_MTU], int* sizes, int maxDatagrams)
+{
+	nett_endpoint_t* endpoint = (nett_endpoint_t*)transport->state;
+	nett_queue_t* inbox;
+	int received;
+
+	inbox = &endpoint->loopback->inboxes[endpoint->side];
+
+	for (received=0; received < maxDatagrams && inbox->head != inbox->tail; received++)
+	{
+		sizes[received] = inbox->sizes[inbox->head % NETT_LOOPBACK_QUEUE];
+		memcpy(buffers[received], inbox->datagrams[inbox->head % NETT_LOOPBACK_QUEUE], sizes[received]);
+		inbox->head++;
+	}
+
+	return received;
+}
+
+static void NETT_Loopback_Close(net_transport_t* transport)
+{
+	nett_endpoint_t* endpoint = (nett_endpoint_t*)transport->state;
+
+	if (--endpoint->loopback->references == 0)
+	{
+		free(endpoint->loopback->inboxes);
+		free(endpoint->loopback);
+	}
+
+	free(endpoint);
+	memset(transport, 0, sizeof(net_transport_t));
+}
+
+void NETT_InitLoopback(net_transport_t* transports, int count)
+{
+	nett_loopback_t* loopback;
+	nett_endpoint_t* endpoint;
+	int i;
+
+	loopback = calloc(1, sizeof(nett_loopback_t));
+	loopback->inboxes = calloc(count, sizeof(nett_queue_t));
+	loopback->count = count;
+	loopback->references = count;
+
+	for (i=0; i < count; i++)
+	{
+		endpoint = calloc(1, sizeof(nett_endpoint_t));
+		endpoint->loopback = loopback;
+		endpoint->side = i;
+
+		transports[i].Send = NETT_Loopback_Send;
+		transports[i].Receive = NETT_Loopback_Receive;
+		transports[i].Close = NETT_Loopback_Close;
+		transports[i].state = endpoint;
+	}
+}
+
+//
+// Impairment
+//
+
+typedef struct nett_pending_t
+{
+	uint deliverAt;
+	uint order;					// Send order, breaks the ties.
+	int size;
+	uchar data[NETT_MTU];
+} nett_pending_t;
+
+typedef struct nett_impaired_t
+{
+	net_transport_t inner;
+	nett_impairment_t impairment;
+	uint random;
+	uint nextOrder;
+	int numPending;
+	nett_pending_t pending[NETT_MAX_PENDING];
+} nett_impaired_t;
+
+static uint NETT_Random(nett_impaired_t* impaired)
+{
+	// xorshift32
+	impaired->random ^= impaired->random << 13;
+	impaired->random ^= impaired->random >> 17;
+	impaired->random ^= impaired->random << 5;
+
+	return impaired->random;
+}
+
+static uint NETT_Now(const nett_impaired_t* impaired)
+{
+	if (impaired->impairment.clock)
+		return *impaired->impairment.clock;
+
+	return (uint)E_Sys_Milliseconds();
+}
+
+// Hands the datagrams that are due to the inner transport, earliest first.
+static void NETT_Impaired_Flush(nett_impaired_t* impaired)
+{
+	uint now;
+	int earliest;
+	int i;
+
+	now = NETT_Now(impaired);
+
+	for (;;)
+	{
+		earliest = -1;
+		for (i=0; i < impaired->numPending; i++)
+		{
+			if ((int)(impaired->pending[i].deliverAt - now) > 0)
+				continue;
+
+			if (earliest == -1 ||
+				impaired->pending[i].deliverAt < impaired->pending[earliest].deliverAt ||
+				(impaired->pending[i].deliverAt == impaired->pending[earliest].deliverAt && impaired->pending[i].order < impaired->pending[earliest].order))
+				earliest = i;
+		}
+
+		if (earliest == -1)
+			return;
+
+		impaired->inner.Send(&impaired->inner, impaired->pending[earliest].data, impaired->pending[earliest].size);
+		impaired->pending[earliest] = impaired->pending[--impaired->numPending];
+	}
+}
+
+static char NETT_Impaired_Send(net_transport_t* transport, const uchar* data, uint size)
+{
+	nett_impaired_t* impaired = (nett_impaired_t*)transport->state;
+	const nett_impairment_t* impairment = &impaired->impairment;
+	nett_pending_t* pending;
+	uint delay;
+
+	if (size > NETT_MTU)
+		return 0;
+
+	// Lost datagrams look sent, the sender cannot tell.
+	if (NETT_Random(impaired) % 100 < impairment->loss)
+	{
+		NETT_Impaired_Flush(impaired);
+		return 1;
+	}
+
+	delay = impairment->latency;
+	if (impairment->jitter)
+		delay += NETT_Random(impaired) % (impairment->jitter + 1);
+
+	// Held back long enough for the next datagrams to overtake it.
+	if (NETT_Random(impaired) % 100 < impairment->reorder)
+		delay += impairment->latency + impairment->jitter + 1;
+
+	if (impaired->numPending == NETT_MAX_PENDING)
+	{
+		NETT_Impaired_Flush(impaired);
+		if (impaired->numPending == NETT_MAX_PENDING)
+			return 0;
+	}
+
+	pending = &impaired->pending[impaired->numPending++];
+	pending->deliverAt = NETT_Now(impaired) + delay;
+	pending->order = impaired->nextOrder++;
+	pending->size = size;
+	memcpy(pending->data, data, size);
+
+	NETT_Impaired_Flush(impaired);
+
+	return 1;
+}
+
+static int NETT_Impaired_Receive(net_transport_t* transport, uchar buffers[][NETT_MTU], int* sizes, int maxDatagrams)
+{
+	nett_impaired_t* impaired = (nett_impaired_t*)transport->state;
+
+	NETT_Impaired_Flush(impaired);
+
+	return impaired->inner.Receive(&impaired->inner, buffers, sizes, maxDatagrams);
+}
+
+static void NETT_Impaired_Close(net_transport_t* transport)
+{
+	nett_impaired_t* impaired = (nett_impaired_t*)transport->state;
+
+	if (impaired->inner.Close)
+		impaired->inner.Close(&impaired->inner);
+
+	free(impaired);
+	memset(transport, 0, sizeof(net_transport_t));
+}
+
+void NETT_InitImpaired(net_transport_t* transport, const net_transport_t* inner, const nett_impairment_t* impairment)
+{
+	nett_impaired_t* impaired;
+
+	impaired = calloc(1, sizeof(nett_impaired_t));
+	impaired->inner = *inner;
+	impaired->impairment = *impairment;
+	impaired->random = impairment->seed ? impairment->seed : 0x9E3779B9;
+
+	transport->Send = NETT_Impaired_Send;
+	transport->Receive = NETT_Impaired_Receive;
+	transport->Close = NETT_Impaired_Close;
+	transport->state = impaired;
+}
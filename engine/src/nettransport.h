@@ -0,0 +1,98 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  nettransport.h
+ *  dEngine
+ *
+ *  Datagram transports of the netchannel.
+ *
+ */
+
+#ifndef DE_NETTRANSPORT
+#define DE_NETTRANSPORT
+
+#include "globals.h"
+
+#ifndef WIN32
+#include <netinet/in.h>
+#endif
+
+/*
+	The netchannel sends and receives its runtime packets through
+	net.transport, bound like the renderer methods:
+
+		UDP			A socket to one peer. Discovery and the setup packets
+					(DNS-SD on iOS) stay in netchannel.c, the dedicated
+					server demultiplexes its socket itself (server.h).
+		Loopback	Endpoints in the same process: what one sends every
+					other one receives, in order and without loss.
+		Impaired	Wraps another transport and delays, reorders or drops
+					what is sent through it.
+
+	Transports never block. Receive returns what arrived so far, at most
+	maxDatagrams of NETT_MTU bytes each.
+
+	The impairment draws from its own random state (never randomNext, the
+	simulation would diverge) and reads the time from a clock the caller
+	advances: a run over a virtual clock is repeatable and as fast as the
+	simulation.
+*/
+
+#define NETT_MTU			512
+#define NETT_RECV_BATCH		16
+#define NETT_LOOPBACK_QUEUE	256		// Datagrams waiting for each endpoint.
+#define NETT_MAX_PENDING	256		// Datagrams held back by an impairment.
+
+typedef struct net_transport_t
+{
+	// Returns 0 if the datagram was not sent.
+	char (*Send)(struct net_transport_t* transport, const uchar* data, uint size);
+
+	// Returns the number of datagrams copied in buffers, their sizes in sizes.
+	int (*Receive)(struct net_transport_t* transport, uchar buffers[][NETT_MTU], int* sizes, int maxDatagrams);
+
+	void (*Close)(struct net_transport_t* transport);
+
+	void* state;
+} net_transport_t;
+
+typedef struct nett_impairment_t
+{
+	uint latency;			// ms, one way.
+	uint jitter;			// ms, up to this much is added to the latency.
+	uint reorder;			// Percent of datagrams held back behind the next ones.
+	uint loss;				// Percent of datagrams dropped.
+	uint seed;
+	const uint* clock;		// ms. NULL for the wall clock.
+} nett_impairment_t;
+
+#ifndef WIN32
+// The socket stays owned by the caller. NETT_OpenUDPSocket returns -1 on error.
+int  NETT_OpenUDPSocket(ushort port);
+void NETT_InitUDP(net_transport_t* transport, int udpSocket, const struct sockaddr_in* peer);
+
+// Receive of a socket that hears from several peers: senders (NULL to ignore) gets the address of each datagram.
+int  NETT_ReceiveFrom(int udpSocket, uchar buffers[][NETT_MTU], int* sizes, struct sockaddr_in* senders, int maxDatagrams);
+#endif
+
+// Initializes transports[0] to transports[count-1].
+void NETT_InitLoopback(net_transport_t* transports, int count);
+
+// Takes inner over: closing transport closes inner.
+void NETT_InitImpaired(net_transport_t* transport, const net_transport_t* inner, const nett_impairment_t* impairment);
+
+#endif
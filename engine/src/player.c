@@ -38,15 +38,21 @@
 #include "enemy_particules.h"
 #include "renderer.h"
 #include "native_services.h"
+#include "atlas.h"
+#include "rollback.h"
 
 //WARNING...if THIS IS CHANGED
 unsigned char numPlayerRespawn[] = {PLAYER_NUM_LIVES,3,1};
 
 #define SHOW_POINTER_DURATION 5000
 
+//Columns of the bullet, flash and ghost textures: players beyond share them.
+#define PLAYER_NUM_COLORS 2
+
 uchar numPlayers;
 uchar controlledPlayer;
-player_t players[2];
+player_t players[MAX_NUM_PLAYERS];
+char playersNames[MAX_NUM_PLAYERS][16];
 
 diverSpriteLib_t diverSpriteLib;
 
@@ -56,11 +62,11 @@ player_bullet_config_t bulletConfig;
 
 
 //Variable storing players bullet AND firing flash (in front of the player ship)
-// Vertices needed is number_of_players * number_of_bullets * 4 +  number_of_players * 4 = number_of_players * (number_of_bullets*4 +4)
-// Indices needed is number_of_players * number_of_bullets * 6 + number_of_players * 6 =   number_of_players * (number_of_bullets * 6 + 6)
-unsigned short bulletIndices[(MAX_PLAYER_BULLETS * 6 + 6)*MAX_NUM_PLAYERS];
-xf_colorless_sprite_t pBulletVertices[(MAX_PLAYER_BULLETS*4+4)*MAX_NUM_PLAYERS];
+// Allocated for bulletSpritesCapacity players, PLAYER_BULLET_QUADS quads each.
+unsigned short* bulletIndices;
+xf_colorless_sprite_t* pBulletVertices;
 int numPBulletsIndices=0;
+static int bulletSpritesCapacity;
 
 
 
@@ -77,6 +83,7 @@ void P_AttachToCamera(matrix_t globalMatrix)
 	
 	vec4_t ws_playerPos;
 	vec4_t ss_playerPos;
+	vec3_t ws_scenePlayerPos;
 	int i;
 	entity_t* playerEntity;
 	plan_t cameraFront;
@@ -95,6 +102,10 @@ void P_AttachToCamera(matrix_t globalMatrix)
 		ws_playerPos[Z] = playerEntity->matrix[14];
 		ws_playerPos[W] = 1;
 		
+		//The extra players are lined up between the scene ones, the depth comes from the latter.
+		if (i < SCENE_NUM_PLAYERS)
+			vectorCopy(ws_playerPos, ws_scenePlayerPos);
+		
 		matrix_multiplyVertexByMatrix(ws_playerPos,globalMatrix,ss_playerPos);
 		
 		ss_playerPos[X] /= ss_playerPos[W] ;
@@ -124,7 +135,7 @@ void P_AttachToCamera(matrix_t globalMatrix)
 	cameraFront.normal[Z] = camera.forward[Z];
 	cameraFront.d = - DotProduct(cameraFront.normal,camera.position);
 					   
-	distanceZFromCamera = DotProduct(cameraFront.normal,ws_playerPos) + cameraFront.d;
+	distanceZFromCamera = DotProduct(cameraFront.normal,ws_scenePlayerPos) + cameraFront.d;
 
 	distanceZFromCamera = fabsf(distanceZFromCamera);
 //	if (distanceZFromCamera < 0)
@@ -172,7 +183,7 @@ void P_ResetPlayer(int i)
 	player->nextBulletFireTime = 0 ;
 	player->nextGhostFireTime = 0;
 	
-	player->lastBulletType = i;
+	player->lastBulletType = i % PLAYER_NUM_COLORS;
 	
 	player->firingUpTo = 0;
 	
@@ -236,6 +247,68 @@ void P_LoadPlayer(int playerIdToLoad)
 
 
 
+// The ships beyond the scene ones share the model of one of them.
+static void P_ClonePlayer(int playerIdToClone, int sourcePlayerId)
+{
+	player_t* player;
+	
+	player = &players[playerIdToClone];
+	player->playerId = playerIdToClone;
+	strcpy(player->modelPath, players[sourcePlayerId].modelPath);
+	player->entity = players[sourcePlayerId].entity;
+	
+	P_ResetPlayer(playerIdToClone);
+}
+
+// Where a ship stands on the line from players[0] (0) to players[1] (1).
+static float P_LineupPosition(int playerId)
+{
+	if (playerId < SCENE_NUM_PLAYERS)
+		return playerId;
+	
+	return (playerId - 1) / (float)(numPlayers - 1);
+}
+
+// Once the scene placed players 0 and 1: the others are lined up between them, numPlayers must be set.
+void P_PlaceExtraPlayers(void)
+{
+	int i,j;
+	float t;
+	
+	for (i=SCENE_NUM_PLAYERS; i < numPlayers; i++)
+	{
+		t = P_LineupPosition(i);
+		
+		matrixCopy(players[0].entity.matrix, players[i].entity.matrix);
+		for (j=12; j < 15; j++)
+			players[i].entity.matrix[j] += t * (players[1].entity.matrix[j] - players[0].entity.matrix[j]);
+	}
+}
+
+// Grows the bullet sprites to count players, the indices of a slot never change once written.
+static void P_ReserveBulletSprites(int count)
+{
+	int quad;
+	
+	if (count <= bulletSpritesCapacity)
+		return;
+	
+	pBulletVertices = realloc(pBulletVertices, count * PLAYER_BULLET_QUADS * 4 * sizeof(xf_colorless_sprite_t));
+	bulletIndices = realloc(bulletIndices, count * PLAYER_BULLET_QUADS * 6 * sizeof(unsigned short));
+	
+	for (quad = bulletSpritesCapacity * PLAYER_BULLET_QUADS; quad < count * PLAYER_BULLET_QUADS; quad++) 
+	{
+		bulletIndices[quad*6+0] = quad*4+0;
+		bulletIndices[quad*6+1] = quad*4+1;
+		bulletIndices[quad*6+2] = quad*4+3;
+		bulletIndices[quad*6+3] = quad*4+3;
+		bulletIndices[quad*6+4] = quad*4+1;
+		bulletIndices[quad*6+5] = quad*4+2;
+	}
+	
+	bulletSpritesCapacity = count;
+}
+
 void P_ResetPlayers(void)
 {
 	int i;
@@ -270,8 +343,7 @@ void P_ResetPlayers(void)
 #define SCORE_FORMAT "SCORE:%7u"
 void P_InitPlayers(void)
 {
-	int j;
-    int numBulletSpriteVertices;
+	int i;
 	
 	numPlayers = 1;
 	controlledPlayer = 0;
@@ -279,19 +351,25 @@ void P_InitPlayers(void)
 	P_LoadPlayer(0);
 	P_LoadPlayer(1);
 	
+	for (i=SCENE_NUM_PLAYERS; i < MAX_NUM_PLAYERS; i++)
+		P_ClonePlayer(i, i % SCENE_NUM_PLAYERS);
+	
+	for (i=0; i < MAX_NUM_PLAYERS; i++)
+		sprintf(playersNames[i], "Player %d", i+1);
+	
 			
 	
 	
 	
 	//Loading bulletSprites
-	TEX_MakeStaticAvailable(&bulletConfig.bulletTexture);
+	ATL_MakeStaticAvailable(&bulletConfig.bulletTexture);
 	
-	TEX_MakeStaticAvailable(&ghostTexture);
+	ATL_MakeStaticAvailable(&ghostTexture);
 	
 	
 //	pointersTexture.path = calloc(sizeof(char), strlen(POINTER_TEXT_PATH)+1);
 	strcpy(pointersTexture.path,POINTER_TEXT_PATH);
-	TEX_MakeStaticAvailable(&pointersTexture);
+	ATL_MakeStaticAvailable(&pointersTexture);
 	
 	bulletConfig.distPerLifepsan = SS_H*2  ; 	
 	
@@ -313,17 +391,7 @@ void P_InitPlayers(void)
 	
 	
 	//Also prepare bullets indices
-	numBulletSpriteVertices = 0 ;
-	
-	for (j=0; j < (MAX_PLAYER_BULLETS*2 * 6 + 2*6); j+=6,numBulletSpriteVertices+=4) 
-	{
-		bulletIndices[j+0] = numBulletSpriteVertices+0;
-		bulletIndices[j+1] = numBulletSpriteVertices+1;
-		bulletIndices[j+2] = numBulletSpriteVertices+3;
-		bulletIndices[j+3] = numBulletSpriteVertices+3;
-		bulletIndices[j+4] = numBulletSpriteVertices+1;
-		bulletIndices[j+5] = numBulletSpriteVertices+2;
-	}
+	P_ReserveBulletSprites(SCENE_NUM_PLAYERS);
 	
 
 	
@@ -598,6 +666,8 @@ void P_CreatePointerCoordinates(void)
 {
 	vec2short_t start,end;
 	vec2_t dir;
+	int i,j;
+	int sourcePlayer;
 
 	/*
 	 
@@ -712,6 +782,17 @@ void P_CreatePointerCoordinates(void)
 	pointerSprVertices[9].text[Y] = pointerSprVertices[NUM_VERTICE_POINTER_PER_PLAYER+9].text[Y] =  36 /(float)128*SHRT_MAX ;
 
 	
+	//Other players alternate the two pointers above
+	for (i=SCENE_NUM_PLAYERS; i < MAX_NUM_PLAYERS; i++) 
+	{
+		sourcePlayer = i % SCENE_NUM_PLAYERS;
+		
+		memcpy(&pointerSprVertices[i*NUM_VERTICE_POINTER_PER_PLAYER], &pointerSprVertices[sourcePlayer*NUM_VERTICE_POINTER_PER_PLAYER], NUM_VERTICE_POINTER_PER_PLAYER * sizeof(xf_colorless_sprite_t));
+		memcpy(&pointerdeltaSprVertices[i*NUM_VERTICE_POINTER_PER_PLAYER], &pointerdeltaSprVertices[sourcePlayer*NUM_VERTICE_POINTER_PER_PLAYER], NUM_VERTICE_POINTER_PER_PLAYER * sizeof(vec2short_t));
+		
+		for (j=0; j < NUM_INDICE_POINTER_PER_PLAYER; j++) 
+			pointerSprIndices[i*NUM_INDICE_POINTER_PER_PLAYER+j] = pointerSprIndices[sourcePlayer*NUM_INDICE_POINTER_PER_PLAYER+j] + (i-sourcePlayer)*NUM_VERTICE_POINTER_PER_PLAYER;
+	}
 }
 
 // Update position of the pointer to be above the player's ship
@@ -737,8 +818,7 @@ void P_PreparePointerSprites(void)
 	}
 }
 
-char* playersNames[2] = {"Player 1","Player 2"};
-float playerDelta[2][2] = {
+float playerDelta[SCENE_NUM_PLAYERS][2] = {
 	/*p1*/{110,-28},
 	/*p2*/{-200,98}
 };
@@ -791,9 +871,9 @@ void PL_RenderPlayerPointers(void)
 		diverSpriteLib.numIndices+=6;
 	}
 	
-	renderer.SetTexture(pointersTexture.textureId);
+	SPR_SetState(&pointersTexture, SPR_BLEND_ALPHA);
 	
-	renderer.RenderColorlessSprites(diverSpriteLib.vertices,diverSpriteLib.numIndices,enFxLib.indices);
+	SPR_AddColorlessQuads(diverSpriteLib.vertices,diverSpriteLib.numIndices/SPR_QUAD_INDICES);
 	
 	
 	
@@ -803,7 +883,7 @@ void PL_RenderPlayerPointers(void)
 		if (players[i].showPointer <= 0)
 			continue;
 		
-		renderer.RenderColorlessSprites(pointerSprVertices,NUM_INDICE_POINTER_PER_PLAYER,pointerSprIndices+i*NUM_INDICE_POINTER_PER_PLAYER);
+		SPR_AddColorlessIndexed(pointerSprVertices,pointerSprIndices+i*NUM_INDICE_POINTER_PER_PLAYER,NUM_INDICE_POINTER_PER_PLAYER);
 	
 		
 	}
@@ -814,8 +894,8 @@ void PL_RenderPlayerPointers(void)
 			continue;
 		
 		SCR_StartConvertText();
-		SCR_ConvertTextToVertices(playersNames[i],2.2f,players[i].ss_boudaries[LEFT]+playerDelta[i][X],players[i].ss_boudaries[DOWN]+playerDelta[i][Y],TEXT_NOT_CENTERED);
-		SCR_RenderText();
+		SCR_ConvertTextToVertices(playersNames[i],2.2f,players[i].ss_boudaries[LEFT]+playerDelta[i % SCENE_NUM_PLAYERS][X],players[i].ss_boudaries[DOWN]+playerDelta[i % SCENE_NUM_PLAYERS][Y],TEXT_NOT_CENTERED);
+		SCR_BatchText();
 	}
 	
 
@@ -824,7 +904,7 @@ void PL_RenderPlayerPointers(void)
 	sprintf(stringScore,SCORE_FORMAT,players[controlledPlayer].score);
 	SCR_StartConvertText();
 	SCR_ConvertTextToVertices(stringScore,SCORE_FONT_SIZE,SCORE_POS_X,SCORE_POS_Y,TEXT_NOT_CENTERED);
-	SCR_RenderText();
+	SCR_BatchText();
 	
 }
 
@@ -841,6 +921,9 @@ void P_PrepareBulletSprites(void)
 	
 	bullet_t* bullet;
 	player_t* player;
+	int color;
+	
+	P_ReserveBulletSprites(numPlayers);
 	
 	bulSprite = pBulletVertices;
 	numPBulletsIndices = 0;
@@ -849,6 +932,7 @@ void P_PrepareBulletSprites(void)
 	for(i=0 ; i < numPlayers ; i++)
 	{
 		player = &players[i] ;
+		color = i % PLAYER_NUM_COLORS;
 		
 		//Check if the player is currently firing and spawn a flash if so.
 		if (player->firingUpTo >= simulationTime)
@@ -862,26 +946,26 @@ void P_PrepareBulletSprites(void)
 			
 			bulSprite->pos[X] = leftFlashX - bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY  ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) +  (32.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			bulSprite->pos[X] = leftFlashX - bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY + bulletConfig.flashHeight * flashInterpolation ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			
 			bulSprite->pos[X] = leftFlashX + bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY + bulletConfig.flashHeight * flashInterpolation;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			bulSprite->pos[X] = leftFlashX + bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY  ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) + (32.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 	
@@ -891,26 +975,26 @@ void P_PrepareBulletSprites(void)
 			
 			bulSprite->pos[X] = rightFlashX - bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY   ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) +  (32.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			bulSprite->pos[X] = rightFlashX - bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY + bulletConfig.flashHeight * flashInterpolation  ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			
 			bulSprite->pos[X] = rightFlashX + bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY + bulletConfig.flashHeight * flashInterpolation ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			bulSprite->pos[X] = rightFlashX + bulletConfig.flashHalfWidth  ;
 			bulSprite->pos[Y] = flashY  ;
-			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + i*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
+			bulSprite->text[X] = (80.0f/128*SHRT_MAX) + color*(24.0f/128*SHRT_MAX) + (24.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = (64.0f/128*SHRT_MAX) + (32.0f/128*SHRT_MAX) + player->lastBulletType* (32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
@@ -941,26 +1025,26 @@ void P_PrepareBulletSprites(void)
 			
 			bulSprite->pos[X] = bullet->ss_boudaries[LEFT];
 			bulSprite->pos[Y] = bullet->ss_boudaries[DOWN];
-			bulSprite->text[X] = i*(16.0f/128*SHRT_MAX) ;
+			bulSprite->text[X] = color*(16.0f/128*SHRT_MAX) ;
 			bulSprite->text[Y] = bullet->type*(32.0f/128*SHRT_MAX) + 32.0f/128*SHRT_MAX;
 			bulSprite++;
 			
 			bulSprite->pos[X] = bullet->ss_boudaries[LEFT];
 			bulSprite->pos[Y] = bullet->ss_boudaries[UP];
-			bulSprite->text[X] = i*(16.0f/128*SHRT_MAX);
+			bulSprite->text[X] = color*(16.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = bullet->type*(32.0f/128*SHRT_MAX) ;
 			bulSprite++;
 			
 					
 			bulSprite->pos[X] = bullet->ss_boudaries[RIGHT];
 			bulSprite->pos[Y] = bullet->ss_boudaries[UP];
-			bulSprite->text[X] = i*(16.0f/128*SHRT_MAX) + 16.0f/128*SHRT_MAX;
+			bulSprite->text[X] = color*(16.0f/128*SHRT_MAX) + 16.0f/128*SHRT_MAX;
 			bulSprite->text[Y] = bullet->type*(32.0f/128*SHRT_MAX);
 			bulSprite++;
 			
 			bulSprite->pos[X] = bullet->ss_boudaries[RIGHT];
 			bulSprite->pos[Y] = bullet->ss_boudaries[DOWN];
-			bulSprite->text[X] = i*(16.0f/128*SHRT_MAX) + (16.0f/128*SHRT_MAX);
+			bulSprite->text[X] = color*(16.0f/128*SHRT_MAX) + (16.0f/128*SHRT_MAX);
 			bulSprite->text[Y] = bullet->type*(32.0f/128*SHRT_MAX)+32.0f/128*SHRT_MAX;
 			bulSprite++;
 			
@@ -1242,12 +1326,12 @@ void P_PrepareGhostSprites(void)
 			{
 			
 				//Need to update texture coordinate
-				vertex->text[X] = i * SHRT_MAX/2; 
+				vertex->text[X] = i % PLAYER_NUM_COLORS * SHRT_MAX/2; 
 				vertex->text[Y] = textureY;
 				vertex++;
 			
 				//Need to update texture coordinate
-				vertex->text[X] = i * SHRT_MAX/2 + SHRT_MAX/2; 
+				vertex->text[X] = i % PLAYER_NUM_COLORS * SHRT_MAX/2 + SHRT_MAX/2; 
 				vertex->text[Y] = textureY;
 				vertex++;
 
@@ -1266,9 +1350,8 @@ void P_Die(uchar playerId)
 {
 
 	command_t t;
-	event_t* event;
-	event_req_menu_t* eventReqMenu;
-	event_req_scene_t* eventReqScene;
+	event_t event;
+	int i;
     
     
 	// Player collided with the enemy
@@ -1282,8 +1365,8 @@ void P_Die(uchar playerId)
 
 	
 	
-	//NET_Update peer that we died
-	if (engine.mode == DE_MODE_MULTIPLAYER && playerId == controlledPlayer)
+	//NET_Update peer that we died, unless it simulates the death itself.
+	if (engine.mode == DE_MODE_MULTIPLAYER && playerId == controlledPlayer && !RB_IsRunning())
 	{
 		t.time = simulationTime;
 		t.type = NET_RTM_DIED;
@@ -1306,13 +1389,13 @@ void P_Die(uchar playerId)
 		
 		
 		// Set player's position out of screen
-		players[playerId].ss_position[X] = 0.5f*(playerId-0.5f)*2.f;
+		players[playerId].ss_position[X] = P_LineupPosition(playerId) - 0.5f;
 		players[playerId].ss_position[Y] = -1.4;
 		
 		
 		players[playerId].autopilot.enabled = 1;
 		
-		players[playerId].autopilot.end_ss_position[X] = 0.5f*(playerId-0.5f)*2.f;
+		players[playerId].autopilot.end_ss_position[X] = P_LineupPosition(playerId) - 0.5f;
 		players[playerId].autopilot.end_ss_position[Y] = -0.0f;
 		
 		players[playerId].autopilot.diff_ss_position[X] = players[playerId].ss_position[X] - players[playerId].autopilot.end_ss_position[X];
@@ -1328,13 +1411,13 @@ void P_Die(uchar playerId)
 	{
       	//printf("RIP branch lives=%d\n",players[playerId].lives);
 		// Set player's position out of screen
-		players[playerId].ss_position[X] = 0.5f*(playerId-0.5f)*2.f;
+		players[playerId].ss_position[X] = P_LineupPosition(playerId) - 0.5f;
 		players[playerId].ss_position[Y] = -1.4;
 		
 		
 		players[playerId].autopilot.enabled = 1;
 		
-		players[playerId].autopilot.end_ss_position[X] = 0.5f*(playerId-0.5f)*2.f;
+		players[playerId].autopilot.end_ss_position[X] = P_LineupPosition(playerId) - 0.5f;
 		players[playerId].autopilot.end_ss_position[Y] = -1.4f;
 		
 		players[playerId].autopilot.diff_ss_position[X] = 0;
@@ -1344,8 +1427,12 @@ void P_Die(uchar playerId)
 		players[playerId].shouldDraw = 0;
 		
 		
+		for (i=0; i < numPlayers; i++)
+			if (players[i].respawnCounter >= 0)
+				break;
+		
 		if (((numPlayers == 1) && (playerId == controlledPlayer))     ||
-			((numPlayers == 2) && (players[0].respawnCounter < 0 && players[1].respawnCounter < 0))
+			((numPlayers >= 2) && i == numPlayers)
            )
 		{
 			
@@ -1358,21 +1445,17 @@ void P_Die(uchar playerId)
 			
             
             //Request scene 0 and menu 0 for within 3 seconds from now
-			event = calloc(1, sizeof(event_t));
-			event->type = EV_REQUEST_MENU;
-			event->time = simulationTime + 5000;
-			eventReqMenu = (event_req_menu_t*)calloc(1,sizeof(event_req_menu_t));
-			eventReqMenu->menuId = MENU_HOME;
-			event->payload = eventReqMenu;
-			EV_AddEvent(event);
-			
-			event= calloc(1, sizeof(event_t));
-			event->type = EV_REQUEST_SCENE;
-			event->time = simulationTime + 5000;
-			eventReqScene = (event_req_scene_t*)calloc(1,sizeof(event_req_scene_t));
-			eventReqScene->sceneId = 0;
-			event->payload = eventReqScene;
-			EV_AddEvent(event);
+			memset(&event, 0, sizeof(event_t));
+			event.type = EV_REQUEST_MENU;
+			event.time = simulationTime + 5000;
+			event.payload.reqMenu.menuId = MENU_HOME;
+			EV_AddEvent(&event);
+			
+			memset(&event, 0, sizeof(event_t));
+			event.type = EV_REQUEST_SCENE;
+			event.time = simulationTime + 5000;
+			event.payload.reqScene.sceneId = 0;
+			EV_AddEvent(&event);
              
 			
 			
@@ -39,7 +39,10 @@ extern texture_t pointersTexture;
 #define MAX_PLAYER_BULLETS 16
 
 #define BULLET_DEFAULT_ENERGY 1
-#define MAX_NUM_PLAYERS 2
+#define MAX_NUM_PLAYERS 8
+
+//Scenes only place the first two ships, the others are lined up between them (P_PlaceExtraPlayers).
+#define SCENE_NUM_PLAYERS 2
 
 
 
@@ -99,11 +102,12 @@ typedef struct playerBulletSprite_t
 */
 
 //Variable storing players bullet AND firing flash (in front of the player ship)
-// Vertices needed is number_of_players * number_of_bullets * 4 +  number_of_players * 4 = number_of_players * (number_of_bullets*4 +4)
-// Indices needed is number_of_players * number_of_bullets * 6 + number_of_players * 6 =   number_of_players * (number_of_bullets * 6 + 6)
+// The flash is two quads: a player needs (number_of_bullets + 2) * 4 vertices and (number_of_bullets + 2) * 6 indices.
+// Both arrays grow with numPlayers, see P_PrepareBulletSprites.
+#define PLAYER_BULLET_QUADS (MAX_PLAYER_BULLETS + 2)
 extern int numPBulletsIndices;
-extern unsigned short bulletIndices[(MAX_PLAYER_BULLETS * 6 + 6)*MAX_NUM_PLAYERS];
-extern xf_colorless_sprite_t pBulletVertices[(MAX_PLAYER_BULLETS*4+4)*MAX_NUM_PLAYERS];
+extern unsigned short* bulletIndices;
+extern xf_colorless_sprite_t* pBulletVertices;
 
 
 typedef struct bullet_t
@@ -231,10 +235,11 @@ typedef struct player_t
 
 extern uchar numPlayers;
 extern uchar controlledPlayer;
-extern player_t players[2];
+extern player_t players[MAX_NUM_PLAYERS];
 extern uchar entitiesAttachedToCamera;
 
 void P_InitPlayers(void);
+void P_PlaceExtraPlayers(void);
 void P_ResetPlayers(void);
 void PL_ResetPlayersScore(void);
 
@@ -33,6 +33,7 @@
 #include "camera.h"
 #include "world.h"
 #include "timer.h"
+#include "vcache.h"
 
 int logPreproc;
 
@@ -501,27 +502,27 @@ prec_camera_frame_t* PREPROC_ReadFrameFromFile(void)
 	
 	//Log_Printf("PREPROC_ReadFrameFromFile");
 	
-	LE_readToken(); //time
+	LE_skipToken(); //time
 	frame->time = LE_readReal();
 	
-	LE_readToken(); //position
+	LE_skipToken(); //position
 	frame->position[0] = LE_readReal();
 	frame->position[1] = LE_readReal();
 	frame->position[2] = LE_readReal();
 	
-	LE_readToken(); //q or m
-	if (!strcmp("q", LE_getCurrentToken()))
+	LE_readSpan(); //q or m
+	if (LE_spanEquals(LE_getCurrentSpan(), "q"))
 	{
 		for( i=0; i < 4 ; i++)
 			frame->orientation[i]= LE_readReal();
 	}
-	else if (!strcmp("lookat", LE_getCurrentToken()))
+	else if (LE_spanEquals(LE_getCurrentSpan(), "lookat"))
 	{
 		lookAt[X] = LE_readReal();
 		lookAt[Y] = LE_readReal();
 		lookAt[Z] = LE_readReal();
 		
-		LE_readToken(); // upVector
+		LE_skipToken(); // upVector
 		
 		Yaxis[X] = LE_readReal();
 		Yaxis[Y] = LE_readReal();
@@ -1040,6 +1041,42 @@ void printIndexes(filehandle_t*	debug)
 
 #define TRACE_CONVERT_FRAME 0
 
+// Key frame indices come in area order: reorder them for the vertex cache and keep track of where each face went.
+static void PREPROC_OptimizeVisSet(entity_visset_t* visSet)
+{
+	ushort* order;
+	ushort* previousEntityIndiceToModelIndice;
+	ushort modelIndice;
+	int numTriangles;
+	int i;
+	ushort entId;
+	
+	entId = visSet->entityId;
+	numTriangles = visSet->numIndices / 3;
+	
+	order = malloc(numTriangles * sizeof(ushort));
+	
+	if (!VCACHE_Optimize(visSet->indices, visSet->numIndices, map[entId].model->numVertices, order))
+	{
+		free(order);
+		return;
+	}
+	
+	previousEntityIndiceToModelIndice = malloc(visSet->numIndices * sizeof(ushort));
+	memcpy(previousEntityIndiceToModelIndice, entityIndiceToModelIndice[entId], visSet->numIndices * sizeof(ushort));
+	
+	for (i=0; i < numTriangles; i++)
+	{
+		modelIndice = previousEntityIndiceToModelIndice[order[i]*3];
+		
+		entityIndiceToModelIndice[entId][i*3] = modelIndice;
+		modelIndiceToEntityIndice[entId][modelIndice] = i*3;
+	}
+	
+	free(previousEntityIndiceToModelIndice);
+	free(order);
+}
+
 
 void PREPROC_ConvertPrecToRuntime(prec_camera_frame_t* prevFrame,prec_camera_frame_t* currentFrame,camera_frame_t* runTimeFrame)
 {
@@ -1062,6 +1099,9 @@ void PREPROC_ConvertPrecToRuntime(prec_camera_frame_t* prevFrame,prec_camera_fra
 	
 	ushort						entId;
 	
+#ifdef REPORT_ACMR
+	float						acmr;
+#endif
 	
 	filehandle_t*						debug;
 	char						debugFilename[256];
@@ -1155,6 +1195,25 @@ void PREPROC_ConvertPrecToRuntime(prec_camera_frame_t* prevFrame,prec_camera_fra
 			
 		}
 		
+		for(i=0 ; i < worldVisSet->numVisSets ; i++)
+		{
+			visSet = &worldVisSet->visSets[i];
+			
+			if (visSet->numIndices == 0)
+				continue;
+			
+#ifdef REPORT_ACMR
+			acmr = VCACHE_ComputeACMR(visSet->indices, visSet->numIndices, map[i].model->numVertices);
+#endif
+			
+			PREPROC_OptimizeVisSet(visSet);
+			
+#ifdef REPORT_ACMR
+			Log_Printf("[ACMR] frame t=%d entity %d: %d triangles, %.3f -> %.3f.\n",currentFrame->time, i, visSet->numIndices/3, acmr,
+					   VCACHE_ComputeACMR(visSet->indices, visSet->numIndices, map[i].model->numVertices));
+#endif
+		}
+		
 		
 		
 		if (TRACE_CONVERT_FRAME)
@@ -1452,10 +1511,10 @@ void PREPROC_ConvertCp1Tocp2b(char* cpFilename, char* cp2bFilename, char* logFil
 	
 	LE_init(file);
 	
-	LE_readToken(); //CP1
+	LE_readSpan(); //CP1
 	
 	
-	if (strcmp("cp1", LE_getCurrentToken()))
+	if (!LE_spanEquals(LE_getCurrentSpan(), "cp1"))
 	{
 		Log_Printf("CP file found but magic number check failed. Aborting.\n");
 		return;
@@ -1481,7 +1540,7 @@ void PREPROC_ConvertCp1Tocp2b(char* cpFilename, char* cp2bFilename, char* logFil
 	indicesPerObjectId = calloc(num_map_entities, sizeof(ushort));
 	
 	
-	LE_readToken(); //num_frames
+	LE_skipToken(); //num_frames
 	num_frames = LE_readReal();	
 	
 		
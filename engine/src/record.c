@@ -0,0 +1,487 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  record.c
+ *  dEngine
+ *
+ *  Streaming command recorder and lazy playback reader.
+ *
+ */
+
+#include "record.h"
+#include "filesystem.h"
+
+#ifndef WIN32
+	#include <pthread.h>
+	#define REC_THREADED 1
+#endif
+
+// The main thread fills one chunk while the writer thread flushes the others.
+#define REC_CHUNK_SIZE (16*1024)
+#define REC_NUM_CHUNKS 4
+
+typedef struct rec_chunk_t
+{
+	uchar data[REC_CHUNK_SIZE];
+	int size;
+	char pending;		// Full, waiting for the writer thread.
+} rec_chunk_t;
+
+typedef struct recorder_t
+{
+	filehandle_t* file;
+	rec_codec_t codec;
+
+	rec_chunk_t chunks[REC_NUM_CHUNKS];
+	int current;		// Chunk filled by the main thread.
+	int toWrite;		// Next chunk flushed by the writer thread.
+
+	char running;
+	char quit;
+
+	uint numCommands;
+	uint numBytes;
+
+#ifdef REC_THREADED
+	char threaded;
+	pthread_t thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+#endif
+} recorder_t;
+
+typedef struct playback_reader_t
+{
+	filehandle_t* file;
+	const uchar* cursor;
+	const uchar* end;
+	char legacy;
+
+	rec_codec_t codec;
+
+	char hasCommand;
+	command_t command;	// Next command to be executed, decoded ahead of time.
+} playback_reader_t;
+
+static recorder_t recorder;
+static playback_reader_t reader;
+
+
+static int REC_WriteVarint(uchar* dst, uint value)
+{
+	int size = 0;
+
+	while (value >= 0x80)
+	{
+		dst[size++] = (uchar)(value | 0x80);
+		value >>= 7;
+	}
+	dst[size++] = (uchar)value;
+
+	return size;
+}
+
+//Return the number of bytes consumed, 0 if the varint is truncated.
+static int REC_ReadVarint(const uchar* src, const uchar* end, uint* value)
+{
+	int size = 0;
+	int shift = 0;
+	uint result = 0;
+	uchar b;
+
+	while (src + size < end && shift < 35)
+	{
+		b = src[size++];
+		result |= (uint)(b & 0x7F) << shift;
+		if (!(b & 0x80))
+		{
+			*value = result;
+			return size;
+		}
+		shift += 7;
+	}
+
+	return 0;
+}
+
+void REC_ResetCodec(rec_codec_t* codec)
+{
+	memset(codec, 0, sizeof(rec_codec_t));
+}
+
+int REC_EncodeCommand(rec_codec_t* codec, const command_t* command, uchar* dst)
+{
+	uchar* cursor = dst;
+	uint deltaBits[2];
+	uchar header;
+	int timeDiff;
+
+	//Floats are compared and encoded through their bits: the codec is lossless.
+	memcpy(deltaBits, command->delta, sizeof(deltaBits));
+
+	header = (command->type & 0x7) | ((command->playerId & 0x7) << 3);
+	if (command->buttons)
+		header |= REC_HEADER_HAS_BUTTONS;
+	if (deltaBits[X] | deltaBits[Y])
+		header |= REC_HEADER_HAS_DELTA;
+
+	*cursor++ = header;
+
+	timeDiff = (int)(command->time - codec->lastTime);
+	cursor += REC_WriteVarint(cursor, ((uint)timeDiff << 1) ^ (uint)(timeDiff >> 31));
+	codec->lastTime = command->time;
+
+	if (header & REC_HEADER_HAS_BUTTONS)
+		*cursor++ = command->buttons;
+
+	if (header & REC_HEADER_HAS_DELTA)
+	{
+		cursor += REC_WriteVarint(cursor, deltaBits[X] ^ codec->lastDeltaBits[command->playerId][X]);
+		cursor += REC_WriteVarint(cursor, deltaBits[Y] ^ codec->lastDeltaBits[command->playerId][Y]);
+		codec->lastDeltaBits[command->playerId][X] = deltaBits[X];
+		codec->lastDeltaBits[command->playerId][Y] = deltaBits[Y];
+	}
+
+	return (int)(cursor - dst);
+}
+
+//Return the number of bytes consumed, 0 if the stream is truncated or corrupted.
+int REC_DecodeCommand(rec_codec_t* codec, const uchar* src, const uchar* end, command_t* command)
+{
+	const uchar* cursor = src;
+	uint deltaBits[2] = {0, 0};
+	uint value;
+	uchar header;
+	int size;
+	int i;
+
+	if (cursor >= end)
+		return 0;
+
+	header = *cursor++;
+
+	memset(command, 0, sizeof(command_t));
+	command->type = header & 0x7;
+	command->playerId = (header >> 3) & 0x7;
+
+	size = REC_ReadVarint(cursor, end, &value);
+	if (!size)
+		return 0;
+	cursor += size;
+	codec->lastTime += (uint)((int)(value >> 1) ^ -(int)(value & 1));
+	command->time = codec->lastTime;
+
+	if (header & REC_HEADER_HAS_BUTTONS)
+	{
+		if (cursor >= end)
+			return 0;
+		command->buttons = *cursor++;
+	}
+
+	if (header & REC_HEADER_HAS_DELTA)
+	{
+		if (command->playerId >= MAX_NUM_PLAYERS)
+			return 0;
+
+		for (i=0; i < 2; i++)
+		{
+			size = REC_ReadVarint(cursor, end, &value);
+			if (!size)
+				return 0;
+			cursor += size;
+			codec->lastDeltaBits[command->playerId][i] ^= value;
+			deltaBits[i] = codec->lastDeltaBits[command->playerId][i];
+		}
+	}
+	memcpy(command->delta, deltaBits, sizeof(deltaBits));
+
+	return (int)(cursor - src);
+}
+
+
+
+#ifdef REC_THREADED
+static void* REC_WriterThread(void* unused)
+{
+	rec_chunk_t* chunk;
+
+	(void)unused;
+
+	pthread_mutex_lock(&recorder.mutex);
+	for (;;)
+	{
+		chunk = &recorder.chunks[recorder.toWrite];
+
+		if (!chunk->pending)
+		{
+			if (recorder.quit)
+				break;
+
+			pthread_cond_wait(&recorder.cond, &recorder.mutex);
+			continue;
+		}
+
+		pthread_mutex_unlock(&recorder.mutex);
+		FS_Write(chunk->data, 1, chunk->size, recorder.file);
+		pthread_mutex_lock(&recorder.mutex);
+
+		chunk->pending = 0;
+		recorder.toWrite = (recorder.toWrite + 1) % REC_NUM_CHUNKS;
+		pthread_cond_broadcast(&recorder.cond);
+	}
+	pthread_mutex_unlock(&recorder.mutex);
+
+	return NULL;
+}
+#endif
+
+static void REC_SubmitChunk(void)
+{
+	rec_chunk_t* chunk;
+
+	chunk = &recorder.chunks[recorder.current];
+
+	if (chunk->size == 0)
+		return;
+
+	recorder.numBytes += chunk->size;
+
+#ifdef REC_THREADED
+	if (recorder.threaded)
+	{
+		pthread_mutex_lock(&recorder.mutex);
+		chunk->pending = 1;
+		pthread_cond_broadcast(&recorder.cond);
+
+		recorder.current = (recorder.current + 1) % REC_NUM_CHUNKS;
+
+		//Only blocks if the writer thread is REC_NUM_CHUNKS chunks behind.
+		while (recorder.chunks[recorder.current].pending)
+			pthread_cond_wait(&recorder.cond, &recorder.mutex);
+
+		pthread_mutex_unlock(&recorder.mutex);
+
+		recorder.chunks[recorder.current].size = 0;
+		return;
+	}
+#endif
+
+	FS_Write(chunk->data, 1, chunk->size, recorder.file);
+	chunk->size = 0;
+}
+
+char REC_StartRecording(const char* filename, int numPlayers)
+{
+	int header[3];
+	int i;
+
+	REC_StopRecording();
+
+	recorder.file = FS_OpenFile(filename, "wb");
+	if (!recorder.file)
+	{
+		Log_Printf("[REC_StartRecording] Unable to create record file: %s.\n",filename);
+		return 0;
+	}
+
+	header[0] = REC_MAGIC;
+	header[1] = REC_VERSION;
+	header[2] = numPlayers;
+	FS_Write(header, sizeof(int), 3, recorder.file);
+
+	REC_ResetCodec(&recorder.codec);
+	for (i=0; i < REC_NUM_CHUNKS; i++)
+	{
+		recorder.chunks[i].size = 0;
+		recorder.chunks[i].pending = 0;
+	}
+	recorder.current = 0;
+	recorder.toWrite = 0;
+	recorder.quit = 0;
+	recorder.numCommands = 0;
+	recorder.numBytes = sizeof(header);
+
+#ifdef REC_THREADED
+	pthread_mutex_init(&recorder.mutex, NULL);
+	pthread_cond_init(&recorder.cond, NULL);
+	recorder.threaded = (pthread_create(&recorder.thread, NULL, REC_WriterThread, NULL) == 0);
+	if (!recorder.threaded)
+	{
+		Log_Printf("[REC_StartRecording] Unable to start writer thread, writing synchronously.\n");
+		pthread_cond_destroy(&recorder.cond);
+		pthread_mutex_destroy(&recorder.mutex);
+	}
+#endif
+
+	recorder.running = 1;
+
+	Log_Printf("[REC_StartRecording] Recording %d player(s) to '%s'.\n",numPlayers,filename);
+
+	return 1;
+}
+
+void REC_RecordCommand(const command_t* command)
+{
+	rec_chunk_t* chunk;
+
+	if (!recorder.running)
+		return;
+
+	chunk = &recorder.chunks[recorder.current];
+
+	if (chunk->size + REC_MAX_ENCODED_SIZE > REC_CHUNK_SIZE)
+	{
+		REC_SubmitChunk();
+		chunk = &recorder.chunks[recorder.current];
+	}
+
+	chunk->size += REC_EncodeCommand(&recorder.codec, command, chunk->data + chunk->size);
+	recorder.numCommands++;
+}
+
+void REC_StopRecording(void)
+{
+	if (!recorder.running)
+		return;
+
+	REC_SubmitChunk();
+
+#ifdef REC_THREADED
+	if (recorder.threaded)
+	{
+		pthread_mutex_lock(&recorder.mutex);
+		recorder.quit = 1;
+		pthread_cond_broadcast(&recorder.cond);
+		pthread_mutex_unlock(&recorder.mutex);
+
+		pthread_join(recorder.thread, NULL);
+		pthread_cond_destroy(&recorder.cond);
+		pthread_mutex_destroy(&recorder.mutex);
+		recorder.threaded = 0;
+	}
+#endif
+
+	FS_CloseFile(recorder.file);
+	recorder.file = NULL;
+	recorder.running = 0;
+
+	Log_Printf("[REC_StopRecording] Wrote %u commands in %u bytes (%u bytes raw).\n",recorder.numCommands,recorder.numBytes,recorder.numCommands*(uint)sizeof(command_t));
+}
+
+char REC_IsRecording(void)
+{
+	return recorder.running;
+}
+
+
+
+//Return the number of players in the record or -1 if it cannot be read.
+int REC_OpenPlayback(const char* filename)
+{
+	int header[3];
+	int numPlayers;
+
+	REC_ClosePlayback();
+
+	reader.file = FS_OpenFile(filename, "rb");
+	if (!reader.file)
+		return -1;
+
+	if (!FS_UploadToRAM(reader.file) || reader.file->filesize < sizeof(int))
+	{
+		REC_ClosePlayback();
+		return -1;
+	}
+
+	reader.cursor = reader.file->ptrStart;
+	reader.end = reader.file->ptrEnd;
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, reader.cursor, reader.file->filesize < sizeof(header) ? reader.file->filesize : sizeof(header));
+
+	if (header[0] == REC_MAGIC && reader.file->filesize >= sizeof(header))
+	{
+		if (header[1] != REC_VERSION)
+		{
+			Log_Printf("[REC_OpenPlayback] Unsupported record version %d in '%s'.\n",header[1],filename);
+			REC_ClosePlayback();
+			return -1;
+		}
+		numPlayers = header[2];
+		reader.cursor += sizeof(header);
+		reader.legacy = 0;
+	}
+	else
+	{
+		numPlayers = header[0];
+		reader.cursor += sizeof(int);
+		reader.legacy = 1;
+	}
+
+	REC_ResetCodec(&reader.codec);
+	REC_NextCommand();
+
+	return numPlayers;
+}
+
+command_t* REC_PeekCommand(void)
+{
+	return reader.hasCommand ? &reader.command : NULL;
+}
+
+void REC_NextCommand(void)
+{
+	int size;
+
+	reader.hasCommand = 0;
+
+	if (!reader.file)
+		return;
+
+	if (reader.legacy)
+	{
+		if (reader.end - reader.cursor < (int)sizeof(command_t))
+			return;
+
+		memcpy(&reader.command, reader.cursor, sizeof(command_t));
+		reader.cursor += sizeof(command_t);
+
+		//Legacy records are zero padded up to their fixed size.
+		if (reader.command.type == 0)
+		{
+			reader.cursor = reader.end;
+			return;
+		}
+	}
+	else
+	{
+		size = REC_DecodeCommand(&reader.codec, reader.cursor, reader.end, &reader.command);
+		if (!size)
+			return;
+		reader.cursor += size;
+	}
+
+	reader.hasCommand = 1;
+}
+
+void REC_ClosePlayback(void)
+{
+	if (reader.file)
+		FS_CloseFile(reader.file);
+
+	memset(&reader, 0, sizeof(reader));
+}
@@ -0,0 +1,80 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  record.h
+ *  dEngine
+ *
+ *  Streaming command recorder and lazy playback reader.
+ *
+ */
+
+#ifndef DE_RECORD
+#define DE_RECORD
+
+#include "globals.h"
+#include "commands.h"
+
+/*
+	File layout:
+
+		int magic		REC_MAGIC
+		int version		REC_VERSION
+		int numPlayers
+		... encoded commands until EOF
+
+	Each command is encoded as:
+
+		uchar  header	bits 0-2 type, bits 3-5 playerId, bit 6 buttons follow, bit 7 delta follows
+		varint time		zigzag difference with the previous command time
+		uchar  buttons	(optional)
+		varint deltaX	(optional) float bits XORed with the previous deltaX of this player
+		varint deltaY	(optional) float bits XORed with the previous deltaY of this player
+
+	An idle frame costs 2 bytes instead of sizeof(command_t).
+	Legacy files (int numPlayers followed by raw command_t) are still readable.
+*/
+
+#define REC_MAGIC				0x31524D43	// "CMR1"
+#define REC_VERSION				1
+#define REC_MAX_ENCODED_SIZE	20
+
+#define REC_HEADER_HAS_BUTTONS	0x40
+#define REC_HEADER_HAS_DELTA	0x80
+
+typedef struct rec_codec_t
+{
+	uint lastTime;
+	uint lastDeltaBits[MAX_NUM_PLAYERS][2];
+} rec_codec_t;
+
+void REC_ResetCodec(rec_codec_t* codec);
+int  REC_EncodeCommand(rec_codec_t* codec, const command_t* command, uchar* dst);
+int  REC_DecodeCommand(rec_codec_t* codec, const uchar* src, const uchar* end, command_t* command);
+
+//Recorder: commands are encoded into chunks, chunks are written to disk by a background thread.
+char REC_StartRecording(const char* filename, int numPlayers);
+void REC_RecordCommand(const command_t* command);
+void REC_StopRecording(void);
+char REC_IsRecording(void);
+
+//Reader: the file is kept in RAM and commands are decoded one at a time.
+int  REC_OpenPlayback(const char* filename);
+command_t* REC_PeekCommand(void);
+void REC_NextCommand(void);
+void REC_ClosePlayback(void);
+
+#endif
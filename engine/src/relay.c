@@ -0,0 +1,334 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  relay.c
+ *  dEngine
+ *
+ *  Spectator relay of a multiplayer session.
+ *
+ */
+
+#include "relay.h"
+
+#define RELAY_NO_FRAME 0xFFFFFFFF
+
+typedef struct relay_frame_t
+{
+	uint frame;
+	command_t commands[MAX_NUM_PLAYERS];
+	uchar confirmed[MAX_NUM_PLAYERS];
+} relay_frame_t;
+
+typedef struct relay_block_t
+{
+	uint offset;				// In the log.
+	uint size;
+} relay_block_t;
+
+typedef struct relay_spectator_t
+{
+	net_transport_t transport;
+	uint ackBlock;				// First block the spectator misses.
+	uint nextBlock;				// Next block to send.
+	uint sentBlock;				// Every block before it was sent once.
+	uint lastProgress;			// ms, last ack moving the window.
+} relay_spectator_t;
+
+struct relay_t
+{
+	uchar numPlayers;
+	net_transport_t players;
+
+	relay_frame_t pending[RELAY_PENDING];
+	uint nextFrames[MAX_NUM_PLAYERS];	// By player, every command before it arrived.
+	uint nextFrame;						// Every frame before it is in the log.
+
+	uchar* log;							// Closed blocks, back to back.
+	uint logCapacity;
+	relay_block_t* blocks;
+	uint blocksCapacity;
+
+	netp_block_writer_t writer;			// Block being filled, not sent yet.
+	uchar writing;
+	uchar current[NETT_MTU];
+
+	relay_spectator_t* spectators;
+	int numSpectators;
+	int spectatorsCapacity;
+
+	relay_stats_t stats;
+};
+
+relay_t* RELAY_New(uchar numPlayers, const net_transport_t* players)
+{
+	relay_t* relay;
+	int i;
+
+	relay = calloc(1, sizeof(relay_t));
+	relay->numPlayers = numPlayers > MAX_NUM_PLAYERS ? MAX_NUM_PLAYERS : numPlayers;
+	relay->players = *players;
+
+	for (i=0; i < RELAY_PENDING; i++)
+		relay->pending[i].frame = RELAY_NO_FRAME;
+
+	relay->stats.logHash = NETP_HASH_OFFSET;
+
+	Log_Printf("[RELAY_New] %d players.\n",relay->numPlayers);
+
+	return relay;
+}
+
+void RELAY_Free(relay_t* relay)
+{
+	int i;
+
+	if (!relay)
+		return;
+
+	Log_Printf("[RELAY_Free] %u frames in %u blocks (%u bytes), %u blocks sent (%u again) to %d spectators, %u bytes.\n",
+			   relay->stats.frames,relay->stats.blocks,relay->stats.logBytes,relay->stats.blocksSent,relay->stats.blocksResent,relay->numSpectators,relay->stats.bytesSent);
+
+	relay->players.Close(&relay->players);
+
+	for (i=0; i < relay->numSpectators; i++)
+		relay->spectators[i].transport.Close(&relay->spectators[i].transport);
+
+	free(relay->spectators);
+	free(relay->blocks);
+	free(relay->log);
+	free(relay);
+}
+
+int RELAY_AddSpectator(relay_t* relay, const net_transport_t* transport)
+{
+	relay_spectator_t* spectator;
+
+	if (relay->numSpectators == relay->spectatorsCapacity)
+	{
+		relay->spectatorsCapacity = relay->spectatorsCapacity ? relay->spectatorsCapacity * 2 : 16;
+		relay->spectators = realloc(relay->spectators, relay->spectatorsCapacity * sizeof(relay_spectator_t));
+	}
+
+	spectator = &relay->spectators[relay->numSpectators];
+	memset(spectator, 0, sizeof(relay_spectator_t));
+	spectator->transport = *transport;
+
+	return relay->numSpectators++;
+}
+
+static void RELAY_CloseBlock(relay_t* relay)
+{
+	relay_block_t* block;
+
+	if (!relay->writing)
+		return;
+
+	if (relay->stats.logBytes + relay->writer.size > relay->logCapacity)
+	{
+		relay->logCapacity = relay->logCapacity ? relay->logCapacity * 2 : 64 * 1024;
+		relay->log = realloc(relay->log, relay->logCapacity);
+	}
+
+	if (relay->stats.blocks == relay->blocksCapacity)
+	{
+		relay->blocksCapacity = relay->blocksCapacity ? relay->blocksCapacity * 2 : 256;
+		relay->blocks = realloc(relay->blocks, relay->blocksCapacity * sizeof(relay_block_t));
+	}
+
+	block = &relay->blocks[relay->stats.blocks++];
+	block->offset = relay->stats.logBytes;
+	block->size = relay->writer.size;
+
+	memcpy(relay->log + block->offset, relay->current, block->size);
+	relay->stats.logBytes += block->size;
+
+	relay->writing = 0;
+}
+
+static void RELAY_AppendFrame(relay_t* relay, const command_t* commands)
+{
+	//A frame that does not fit closes the block, the next one starts with it.
+	if (relay->writing && !NETP_AppendBlockFrame(&relay->writer, commands))
+		RELAY_CloseBlock(relay);
+
+	if (!relay->writing)
+	{
+		NETP_BeginBlock(&relay->writer, relay->current, sizeof(relay->current), relay->numPlayers, relay->stats.blocks, relay->nextFrame);
+		NETP_AppendBlockFrame(&relay->writer, commands);
+		relay->writing = 1;
+	}
+
+	if (relay->writer.numFrames == NETP_MAX_BLOCK_FRAMES)
+		RELAY_CloseBlock(relay);
+
+	relay->stats.frames++;
+	relay->stats.logHash = NETP_HashCommands(relay->stats.logHash, commands, relay->numPlayers);
+}
+
+static void RELAY_AddCommand(relay_t* relay, uint frame, const command_t* command)
+{
+	relay_frame_t* pending;
+	uchar playerId;
+	int i;
+
+	playerId = command->playerId;
+
+	//Already logged, or so far ahead the slot is still in use: it comes again.
+	if (frame < relay->nextFrames[playerId] || frame >= relay->nextFrame + RELAY_PENDING)
+		return;
+
+	pending = &relay->pending[frame & (RELAY_PENDING-1)];
+	if (pending->frame != frame)
+	{
+		memset(pending, 0, sizeof(relay_frame_t));
+		pending->frame = frame;
+	}
+
+	pending->commands[playerId] = *command;
+	pending->confirmed[playerId] = 1;
+
+	while (relay->pending[relay->nextFrames[playerId] & (RELAY_PENDING-1)].frame == relay->nextFrames[playerId] &&
+		   relay->pending[relay->nextFrames[playerId] & (RELAY_PENDING-1)].confirmed[playerId])
+		relay->nextFrames[playerId]++;
+
+	//Every command of the frame arrived: it goes to the log.
+	for (;;)
+	{
+		pending = &relay->pending[relay->nextFrame & (RELAY_PENDING-1)];
+		if (pending->frame != relay->nextFrame)
+			return;
+
+		for (i=0; i < relay->numPlayers; i++)
+			if (!pending->confirmed[i])
+				return;
+
+		RELAY_AppendFrame(relay, pending->commands);
+		pending->frame = RELAY_NO_FRAME;
+		relay->nextFrame++;
+	}
+}
+
+static void RELAY_ReceivePlayers(relay_t* relay)
+{
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	netp_input_packet_t packet;
+	netp_relay_ack_t ack;
+	uchar buffer[NETP_MAX_RELAY_ACK_SIZE];
+	int numReceived;
+	int i, j;
+
+	do
+	{
+		numReceived = relay->players.Receive(&relay->players, buffers, sizes, NETT_RECV_BATCH);
+
+		for (i=0; i < numReceived; i++)
+		{
+			if (!NETP_Decode(&packet, buffers[i], sizes[i]) || packet.playerId >= relay->numPlayers)
+				continue;
+
+			for (j=0; j < packet.numCommands; j++)
+				RELAY_AddCommand(relay, packet.firstFrame + j, &packet.commands[j]);
+		}
+	} while (numReceived == NETT_RECV_BATCH);
+
+	//One ack for every player, in every update: they stop resending as soon as it arrives.
+	ack.numPlayers = relay->numPlayers;
+	memcpy(ack.nextFrames, relay->nextFrames, sizeof(ack.nextFrames));
+	relay->players.Send(&relay->players, buffer, NETP_EncodeRelayAck(&ack, buffer, sizeof(buffer)));
+}
+
+static void RELAY_UpdateSpectator(relay_t* relay, relay_spectator_t* spectator, uint now)
+{
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	relay_block_t* block;
+	uint nextBlock;
+	int numReceived;
+	int i;
+
+	do
+	{
+		numReceived = spectator->transport.Receive(&spectator->transport, buffers, sizes, NETT_RECV_BATCH);
+
+		for (i=0; i < numReceived; i++)
+		{
+			//Acks arrive out of order, never go back. The spectator cannot ack what was not sent.
+			if (!NETP_DecodeBlockAck(&nextBlock, buffers[i], sizes[i]) ||
+				nextBlock <= spectator->ackBlock || nextBlock > spectator->sentBlock)
+				continue;
+
+			spectator->ackBlock = nextBlock;
+			spectator->lastProgress = now;
+		}
+	} while (numReceived == NETT_RECV_BATCH);
+
+	if (spectator->nextBlock < spectator->ackBlock)
+		spectator->nextBlock = spectator->ackBlock;
+
+	//Nothing in flight: the timeout starts with the next block.
+	if (spectator->nextBlock == spectator->ackBlock)
+		spectator->lastProgress = now;
+	else if (now - spectator->lastProgress >= RELAY_RESEND_MS)
+	{
+		spectator->nextBlock = spectator->ackBlock;
+		spectator->lastProgress = now;
+	}
+
+	while (spectator->nextBlock < relay->stats.blocks && spectator->nextBlock < spectator->ackBlock + RELAY_WINDOW)
+	{
+		block = &relay->blocks[spectator->nextBlock];
+
+		//Full: try again in the next update.
+		if (!spectator->transport.Send(&spectator->transport, relay->log + block->offset, block->size))
+			break;
+
+		relay->stats.bytesSent += block->size;
+		relay->stats.blocksSent++;
+		if (spectator->nextBlock < spectator->sentBlock)
+			relay->stats.blocksResent++;
+
+		spectator->nextBlock++;
+		if (spectator->nextBlock > spectator->sentBlock)
+			spectator->sentBlock = spectator->nextBlock;
+	}
+}
+
+void RELAY_Update(relay_t* relay, uint now)
+{
+	int i;
+
+	RELAY_ReceivePlayers(relay);
+
+	for (i=0; i < relay->numSpectators; i++)
+		RELAY_UpdateSpectator(relay, &relay->spectators[i], now);
+}
+
+void RELAY_Flush(relay_t* relay)
+{
+	RELAY_CloseBlock(relay);
+}
+
+char RELAY_SpectatorIsDone(const relay_t* relay, int spectator)
+{
+	return !relay->writing && relay->spectators[spectator].ackBlock == relay->stats.blocks;
+}
+
+const relay_stats_t* RELAY_GetStats(const relay_t* relay)
+{
+	return &relay->stats;
+}
@@ -0,0 +1,94 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  relay.h
+ *  dEngine
+ *
+ *  Spectator relay of a multiplayer session.
+ *
+ */
+
+#ifndef DE_RELAY
+#define DE_RELAY
+
+#include "globals.h"
+#include "nettransport.h"
+#include "netpacket.h"
+
+/*
+	The simulation only depends on the commands of the players: watching a
+	session is replaying them. The relay does that for any number of
+	spectators without loading the players' machines and without running
+	the simulation itself.
+
+	It listens to the session like a peer that never plays: the players
+	send it their input packets along with the other peers and it acks
+	them (NETP_TYPE_RELAY_ACK), rollback then sends again what it misses.
+	A frame is confirmed once the command of every player arrived, the
+	confirmed frames are the log of the session.
+
+	The log is cut into blocks of consecutive frames (netpacket.h), each
+	encoded once in its datagram and shared by every spectator. A block is
+	closed once it holds NETP_MAX_BLOCK_FRAMES frames or fills a datagram:
+	spectators watch about half a second behind the players.
+
+	Each spectator has its own window over the blocks: the relay sends up
+	to RELAY_WINDOW blocks past the first one the spectator misses, and
+	goes back to that one when the acks stop for RELAY_RESEND_MS. A
+	spectator can join any time, it gets the log from block 0 and catches
+	up (spectator.h).
+
+	Snapshots (snapshot.h) only make sense in the process that took them,
+	the log from frame 0 is what travels.
+*/
+
+#define RELAY_WINDOW		32		// Blocks in flight to one spectator.
+#define RELAY_RESEND_MS		400
+#define RELAY_PENDING		64		// Frames waiting on the command of a player, power of two.
+
+typedef struct relay_stats_t
+{
+	uint frames;				// Confirmed.
+	uint blocks;				// Closed.
+	uint logBytes;
+	uint bytesSent;				// To the spectators.
+	uint blocksSent;
+	uint blocksResent;
+	unsigned long long logHash;	// NETP_HashCommands of every confirmed frame.
+} relay_stats_t;
+
+typedef struct relay_t relay_t;
+
+// Owns the transports it is given: players reaches every player.
+relay_t* RELAY_New(uchar numPlayers, const net_transport_t* players);
+void RELAY_Free(relay_t* relay);
+
+// Returns the spectator id.
+int RELAY_AddSpectator(relay_t* relay, const net_transport_t* transport);
+
+// Receives the commands and the acks, sends the acks and the blocks. now in ms.
+void RELAY_Update(relay_t* relay, uint now);
+
+// Closes the current block, at the end of the session.
+void RELAY_Flush(relay_t* relay);
+
+// The last block was acked by this spectator.
+char RELAY_SpectatorIsDone(const relay_t* relay, int spectator);
+
+const relay_stats_t* RELAY_GetStats(const relay_t* relay);
+
+#endif
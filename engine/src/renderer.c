@@ -29,6 +29,8 @@
 #include "renderer_progr.h"
 #ifdef __EMSCRIPTEN__
 #include "wasm_display.h"
+#elif defined(DEDICATED_SERVER)
+#include "dedicated.h"
 #endif
 #include "stats.h"
 #include "timer.h"
@@ -39,6 +41,7 @@
 #include "text.h"
 #include "enemy_particules.h"
 #include "io_interface.h"
+#include "atlas.h"
 
 //int renderWidth;
 //int renderHeight;
@@ -174,6 +177,8 @@ void SCR_Init(void)
 	*/
 	SCR_SetFadeFullScreen();
 	
+	SPR_Init();
+	
 	renderer.enabled = 1;
 	
 }
@@ -187,6 +192,9 @@ void SCR_BindMethods(int rendererType)
 	   // For WASM/Emscripten, we have a dedicated set of display functions
 	   // that interface with SDL/WebGL.
 	   wasm_display_bind_renderer_methods(&renderer);
+#elif defined(DEDICATED_SERVER)
+	Log_Printf("[Renderer] Dedicated server, nothing is rendered\n");
+	Dedicated_BindRendererMethods(&renderer);
 #else
 	if (rendererType == GL_11_RENDERER)
 	{
@@ -202,11 +210,49 @@ void SCR_BindMethods(int rendererType)
 #endif
 	
 	strcpy(scrFont.path,STATS_FONT_PATH);
-	TEX_MakeStaticAvailable(&scrFont);
+	ATL_MakeStaticAvailable(&scrFont);
 }
 
 
 
+static void SCR_BatchFXSprites(void)
+{
+	int i,j;
+	ghost_t* ghost;
+	
+	//Player and enemy bullets
+	SPR_SetState(&bulletConfig.bulletTexture, SPR_BLEND_ADD);
+	SPR_AddColorlessIndexed(pBulletVertices, bulletIndices, numPBulletsIndices);
+	SPR_AddColorlessQuads(partLib.ss_vertices, partLib.num_indices/SPR_QUAD_INDICES);
+	
+	SPR_SetState(&smokeTexture, SPR_BLEND_ADD);
+	SPR_AddColorlessIndexed(smokeVertices, smokeIndices, numSmokeIndices);
+	
+	SPR_SetState(&ghostTexture, SPR_BLEND_ADD);
+	for(i=0 ; i <numPlayers ; i++)
+	{
+		for (j=0; j< GHOSTS_NUM; j++) 
+		{
+			ghost = &players[i].ghosts[j];
+			
+			if (ghost->timeCounter >= GHOST_TTL_MS)
+				continue;
+			
+			SPR_AddColorlessStrip(&ghost->wayPoints[ghost->startVertexArray], ghost->lengthVertexArray);
+		}
+	}
+	
+	SPR_SetState(&bulletConfig.bulletTexture, SPR_BLEND_ADD);
+	SPR_AddIndexed(particuleVertices, particuleIndices, numParticulesIndices);
+	
+	SPR_SetState(&explosionTexture, SPR_BLEND_ALPHA);
+	SPR_AddIndexed(explosionVertices, explosionIndices, numExplosionIndices);
+	
+	//Enemy FXs
+	SPR_SetState(&bulletConfig.bulletTexture, SPR_BLEND_ALPHA);
+	SPR_AddQuads(enFxLib.ss_vertices, enFxLib.num_indices/SPR_QUAD_INDICES);
+}
+
 void SCR_RenderFrame(void)
 {
 	
@@ -222,18 +268,11 @@ void SCR_RenderFrame(void)
 	
 	renderer.Set2D();
 	
-	renderer.RenderPlayersBullets();
-
-//	if (enFxLib.num_indices != 0)
-//		Log_Printf("fsdf\n");
-	// enemy particules + FX + players lives counter
-	
-	
-	
-	
-	renderer.RenderFXSprites();
-
+	//All sprites until the controls go in one stream, TITLE_Render flushes it if a title is shown.
+	SPR_Begin();
 	
+	// players and enemies bullets, enemy particules + FX
+	SCR_BatchFXSprites();
 	
 	TITLE_Render();
 	
@@ -244,6 +283,7 @@ void SCR_RenderFrame(void)
 	
 	STATS_Render();
 	
+	SPR_Flush();
 	
 	
 	if (engine.controlVisible)
@@ -411,7 +451,31 @@ void SCR_ConvertTextToVertices(const char* string, float size, short ss_cooX, sh
 
 void SCR_RenderText(void)
 {
+	static xf_colorless_sprite_t atlasTextVertices[MAX_NUM_TEXT_VERTICES];
+	int i;
+	
 	renderer.SetTexture(scrFont.textureId);
-	renderer.RenderColorlessSprites(scr_TextVertices,scr_TextNumIndices,scr_TextIndices);
+	
+	if (!scrFont.inAtlas)
+	{
+		renderer.RenderColorlessSprites(scr_TextVertices,scr_TextNumIndices,scr_TextIndices);
+		return;
+	}
+	
+	//scr_TextVertices keep the font UVs, SCR_BatchText remaps them itself.
+	for (i=0; i < scr_TextNumVertices; i++)
+	{
+		atlasTextVertices[i] = scr_TextVertices[i];
+		ATL_RemapUV(&scrFont, atlasTextVertices[i].text);
+	}
+	
+	renderer.RenderColorlessSprites(atlasTextVertices,scr_TextNumIndices,scr_TextIndices);
+
+}
 
+//Same as SCR_RenderText but the text goes to the frame sprite batch.
+void SCR_BatchText(void)
+{
+	SPR_SetState(&scrFont, SPR_BLEND_ALPHA);
+	SPR_AddColorlessIndexed(scr_TextVertices, scr_TextIndices, scr_TextNumIndices);
 }
\ No newline at end of file
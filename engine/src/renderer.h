@@ -40,14 +40,16 @@
 #define TEXTURE_FORMAT_PNG    0
 #define TEXTURE_FORMAT_PVRTC  1     
 #define TEXTURE_FORMAT_ETC1   2
-#define TEXTURE_FORMAT_ATITC  3
-#define TEXTURE_FORMAT_S3TC   4     
+#define TEXTURE_FORMAT_ATITC  4
+#define TEXTURE_FORMAT_S3TC   8     
 
      
 #define SHADOW_TYPE_NORMAL 0
 #define SHADOW_TYPE_DISABLED 1
 #define SHADOW_TYPE_VSM 2
 
+#define SHADOW_UPDATE_PERIOD 1			//Default of renderer.shadowUpdatePeriod: a moving light refreshes the shadow map every frame.
+
 #include "config.h"
 #include "texture.h"
 #include "matrix.h"
@@ -57,6 +59,8 @@
 #include "commands.h"
 #include "math.h"
 #include "player.h"
+#include "spritebatch.h"
+#include "instancing.h"
 	 
 //extern int renderWidth;
 //extern int renderHeight;
@@ -96,6 +100,7 @@ typedef struct renderer_t
 	//uint supportBumpMapping;
 	//uint shadowType;
 	uchar isRenderingShadow;
+	uchar shadowUpdatePeriod;		//Frames a moving light takes to refresh the shadow map, casters are spread over them.
 	uchar isBlending;
 	
 	uint mainFramebufferId;
@@ -123,8 +128,8 @@ typedef struct renderer_t
 	void (*UpLoadTextureToGpu)(texture_t* texture);
 	void (*FreeGPUTexture)(texture_t* texture);
 	void (*Set2D)(void);
-	void (*RenderPlayersBullets)(void);
-	void (*RenderFXSprites)(void);
+	void (*RenderSprites)(const xf_sprite_t* vertices, int numQuads, const ushort* quadIndices, const spr_batch_t* batches, int numBatches);
+	void (*RenderInstances)(const inst_batch_t* batch);
 	
 	void (*RenderString)(xf_colorless_sprite_t* vertices,ushort* indices, uint numIndices);
 	void (*GetColorBuffer)(uchar* data);
@@ -165,6 +170,7 @@ void SCR_SetFadeFullScreen(void);
 void SCR_StartConvertText(void);	 
 void SCR_ConvertTextToVertices(const char* string, float size, short ss_cooX, short ss_cooY, uchar centered);
 void SCR_RenderText(void);	 
+void SCR_BatchText(void);
 	 
      void SRC_OnResizeScreen(int width, int height);     
      
@@ -24,6 +24,7 @@
  */
 
 #include "config.h"
+#include <stddef.h>
 
 //#define RENDER_COLL_BOXEX
 
@@ -58,6 +59,7 @@
 #include "world.h"
 #include "player.h"
 #include "enemy.h"
+#include "renderqueue.h"
 #include "timer.h"
 #include <limits.h>
 #include "fx.h"
@@ -69,6 +71,7 @@ static matrix_t modelViewMatrix;
 matrix_t textureMatrix = { 1.0f/32767,       0,0,0,
                            0,          1.0f/32767,0,0,0,0,1,0,0,0,0,1};	//Unpacking matrix since texture coordinates are normalized in a short instead of a float.
 unsigned int lastTextureId;
+static material_t* lastMaterial;
 
 
 
@@ -173,6 +176,9 @@ void Set3DF(void)
 		glEnable(GL_LIGHT0);
 	}
 	
+	//Compact meshes are drawn with a uniform scale, it would shorten the normals.
+	glEnable(GL_RESCALE_NORMAL);
+	
 	glEnable(GL_TEXTURE_2D);
 	glShadeModel(GL_SMOOTH);
 	
@@ -192,8 +198,16 @@ void Set3DF(void)
 	glColor4f(1, 1, 1, 1);
 }
 
+#ifdef RENDER_COLL_BOXEX	
+void RenderCollisionBoxes(void);
+#endif
+
 void StopRenditionF(void)
 {
+#ifdef RENDER_COLL_BOXEX	
+	RenderCollisionBoxes();
+#endif
+	
 	lastTextureId = -1;
 }
 
@@ -201,6 +215,7 @@ void StopRenditionF(void)
 void UpLoadTextureToGPUF(texture_t* texture)
 {
 	int i,mipMapDiv;
+	int mipWidth,mipHeight;
 	
 	if (!texture || !texture->data || texture->textureId != 0)
 		return;
@@ -211,14 +226,18 @@ void UpLoadTextureToGPUF(texture_t* texture)
 		
 	if (texture->format == TEXTURE_GL_RGB ||texture->format == TEXTURE_GL_RGBA)
 	{
-		glTexParameterf(GL_TEXTURE_2D,GL_GENERATE_MIPMAP, GL_TRUE);
+		//Decoded rows are packed, RGB rows and levels are not 4 bytes aligned.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 		
-        if(texture->format == TEXTURE_GL_RGBA)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->width, texture->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture->data[0]);
-        }
-        else
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texture->width, texture->height, 0, GL_RGB, GL_UNSIGNED_BYTE, texture->data[0]);
+		//A chain from the texture cache is uploaded as is, its levels all live in data[0].
+		glTexParameterf(GL_TEXTURE_2D,GL_GENERATE_MIPMAP, texture->numMipmaps > 1 ? GL_FALSE : GL_TRUE);
+		
+		for (i=0; i < texture->numMipmaps; i++)
+		{
+			mipWidth = MAX(texture->width >> i, 1);
+			mipHeight = MAX(texture->height >> i, 1);
+			glTexImage2D(GL_TEXTURE_2D, i, texture->format, mipWidth, mipHeight, 0, texture->format, GL_UNSIGNED_BYTE, texture->data[i]);
+		}
 
 		free(texture->data[0]);
 		texture->data[0] = 0;
@@ -229,11 +248,16 @@ void UpLoadTextureToGPUF(texture_t* texture)
 		
 		glCompressedTexImage2D(GL_TEXTURE_2D, 0, texture->format, texture->width,texture-> height, 0, texture->dataLength[0], texture->data[0]);
 		//Log_Printf("Uploading mipmapp %d w=%d, h=%d, size=%d\n",0,texture->width,texture-> height,texture->dataLength[0]);
+		free(texture->data[0]);
+		texture->data[0] = 0;
 		
 		mipMapDiv = 2;
 		for (i=1; i < texture->numMipmaps; i++,mipMapDiv*=2) 
 		{
-			glCompressedTexImage2D(GL_TEXTURE_2D, i, texture->format, texture->width/mipMapDiv,texture-> height/mipMapDiv, 0, texture->dataLength[i], texture->data[i]);
+			//Non square chains go down to 1 on both sides.
+			mipWidth = MAX(texture->width/mipMapDiv, 1);
+			mipHeight = MAX(texture->height/mipMapDiv, 1);
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, texture->format, mipWidth, mipHeight, 0, texture->dataLength[i], texture->data[i]);
 		//	Log_Printf("Uploading mipmapp %d w=%d, h=%d, size=%d\n",i,texture->width/mipMapDiv,texture-> height/mipMapDiv,texture->dataLength[i]);
 			free(texture->data[i]);
 			texture->data[i] = 0;
@@ -489,9 +513,20 @@ static void RenderEntityF(entity_t* entity)
 	
 	glMultMatrixf(entity->matrix);
 	
-	glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, entity->material->shininess);
-	glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, entity->material->specularColor);
-	SetTextureF(entity->material->textures[TEXTURE_DIFFUSE].textureId);
+	if (entity->model->isCompact)
+	{
+		//Normalized shorts to model space.
+		glTranslatef(entity->model->dequantization[X], entity->model->dequantization[Y], entity->model->dequantization[Z]);
+		glScalef(entity->model->dequantization[W] / DE_SHRT_MAX, entity->model->dequantization[W] / DE_SHRT_MAX, entity->model->dequantization[W] / DE_SHRT_MAX);
+	}
+	
+	if (lastMaterial != entity->material)
+	{
+		glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, entity->material->shininess);
+		glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, entity->material->specularColor);
+		SetTextureF(entity->material->textures[TEXTURE_DIFFUSE].textureId);
+		lastMaterial = entity->material;
+	}
 	
 	//Disabling blending for now
 	/*
@@ -517,7 +552,15 @@ static void RenderEntityF(entity_t* entity)
 	*/
 	
 		
-	if (entity->model->memLocation == MD5_MEMLOC_VRAM)
+	if (entity->model->isCompact)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, entity->model->vboId);
+		
+		glVertexPointer  (3, GL_SHORT, sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, pos));
+		glNormalPointer  (   GL_BYTE,  sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, normal));
+		glTexCoordPointer(2, GL_SHORT, sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, text));
+	}
+	else if (entity->model->memLocation == MD5_MEMLOC_VRAM)
 	{
 
 		glBindBuffer(GL_ARRAY_BUFFER, entity->model->vboId);
@@ -577,6 +620,38 @@ static void RenderEntityF(entity_t* entity)
 
 
 
+//World space vertices from instancing.c, the modelview only holds the camera.
+static void RenderInstancesF(const inst_batch_t* batch)
+{
+	if (lastMaterial != batch->material)
+	{
+		glMaterialf(GL_FRONT_AND_BACK, GL_SHININESS, batch->material->shininess);
+		glMaterialfv(GL_FRONT_AND_BACK, GL_SPECULAR, batch->material->specularColor);
+		SetTextureF(batch->material->textures[TEXTURE_DIFFUSE].textureId);
+		lastMaterial = batch->material;
+	}
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glVertexPointer  (3, GL_FLOAT, sizeof(vertex_t), batch->vertices->pos);
+	glNormalPointer  (   GL_SHORT, sizeof(vertex_t), batch->vertices->normal);
+	glTexCoordPointer(2, GL_SHORT, sizeof(vertex_t), batch->vertices->text);
+	
+	//Per instance color, GL_MODULATE is set by the enemies pass.
+	glEnableClientState(GL_COLOR_ARRAY);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, batch->colors);
+	
+	if (batch->flags & RQ_FLAG_FLICKER)
+		glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD);
+	
+	glDrawElements (GL_TRIANGLES, batch->numIndices, GL_UNSIGNED_SHORT, batch->indices);
+	STATS_AddTriangles(batch->numIndices/3);
+	
+	if (batch->flags & RQ_FLAG_FLICKER)
+		glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	
+	glDisableClientState(GL_COLOR_ARRAY);
+}
+
 void SetTransparencyF(float alpha)
 {
 	glColor4f(1, 1, 1, alpha);
@@ -584,6 +659,31 @@ void SetTransparencyF(float alpha)
 }
 
 
+//Fixed state shared by all the items of a render queue pass.
+static void SetPassStateF(int pass, char fogEnabled)
+{
+	if (pass == RQ_PASS_BACKGROUND || !fogEnabled)
+		glDisable(GL_FOG);
+	else
+		glEnable(GL_FOG);
+	
+	//Map entities are not closed meshes.
+	if (pass == RQ_PASS_BACKGROUND || pass == RQ_PASS_MAP)
+		glDisable(GL_CULL_FACE);
+	else
+		glEnable(GL_CULL_FACE);
+	
+	if (pass == RQ_PASS_ENEMIES)
+	{
+		glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	}
+	else
+	{
+		glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+		glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+	}
+}
+
 void RenderEntitiesF(void)
 {
 	
@@ -593,6 +693,10 @@ void RenderEntitiesF(void)
 	int i;
 	entity_t* entity;
 	enemy_t* enemy;
+	const rq_item_t* item;
+	int numItems;
+	int pass;
+	char fogEnabled;
 	
 	//Log_Printf("Starting rendering frame, t=%d.\n",simulationTime);
 
@@ -613,25 +717,9 @@ void RenderEntitiesF(void)
 		SetupLightingF();
 
 	
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_FOG);
-	
-	//traceRenderEntity = 0;
-	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-	
-	for(i=0; i < numBackgroundEntities; i++)
-	{
-		entity = &map[i];
-		
-		if (entity->numIndices == 0)
-			continue;
-		
-		RenderEntityF(entity);
-	}
-	
-	if (engine.fogEnabled && (renderer.props & PROP_FOG) == PROP_FOG )
+	fogEnabled = engine.fogEnabled && (renderer.props & PROP_FOG) == PROP_FOG;
+	if (fogEnabled)
 	{
-		glEnable(GL_FOG);
 		glFogx(GL_FOG_MODE, GL_LINEAR);						// Fog Mode
 		glFogfv(GL_FOG_COLOR,renderer.fogColor);			// Set Fog Color
 		glFogf(GL_FOG_DENSITY, renderer.fogDensity);		// How Dense Will The Fog Be (not used if GL_FOG_MODE == GL_LINEAR )
@@ -640,47 +728,69 @@ void RenderEntitiesF(void)
 		glFogf(GL_FOG_END, renderer.fogStopAt);				// Fog End Depth
 	}
 	
+	//Collect everything, sort once by state and submit.
+	RQ_Begin();
 	
-	
-	for(i=numBackgroundEntities; i < num_map_entities; i++)
+	for(i=0; i < num_map_entities; i++)
 	{
 		entity = &map[i];
 		
 		if (entity->numIndices == 0)
 			continue;
 		
-		RenderEntityF(entity);
+		RQ_Push(entity, i < numBackgroundEntities ? RQ_PASS_BACKGROUND : RQ_PASS_MAP, RQ_FLAG_STATIC);
 	}
-	glEnable(GL_CULL_FACE);
 	
-	
-	
-	
-	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 	for (i=0 ; i < numPlayers; i++) 
 	{
 		//Log_Printf("player[%d].shouldDraw=%d\n",i,players[i].shouldDraw);
 		if (players[i].shouldDraw)
-			RenderEntityF(&players[i].entity);
+			RQ_Push(&players[i].entity, RQ_PASS_PLAYERS, 0);
 	}
 	
-	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	
-	//glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-	//traceRenderEntity=1;
 	enemy = ENE_GetFirstEnemy();
 	while (enemy != NULL) 
 	{
-		entity = &enemy->entity;
+		RQ_Push(&enemy->entity, RQ_PASS_ENEMIES, enemy->shouldFlicker ? RQ_FLAG_FLICKER : 0);
+		enemy->shouldFlicker = 0;
 		
+		enemy = enemy->next;
+	} 
+	
+	RQ_Sort();
+	
+	lastMaterial = NULL;
+	
+	INST_Begin();
+	
+	pass = -1;
+	item = RQ_GetItems(&numItems);
+	for (i=0; i < numItems; i++,item++)
+	{
+		if (RQ_GetPass(item->key) != pass)
+		{
+			//Instances collected so far belong to the previous pass state.
+			INST_Flush();
+			
+			pass = RQ_GetPass(item->key);
+			SetPassStateF(pass, fogEnabled);
+		}
 		
+		entity = item->entity;
 		
-		if (enemy->shouldFlicker)
+		if (pass != RQ_PASS_ENEMIES)
+		{
+			RenderEntityF(entity);
+		}
+		else if (INST_CanInstance(entity))
+		{
+			INST_Add(entity, item->flags & RQ_FLAG_FLICKER);
+		}
+		else if (item->flags & RQ_FLAG_FLICKER)
 		{
 			glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
 			glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_ADD);
 			RenderEntityF(entity);
-			enemy->shouldFlicker = 0;
 			glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 		}
 		else 
@@ -688,10 +798,11 @@ void RenderEntitiesF(void)
 			glColor4f(entity->color[R], entity->color[G], entity->color[B], entity->color[A]);
 			RenderEntityF(entity);
 		}
-
-		
-		enemy = enemy->next;
-	} 
+	}
+	INST_Flush();
+	
+	glEnable(GL_CULL_FACE);
+	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 	glColor4f(1, 1, 1, 1);
 }
 
@@ -711,6 +822,7 @@ void GetColorBufferF(uchar* data)
 void UpLoadEntityToGPUF(entity_t* entity)
 {
 	md5_mesh_t* mesh;
+	vertex_compact_t* compactVertices;
 
 	if (entity == NULL || entity->model == NULL)
 	{
@@ -726,13 +838,26 @@ void UpLoadEntityToGPUF(entity_t* entity)
 		
 	glGenBuffers(1, &mesh->vboId);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vboId);
-	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * sizeof(vertex_t), mesh->vertexArray, GL_STATIC_DRAW);
+	
+	//Map meshes are only read by the GPU. No tangent on the fixed pipeline: the normal is stored as is.
+	if ((renderer.props & PROP_COMPACT) && entity->usage == ENT_PARTIAL_DRAW && !mesh->keepVertices)
+	{
+		compactVertices = MD5_CompactVertices(mesh, MD5_NORMALS_XYZ);
+		glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * sizeof(vertex_compact_t), compactVertices, GL_STATIC_DRAW);
+		free(compactVertices);
+		mesh->isCompact = 1;
+	}
+	else
+		glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * sizeof(vertex_t), mesh->vertexArray, GL_STATIC_DRAW);
 	
     
 //#define GENERATE_VIDEO	
 #ifndef GENERATE_VIDEO	
-	free(mesh->vertexArray);
-	mesh->vertexArray = 0;
+	if (!mesh->keepVertices)
+	{
+		free(mesh->vertexArray);
+		mesh->vertexArray = 0;
+	}
 #else
 	Log_Printf("Warning, not freeing mesh after GPU upload.\n");
 #endif
@@ -743,152 +868,62 @@ void UpLoadEntityToGPUF(entity_t* entity)
 	
 }
 
-void RenderPlayersBulletsF(void)
-{
-	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);	
-	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-	
-	SetTextureF(bulletConfig.bulletTexture.textureId);
-	
-	//Player bullets
-	glVertexPointer(  2, GL_SHORT,  sizeof(xf_colorless_sprite_t), pBulletVertices->pos);
-	glTexCoordPointer(2, GL_SHORT,  sizeof(xf_colorless_sprite_t), pBulletVertices->text);			
-	glDrawElements (GL_TRIANGLES, numPBulletsIndices, GL_UNSIGNED_SHORT,bulletIndices);
-	STATS_AddTriangles(numPBulletsIndices/3);
-	
-	//Also render enemy bullets
-//	glColor4f(1, 1, 1, 1);
-	//glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);	
-	glVertexPointer(  2, GL_SHORT,  sizeof(xf_colorless_sprite_t), partLib.ss_vertices[0].pos);
-	glTexCoordPointer(2, GL_SHORT,  sizeof(xf_colorless_sprite_t), partLib.ss_vertices[0].text);			
-	glDrawElements (GL_TRIANGLES, partLib.num_indices, GL_UNSIGNED_SHORT,partLib.indices);
-	STATS_AddTriangles(partLib.num_indices/3);
-}
+static GLuint spriteVBOId;
+static GLuint spriteIndicesVBOId;
 
-void RenderFXSpritesF(void)
+static void RenderSpritesF(const xf_sprite_t* vertices, int numQuads, const ushort* quadIndices, const spr_batch_t* batches, int numBatches)
 {
-	int i,j;
+	int i;
+	int blend;
+	const spr_batch_t* batch;
 	
-	/*
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glColor4f(1.0f, 1.0f, 1.0f, 0.5f);
-	SetTextureF(smokeTexture.textureId);
-	if (numSmokeIndices != 0)
+	//The quad index pattern never changes: uploaded once.
+	if (spriteIndicesVBOId == 0)
 	{
-		glVertexPointer(  2, GL_SHORT,  sizeof(xf_colorless_sprite_t), smokeVertices->pos);
-		glTexCoordPointer(2, GL_SHORT,  sizeof(xf_colorless_sprite_t), smokeVertices->text);
-		//glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), smokeVertices->color);
-		glDrawElements (GL_TRIANGLES, numSmokeIndices, GL_UNSIGNED_SHORT,smokeIndices);
-		STATS_AddTriangles(numSmokeIndices/3);
+		glGenBuffers(1, &spriteIndicesVBOId);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spriteIndicesVBOId);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, SPR_MAX_QUADS * SPR_QUAD_INDICES * sizeof(ushort), quadIndices, GL_STATIC_DRAW);
+		
+		glGenBuffers(1, &spriteVBOId);
 	}
 	
-	glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-	 */
-	
-	
-	
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-	
-	SetTextureF(smokeTexture.textureId);
-	if (numSmokeIndices != 0)
-	{
-		glVertexPointer(  2, GL_SHORT,  sizeof(xf_colorless_sprite_t), smokeVertices->pos);
-		glTexCoordPointer(2, GL_SHORT,  sizeof(xf_colorless_sprite_t), smokeVertices->text);
-		//glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), smokeVertices->color);
-		glDrawElements (GL_TRIANGLES, numSmokeIndices, GL_UNSIGNED_SHORT,smokeIndices);
-		STATS_AddTriangles(numSmokeIndices/3);
-	}
+	//Vertices are streamed, the previous content is orphaned.
+	glBindBuffer(GL_ARRAY_BUFFER, spriteVBOId);
+	glBufferData(GL_ARRAY_BUFFER, numQuads * 4 * sizeof(xf_sprite_t), vertices, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spriteIndicesVBOId);
 	
+	glVertexPointer(  2, GL_SHORT,  sizeof(xf_sprite_t), (char *)NULL + offsetof(xf_sprite_t, pos));
+	glTexCoordPointer(2, GL_SHORT,  sizeof(xf_sprite_t), (char *)NULL + offsetof(xf_sprite_t, text));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), (char *)NULL + offsetof(xf_sprite_t, color));
 	
+	glEnableClientState(GL_COLOR_ARRAY);
+	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 	
-	SetTextureF(ghostTexture.textureId);
-	for(i=0 ; i <numPlayers ; i++)
+	blend = -1;
+	batch = batches;
+	for (i=0; i < numBatches; i++,batch++)
 	{
-		/*
-		if (i==0)
-			glColor4f(0.8f, 0.8f, 1.0f, 0.9f);
-		else {
-			glColor4f(1.0f, 0.4f, 0.4f, 0.9f);
-		}
-*/
+		SetTextureF(batch->textureId);
 		
-		
-		for (j=0; j< GHOSTS_NUM; j++) 
+		if (batch->blend != blend)
 		{
-			if (players[i].ghosts[j].timeCounter >= GHOST_TTL_MS)
-				continue;
-			
-			
-			//vertices = &players[i].ghosts[j].wayPoints[players[i].ghosts[j].startVertexArray];
-			glVertexPointer(  2, GL_SHORT,  sizeof(xf_colorless_sprite_t), players[i].ghosts[j].wayPoints[players[i].ghosts[j].startVertexArray].pos);
-			glTexCoordPointer(2, GL_SHORT,  sizeof(xf_colorless_sprite_t), players[i].ghosts[j].wayPoints[players[i].ghosts[j].startVertexArray].text);
-			//glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), vertices->color);
-			glDrawArrays(GL_TRIANGLE_STRIP, 0, players[i].ghosts[j].lengthVertexArray);
-			STATS_AddTriangles((players[i].ghosts[j].lengthVertexArray/2));
+			blend = batch->blend;
+			if (blend == SPR_BLEND_ADD)
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+			else
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			STATS_AddBlendingSwitch();
 		}
-	}
-
-	
-	
-
-	glEnableClientState(GL_COLOR_ARRAY);
-	
-	glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
-	
-	//Render all particules
-	if (numParticulesIndices != 0)
-	{
 		
-		SetTextureF(bulletConfig.bulletTexture.textureId);
-		glVertexPointer(  2, GL_SHORT,  sizeof(xf_sprite_t), particuleVertices->pos);
-		glTexCoordPointer(2, GL_SHORT,  sizeof(xf_sprite_t), particuleVertices->text);
-		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), particuleVertices->color);
-		glDrawElements (GL_TRIANGLES, numParticulesIndices, GL_UNSIGNED_SHORT,particuleIndices);
-		STATS_AddTriangles(numParticulesIndices/3);
+		glDrawElements (GL_TRIANGLES, batch->numQuads * SPR_QUAD_INDICES, GL_UNSIGNED_SHORT, (char *)NULL + batch->firstQuad * SPR_QUAD_INDICES * sizeof(ushort));
+		STATS_AddTriangles(batch->numQuads * 2);
 	}
 	
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	
-	
-	
-	
-	//Render all explosions 
-	if (numExplosionIndices != 0)
-	{
-		SetTextureF(explosionTexture.textureId);
-		glVertexPointer(  2, GL_SHORT,  sizeof(xf_sprite_t), explosionVertices->pos);
-		glTexCoordPointer(2, GL_SHORT,  sizeof(xf_sprite_t), explosionVertices->text);
-		//Log_Printf("REMOVE COLOR INDICES EXPLOSIONS RenderFXSpritesF !!!! \n");
-		glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), explosionVertices->color);
-		glDrawElements (GL_TRIANGLES, numExplosionIndices, GL_UNSIGNED_SHORT,explosionIndices);
-		STATS_AddTriangles(numExplosionIndices/3);
-	}
-	
-	
-	//Render enemy FXs
-	SetTextureF(bulletConfig.bulletTexture.textureId);
-	glVertexPointer(  2, GL_SHORT,  sizeof(xf_sprite_t), enFxLib.ss_vertices[0].pos);
-	glTexCoordPointer(2, GL_SHORT,  sizeof(xf_sprite_t), enFxLib.ss_vertices[0].text);
-	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(xf_sprite_t), enFxLib.ss_vertices[0].color);
-	glDrawElements (GL_TRIANGLES, enFxLib.num_indices, GL_UNSIGNED_SHORT,enFxLib.indices);
-	STATS_AddTriangles(enFxLib.num_indices/3);
-	//Log_Printf("enFxLib.num_indices=%d\n",enFxLib.num_indices);
-	
-	
-	
-#ifdef RENDER_COLL_BOXEX	
-	RenderCollisionBoxes();
-#endif
-	
-	//glTexEnvf( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-	
-	
-	
 	glDisableClientState(GL_COLOR_ARRAY);
-
-	
 	
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void DrawControlsF(void)
@@ -1023,6 +1058,7 @@ void initFixedRenderer(renderer_t* renderer)
 	
 	//renderer->supportBumpMapping = 0;
 	renderer->props = 0;
+	renderer->props |= PROP_COMPACT;
 	
 	
 	
@@ -1033,11 +1069,11 @@ void initFixedRenderer(renderer_t* renderer)
 	renderer->UpLoadTextureToGpu = UpLoadTextureToGPUF;
 	renderer->UpLoadEntityToGPU = UpLoadEntityToGPUF;
 	renderer->Set2D = Set2DF;
-	renderer->RenderPlayersBullets = RenderPlayersBulletsF ;
 	renderer->RenderString = RenderStringF;
 	renderer->GetColorBuffer = GetColorBufferF;
 	
-	renderer->RenderFXSprites = RenderFXSpritesF;
+	renderer->RenderSprites = RenderSpritesF;
+	renderer->RenderInstances = RenderInstancesF;
 	renderer->DrawControls = DrawControlsF;
 	
 	renderer->FreeGPUTexture = FreeGPUTextureF;
@@ -1086,6 +1122,12 @@ void initFixedRenderer(renderer_t* renderer)
     extensionsList = (char *) glGetString(GL_EXTENSIONS);
     if (strstr(extensionsList,"GL_IMG_texture_compression_pvrtc"))
         supportedCompressionFormatF |= TEXTURE_FORMAT_PVRTC ;
+    if (strstr(extensionsList,"GL_OES_compressed_ETC1_RGB8_texture"))
+        supportedCompressionFormatF |= TEXTURE_FORMAT_ETC1 ;
+    if (strstr(extensionsList,"GL_AMD_compressed_ATC_texture") || strstr(extensionsList,"GL_ATI_texture_compression_atitc"))
+        supportedCompressionFormatF |= TEXTURE_FORMAT_ATITC ;
+    if (strstr(extensionsList,"GL_EXT_texture_compression_s3tc"))
+        supportedCompressionFormatF |= TEXTURE_FORMAT_S3TC ;
         
         
     
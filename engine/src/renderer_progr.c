@@ -25,6 +25,7 @@
 
 
 #include "renderer_progr.h"
+#include <stddef.h>
 
 #include "target.h"
 #if defined (SHMUP_TARGET_WINDOWS) || defined (SHMUP_TARGET_MACOSX) || defined (SHMUP_TARGET_LINUX)
@@ -40,6 +41,7 @@ void initProgrRenderer(renderer_t* renderer){ Log_Printf("Shader renderer is not
 #include "config.h"
 #include "player.h"
 #include "enemy.h"
+#include "renderqueue.h"
 
 #if defined(__EMSCRIPTEN__)
     #include <GLES2/gl2.h>
@@ -56,6 +58,7 @@ void initProgrRenderer(renderer_t* renderer){ Log_Printf("Shader renderer is not
 matrix_t projectionMatrix;
 matrix_t modelViewMatrix;
 matrix_t modelViewProjectionMatrix;
+matrix_t viewProjectionMatrix;		//projection * view, once per frame in SetupCamera.
 
 
 typedef struct simple_shader_t {
@@ -69,12 +72,18 @@ int lastId;
 int lastBumpId;
 int lastSpecId;
 
+//Uniforms and attribute pointers belong to the current program: reset on every shader switch.
+static material_t* lastMaterial;
+static md5_mesh_t* lastMesh;
+static int lastFlicker;
+
 
 shader_prog_t shaders[8];
 #define UNIFIED_LIGHT_SHADER 0
 #define STRING_RENDER_SHADER 1
 #define UNIFIED_LIGHT_SHADOW_SHADER 2
 #define SHADOW_GENERATOR_SHADER 3
+#define SPRITE_RENDER_SHADER 4
 
 #define SHADER_MVT_MATRIX 0
 #define SHADER_ATT_VERTEX 1
@@ -95,6 +104,9 @@ shader_prog_t shaders[8];
 
 #define SHADER_TEXT_SPEC_SAMPLER 16
 #define SHADER_UNI_MAT_COL_SPECULAR 17
+#define SHADER_UNI_DEQUANTIZATION 18
+#define SHADER_ATT_COLOR 19
+#define SHADER_UNI_FLICKER 20
 
 #define NUM_UBERSHADERS 256
 shader_prog_t* ubershaders[NUM_UBERSHADERS];
@@ -105,7 +117,7 @@ char ubserShaderDefines[8][64] =
 	"#define BUMP_MAPPING\n",
 	"#define SPEC_MAPPING\n",
 	"#define DIFF_MAPPING\n",
-	"\n",
+	"#define COMPACT_VERTEX\n",
 	"\n",
 	"\n",
 	"#define FOG",
@@ -117,7 +129,7 @@ char ubserShaderUndefines[8][64] =
 	"#undef BUMP_MAPPING\n",
 	"#undef SPEC_MAPPING\n",
 	"#undef DIFF_MAPPING\n",
-	"\n",
+	"#undef COMPACT_VERTEX\n",
 	"\n",
 	"\n",
 	"#undef FOG",
@@ -133,6 +145,25 @@ GLuint shadowMapTextureId;
 
 float shadowMapRation = 1.0f;
 
+/*
+	The shadow map only depends on the light and the map entities, which are
+	static: it is rendered again only when lightVersion changes. A moving
+	light can be refreshed every renderer.shadowUpdatePeriod frames (config.cfg),
+	the casters being spread over those frames in a back map.
+*/
+
+static GLuint shadowBackFBOId;
+static GLuint shadowBackMapTextureId;
+
+static char shadowMapValid;
+static uint shadowMapLightVersion;		//lightVersion the front map was rendered with.
+static uint shadowPendingLightVersion;
+static int shadowSlice;					//Next slice of casters to render, -1 when the map is up to date.
+
+static matrix_t shadowViewProjectionMatrix;
+static entity_t* shadowCasters[MAX_NUM_ENTITIES];
+static int numShadowCasters;
+
 int SRC_UseShader(shader_prog_t* shader)
 {
 		
@@ -142,8 +173,8 @@ int SRC_UseShader(shader_prog_t* shader)
 		Log_Printf("Shader was null: WTF !\n");
 	}
 	
-	//if (shader == currentShader)
-	//	return 0;
+	if (shader == currentShader)
+		return 0;
 		
 	
 	STATS_AddShaderSwitch();
@@ -154,6 +185,9 @@ int SRC_UseShader(shader_prog_t* shader)
 	lastId = -1;
 	lastBumpId = -1;
 	lastSpecId = -1;
+	lastMaterial = NULL;
+	lastMesh = NULL;
+	lastFlicker = -1;
 	
 	return 1;
 }
@@ -161,26 +195,26 @@ int SRC_UseShader(shader_prog_t* shader)
 
 
 
-void CreateFBOandShadowMap()
+static void CreateShadowTarget(GLuint* fboId, GLuint* textureId)
 {
 	GLenum status;
 	GLuint   depthRenderbuffer; 
 	
 	
-	glGenFramebuffers(1, &shadowFBOId);
-	glBindFramebuffer(GL_FRAMEBUFFER,shadowFBOId);
+	glGenFramebuffers(1, fboId);
+	glBindFramebuffer(GL_FRAMEBUFFER,*fboId);
 	
 	
 	
-	glGenTextures(1, &shadowMapTextureId);
-	glBindTexture(GL_TEXTURE_2D, shadowMapTextureId);
+	glGenTextures(1, textureId);
+	glBindTexture(GL_TEXTURE_2D, *textureId);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); 
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE); 
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	//glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB565, renderWidth*shadowMapRation, renderHeight*shadowMapRation, 0, GL_RGB565, GL_UNSIGNED_SHORT_5_6_5, NULL);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, renderer.glBuffersDimensions[WIDTH]*shadowMapRation, renderer.glBuffersDimensions[HEIGHT]*shadowMapRation, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D, shadowMapTextureId,0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,GL_TEXTURE_2D, *textureId,0);
 	glBindTexture(GL_TEXTURE_2D, -1);
 	
 	glGenRenderbuffers(1, &depthRenderbuffer);
@@ -208,6 +242,18 @@ void CreateFBOandShadowMap()
 	//glBindFramebuffer(GL_FRAMEBUFFER,0);
 }
 
+void CreateFBOandShadowMap()
+{
+	CreateShadowTarget(&shadowFBOId, &shadowMapTextureId);
+	
+	//Amortized updates render into a second map, swapped when complete.
+	if (renderer.shadowUpdatePeriod > 1)
+		CreateShadowTarget(&shadowBackFBOId, &shadowBackMapTextureId);
+	
+	shadowMapValid = 0;
+	shadowSlice = -1;
+}
+
 
 GLuint LoadShader(const char *shaderSrcPath, GLenum type, uchar props) 
 { 
@@ -395,6 +441,8 @@ void SRC_BindUberShader(uchar props)
 		currentShader->vars[SHADER_UNI_MATERIAL_SHININESS]	= glGetUniformLocation(currentShader->prog,"materialShininess");
 		currentShader->vars[SHADER_TEXT_SPEC_SAMPLER]		= glGetUniformLocation(currentShader->prog,"s_specularMap");
 		currentShader->vars[SHADER_UNI_MAT_COL_SPECULAR]	= glGetUniformLocation(currentShader->prog,"matColorSpecular");
+		currentShader->vars[SHADER_UNI_DEQUANTIZATION]		= glGetUniformLocation(currentShader->prog,"dequantization");
+		currentShader->vars[SHADER_UNI_FLICKER]				= glGetUniformLocation(currentShader->prog,"flicker");
 		SCR_CheckErrorsF("Ubershader attribute binded.", "no details");
 	}
 	
@@ -435,6 +483,13 @@ void LoadAllShaders(void)
 	shaders[STRING_RENDER_SHADER].vars[SHADER_TEXT_COLOR_SAMPLER] = glGetUniformLocation(shaders[STRING_RENDER_SHADER].prog,"s_baseMap");
 	shaders[STRING_RENDER_SHADER].vars[SHADER_MVT_MATRIX] = glGetUniformLocation(shaders[STRING_RENDER_SHADER].prog,"modelViewProjectionMatrix");
 	
+	LoadProgram(&shaders[SPRITE_RENDER_SHADER], "data/shaders/v_sprite.glsl", "data/shaders/f_sprite.glsl", PROP_NULL);	
+	shaders[SPRITE_RENDER_SHADER].vars[SHADER_ATT_VERTEX] = glGetAttribLocation(shaders[SPRITE_RENDER_SHADER].prog,"a_vertex");
+	shaders[SPRITE_RENDER_SHADER].vars[SHADER_ATT_UV] = glGetAttribLocation(shaders[SPRITE_RENDER_SHADER].prog,"a_texcoord0");
+	shaders[SPRITE_RENDER_SHADER].vars[SHADER_ATT_COLOR] = glGetAttribLocation(shaders[SPRITE_RENDER_SHADER].prog,"a_color");
+	shaders[SPRITE_RENDER_SHADER].vars[SHADER_TEXT_COLOR_SAMPLER] = glGetUniformLocation(shaders[SPRITE_RENDER_SHADER].prog,"s_baseMap");
+	shaders[SPRITE_RENDER_SHADER].vars[SHADER_MVT_MATRIX] = glGetUniformLocation(shaders[SPRITE_RENDER_SHADER].prog,"modelViewProjectionMatrix");
+	
 	LoadProgram(&shaders[SHADOW_GENERATOR_SHADER], "data/shaders/v_shadowMapGenerator.glsl", "data/shaders/f_shadowMapGenerator.glsl",PROP_NULL) ;	
 	shaders[SHADOW_GENERATOR_SHADER].vars[SHADER_ATT_VERTEX] = glGetAttribLocation(shaders[SHADOW_GENERATOR_SHADER].prog,"a_vertex");
 	shaders[SHADOW_GENERATOR_SHADER].vars[SHADER_MVT_MATRIX]= glGetUniformLocation(shaders[SHADOW_GENERATOR_SHADER].prog,"modelViewProjectionMatrix");
@@ -469,6 +524,7 @@ void StopRendition(void)
 void UpLoadTextureToGPU(texture_t* texture)
 {
 	int i,mipMapDiv;
+	int mipWidth,mipHeight;
 	
 	if (!texture || !texture->data || texture->textureId != 0)
 		return;
@@ -482,14 +538,19 @@ void UpLoadTextureToGPU(texture_t* texture)
 	if (texture->format == TEXTURE_GL_RGB ||texture->format == TEXTURE_GL_RGBA)
 	{
 		//glTexParameterf(GL_TEXTURE_2D, GL_GENERATE_MIPMAP, GL_TRUE);
-		Log_Printf("Warning mipmap for %s were not generated due to no GL_GENERATE_MIPMAP support.\n",texture->path);
+		//Only the texture cache provides the mip levels, they all live in data[0].
+		if (texture->numMipmaps == 1)
+			Log_Printf("Warning mipmap for %s were not generated due to no GL_GENERATE_MIPMAP support.\n",texture->path);
+		
+		//Decoded rows are packed, RGB rows and levels are not 4 bytes aligned.
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
         
-        if(texture->format == TEXTURE_GL_RGBA)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture->width, texture->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture->data[0]);
-        }
-        else
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texture->width, texture->height, 0, GL_RGB, GL_UNSIGNED_BYTE, texture->data[0]);
+		for (i=0; i < texture->numMipmaps; i++)
+		{
+			mipWidth = MAX(texture->width >> i, 1);
+			mipHeight = MAX(texture->height >> i, 1);
+			glTexImage2D(GL_TEXTURE_2D, i, texture->format, mipWidth, mipHeight, 0, texture->format, GL_UNSIGNED_BYTE, texture->data[i]);
+		}
         
 		free(texture->data[0]);
 		texture->data[0] = 0;
@@ -497,10 +558,15 @@ void UpLoadTextureToGPU(texture_t* texture)
 	else
 	{
 		glCompressedTexImage2D(GL_TEXTURE_2D, 0, texture->format, texture->width,texture-> height, 0, texture->dataLength[0], texture->data[0]);
+		free(texture->data[0]);
+		
 		mipMapDiv = 2;
 		for (i=1; i < texture->numMipmaps; i++,mipMapDiv*=2) 
 		{
-			glCompressedTexImage2D(GL_TEXTURE_2D, i, texture->format, texture->width/mipMapDiv,texture-> height/mipMapDiv, 0, texture->dataLength[i], texture->data[i]);
+			//Non square chains go down to 1 on both sides.
+			mipWidth = MAX(texture->width/mipMapDiv, 1);
+			mipHeight = MAX(texture->height/mipMapDiv, 1);
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, texture->format, mipWidth, mipHeight, 0, texture->dataLength[i], texture->data[i]);
 			free(texture->data[i]);
 		}
 		
@@ -596,7 +662,20 @@ void SetTexture(unsigned int textureId)
 void SetupMD5forRendition(md5_mesh_t* mesh)
 {
 
-	if (!renderer.isRenderingShadow)
+	if (mesh->isCompact)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, mesh->vboId);
+		
+		glVertexAttribPointer(currentShader->vars[SHADER_ATT_VERTEX], 3, GL_SHORT, GL_TRUE, sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, pos));
+		
+		if (!renderer.isRenderingShadow)
+		{
+			glVertexAttribPointer(currentShader->vars[SHADER_ATT_NORMAL],  2, GL_BYTE,  GL_TRUE, sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, normal));
+			glVertexAttribPointer(currentShader->vars[SHADER_ATT_UV],      2, GL_SHORT, GL_TRUE, sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, text));
+			glVertexAttribPointer(currentShader->vars[SHADER_ATT_TANGENT], 2, GL_BYTE,  GL_TRUE, sizeof(vertex_compact_t), (char *)NULL + offsetof(vertex_compact_t, normal) + 2);
+		}
+	}
+	else if (!renderer.isRenderingShadow)
 	{
 		if (mesh->memLocation == MD5_MEMLOC_VRAM)
 		{
@@ -626,7 +705,10 @@ void SetupMD5forRendition(md5_mesh_t* mesh)
 	else 
 	{
 		if (mesh->memLocation == MD5_MEMLOC_VRAM)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, mesh->vboId);
 			glVertexAttribPointer(currentShader->vars[SHADER_ATT_VERTEX], 3, GL_FLOAT, GL_FALSE,  sizeof(vertex_t), 0);
+		}
 		else
 			glVertexAttribPointer(currentShader->vars[SHADER_ATT_VERTEX], 3, GL_FLOAT, GL_FALSE,  sizeof(vertex_t), mesh->vertexArray->pos);
 	}
@@ -657,28 +739,70 @@ void ComputeInvModelMatrix(matrix_t matrix, matrix_t dest)
 }
 
 
-matrix_t tmp;
 matrix_t inv_modelMatrix;
 vec4_t modelSpaceLightPos;
 vec4_t modelSpaceCameraPos;
 
-static void RenderEntity(entity_t* entity)
+//A hit enemy is drawn white, like the additive texture environment of the fixed pipeline.
+static void SetFlicker(uchar flags)
 {
-
+	int flicker;
+	
+	flicker = (flags & RQ_FLAG_FLICKER) != 0;
+	if (flicker == lastFlicker)
+		return;
 	
-	SRC_BindUberShader(entity->material->prop);
+	glUniform1f(currentShader->vars[SHADER_UNI_FLICKER], flicker);
+	lastFlicker = flicker;
+}
+
+static void RenderEntity(entity_t* entity, uchar flags)
+{
+	entity_render_cache_t* cache;
+	float* invModelMatrix;
+	float* lightPos;
 	
+	SRC_BindUberShader(entity->material->prop | (entity->model->isCompact ? PROP_COMPACT : 0));
+	SetFlicker(flags);
 	
-	matrix_multiply(modelViewMatrix,entity->matrix, tmp);
-	matrix_multiply(projectionMatrix,tmp, modelViewProjectionMatrix);
+	matrix_multiply(viewProjectionMatrix,entity->matrix, modelViewProjectionMatrix);
 	glUniformMatrix4fv(currentShader->vars[SHADER_MVT_MATRIX]   ,1,GL_FALSE,modelViewProjectionMatrix);
 	
-	ComputeInvModelMatrix(entity->matrix, inv_modelMatrix);
+	if (entity->model->isCompact)
+		glUniform4fv(currentShader->vars[SHADER_UNI_DEQUANTIZATION],1,entity->model->dequantization);
+	
+	if (flags & RQ_FLAG_STATIC)
+	{
+		cache = &entity->renderCache;
+		
+		if (!cache->valid)
+		{
+			ComputeInvModelMatrix(entity->matrix, cache->invModelMatrix);
+			cache->lightVersion = lightVersion - 1;
+			cache->valid = 1;
+		}
+		
+		if (cache->lightVersion != lightVersion)
+		{
+			matrix_transform_vec4t(cache->invModelMatrix, light.position, cache->modelSpaceLightPos);
+			cache->lightVersion = lightVersion;
+		}
+		
+		invModelMatrix = cache->invModelMatrix;
+		lightPos = cache->modelSpaceLightPos;
+	}
+	else
+	{
+		ComputeInvModelMatrix(entity->matrix, inv_modelMatrix);
+		matrix_transform_vec4t(inv_modelMatrix, light.position, modelSpaceLightPos);
+		
+		invModelMatrix = inv_modelMatrix;
+		lightPos = modelSpaceLightPos;
+	}
 	
-	matrix_transform_vec4t(inv_modelMatrix, light.position, modelSpaceLightPos);
-	glUniform3fv(currentShader->vars[SHADER_UNI_LIGHT_POS],1,modelSpaceLightPos);
+	glUniform3fv(currentShader->vars[SHADER_UNI_LIGHT_POS],1,lightPos);
 	
-	matrix_transform_vec4t(inv_modelMatrix, camera.position, modelSpaceCameraPos);
+	matrix_transform_vec4t(invModelMatrix, camera.position, modelSpaceCameraPos);
 	glUniform3fv(currentShader->vars[SHADER_UNI_CAMERA_POS],1,modelSpaceCameraPos);
 	
 	
@@ -686,10 +810,13 @@ static void RenderEntity(entity_t* entity)
 	if ((renderer.props & PROP_SHADOW) == PROP_SHADOW)
 		glUniformMatrix4fv(currentShader->vars[SHADER_LIGHTPOV_MVT_MATRIX]   ,1,GL_FALSE,entity->cachePVMShadow);
 	
-	glUniform1f(currentShader->vars[SHADER_UNI_MATERIAL_SHININESS], entity->material->shininess);
-	glUniform3fv(currentShader->vars[SHADER_UNI_MAT_COL_SPECULAR],1,entity->material->specularColor);
-	
-	SetTextures(entity->material);
+	if (lastMaterial != entity->material)
+	{
+		glUniform1f(currentShader->vars[SHADER_UNI_MATERIAL_SHININESS], entity->material->shininess);
+		glUniform3fv(currentShader->vars[SHADER_UNI_MAT_COL_SPECULAR],1,entity->material->specularColor);
+		SetTextures(entity->material);
+		lastMaterial = entity->material;
+	}
 	
 	if (entity->material->hasAlpha )
 	{
@@ -713,7 +840,11 @@ static void RenderEntity(entity_t* entity)
 	
 	
 	
-	SetupMD5forRendition(entity->model);
+	if (lastMesh != entity->model)
+	{
+		SetupMD5forRendition(entity->model);
+		lastMesh = entity->model;
+	}
 	
 	if (entity->usage == ENT_PARTIAL_DRAW)
 	{
@@ -732,6 +863,46 @@ static void RenderEntity(entity_t* entity)
 	
 }
 
+//World space vertices from instancing.c: light and camera need no model space conversion.
+static void RenderInstances(const inst_batch_t* batch)
+{
+	SRC_BindUberShader(batch->material->prop);
+	SetFlicker(batch->flags);
+	
+	glUniformMatrix4fv(currentShader->vars[SHADER_MVT_MATRIX]   ,1,GL_FALSE,viewProjectionMatrix);
+	glUniform3fv(currentShader->vars[SHADER_UNI_LIGHT_POS],1,light.position);
+	glUniform3fv(currentShader->vars[SHADER_UNI_CAMERA_POS],1,camera.position);
+	
+	if ((renderer.props & PROP_SHADOW) == PROP_SHADOW)
+		glUniformMatrix4fv(currentShader->vars[SHADER_LIGHTPOV_MVT_MATRIX]   ,1,GL_FALSE,shadowViewProjectionMatrix);
+	
+	if (lastMaterial != batch->material)
+	{
+		glUniform1f(currentShader->vars[SHADER_UNI_MATERIAL_SHININESS], batch->material->shininess);
+		glUniform3fv(currentShader->vars[SHADER_UNI_MAT_COL_SPECULAR],1,batch->material->specularColor);
+		SetTextures(batch->material);
+		lastMaterial = batch->material;
+	}
+	
+	//Only opaque entities are instanced.
+	if (renderer.isBlending)
+	{
+		renderer.isBlending = 0;
+		glDisable(GL_BLEND);
+		STATS_AddBlendingSwitch();
+	}
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_VERTEX],  3, GL_FLOAT, GL_FALSE, sizeof(vertex_t), batch->vertices->pos);
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_NORMAL],  3, GL_SHORT, GL_TRUE,  sizeof(vertex_t), batch->vertices->normal);
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_UV],      2, GL_SHORT, GL_TRUE,  sizeof(vertex_t), batch->vertices->text);
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_TANGENT], 3, GL_SHORT, GL_TRUE,  sizeof(vertex_t), batch->vertices->tangent);
+	lastMesh = NULL;
+	
+	glDrawElements (GL_TRIANGLES, batch->numIndices, GL_UNSIGNED_SHORT, batch->indices);
+	STATS_AddTriangles(batch->numIndices/3);
+}
+
 void SetupCamera(void)
 {
 	vec3_t vLookat;
@@ -742,108 +913,222 @@ void SetupCamera(void)
 	
 	gluPerspective(camera.fov, camera.aspect,camera.zNear, camera.zFar, projectionMatrix);
 	
+	matrix_multiply(projectionMatrix, modelViewMatrix, viewProjectionMatrix);
 }
 
 
 
 
-void RenderEntities(void)
+// Map entities seen from the light, they can differ from the ones seen by the camera.
+static void CollectShadowCasters(void)
 {
-	int i;
+	matrix_t lightProjectionMatrix;
+	matrix_t lightViewMatrix;
+	frustrum_t lightFrustrum;
 	entity_t* entity;
-	enemy_t* enemy;
-	
-	
+	int i;
 	
-	renderer.isRenderingShadow = ((renderer.props & PROP_SHADOW) == PROP_SHADOW) ;
+	gluPerspective(light.fov, camera.aspect,camera.zNear, camera.zFar, lightProjectionMatrix);
+	gluLookAt(light.position, light.lookAt, light.upVector, lightViewMatrix);
+	matrix_multiply(lightProjectionMatrix, lightViewMatrix, shadowViewProjectionMatrix);
 	
+	COLL_GenerateFrustrum(shadowViewProjectionMatrix, lightFrustrum);
 	
-	if (renderer.isRenderingShadow)
+	numShadowCasters = 0;
+	entity = map;
+	for(i=0; i < num_map_entities; i++,entity++)
 	{
-		glCullFace(GL_FRONT);
-		glBindFramebuffer(GL_FRAMEBUFFER,shadowFBOId);
-		glClearColor(1.0,1.0,1.0,1.0);
-		
-		glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glClearColor(0.0,0.0,0.0,1.0);
+		if (COLL_CheckBoxAgainstFrustrum(entity->worldSpacebbox, lightFrustrum) == INT_OUT)
+			continue;
 		
-		SRC_UseShader(&shaders[SHADOW_GENERATOR_SHADER]);
-		glEnableVertexAttribArray(currentShader->vars[SHADER_ATT_VERTEX] );
-		glViewport(0, 0, renderer.glBuffersDimensions[WIDTH]*shadowMapRation, renderer.glBuffersDimensions[HEIGHT]*shadowMapRation);
+		shadowCasters[numShadowCasters++] = entity;
+	}
+}
+
+static void RenderShadowCasters(int first, int last)
+{
+	entity_t* entity;
+	matrix_t lightPVMMatrix;
+	matrix_t dequantizationMatrix;
+	float* dequantization;
+	int i;
+	
+	for(i=first; i < last; i++)
+	{
+		entity = shadowCasters[i];
 		
-		//Setup perspective and camera
-		gluPerspective(light.fov, camera.aspect,camera.zNear, camera.zFar, projectionMatrix);
-		gluLookAt(light.position, light.lookAt, light.upVector, modelViewMatrix);
-	
-		entity = map;
-		for(i=0; i < num_map_entities; i++,entity++)
-		{		
-			if (entity->numIndices == 0)
-				continue;
-			
-			matrix_multiply(modelViewMatrix,entity->matrix, tmp);
-			matrix_multiply(projectionMatrix,tmp, modelViewProjectionMatrix);
-			glUniformMatrix4fv(currentShader->vars[SHADER_MVT_MATRIX]   ,1,GL_FALSE,modelViewProjectionMatrix);
-			
-			SetupMD5forRendition(entity->model);
-			
-			glDrawElements (GL_TRIANGLES, entity->numIndices, GL_UNSIGNED_SHORT, entity->indices);
-			if (!renderer.isRenderingShadow)
-				STATS_AddTriangles(entity->numIndices/3);
+		if (entity->model->isCompact)
+		{
+			//Normalized shorts to model space, a uniform scale and a translation folded in the matrix.
+			dequantization = entity->model->dequantization;
+			matrixLoadIdentity(dequantizationMatrix);
+			dequantizationMatrix[0] = dequantizationMatrix[5] = dequantizationMatrix[10] = dequantization[W];
+			dequantizationMatrix[12] = dequantization[X];
+			dequantizationMatrix[13] = dequantization[Y];
+			dequantizationMatrix[14] = dequantization[Z];
 			
-			//Also need to cache the PVM matrix in entity
-			matrixCopy(modelViewProjectionMatrix,entity->cachePVMShadow);
+			matrix_multiply(shadowViewProjectionMatrix,entity->matrix, lightPVMMatrix);
+			matrix_multiply(lightPVMMatrix,dequantizationMatrix, modelViewProjectionMatrix);
 		}
+		else
+			matrix_multiply(shadowViewProjectionMatrix,entity->matrix, modelViewProjectionMatrix);
+		glUniformMatrix4fv(currentShader->vars[SHADER_MVT_MATRIX]   ,1,GL_FALSE,modelViewProjectionMatrix);
 		
-		//NOTE: Not rendering player because shadow will never be used in action phases
-		
-		glViewport(renderer.viewPortDimensions[VP_X],
-				   renderer.viewPortDimensions[VP_Y],
-				   renderer.viewPortDimensions[VP_WIDTH],
-				   renderer.viewPortDimensions[VP_HEIGHT]);
-		
-		glCullFace(GL_BACK);
+		SetupMD5forRendition(entity->model);
 		
-		renderer.isRenderingShadow = 0;
+		//Whole mesh: entity->indices only holds what the camera sees.
+		glDrawElements (GL_TRIANGLES, entity->model->numIndices, GL_UNSIGNED_SHORT, entity->model->indices);
+	}
+}
+
+static void UpdateShadowMap(void)
+{
+	int period;
+	GLuint swap;
+	entity_t* entity;
+	int i;
+	
+	if (shadowSlice == -1)
+	{
+		if (shadowMapValid && shadowMapLightVersion == lightVersion)
+			return;
 		
-		glBindFramebuffer(GL_FRAMEBUFFER,renderer.mainFramebufferId);
+		CollectShadowCasters();
+		shadowPendingLightVersion = lightVersion;
+		shadowSlice = 0;
+	}
+	
+	period = shadowBackFBOId ? renderer.shadowUpdatePeriod : 1;
+	
+	renderer.isRenderingShadow = 1;
+	
+	glCullFace(GL_FRONT);
+	glBindFramebuffer(GL_FRAMEBUFFER, period > 1 ? shadowBackFBOId : shadowFBOId);
+	
+	if (shadowSlice == 0)
+	{
+		glClearColor(1.0,1.0,1.0,1.0);
+		glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glClearColor(0.0,0.0,0.0,1.0);
+	}
+	
+	SRC_UseShader(&shaders[SHADOW_GENERATOR_SHADER]);
+	glEnableVertexAttribArray(currentShader->vars[SHADER_ATT_VERTEX] );
+	glViewport(0, 0, renderer.glBuffersDimensions[WIDTH]*shadowMapRation, renderer.glBuffersDimensions[HEIGHT]*shadowMapRation);
+	
+	RenderShadowCasters(numShadowCasters * shadowSlice / period, numShadowCasters * (shadowSlice+1) / period);
+	
+	//NOTE: Not rendering player because shadow will never be used in action phases
+	
+	glViewport(renderer.viewPortDimensions[VP_X],
+			   renderer.viewPortDimensions[VP_Y],
+			   renderer.viewPortDimensions[VP_WIDTH],
+			   renderer.viewPortDimensions[VP_HEIGHT]);
+	
+	glCullFace(GL_BACK);
+	
+	renderer.isRenderingShadow = 0;
+	
+	glBindFramebuffer(GL_FRAMEBUFFER,renderer.mainFramebufferId);
+	
+	shadowSlice++;
+	if (shadowSlice < period)
+		return;
+	
+	//The new map is complete.
+	if (period > 1)
+	{
+		swap = shadowFBOId;				shadowFBOId = shadowBackFBOId;						shadowBackFBOId = swap;
+		swap = shadowMapTextureId;		shadowMapTextureId = shadowBackMapTextureId;		shadowBackMapTextureId = swap;
 	}
 	
+	//Receivers project themselves in the light with the matrix the map was rendered with.
+	entity = map;
+	for(i=0; i < num_map_entities; i++,entity++)
+		matrix_multiply(shadowViewProjectionMatrix, entity->matrix, entity->cachePVMShadow);
+	
+	shadowMapLightVersion = shadowPendingLightVersion;
+	shadowMapValid = 1;
+	shadowSlice = -1;
+}
+
+
+void RenderEntities(void)
+{
+	int i;
+	entity_t* entity;
+	enemy_t* enemy;
+	const rq_item_t* item;
+	int numItems;
+	int pass;
+	
+	
+	
+	if ((renderer.props & PROP_SHADOW) == PROP_SHADOW)
+		UpdateShadowMap();
+	
 	
 	
 	//Setup perspective and camera
 	SetupCamera();
 	
-	entity = map;
+	//Collect everything, sort once by state and submit.
+	RQ_Begin();
 	
-	glDisable(GL_CULL_FACE);
+	entity = map;
 	for(i=0; i < num_map_entities; i++,entity++)
 	{
 		if (entity->numIndices == 0)
 			continue;
 		
-		RenderEntity(entity);		
+		RQ_Push(entity, RQ_PASS_MAP, RQ_FLAG_STATIC);
 	}
-	glEnable(GL_CULL_FACE);
-	
 	
-	// Rendering players
 	for (i=0 ; i < numPlayers; i++) 
-	{
-		entity = &players[i].entity ;
-		
-		RenderEntity(entity);
-	}
+		RQ_Push(&players[i].entity, RQ_PASS_PLAYERS, 0);
 	
 	enemy = ENE_GetFirstEnemy();
 	while (enemy != NULL) 
 	{
-		entity = &enemy->entity;
-				
-		RenderEntity(entity);
+		RQ_Push(&enemy->entity, RQ_PASS_ENEMIES, enemy->shouldFlicker ? RQ_FLAG_FLICKER : 0);
+		enemy->shouldFlicker = 0;
 		
 		enemy = enemy->next;
 	} 
+	
+	RQ_Sort();
+	
+	//Attribute pointers may have been changed by the shadow pass or the 2D rendition.
+	lastMesh = NULL;
+	
+	INST_Begin();
+	
+	pass = -1;
+	item = RQ_GetItems(&numItems);
+	for (i=0; i < numItems; i++,item++)
+	{
+		if (RQ_GetPass(item->key) != pass)
+		{
+			//Instances collected so far belong to the previous pass state.
+			INST_Flush();
+			
+			pass = RQ_GetPass(item->key);
+			
+			//Map entities are not closed meshes.
+			if (pass == RQ_PASS_MAP)
+				glDisable(GL_CULL_FACE);
+			else
+				glEnable(GL_CULL_FACE);
+		}
+		
+		//Blended items keep their back to front order.
+		if (pass == RQ_PASS_ENEMIES && !RQ_IsBlended(item->key) && INST_CanInstance(item->entity))
+			INST_Add(item->entity, item->flags & RQ_FLAG_FLICKER);
+		else
+			RenderEntity(item->entity, item->flags);
+	}
+	INST_Flush();
+	glEnable(GL_CULL_FACE);
 }
 
 void RenderString(xf_colorless_sprite_t* vertices,ushort* indices, uint numIndices)
@@ -923,23 +1208,53 @@ void GetColorBuffer(uchar* data)
 	glReadPixels(0,0,renderer.glBuffersDimensions[WIDTH],renderer.glBuffersDimensions[HEIGHT],GL_RGBA, GL_UNSIGNED_BYTE,data);
 }
 
-void RenderPlayersBullets(void)
+//Sprites are modulated by their vertex color (fading explosions, smoke, particles): they have their own shader,
+//the string shader is back once they are drawn.
+static void Use2DShader(int shaderId)
 {
+	SRC_UseShader(&shaders[shaderId]);
+	glEnableVertexAttribArray(currentShader->vars[SHADER_ATT_UV]);
+	glEnableVertexAttribArray(currentShader->vars[SHADER_ATT_VERTEX] );
+	glUniformMatrix4fv(currentShader->vars[SHADER_MVT_MATRIX],1,GL_FALSE,modelViewProjectionMatrix);
+}
+
+void RenderSprites(const xf_sprite_t* vertices, int numQuads, const ushort* quadIndices, const spr_batch_t* batches, int numBatches)
+{
+	int i;
+	int blend;
+	const spr_batch_t* batch;
 	
-	if (numPBulletsIndices == 0)
-		return;
-	
-	SetTexture(bulletConfig.bulletTexture.textureId);
+	Use2DShader(SPRITE_RENDER_SHADER);
+	glEnableVertexAttribArray(currentShader->vars[SHADER_ATT_COLOR]);
 	
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_VERTEX], 2, GL_SHORT, GL_FALSE,  sizeof(xf_sprite_t), vertices->pos);
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_UV], 2, GL_SHORT, GL_TRUE,  sizeof(xf_sprite_t), vertices->text);			
+	glVertexAttribPointer(currentShader->vars[SHADER_ATT_COLOR], 4, GL_UNSIGNED_BYTE, GL_TRUE,  sizeof(xf_sprite_t), vertices->color);
 	
-	glVertexAttribPointer(currentShader->vars[SHADER_ATT_VERTEX], 2, GL_SHORT, GL_FALSE,  sizeof(xf_colorless_sprite_t), pBulletVertices->pos);
-	glVertexAttribPointer(currentShader->vars[SHADER_ATT_UV], 2, GL_SHORT, GL_TRUE,  sizeof(xf_colorless_sprite_t), pBulletVertices->text);			
-
-	glDrawElements (GL_TRIANGLES, numPBulletsIndices, GL_UNSIGNED_SHORT,bulletIndices);
-	 
-	STATS_AddTriangles(numPBulletsIndices/3);
+	blend = -1;
+	batch = batches;
+	for (i=0; i < numBatches; i++,batch++)
+	{
+		SetTexture(batch->textureId);
+		
+		if (batch->blend != blend)
+		{
+			blend = batch->blend;
+			if (blend == SPR_BLEND_ADD)
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+			else
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			STATS_AddBlendingSwitch();
+		}
+		
+		glDrawElements (GL_TRIANGLES, batch->numQuads * SPR_QUAD_INDICES, GL_UNSIGNED_SHORT, quadIndices + batch->firstQuad * SPR_QUAD_INDICES);
+		STATS_AddTriangles(batch->numQuads * 2);
+	}
 	
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	
+	glDisableVertexAttribArray(currentShader->vars[SHADER_ATT_COLOR]);
+	Use2DShader(STRING_RENDER_SHADER);
 }
 
 
@@ -947,6 +1262,7 @@ void RenderPlayersBullets(void)
 void UpLoadEntityToGPU(entity_t* entity)
 {
 	md5_mesh_t* mesh;
+	vertex_compact_t* compactVertices;
 	
 	if (entity == NULL || entity->model == NULL)
 	{
@@ -962,20 +1278,29 @@ void UpLoadEntityToGPU(entity_t* entity)
 	
 	glGenBuffers(1, &mesh->vboId);
 	glBindBuffer(GL_ARRAY_BUFFER, mesh->vboId);
-	glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * sizeof(vertex_t), mesh->vertexArray, GL_STATIC_DRAW);
+	
+	//Map meshes are only read by the GPU: normal and tangent are decoded by the uber shader.
+	if ((renderer.props & PROP_COMPACT) && entity->usage == ENT_PARTIAL_DRAW && !mesh->keepVertices)
+	{
+		compactVertices = MD5_CompactVertices(mesh, MD5_NORMALS_OCTAHEDRAL);
+		glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * sizeof(vertex_compact_t), compactVertices, GL_STATIC_DRAW);
+		free(compactVertices);
+		mesh->isCompact = 1;
+	}
+	else
+		glBufferData(GL_ARRAY_BUFFER, mesh->numVertices * sizeof(vertex_t), mesh->vertexArray, GL_STATIC_DRAW);
 	
 	
-	free(mesh->vertexArray);
+	if (!mesh->keepVertices)
+	{
+		free(mesh->vertexArray);
+		mesh->vertexArray = 0;
+	}
 	
 	mesh->memLocation = MD5_MEMLOC_VRAM;
 }
 
 
-void RenderFXSprites(void)
-{
-	Log_Printf("Not implemented (RenderFXSprites).!\n");
-}
-
 void DrawControls(void)
 {
 	Log_Printf("Not implemented (DrawControls) .!\n");
@@ -1069,6 +1394,9 @@ void initProgrRenderer(renderer_t* renderer)
 	renderer->props |= PROP_SPEC;
 	renderer->props |= PROP_DIFF;
 	renderer->props |= PROP_SHADOW;
+	renderer->props |= PROP_COMPACT;
+	if (renderer->shadowUpdatePeriod < 1)
+		renderer->shadowUpdatePeriod = 1;
 
 	renderer->Set3D = Set3D;
 	renderer->StopRendition = StopRendition;
@@ -1077,13 +1405,13 @@ void initProgrRenderer(renderer_t* renderer)
 	renderer->SetTexture = SetTexture;
 	renderer->RenderEntities = RenderEntities;
 	renderer->UpLoadTextureToGpu = UpLoadTextureToGPU;
-	renderer->RenderPlayersBullets = RenderPlayersBullets ;
 	renderer->UpLoadEntityToGPU = UpLoadEntityToGPU;
 	renderer->Set2D = Set2D;
 	renderer->RenderString = RenderString;
 	renderer->GetColorBuffer = GetColorBuffer;
 	
-	renderer->RenderFXSprites = RenderFXSprites;
+	renderer->RenderSprites = RenderSprites;
+	renderer->RenderInstances = RenderInstances;
 	renderer->DrawControls = DrawControls;
 	
 	renderer->FreeGPUTexture = FreeGPUTexture;
@@ -1124,6 +1452,12 @@ void initProgrRenderer(renderer_t* renderer)
     extensionsList = (char *) glGetString(GL_EXTENSIONS);
     if (strstr(extensionsList,"GL_IMG_texture_compression_pvrtc"))
         supportedCompressionFormat |= TEXTURE_FORMAT_PVRTC ;
+    if (strstr(extensionsList,"GL_OES_compressed_ETC1_RGB8_texture"))
+        supportedCompressionFormat |= TEXTURE_FORMAT_ETC1 ;
+    if (strstr(extensionsList,"GL_AMD_compressed_ATC_texture") || strstr(extensionsList,"GL_ATI_texture_compression_atitc"))
+        supportedCompressionFormat |= TEXTURE_FORMAT_ATITC ;
+    if (strstr(extensionsList,"GL_EXT_texture_compression_s3tc"))
+        supportedCompressionFormat |= TEXTURE_FORMAT_S3TC ;
 	
 	SCR_CheckErrorsF("End of initProgrRenderer", "no details");
 
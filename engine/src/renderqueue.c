@@ -0,0 +1,193 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  renderqueue.c
+ *  dEngine
+ *
+ *  Per frame list of draw items sorted by state.
+ *
+ */
+
+#include "renderqueue.h"
+#include "camera.h"
+#include "material.h"
+#include "renderer.h"
+#include "collisions.h"
+#include "stats.h"
+
+#define RQ_DEPTH_BITS 24
+#define RQ_DEPTH_MAX ((1 << RQ_DEPTH_BITS) - 1)
+
+static rq_item_t* queue = NULL;
+static int queueSize = 0;
+static int queueCapacity = 0;
+
+static frustrum_t cameraFrustrum;
+
+void RQ_Begin(void)
+{
+	matrix_t projectionMatrix;
+	matrix_t viewMatrix;
+	matrix_t viewProjectionMatrix;
+	vec3_t lookAt;
+	
+	queueSize = 0;
+	
+	//Same camera setup as the renderers.
+	vectorAdd(camera.position, camera.forward, lookAt);
+	gluLookAt(camera.position, lookAt, camera.up, viewMatrix);
+	gluPerspective(camera.fov, camera.aspect, camera.zNear, camera.zFar, projectionMatrix);
+	matrix_multiply(projectionMatrix, viewMatrix, viewProjectionMatrix);
+	
+	COLL_GenerateFrustrum(viewProjectionMatrix, cameraFrustrum);
+}
+
+// Model bounding box in world space against the camera frustum.
+static char RQ_IsInFrustum(entity_t* entity)
+{
+	md5_bbox_t* modelBox;
+	bbox_t worldBox;
+	vec4_t corner;
+	vec4_t worldCorner;
+	int i;
+	
+	if (entity->model == NULL)
+		return 1;
+	
+	modelBox = &entity->model->modelSpacebbox;
+	corner[W] = 1;
+	
+	for (i=0; i < 8; i++)
+	{
+		corner[X] = (i & 1) ? modelBox->max[X] : modelBox->min[X];
+		corner[Y] = (i & 2) ? modelBox->max[Y] : modelBox->min[Y];
+		corner[Z] = (i & 4) ? modelBox->max[Z] : modelBox->min[Z];
+		
+		matrix_transform_vec4t(entity->matrix, corner, worldCorner);
+		vectorCopy(worldCorner, worldBox[i]);
+	}
+	
+	return COLL_CheckBoxAgainstFrustrum(worldBox, cameraFrustrum) != INT_OUT;
+}
+
+// Distance along the view axis, quantized on RQ_DEPTH_BITS.
+static rq_key_t RQ_QuantizeDepth(entity_t* entity)
+{
+	vec3_t toEntity;
+	float depth;
+
+	toEntity[X] = entity->matrix[12] - camera.position[X];
+	toEntity[Y] = entity->matrix[13] - camera.position[Y];
+	toEntity[Z] = entity->matrix[14] - camera.position[Z];
+
+	depth = DotProduct(toEntity, camera.forward) / camera.zFar;
+
+	if (depth <= 0)
+		return 0;
+
+	if (depth >= 1)
+		return RQ_DEPTH_MAX;
+
+	return (rq_key_t)(depth * RQ_DEPTH_MAX);
+}
+
+static rq_key_t RQ_MakeKey(entity_t* entity, int pass)
+{
+	material_t* material;
+	rq_key_t props, texture, materialId, depth;
+	rq_key_t key;
+
+	material = entity->material;
+
+	props = material->prop;
+	texture = material->textures[TEXTURE_DIFFUSE].textureId & 0xFFF;
+
+	materialId = material->index & 0xFFF;
+
+	depth = RQ_QuantizeDepth(entity);
+
+	key = (rq_key_t)(pass & 0x7) << 60;
+
+	if (material->hasAlpha)
+	{
+		key |= (rq_key_t)1 << 63;
+		key |= (RQ_DEPTH_MAX - depth) << 36;
+		key |= props << 28;
+		key |= texture << 16;
+		key |= materialId << 4;
+	}
+	else
+	{
+		key |= props << 52;
+		key |= texture << 40;
+		key |= materialId << 28;
+		key |= depth << 4;
+	}
+
+	return key;
+}
+
+void RQ_Push(entity_t* entity, int pass, uchar flags)
+{
+	rq_item_t* item;
+
+	//Static entities went through the visibility set already.
+	if (!(flags & RQ_FLAG_STATIC))
+	{
+		if (!RQ_IsInFrustum(entity))
+		{
+			STATS_AddCulledEntity();
+			return;
+		}
+		
+		STATS_AddDrawnEntity();
+	}
+
+	if (queueSize == queueCapacity)
+	{
+		queueCapacity = queueCapacity ? queueCapacity * 2 : 256;
+		queue = realloc(queue, queueCapacity * sizeof(rq_item_t));
+	}
+
+	item = &queue[queueSize++];
+	item->key = RQ_MakeKey(entity, pass);
+	item->entity = entity;
+	item->flags = flags;
+	item->order = queueSize - 1;
+}
+
+static int RQ_CompareItems(const void* a, const void* b)
+{
+	const rq_item_t* itemA = (const rq_item_t*)a;
+	const rq_item_t* itemB = (const rq_item_t*)b;
+
+	if (itemA->key != itemB->key)
+		return itemA->key < itemB->key ? -1 : 1;
+
+	return itemA->order < itemB->order ? -1 : itemA->order > itemB->order;
+}
+
+void RQ_Sort(void)
+{
+	qsort(queue, queueSize, sizeof(rq_item_t), RQ_CompareItems);
+}
+
+const rq_item_t* RQ_GetItems(int* numItems)
+{
+	*numItems = queueSize;
+	return queue;
+}
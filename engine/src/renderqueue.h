@@ -0,0 +1,86 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  renderqueue.h
+ *  dEngine
+ *
+ *  Per frame list of draw items sorted by state.
+ *
+ */
+
+#ifndef DE_RENDERQUEUE
+#define DE_RENDERQUEUE
+
+#include "globals.h"
+#include "entities.h"
+
+/*
+	Every frame the renderer pushes one item per visible entity, sorts the
+	queue once and submits it in order, so that entities sharing a shader,
+	a texture and a material are drawn back to back. Dynamic entities
+	(players, enemies) fully outside the camera frustum are dropped by
+	RQ_Push; RQ_Begin must be called once the camera is set for the frame.
+
+	64 bits sort key, most significant first:
+
+		63		blended			opaque items are all drawn before blended ones
+		62-60	pass			fixed state of a group (fog, culling, texture env)
+
+	opaque:
+		59-52	shader props
+		51-40	diffuse texture
+		39-28	material
+		27-4	depth			front to back, for early z rejection
+
+	blended:
+		59-36	depth			back to front, required for correct blending
+		35-28	shader props
+		27-16	diffuse texture
+		15-4	material
+
+		3-0		unused
+
+	Items with the same key are drawn in the order they were pushed.
+*/
+
+#define RQ_PASS_BACKGROUND	0		// Map entities drawn before the fog is enabled.
+#define RQ_PASS_MAP			1
+#define RQ_PASS_PLAYERS		2
+#define RQ_PASS_ENEMIES		3
+
+#define RQ_FLAG_FLICKER		0x01
+#define RQ_FLAG_STATIC		0x02		// Matrix set at load time, derived data is in entity->renderCache.
+
+typedef unsigned long long rq_key_t;
+
+typedef struct rq_item_t
+{
+	rq_key_t key;
+	entity_t* entity;
+	uchar flags;
+	uint order;					// Pushed this frame before it, qsort is not stable.
+} rq_item_t;
+
+#define RQ_GetPass(key)		((int)(((key) >> 60) & 0x7))
+#define RQ_IsBlended(key)	((int)((key) >> 63))
+
+void RQ_Begin(void);
+void RQ_Push(entity_t* entity, int pass, uchar flags);
+void RQ_Sort(void);
+const rq_item_t* RQ_GetItems(int* numItems);
+
+#endif
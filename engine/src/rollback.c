@@ -0,0 +1,697 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  rollback.c
+ *  dEngine
+ *
+ *  Rollback of the multiplayer simulation.
+ *
+ */
+
+#include "rollback.h"
+#include "snapshot.h"
+#include "dEngine.h"
+#include "timer.h"
+#include "event.h"
+#include "sounds.h"
+#include "netpacket.h"
+
+#define RB_NO_FRAME 0xFFFFFFFF
+
+typedef struct rb_input_t
+{
+	uint frame;
+	command_t commands[MAX_NUM_PLAYERS];
+	uchar confirmed[MAX_NUM_PLAYERS];
+} rb_input_t;
+
+// What is known of one remote player.
+typedef struct rb_remote_t
+{
+	uint nextFrame;				// Every command of this player before it has been received.
+	uint ackFrame;				// Local commands before it reached this player.
+
+	uint frame;					// From the last rb_sync_t of this player.
+	int advantage;
+} rb_remote_t;
+
+struct rollback_t
+{
+	char running;
+	char resimulating;
+
+	uchar localPlayer;
+	uchar numPlayers;
+	uint inputDelay;
+
+	uint frame;					// Next frame to begin.
+	uint simulatedFrame;		// Frame RB_GetCommand answers for.
+
+	uint firstMispredicted;		// RB_NO_FRAME when the predictions held.
+	uint lastSyncFrame;
+
+	rb_remote_t remotes[MAX_NUM_PLAYERS];	// By player, the local one is not used.
+	uint relayAckFrame;						// RB_NO_FRAME without a relay.
+
+	rb_input_t inputs[RB_MAX_FRAMES];
+
+	uchar* snapshots;
+	uint snapshotCapacity;
+	uint snapshotFrames[RB_NUM_SNAPSHOTS];
+
+	rb_state_t states[RB_NUM_STATES];		// By frame / RB_STATE_INTERVAL.
+	rb_state_t authority;					// Newest state of the server.
+	char authorityPending;					// Not checked yet.
+	uint correctionFrame;					// RB_NO_FRAME when there is nothing to correct.
+	int scoreCorrections[MAX_NUM_PLAYERS];
+	int livesCorrections[MAX_NUM_PLAYERS];
+
+	rb_stats_t stats;
+};
+
+static rollback_t defaultContext;
+static rollback_t* rb = &defaultContext;		// RB_SetContext
+
+static rb_input_t* RB_GetInput(uint frame)
+{
+	rb_input_t* input;
+
+	input = &rb->inputs[frame & (RB_MAX_FRAMES-1)];
+	if (input->frame != frame)
+	{
+		memset(input, 0, sizeof(rb_input_t));
+		input->frame = frame;
+	}
+
+	return input;
+}
+
+// Like RB_GetInput, but NULL instead of recycling the slot.
+static const rb_input_t* RB_FindInput(uint frame)
+{
+	const rb_input_t* input;
+
+	input = &rb->inputs[frame & (RB_MAX_FRAMES-1)];
+
+	return input->frame == frame ? input : NULL;
+}
+
+static void RB_EmptyCommand(command_t* command, uchar playerId)
+{
+	memset(command, 0, sizeof(command_t));
+	command->type = NET_RTM_COMMAND;
+	command->playerId = playerId;
+}
+
+static char RB_SameCommand(const command_t* a, const command_t* b)
+{
+	return a->type == b->type &&
+		   a->buttons == b->buttons &&
+		   a->delta[X] == b->delta[X] &&
+		   a->delta[Y] == b->delta[Y];
+}
+
+static char RB_IsRemote(uchar playerId)
+{
+	return playerId < rb->numPlayers && playerId != rb->localPlayer;
+}
+
+static char RB_IsSpectating(void)
+{
+	return rb->localPlayer == RB_SPECTATOR;
+}
+
+// Every remote command before it has been received, from every remote player.
+static uint RB_NextRemoteFrame(void)
+{
+	uint next = RB_NO_FRAME;
+	uchar i;
+
+	for (i=0; i < rb->numPlayers; i++)
+		if (RB_IsRemote(i) && rb->remotes[i].nextFrame < next)
+			next = rb->remotes[i].nextFrame;
+
+	return next;
+}
+
+// Local commands before it reached every remote player.
+static uint RB_PeerAckFrame(void)
+{
+	uint ack = RB_NO_FRAME;
+	uchar i;
+
+	for (i=0; i < rb->numPlayers; i++)
+		if (RB_IsRemote(i) && rb->remotes[i].ackFrame < ack)
+			ack = rb->remotes[i].ackFrame;
+
+	return ack;
+}
+
+// Every slot from here on can still be read: by a rollback, a resend or a prediction.
+static uint RB_OldestFrame(void)
+{
+	uint oldest;
+
+	oldest = rb->frame > RB_MAX_PREDICTION ? rb->frame - RB_MAX_PREDICTION : 0;
+
+	if (RB_NextRemoteFrame() < oldest)
+		oldest = RB_NextRemoteFrame();
+
+	if (!RB_IsSpectating() && RB_PeerAckFrame() < oldest)
+		oldest = RB_PeerAckFrame();
+
+	return oldest;
+}
+
+// Against the slowest remote player.
+static int RB_LocalAdvantage(void)
+{
+	int advantage = 0;
+	uchar i;
+
+	for (i=0; i < rb->numPlayers; i++)
+		if (RB_IsRemote(i) && (int)rb->frame - (int)rb->remotes[i].frame > advantage)
+			advantage = (int)rb->frame - (int)rb->remotes[i].frame;
+
+	return advantage;
+}
+
+static void RB_SetLocalCommand(uint frame, const command_t* command)
+{
+	rb_input_t* input;
+
+	input = RB_GetInput(frame);
+	input->commands[rb->localPlayer] = *command;
+	input->commands[rb->localPlayer].playerId = rb->localPlayer;
+	input->commands[rb->localPlayer].time = 0;
+	NETP_QuantizeCommand(&input->commands[rb->localPlayer]);
+	input->confirmed[rb->localPlayer] = 1;
+}
+
+void RB_Start(uchar localPlayer, uchar numPlayers, int inputDelay)
+{
+	command_t command;
+	uint i;
+
+	RB_Stop();
+
+	memset(rb, 0, sizeof(rollback_t));
+
+	rb->localPlayer = localPlayer;
+	rb->numPlayers = numPlayers > MAX_NUM_PLAYERS ? MAX_NUM_PLAYERS : numPlayers;
+	rb->inputDelay = inputDelay < 0 || RB_IsSpectating() ? 0 : inputDelay > RB_MAX_INPUT_DELAY ? RB_MAX_INPUT_DELAY : inputDelay;
+	rb->firstMispredicted = RB_NO_FRAME;
+	rb->relayAckFrame = RB_NO_FRAME;
+
+	for (i=0; i < RB_MAX_FRAMES; i++)
+		rb->inputs[i].frame = RB_NO_FRAME;
+
+	for (i=0; i < RB_NUM_SNAPSHOTS; i++)
+		rb->snapshotFrames[i] = RB_NO_FRAME;
+
+	for (i=0; i < RB_NUM_STATES; i++)
+		rb->states[i].frame = RB_NO_FRAME;
+
+	rb->authority.frame = RB_NO_FRAME;
+	rb->correctionFrame = RB_NO_FRAME;
+
+	rb->running = 1;
+
+	//Only confirmed frames are run, nothing to roll back.
+	if (RB_IsSpectating())
+	{
+		Log_Printf("[RB_Start] Spectating %d players.\n",rb->numPlayers);
+		return;
+	}
+
+	rb->snapshotCapacity = SNAP_MaxSize();
+	rb->snapshots = malloc(rb->snapshotCapacity * RB_NUM_SNAPSHOTS);
+
+	//Nothing was sampled for the first frames, they are sent as empty commands like the others.
+	RB_EmptyCommand(&command, localPlayer);
+	for (i=0; i < rb->inputDelay; i++)
+		RB_SetLocalCommand(i, &command);
+
+	Log_Printf("[RB_Start] Player %d of %d, input delay %d frames, %d KB of snapshots.\n",localPlayer,rb->numPlayers,rb->inputDelay,rb->snapshotCapacity * RB_NUM_SNAPSHOTS / 1024);
+}
+
+void RB_Stop(void)
+{
+	if (!rb->running)
+		return;
+
+	Log_Printf("[RB_Stop] %u rollbacks, %u frames re-simulated (at most %u), %u stalls.\n",
+			   rb->stats.rollbacks,rb->stats.resimulatedFrames,rb->stats.maxRollback,rb->stats.stalls);
+
+	free(rb->snapshots);
+	rb->snapshots = NULL;
+	rb->running = 0;
+}
+
+char RB_IsRunning(void)
+{
+	return rb->running;
+}
+
+char RB_IsResimulating(void)
+{
+	return rb->resimulating;
+}
+
+char RB_CanAdvance(void)
+{
+	rb_remote_t* remote;
+	uchar i;
+
+	if (!rb->running)
+		return 1;
+
+	if (RB_IsSpectating())
+		return rb->frame < RB_NextRemoteFrame();
+
+	//Out of predictions, or the ring would recycle a command a peer still needs.
+	if (rb->frame >= RB_NextRemoteFrame() + RB_MAX_PREDICTION ||
+		rb->frame + rb->inputDelay >= RB_OldestFrame() + RB_MAX_FRAMES)
+	{
+		rb->stats.stalls++;
+		return 0;
+	}
+
+	if (rb->frame - rb->lastSyncFrame < RB_SYNC_INTERVAL)
+		return 1;
+
+	//Both sides of a pair see the same latency: half the difference of advantages is how far ahead we run.
+	for (i=0; i < rb->numPlayers; i++)
+	{
+		remote = &rb->remotes[i];
+		if (!RB_IsRemote(i) || (int)rb->frame - (int)remote->frame - remote->advantage < 2)
+			continue;
+
+		rb->lastSyncFrame = rb->frame;
+		rb->stats.stalls++;
+		return 0;
+	}
+
+	return 1;
+}
+
+void RB_AddLocalCommand(const command_t* command)
+{
+	if (!rb->running || RB_IsSpectating())
+		return;
+
+	RB_SetLocalCommand(rb->frame + rb->inputDelay, command);
+}
+
+// The last command received before this frame, a ghost launch is not repeated.
+static void RB_Predict(uint frame, uchar playerId, command_t* command)
+{
+	const rb_input_t* input;
+	uint previous;
+
+	for (previous = frame; previous-- > 0 && frame - previous < RB_MAX_FRAMES; )
+	{
+		input = RB_FindInput(previous);
+		if (input && input->confirmed[playerId])
+		{
+			*command = input->commands[playerId];
+			command->buttons &= ~BUTTON_GHOST_PRESSED;
+			return;
+		}
+	}
+
+	RB_EmptyCommand(command, playerId);
+}
+
+static void RB_PrepareFrame(uint frame)
+{
+	rb_input_t* input;
+	uchar i;
+
+	input = RB_GetInput(frame);
+
+	for (i=0; i < rb->numPlayers; i++)
+		if (RB_IsRemote(i) && !input->confirmed[i])
+			RB_Predict(frame, i, &input->commands[i]);
+
+	rb->simulatedFrame = frame;
+}
+
+static void RB_CaptureState(uint frame, rb_state_t* state)
+{
+	uchar i;
+
+	memset(state, 0, sizeof(rb_state_t));
+	state->frame = frame;
+	state->numPlayers = rb->numPlayers;
+	state->hash = SNAP_Hash();
+
+	for (i=0; i < rb->numPlayers; i++)
+	{
+		state->scores[i] = players[i].score;
+		state->lives[i] = players[i].respawnCounter;
+	}
+}
+
+static void RB_SaveSnapshot(uint frame)
+{
+	uint slot;
+
+	slot = frame % RB_NUM_SNAPSHOTS;
+
+	SNAP_Save(rb->snapshots + slot * rb->snapshotCapacity, rb->snapshotCapacity);
+	rb->snapshotFrames[slot] = frame;
+
+	//Re-simulated frames take it again.
+	if (frame % RB_STATE_INTERVAL == 0)
+		RB_CaptureState(frame, &rb->states[(frame / RB_STATE_INTERVAL) & (RB_NUM_STATES-1)]);
+}
+
+static void RB_ApplyCorrection(void)
+{
+	uchar i;
+
+	for (i=0; i < rb->numPlayers; i++)
+	{
+		players[i].score += rb->scoreCorrections[i];
+
+		//Deaths only the server saw run like the NET_RTM_DIED of the legacy peers.
+		for (; rb->livesCorrections[i] < 0 && players[i].respawnCounter >= 0; rb->livesCorrections[i]++)
+			P_Die(i);
+
+		players[i].respawnCounter += rb->livesCorrections[i];
+	}
+
+	memset(rb->scoreCorrections, 0, sizeof(rb->scoreCorrections));
+	memset(rb->livesCorrections, 0, sizeof(rb->livesCorrections));
+	rb->correctionFrame = RB_NO_FRAME;
+}
+
+// Compares the state of the server with the digest of the same frame, once no rollback can change that digest.
+static void RB_CheckAuthority(void)
+{
+	const rb_state_t* authority;
+	const rb_state_t* local;
+	char corrected = 0;
+	uint frame;
+	uchar i;
+
+	authority = &rb->authority;
+
+	if (!rb->authorityPending || authority->frame >= rb->frame ||
+		authority->frame > RB_NextRemoteFrame() || authority->frame > rb->firstMispredicted)
+		return;
+
+	rb->authorityPending = 0;
+
+	//Too old, the digest was recycled.
+	local = &rb->states[(authority->frame / RB_STATE_INTERVAL) & (RB_NUM_STATES-1)];
+	if (local->frame != authority->frame)
+		return;
+
+	rb->stats.statesChecked++;
+
+	if (local->hash != authority->hash)
+	{
+		rb->stats.desyncs++;
+		Log_Printf("[RB_CheckAuthority] Frame %u differs from the server.\n",authority->frame);
+	}
+
+	for (i=0; i < rb->numPlayers; i++)
+	{
+		rb->scoreCorrections[i] = (int)authority->scores[i] - (int)local->scores[i];
+		rb->livesCorrections[i] = authority->lives[i] - local->lives[i];
+		corrected |= rb->scoreCorrections[i] != 0 || rb->livesCorrections[i] != 0;
+	}
+
+	if (!corrected)
+		return;
+
+	//Every command before it is confirmed: rollbacks never go further back.
+	frame = RB_NextRemoteFrame() < rb->frame ? RB_NextRemoteFrame() : rb->frame;
+
+	rb->correctionFrame = frame;
+	if (frame < rb->firstMispredicted)
+		rb->firstMispredicted = frame;
+
+	rb->stats.corrections++;
+}
+
+static void RB_Resimulate(uint fromFrame)
+{
+	uint slot;
+	uint frame;
+
+	slot = fromFrame % RB_NUM_SNAPSHOTS;
+
+	if (rb->snapshotFrames[slot] != fromFrame || !SNAP_Restore(rb->snapshots + slot * rb->snapshotCapacity))
+	{
+		Log_Printf("[RB_Resimulate] No snapshot for frame %u, the peers may diverge.\n",fromFrame);
+		return;
+	}
+
+	rb->resimulating = 1;
+	EV_SetReplay(1);
+
+	//The snapshot of a frame is taken after its timer step.
+	for (frame = fromFrame; frame < rb->frame; frame++)
+	{
+		if (frame == rb->correctionFrame)
+		{
+			RB_ApplyCorrection();
+			RB_SaveSnapshot(frame);
+		}
+		else if (frame != fromFrame)
+			RB_SaveSnapshot(frame);
+
+		RB_PrepareFrame(frame);
+		dEngine_SimulateFrame();
+		Timer_Step();
+	}
+
+	EV_SetReplay(0);
+	SND_ClearPendingSounds();
+	rb->resimulating = 0;
+
+	rb->stats.rollbacks++;
+	rb->stats.resimulatedFrames += rb->frame - fromFrame;
+	if (rb->frame - fromFrame > rb->stats.maxRollback)
+		rb->stats.maxRollback = rb->frame - fromFrame;
+}
+
+void RB_BeginFrame(void)
+{
+	command_t command;
+	rb_input_t* input;
+
+	if (!rb->running)
+		return;
+
+	if (RB_IsSpectating())
+	{
+		RB_PrepareFrame(rb->frame);
+		rb->frame++;
+		return;
+	}
+
+	//Nothing was sampled this frame (players detached): the peer still needs a command.
+	input = RB_GetInput(rb->frame + rb->inputDelay);
+	if (!input->confirmed[rb->localPlayer])
+	{
+		RB_EmptyCommand(&command, rb->localPlayer);
+		RB_SetLocalCommand(rb->frame + rb->inputDelay, &command);
+	}
+
+	RB_CheckAuthority();
+
+	if (rb->firstMispredicted < rb->frame)
+		RB_Resimulate(rb->firstMispredicted);
+
+	rb->firstMispredicted = RB_NO_FRAME;
+
+	//Not applied by the re-simulation, or right on this frame.
+	if (rb->correctionFrame <= rb->frame)
+		RB_ApplyCorrection();
+
+	RB_SaveSnapshot(rb->frame);
+	RB_PrepareFrame(rb->frame);
+
+	rb->frame++;
+}
+
+const command_t* RB_GetCommand(uchar playerId)
+{
+	return &RB_GetInput(rb->simulatedFrame)->commands[playerId];
+}
+
+void RB_GetSync(rb_sync_t* sync)
+{
+	sync->frame = rb->frame;
+	sync->advantage = RB_LocalAdvantage();
+	sync->ackFrame = RB_NextRemoteFrame();
+}
+
+void RB_SetRemoteSync(uchar playerId, const rb_sync_t* sync)
+{
+	rb_remote_t* remote;
+
+	if (!rb->running || !RB_IsRemote(playerId))
+		return;
+
+	remote = &rb->remotes[playerId];
+
+	if (sync->frame > remote->frame)
+	{
+		remote->frame = sync->frame;
+		remote->advantage = sync->advantage;
+	}
+
+	//Packets arrive out of order, never go back. The peer cannot ack what was not sent.
+	if (sync->ackFrame > remote->ackFrame && sync->ackFrame <= rb->frame + rb->inputDelay)
+		remote->ackFrame = sync->ackFrame;
+}
+
+void RB_SetRelayAck(uint ackFrame)
+{
+	if (!rb->running || ackFrame > rb->frame + rb->inputDelay)
+		return;
+
+	if (rb->relayAckFrame == RB_NO_FRAME || ackFrame > rb->relayAckFrame)
+		rb->relayAckFrame = ackFrame;
+}
+
+uint RB_GetRemoteFrame(uchar playerId)
+{
+	return RB_IsRemote(playerId) ? rb->remotes[playerId].nextFrame : 0;
+}
+
+void RB_GetState(rb_state_t* state)
+{
+	RB_CaptureState(rb->frame, state);
+}
+
+void RB_SetAuthority(const rb_state_t* state)
+{
+	if (!rb->running || RB_IsSpectating() || state->numPlayers != rb->numPlayers)
+		return;
+
+	//Out of order: only the newest one is checked.
+	if (rb->authority.frame != RB_NO_FRAME && state->frame <= rb->authority.frame)
+		return;
+
+	rb->authority = *state;
+	rb->authorityPending = 1;
+}
+
+uint RB_GetLocalCommands(command_t* commands, uint maxCommands, uint* firstFrame)
+{
+	const rb_input_t* input;
+	uint frame;
+	uint relayFrame;
+	uint numCommands;
+
+	*firstFrame = RB_PeerAckFrame();
+
+	if (!rb->running || RB_IsSpectating())
+		return 0;
+
+	//The relay gets the commands it misses as long as the peers still get the newest ones.
+	if (rb->relayAckFrame < *firstFrame)
+	{
+		relayFrame = rb->relayAckFrame;
+		if (relayFrame + maxCommands < rb->frame + rb->inputDelay)
+			relayFrame = rb->frame + rb->inputDelay - maxCommands;
+
+		if (relayFrame < *firstFrame)
+			*firstFrame = relayFrame;
+	}
+
+	//Local commands exist up to frame + delay, everything a peer has not acked is sent again.
+	numCommands = 0;
+	for (frame = *firstFrame; frame < rb->frame + rb->inputDelay && numCommands < maxCommands; frame++)
+	{
+		input = RB_FindInput(frame);
+		if (!input || !input->confirmed[rb->localPlayer])
+			break;
+
+		commands[numCommands++] = input->commands[rb->localPlayer];
+	}
+
+	return numCommands;
+}
+
+void RB_AddRemoteCommand(uint frame, const command_t* command)
+{
+	rb_input_t* input;
+	rb_remote_t* remote;
+	uchar playerId;
+
+	playerId = command->playerId;
+
+	if (!rb->running || !RB_IsRemote(playerId))
+		return;
+
+	remote = &rb->remotes[playerId];
+
+	//Already known, or so far ahead it would recycle a slot still in use.
+	if (frame < remote->nextFrame || frame >= RB_OldestFrame() + RB_MAX_FRAMES)
+		return;
+
+	input = RB_GetInput(frame);
+	if (input->confirmed[playerId])
+		return;
+
+	//Already simulated with a prediction.
+	if (frame < rb->frame && !RB_SameCommand(&input->commands[playerId], command) && frame < rb->firstMispredicted)
+		rb->firstMispredicted = frame;
+
+	input->commands[playerId] = *command;
+	input->confirmed[playerId] = 1;
+
+	while ((input = (rb_input_t*)RB_FindInput(remote->nextFrame)) != NULL && input->confirmed[playerId])
+		remote->nextFrame++;
+}
+
+const rb_stats_t* RB_GetStats(void)
+{
+	return &rb->stats;
+}
+
+rollback_t* RB_NewContext(void)
+{
+	return calloc(1, sizeof(rollback_t));
+}
+
+void RB_FreeContext(rollback_t* context)
+{
+	rollback_t* current;
+
+	if (!context)
+		return;
+
+	current = rb;
+	rb = context;
+	RB_Stop();
+	rb = current == context ? &defaultContext : current;
+
+	free(context);
+}
+
+void RB_SetContext(rollback_t* context)
+{
+	rb = context ? context : &defaultContext;
+}
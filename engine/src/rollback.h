@@ -0,0 +1,156 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  rollback.h
+ *  dEngine
+ *
+ *  Rollback of the multiplayer simulation.
+ *
+ */
+
+#ifndef DE_ROLLBACK
+#define DE_ROLLBACK
+
+#include "globals.h"
+#include "commands.h"
+
+/*
+	Every peer runs the same simulation from the same inputs, one command
+	per player and per frame. Each peer controls one player and sends its
+	commands to all the others.
+
+	A local command sampled during frame F applies to frame F + inputDelay
+	and is sent right away: with enough delay the remote ones arrive before
+	they are needed. When one does not, that remote command is predicted
+	(the last one received from the player, ghost button released) and the
+	frame runs anyway.
+
+	Every frame is snapshotted before it runs (snapshot.h). A remote command
+	that contradicts its prediction rolls back: the snapshot of that frame
+	is restored and the frames up to the current one run again with the
+	corrected inputs. Re-simulated frames are not rendered, do not play
+	sounds and skip the events that only touch the screen.
+
+	The simulation may run at most RB_MAX_PREDICTION frames ahead of the
+	slowest remote inputs, after that it waits. A peer ahead of another
+	one also skips a frame now and then so they stay aligned.
+
+	Frames step the timer by the fixed 16/17ms of Timer_Step, the
+	simulation time is the same on both peers.
+
+	A spectator (spectator.h) starts as RB_SPECTATOR: every player is
+	remote, nothing is predicted, a frame only runs once the commands of
+	every player for it were added.
+
+	A dedicated server (server.h) simulates the session too and sends the
+	state it confirms every RB_STATE_INTERVAL frames: hash, scores and
+	lives. Each peer keeps the same digest of those frames and checks it
+	once its inputs are confirmed. The score and the lives of the server
+	win: a death the peer missed runs P_Die like a NET_RTM_DIED, the rest
+	is adjusted. The correction goes into the oldest frame a rollback can
+	still restore and the frames after it run again, so no later rollback
+	undoes it. A hash that differs is counted as a desync.
+
+	The state lives in a context. The game uses the default one, a process
+	running several peers (netsim.h) switches contexts along with the
+	snapshots of their simulations.
+*/
+
+#define RB_MAX_FRAMES			32		// Inputs kept, power of two.
+#define RB_MAX_PREDICTION		8		// Frames simulated ahead of the remote inputs.
+#define RB_NUM_SNAPSHOTS		(RB_MAX_PREDICTION+1)
+#define RB_DEFAULT_INPUT_DELAY	2
+#define RB_MAX_INPUT_DELAY		6		// RB_MAX_FRAMES has to cover 2 * delay + 2 * prediction.
+#define RB_SYNC_INTERVAL		20		// Frames between two catch up skips.
+#define RB_SPECTATOR			0xFF	// Local player of a spectator.
+#define RB_STATE_INTERVAL		30		// Frames between two states of the server.
+#define RB_NUM_STATES			8		// Digests kept to check them, power of two.
+
+// Exchanged in every input packet.
+typedef struct rb_sync_t
+{
+	uint frame;					// Next frame of the sender.
+	int advantage;				// Frames the sender thinks it is ahead.
+	uint ackFrame;				// First frame the sender is missing a remote command of.
+} rb_sync_t;
+
+// Digest of a frame before it runs.
+typedef struct rb_state_t
+{
+	uint frame;
+	uchar numPlayers;
+	unsigned long long hash;			// SNAP_Hash
+	uint scores[MAX_NUM_PLAYERS];
+	char lives[MAX_NUM_PLAYERS];		// respawnCounter
+} rb_state_t;
+
+typedef struct rb_stats_t
+{
+	uint rollbacks;
+	uint resimulatedFrames;
+	uint stalls;
+	uint maxRollback;
+	uint statesChecked;
+	uint desyncs;
+	uint corrections;
+} rb_stats_t;
+
+// After the scene is loaded, on every peer at the same frame 0. numPlayers is 2 or more.
+void RB_Start(uchar localPlayer, uchar numPlayers, int inputDelay);
+void RB_Stop(void);
+char RB_IsRunning(void);
+char RB_IsResimulating(void);
+
+// 0 while waiting on the remote peer: the frame must not be simulated.
+char RB_CanAdvance(void);
+
+void RB_AddLocalCommand(const command_t* command);
+
+// Restores and re-simulates if a remote command contradicted a prediction, then snapshots this frame.
+void RB_BeginFrame(void);
+
+// Command of a player for the frame being simulated.
+const command_t* RB_GetCommand(uchar playerId);
+
+// Netchannel side.
+void RB_GetSync(rb_sync_t* sync);
+void RB_SetRemoteSync(uchar playerId, const rb_sync_t* sync);
+uint RB_GetLocalCommands(command_t* commands, uint maxCommands, uint* firstFrame);
+void RB_AddRemoteCommand(uint frame, const command_t* command);	// Of command->playerId.
+
+// A spectator relay (relay.h) misses the local commands from ackFrame on. It
+// gets them again in the next packets but never holds the peers back.
+void RB_SetRelayAck(uint ackFrame);
+
+// Server side: every command of this player before it was added.
+uint RB_GetRemoteFrame(uchar playerId);
+
+// Server side, of the frame about to begin.
+void RB_GetState(rb_state_t* state);
+
+// Peer side: checked against the digest of that frame once it is final.
+void RB_SetAuthority(const rb_state_t* state);
+
+const rb_stats_t* RB_GetStats(void);
+
+typedef struct rollback_t rollback_t;
+
+rollback_t* RB_NewContext(void);
+void RB_FreeContext(rollback_t* context);	// Stops it first.
+void RB_SetContext(rollback_t* context);	// NULL for the default one.
+
+#endif
@@ -0,0 +1,480 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  server.c
+ *  dEngine
+ *
+ *  Dedicated server of multiplayer sessions.
+ *
+ */
+
+#include "server.h"
+#include "netpacket.h"
+#include "snapshot.h"
+#include "dEngine.h"
+#include "player.h"
+#include "timer.h"
+#include "event.h"
+#include "sounds.h"
+#include "renderer.h"
+
+#ifndef WIN32
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#endif
+
+#define SERV_HUB_QUEUE	64			// Datagrams of a session waiting for SERV_Update.
+
+// Transport of a session whose players joined over UDP: what they send is queued by SERV_Accept.
+typedef struct serv_hub_t
+{
+	int udpSocket;
+	uchar numPlayers;				// Seated so far.
+#ifndef WIN32
+	struct sockaddr_in players[MAX_NUM_PLAYERS];
+#endif
+
+	uchar datagrams[SERV_HUB_QUEUE][NETT_MTU];
+	int sizes[SERV_HUB_QUEUE];
+	uint head;
+	uint tail;
+} serv_hub_t;
+
+typedef struct serv_session_t
+{
+	net_transport_t players;
+	serv_hub_t* hub;				// NULL unless the players joined over UDP.
+	uint lastFrame;					// 0 for never.
+	uchar* snapshot;
+	rollback_t* rollback;
+	serv_session_stats_t stats;
+} serv_session_t;
+
+#ifndef WIN32
+typedef struct serv_client_t
+{
+	struct sockaddr_in address;
+	int session;
+	uchar playerId;
+} serv_client_t;
+#endif
+
+struct server_t
+{
+	uchar numPlayers;
+	uchar sceneId;
+	uint snapshotCapacity;
+	uchar* scene;					// Snapshot of the scene as loaded.
+
+	serv_session_t* sessions;
+	int numSessions;
+	int sessionsCapacity;
+
+	// Listener, udpSocket is -1 without one.
+	int udpSocket;
+	uint listenFrames;
+	uchar inputDelay;
+	int openSession;				// Seats the players that join, -1 until the first one.
+#ifndef WIN32
+	serv_client_t* clients;
+	int numClients;
+	int clientsCapacity;
+#endif
+};
+
+server_t* SERV_New(void)
+{
+	server_t* server;
+
+	server = calloc(1, sizeof(server_t));
+	server->numPlayers = numPlayers;
+	server->sceneId = engine.sceneId;
+	server->udpSocket = -1;
+	server->openSession = -1;
+	server->snapshotCapacity = SNAP_MaxSize();
+	server->scene = malloc(server->snapshotCapacity);
+	SNAP_Save(server->scene, server->snapshotCapacity);
+
+	Log_Printf("[SERV_New] Sessions of %d players, %d KB each.\n",server->numPlayers,server->snapshotCapacity / 1024);
+
+	return server;
+}
+
+void SERV_Free(server_t* server)
+{
+	serv_session_t* session;
+	int i;
+
+	if (!server)
+		return;
+
+	for (i=0; i < server->numSessions; i++)
+	{
+		session = &server->sessions[i];
+
+		Log_Printf("[SERV_Free] Session %d: %u frames, %u states (%u bytes), %lluus.\n",
+				   i,session->stats.frames,session->stats.statesSent,session->stats.bytesSent,session->stats.microseconds);
+
+		session->players.Close(&session->players);
+		RB_FreeContext(session->rollback);
+		free(session->snapshot);
+	}
+
+	//The scene goes back to how it was loaded.
+	RB_SetContext(NULL);
+	SNAP_Restore(server->scene);
+
+#ifndef WIN32
+	if (server->udpSocket != -1)
+		close(server->udpSocket);
+	free(server->clients);
+#endif
+
+	free(server->sessions);
+	free(server->scene);
+	free(server);
+}
+
+int SERV_AddSession(server_t* server, const net_transport_t* players, uint frames)
+{
+	serv_session_t* session;
+
+	if (server->numSessions == server->sessionsCapacity)
+	{
+		server->sessionsCapacity = server->sessionsCapacity ? server->sessionsCapacity * 2 : 16;
+		server->sessions = realloc(server->sessions, server->sessionsCapacity * sizeof(serv_session_t));
+	}
+
+	session = &server->sessions[server->numSessions];
+	memset(session, 0, sizeof(serv_session_t));
+	session->players = *players;
+	session->lastFrame = frames;
+
+	session->snapshot = malloc(server->snapshotCapacity);
+	memcpy(session->snapshot, server->scene, server->snapshotCapacity);
+
+	session->rollback = RB_NewContext();
+	RB_SetContext(session->rollback);
+	RB_Start(RB_SPECTATOR, server->numPlayers, 0);
+
+	return server->numSessions++;
+}
+
+#ifndef WIN32
+
+//
+// Players joining over UDP
+//
+
+static char SERV_Hub_Send(net_transport_t* transport, const uchar* data, uint size)
+{
+	serv_hub_t* hub = (serv_hub_t*)transport->state;
+	char sent = 1;
+	int i;
+
+	for (i=0; i < hub->numPlayers; i++)
+		sent &= sendto(hub->udpSocket, data, size, 0, (struct sockaddr*)&hub->players[i], sizeof(hub->players[i])) == (int)size;
+
+	return sent;
+}
+
+static int SERV_Hub_Receive(net_transport_t* transport, uchar buffers[][NETT_MTU], int* sizes, int maxDatagrams)
+{
+	serv_hub_t* hub = (serv_hub_t*)transport->state;
+	int received;
+
+	for (received=0; received < maxDatagrams && hub->head != hub->tail; received++)
+	{
+		sizes[received] = hub->sizes[hub->head % SERV_HUB_QUEUE];
+		memcpy(buffers[received], hub->datagrams[hub->head % SERV_HUB_QUEUE], sizes[received]);
+		hub->head++;
+	}
+
+	return received;
+}
+
+static void SERV_Hub_Close(net_transport_t* transport)
+{
+	free(transport->state);
+	memset(transport, 0, sizeof(net_transport_t));
+}
+
+char SERV_Listen(server_t* server, ushort port, uint frames)
+{
+	server->udpSocket = NETT_OpenUDPSocket(port);
+	if (server->udpSocket == -1)
+		return 0;
+
+	server->listenFrames = frames;
+	server->inputDelay = engine.netInputDelay < 0 ? 0 : engine.netInputDelay > RB_MAX_INPUT_DELAY ? RB_MAX_INPUT_DELAY : engine.netInputDelay;
+
+	Log_Printf("[SERV_Listen] Port %hu, scene %d, sessions of %d players.\n",port,server->sceneId,server->numPlayers);
+
+	return 1;
+}
+
+// A seat is kept as long as the server runs: a player that joins again from the same address gets it back.
+static serv_client_t* SERV_FindClient(server_t* server, const struct sockaddr_in* address)
+{
+	int i;
+
+	for (i=0; i < server->numClients; i++)
+		if (server->clients[i].address.sin_addr.s_addr == address->sin_addr.s_addr && server->clients[i].address.sin_port == address->sin_port)
+			return &server->clients[i];
+
+	return NULL;
+}
+
+// Players fill a session in the order they join, the next one opens once it is full.
+static serv_client_t* SERV_Seat(server_t* server, const struct sockaddr_in* address)
+{
+	net_transport_t transport;
+	serv_hub_t* hub;
+	serv_client_t* client;
+
+	if (server->openSession == -1 || server->sessions[server->openSession].hub->numPlayers == server->numPlayers)
+	{
+		hub = calloc(1, sizeof(serv_hub_t));
+		hub->udpSocket = server->udpSocket;
+
+		transport.Send = SERV_Hub_Send;
+		transport.Receive = SERV_Hub_Receive;
+		transport.Close = SERV_Hub_Close;
+		transport.state = hub;
+
+		server->openSession = SERV_AddSession(server, &transport, server->listenFrames);
+		server->sessions[server->openSession].hub = hub;
+	}
+
+	hub = server->sessions[server->openSession].hub;
+
+	if (server->numClients == server->clientsCapacity)
+	{
+		server->clientsCapacity = server->clientsCapacity ? server->clientsCapacity * 2 : 16;
+		server->clients = realloc(server->clients, server->clientsCapacity * sizeof(serv_client_t));
+	}
+
+	client = &server->clients[server->numClients++];
+	client->address = *address;
+	client->session = server->openSession;
+	client->playerId = hub->numPlayers;
+
+	hub->players[hub->numPlayers++] = *address;
+
+	Log_Printf("[SERV_Seat] %s:%hu is player %d of session %d.\n",inet_ntoa(address->sin_addr),ntohs(address->sin_port),client->playerId,client->session);
+
+	return client;
+}
+
+static void SERV_Welcome(server_t* server, const serv_client_t* client, uint nonce)
+{
+	netp_welcome_t welcome;
+	uchar buffer[NETP_MAX_WELCOME_SIZE];
+
+	welcome.nonce = nonce;
+	welcome.session = client->session;
+	welcome.playerId = client->playerId;
+	welcome.numPlayers = server->numPlayers;
+	welcome.sceneId = server->sceneId;
+	welcome.inputDelay = server->inputDelay;
+
+	sendto(server->udpSocket, buffer, NETP_EncodeWelcome(&welcome, buffer), 0, (struct sockaddr*)&client->address, sizeof(client->address));
+}
+
+static void SERV_Dispatch(server_t* server, const uchar* data, int size, const struct sockaddr_in* sender)
+{
+	serv_client_t* client;
+	serv_hub_t* hub;
+	uint nonce;
+	int i;
+
+	client = SERV_FindClient(server, sender);
+
+	//Joins are answered every time: the welcome may have been lost.
+	if (NETP_DecodeJoin(&nonce, data, size))
+	{
+		if (!client)
+			client = SERV_Seat(server, sender);
+		SERV_Welcome(server, client, nonce);
+		return;
+	}
+
+	if (!client)
+		return;
+
+	hub = server->sessions[client->session].hub;
+
+	//The other players get it as if they shared a loopback with the sender.
+	for (i=0; i < hub->numPlayers; i++)
+		if (i != client->playerId)
+			sendto(server->udpSocket, data, size, 0, (struct sockaddr*)&hub->players[i], sizeof(hub->players[i]));
+
+	//A full queue drops, as a socket buffer would.
+	if (hub->tail - hub->head >= SERV_HUB_QUEUE)
+		return;
+
+	memcpy(hub->datagrams[hub->tail % SERV_HUB_QUEUE], data, size);
+	hub->sizes[hub->tail % SERV_HUB_QUEUE] = size;
+	hub->tail++;
+}
+
+static void SERV_Accept(server_t* server)
+{
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	struct sockaddr_in senders[NETT_RECV_BATCH];
+	int numReceived;
+	int i;
+
+	if (server->udpSocket == -1)
+		return;
+
+	do
+	{
+		numReceived = NETT_ReceiveFrom(server->udpSocket, buffers, sizes, senders, NETT_RECV_BATCH);
+
+		for (i=0; i < numReceived; i++)
+			SERV_Dispatch(server, buffers[i], sizes[i], &senders[i]);
+	} while (numReceived == NETT_RECV_BATCH);
+}
+
+#endif
+
+static void SERV_Receive(server_t* server, serv_session_t* session)
+{
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	netp_input_packet_t packet;
+	netp_relay_ack_t ack;
+	uchar buffer[NETP_MAX_RELAY_ACK_SIZE];
+	int numReceived;
+	int i, j;
+
+	do
+	{
+		numReceived = session->players.Receive(&session->players, buffers, sizes, NETT_RECV_BATCH);
+
+		for (i=0; i < numReceived; i++)
+		{
+			if (!NETP_Decode(&packet, buffers[i], sizes[i]) || packet.playerId >= server->numPlayers)
+				continue;
+
+			for (j=0; j < packet.numCommands; j++)
+				RB_AddRemoteCommand(packet.firstFrame + j, &packet.commands[j]);
+		}
+	} while (numReceived == NETT_RECV_BATCH);
+
+	//Like the relay: the players send again what is missing.
+	ack.numPlayers = server->numPlayers;
+	for (i=0; i < server->numPlayers; i++)
+		ack.nextFrames[i] = RB_GetRemoteFrame(i);
+
+	session->players.Send(&session->players, buffer, NETP_EncodeRelayAck(&ack, buffer, sizeof(buffer)));
+}
+
+static void SERV_SendState(serv_session_t* session)
+{
+	rb_state_t state;
+	uchar buffer[NETP_MAX_STATE_SIZE];
+	uint size;
+
+	RB_GetState(&state);
+	size = NETP_EncodeState(&state, buffer);
+
+	if (!session->players.Send(&session->players, buffer, size))
+		return;
+
+	session->stats.statesSent++;
+	session->stats.bytesSent += size;
+}
+
+static void SERV_UpdateSession(server_t* server, serv_session_t* session)
+{
+	rb_sync_t sync;
+
+	SNAP_Restore(session->snapshot);
+	RB_SetContext(session->rollback);
+
+	SERV_Receive(server, session);
+
+	EV_SetReplay(1);
+
+	for (;;)
+	{
+		RB_GetSync(&sync);
+		if ((session->lastFrame && sync.frame >= session->lastFrame) || !RB_CanAdvance())
+			break;
+
+		Timer_Step();
+
+		if (sync.frame % RB_STATE_INTERVAL == 0)
+			SERV_SendState(session);
+
+		RB_BeginFrame();
+		dEngine_SimulateFrame();
+		SND_ClearPendingSounds();
+
+		diverSpriteLib.numVertices = 0;
+		diverSpriteLib.numIndices = 0;
+
+		session->stats.frames++;
+
+		if (sync.frame + 1 == session->lastFrame)
+			session->stats.hash = SNAP_Hash();
+	}
+
+	EV_SetReplay(0);
+
+	SNAP_Save(session->snapshot, server->snapshotCapacity);
+}
+
+void SERV_Update(server_t* server)
+{
+	serv_session_t* session;
+	uint start;
+	int i;
+
+#ifndef WIN32
+	SERV_Accept(server);
+#endif
+
+	for (i=0; i < server->numSessions; i++)
+	{
+		session = &server->sessions[i];
+
+		start = E_Sys_Microseconds();
+		SERV_UpdateSession(server, session);
+		session->stats.microseconds += E_Sys_Microseconds() - start;
+	}
+}
+
+int SERV_GetNumSessions(const server_t* server)
+{
+	return server->numSessions;
+}
+
+char SERV_SessionIsDone(const server_t* server, int session)
+{
+	return server->sessions[session].lastFrame && server->sessions[session].stats.frames >= server->sessions[session].lastFrame;
+}
+
+const serv_session_stats_t* SERV_GetSessionStats(const server_t* server, int session)
+{
+	return &server->sessions[session].stats;
+}
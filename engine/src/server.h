@@ -0,0 +1,89 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  server.h
+ *  dEngine
+ *
+ *  Dedicated server of multiplayer sessions.
+ *
+ */
+
+#ifndef DE_SERVER
+#define DE_SERVER
+
+#include "globals.h"
+#include "nettransport.h"
+#include "rollback.h"
+
+/*
+	The server has the authority on what happens in a session: it runs
+	the simulation alone (events, enemies, collisions, scores), nothing is
+	rendered or played, and the players check their state against its
+	own (rollback.h).
+
+	It listens to a session like the spectator relay (relay.h): the
+	players send it their input packets along with the other peers and it
+	acks them with relay acks. A frame runs, at the fixed 16/17ms step,
+	once the command of every player for it arrived. Every
+	RB_STATE_INTERVAL frames the state it begins with goes to every player
+	(NETP_TYPE_STATE), a few bytes per player.
+
+	One process hosts many sessions of the scene loaded before SERV_New,
+	with its number of players. Each session has its own snapshot
+	(snapshot.h) and rollback context started as RB_SPECTATOR, they are
+	swapped in turn like the peers of netsim.h. The time spent in each
+	session, swapping included, is its cost.
+
+	A session cannot also have a relay: both ack with relay acks.
+
+	Players reach it over UDP with SERV_Listen: a player sends
+	NETP_TYPE_JOIN and is answered NETP_TYPE_WELCOME with its session and
+	player id (netpacket.h). Sessions fill in the order players join, the
+	first one with a free seat takes the next player. Afterwards a player
+	sends its packets to the server only, which forwards them to the other
+	players of its session before reading them.
+*/
+
+typedef struct serv_session_stats_t
+{
+	uint frames;					// Simulated.
+	uint statesSent;
+	uint bytesSent;
+	unsigned long long microseconds;	// Spent in the session.
+	unsigned long long hash;		// SNAP_Hash once the last frame ran.
+} serv_session_stats_t;
+
+typedef struct server_t server_t;
+
+// After the scene is loaded, every session starts from it.
+server_t* SERV_New(void);
+void SERV_Free(server_t* server);
+
+// Owns the transport it is given, which reaches every player. The session stops after frames, 0 for never.
+int SERV_AddSession(server_t* server, const net_transport_t* players, uint frames);
+
+// Opens a UDP socket on port (0 for any), each session it fills stops after frames. Not on WIN32.
+char SERV_Listen(server_t* server, ushort port, uint frames);
+
+// Accepts the players that join, then receives, acks and simulates every confirmed frame of every session.
+void SERV_Update(server_t* server);
+
+int SERV_GetNumSessions(const server_t* server);
+char SERV_SessionIsDone(const server_t* server, int session);
+const serv_session_stats_t* SERV_GetSessionStats(const server_t* server, int session);
+
+#endif
@@ -229,10 +229,10 @@ void updateSHABHelling(enemy_t* enemy)
 	
 	
 	
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
-	random[Y] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
+	random[Y] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
 	normalize2(random);
-	FX_GetParticule(enemy->ss_position,random		,0.02*PARTICULE_SIZE_GLOBAL*SHAB_PARTICULE_IMPLOSION_RATION	,PARTICULE_TRAVEL_DIST*0.6*rand()/(float)RAND_MAX,PARTICULE_TYPE_IMPLOSION, PARTICULE_COLOR_WHITE,3.0f);
+	FX_GetParticule(enemy->ss_position,random		,0.02*PARTICULE_SIZE_GLOBAL*SHAB_PARTICULE_IMPLOSION_RATION	,PARTICULE_TRAVEL_DIST*0.6*randomNext()/(float)RANDOM_MAX,PARTICULE_TYPE_IMPLOSION, PARTICULE_COLOR_WHITE,3.0f);
 	
 	
 	if (enemy->timeCounter >= SHAB_TIME_FIRING_LIMIT)
@@ -0,0 +1,300 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  snapshot.c
+ *  dEngine
+ *
+ *  Save and restore of the simulation state.
+ *
+ */
+
+#include "snapshot.h"
+#include "player.h"
+#include "enemy.h"
+#include "enemy_particules.h"
+#include "fx.h"
+#include "event.h"
+#include "camera.h"
+#include "world.h"
+#include "timer.h"
+#include "dEngine.h"
+
+#define SNAP_FNV_OFFSET	0xcbf29ce484222325ULL
+#define SNAP_FNV_PRIME	0x100000001b3ULL
+
+#define SNAP_MODE_MEASURE	0		// Only counts, arrays at their capacity.
+#define SNAP_MODE_SAVE		1
+#define SNAP_MODE_RESTORE	2
+
+typedef struct snap_cursor_t
+{
+	uchar mode;
+	uchar* blob;
+	uint size;
+} snap_cursor_t;
+
+static uint generation;
+
+void SNAP_NewScene(void)
+{
+	generation++;
+}
+
+static void SNAP_Region(snap_cursor_t* cursor, void* data, uint size)
+{
+	if (cursor->mode == SNAP_MODE_SAVE)
+		memcpy(cursor->blob + cursor->size, data, size);
+	else if (cursor->mode == SNAP_MODE_RESTORE)
+		memcpy(data, cursor->blob + cursor->size, size);
+
+	cursor->size += size;
+}
+
+// count has to be transferred before the array: on restore it is already the saved one.
+static void SNAP_Array(snap_cursor_t* cursor, void* data, uint elementSize, uint count, uint capacity)
+{
+	SNAP_Region(cursor, data, elementSize * (cursor->mode == SNAP_MODE_MEASURE ? capacity : count));
+}
+
+#define SNAP_VAR(cursor, var) SNAP_Region(cursor, &(var), sizeof(var))
+
+// The only description of the layout: measure, save and restore all walk it.
+static void SNAP_Transfer(snap_cursor_t* cursor)
+{
+	int i;
+	entity_t* entity;
+
+	//Time and random numbers
+	SNAP_VAR(cursor, simulationTime);
+	SNAP_VAR(cursor, timediff);
+	SNAP_VAR(cursor, frameCounter);
+	SNAP_VAR(cursor, extraPrecision);
+	SNAP_VAR(cursor, randomState);
+
+	//Players, with their bullets, ghosts and autopilot
+	SNAP_VAR(cursor, numPlayers);
+	SNAP_Array(cursor, players, sizeof(player_t), numPlayers, MAX_NUM_PLAYERS);
+	SNAP_VAR(cursor, controlledPlayer);
+	SNAP_VAR(cursor, entitiesAttachedToCamera);
+	SNAP_VAR(cursor, engine.playerStats);
+
+	//Enemies
+	SNAP_VAR(cursor, rootEnemy);
+	SNAP_VAR(cursor, enemies);
+	SNAP_VAR(cursor, numFreeEnemies);
+	SNAP_VAR(cursor, freeEnemies);
+	SNAP_VAR(cursor, uniqueIdGenerator);
+
+	SNAP_VAR(cursor, partLib.numParticules);
+	SNAP_Array(cursor, partLib.particules, sizeof(enemy_part_t), partLib.numParticules, MAX_NUM_ENEMY_PARTICULES);
+
+	SNAP_VAR(cursor, enFxLib.num_vertices);
+	SNAP_VAR(cursor, enFxLib.num_indices);
+	SNAP_Array(cursor, enFxLib.ss_vertices, sizeof(xf_sprite_t), enFxLib.num_vertices, 4*MAX_NUM_ENEMY_FX);
+
+	//FX pools
+	SNAP_VAR(cursor, rootExplosion);
+	SNAP_VAR(cursor, explosions);
+	SNAP_VAR(cursor, numFreeExplosions);
+	SNAP_VAR(cursor, freeExplosions);
+
+	SNAP_VAR(cursor, rootParticule);
+	SNAP_VAR(cursor, particules);
+	SNAP_VAR(cursor, numFreeParticules);
+	SNAP_VAR(cursor, freeParticules);
+
+	SNAP_VAR(cursor, rootSmoke);
+	SNAP_VAR(cursor, smokes);
+	SNAP_VAR(cursor, numFreeSmokes);
+	SNAP_VAR(cursor, freeSmokes);
+
+	//Events
+	SNAP_VAR(cursor, timelineCursor);
+	SNAP_VAR(cursor, cancelSpawnsUntil);
+	SNAP_VAR(cursor, runtimeSequence);
+	SNAP_VAR(cursor, numRuntimeEvents);
+	SNAP_Array(cursor, runtimeEvents, sizeof(ev_runtime_event_t), numRuntimeEvents, EV_MAX_RUNTIME_EVENTS);
+
+	//Camera
+	SNAP_VAR(cursor, camera.position);
+	SNAP_VAR(cursor, camera.forward);
+	SNAP_VAR(cursor, camera.right);
+	SNAP_VAR(cursor, camera.up);
+	SNAP_VAR(cursor, camera.playing);
+	SNAP_VAR(cursor, camera.currentFrame);
+
+	//Visible faces of the map, VIS_Update applies deltas to them.
+	for (i=0; i < num_map_entities; i++)
+	{
+		entity = &map[i];
+		if (!entity->indices)
+			continue;
+
+		SNAP_VAR(cursor, entity->numIndices);
+		SNAP_Array(cursor, entity->indices, sizeof(ushort), entity->numIndices, entity->model->numIndices);
+	}
+}
+
+uint SNAP_MaxSize(void)
+{
+	snap_cursor_t cursor;
+
+	cursor.mode = SNAP_MODE_MEASURE;
+	cursor.blob = NULL;
+	cursor.size = sizeof(snap_header_t);
+
+	SNAP_Transfer(&cursor);
+
+	return cursor.size;
+}
+
+uint SNAP_Save(uchar* blob, uint capacity)
+{
+	snap_cursor_t cursor;
+	snap_header_t header;
+
+	if (capacity < SNAP_MaxSize())
+		return 0;
+
+	cursor.mode = SNAP_MODE_SAVE;
+	cursor.blob = blob;
+	cursor.size = sizeof(snap_header_t);
+
+	SNAP_Transfer(&cursor);
+
+	header.magic = SNAP_MAGIC;
+	header.generation = generation;
+	header.size = cursor.size;
+	memcpy(blob, &header, sizeof(header));
+
+	return cursor.size;
+}
+
+char SNAP_Restore(const uchar* blob)
+{
+	snap_cursor_t cursor;
+	snap_header_t header;
+
+	memcpy(&header, blob, sizeof(header));
+
+	if (header.magic != SNAP_MAGIC || header.generation != generation)
+	{
+		Log_Printf("[SNAP_Restore] Snapshot is not from the current scene, ignored.\n");
+		return 0;
+	}
+
+	//Restore only reads the blob.
+	cursor.mode = SNAP_MODE_RESTORE;
+	cursor.blob = (uchar*)blob;
+	cursor.size = sizeof(snap_header_t);
+
+	SNAP_Transfer(&cursor);
+
+	return 1;
+}
+
+static unsigned long long SNAP_HashBytes(unsigned long long hash, const void* data, uint size)
+{
+	const uchar* bytes = (const uchar*)data;
+	uint i;
+
+	for (i=0; i < size; i++)
+		hash = (hash ^ bytes[i]) * SNAP_FNV_PRIME;
+
+	return hash;
+}
+
+#define SNAP_HASH(hash, var) hash = SNAP_HashBytes(hash, &(var), sizeof(var))
+
+unsigned long long SNAP_Hash(void)
+{
+	unsigned long long hash;
+	int i, j;
+	player_t* player;
+	bullet_t* bullet;
+	ghost_t* ghost;
+	enemy_t* enemy;
+	enemy_part_t* particule;
+
+	hash = SNAP_FNV_OFFSET;
+
+	SNAP_HASH(hash, simulationTime);
+	SNAP_HASH(hash, randomState);
+
+	for (i=0; i < numPlayers; i++)
+	{
+		player = &players[i];
+
+		SNAP_HASH(hash, player->ss_position);
+		SNAP_HASH(hash, player->score);
+		SNAP_HASH(hash, player->invulnerableFor);
+		SNAP_HASH(hash, player->respawnCounter);
+		SNAP_HASH(hash, player->nextBulletFireTime);
+		SNAP_HASH(hash, player->nextGhostFireTime);
+		SNAP_HASH(hash, player->autopilot.enabled);
+		SNAP_HASH(hash, player->autopilot.timeCounter);
+
+		for (j=0; j < MAX_PLAYER_BULLETS; j++)
+		{
+			bullet = &player->bullets[j];
+			SNAP_HASH(hash, bullet->expirationTime);
+			SNAP_HASH(hash, bullet->ss_boudaries);
+			SNAP_HASH(hash, bullet->energy);
+		}
+
+		for (j=0; j < GHOSTS_NUM; j++)
+		{
+			ghost = &player->ghosts[j];
+			SNAP_HASH(hash, ghost->ss_position);
+			SNAP_HASH(hash, ghost->energy);
+			SNAP_HASH(hash, ghost->timeCounter);
+			SNAP_HASH(hash, ghost->targetUniqueId);
+		}
+	}
+
+	for (enemy = ENE_GetFirstEnemy(); enemy != NULL; enemy = enemy->next)
+	{
+		SNAP_HASH(hash, enemy->uniqueId);
+		SNAP_HASH(hash, enemy->type);
+		SNAP_HASH(hash, enemy->ss_position);
+		SNAP_HASH(hash, enemy->energy);
+		SNAP_HASH(hash, enemy->ttl);
+		SNAP_HASH(hash, enemy->state);
+	}
+
+	SNAP_HASH(hash, partLib.numParticules);
+	for (i=0; i < partLib.numParticules; i++)
+	{
+		particule = &partLib.particules[i];
+		SNAP_HASH(hash, particule->ttl);
+		SNAP_HASH(hash, particule->ss_boudaries);
+	}
+
+	SNAP_HASH(hash, numFreeExplosions);
+	SNAP_HASH(hash, numFreeParticules);
+	SNAP_HASH(hash, numFreeSmokes);
+
+	SNAP_HASH(hash, timelineCursor);
+	SNAP_HASH(hash, numRuntimeEvents);
+
+	SNAP_HASH(hash, camera.position);
+
+	for (i=0; i < num_map_entities; i++)
+		SNAP_HASH(hash, map[i].numIndices);
+
+	return hash;
+}
@@ -0,0 +1,79 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  snapshot.h
+ *  dEngine
+ *
+ *  Save and restore of the simulation state.
+ *
+ */
+
+#ifndef DE_SNAPSHOT
+#define DE_SNAPSHOT
+
+#include "globals.h"
+
+/*
+	A snapshot is the state of the running scene in one flat blob: players
+	(bullets, ghosts, autopilot), the enemy pool, partLib and enFxLib, the
+	explosion/particule/smoke pools, the event cursor and runtime events,
+	the camera and its current frame, the visible faces of map[], the
+	simulation time and the random state.
+
+	Pools are saved whole with their links. These pointers stay valid until
+	the scene is reloaded, so a snapshot from an earlier scene load is
+	refused. Sprite vertices of bullets, ghosts, explosions, particules and
+	smoke are not saved, each frame rebuilds them: restore between two
+	dEngine_HostFrame.
+
+	Layout (native endianness, only meaningful to this process):
+
+		snap_header_t
+		regions         In the order of SNAP_Transfer, arrays cut to their counts.
+
+	No pointer points inside the blob: it can be memcpy'd around (rollback
+	ring, checkpoint) and restored from any copy.
+
+	SNAP_Hash digests gameplay values only, no pointers and no padding, so
+	two runs or two peers fed the same inputs can be compared.
+*/
+
+#define SNAP_MAGIC		0x50414E53	// "SNAP"
+
+typedef struct snap_header_t
+{
+	int magic;
+	uint generation;		// Scene load the snapshot belongs to.
+	uint size;				// Of the whole blob, header included.
+} snap_header_t;
+
+// A scene was loaded: every snapshot taken until now becomes invalid.
+void SNAP_NewScene(void);
+
+// Largest blob the current scene can produce.
+uint SNAP_MaxSize(void);
+
+// Returns the size written, 0 if capacity is too small.
+uint SNAP_Save(uchar* blob, uint capacity);
+
+// Returns 0 if the blob does not belong to the current scene load.
+char SNAP_Restore(const uchar* blob);
+
+// FNV-1a of the gameplay state.
+unsigned long long SNAP_Hash(void);
+
+#endif
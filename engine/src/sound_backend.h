@@ -15,5 +15,5 @@
 
 void SND_BACKEND_Upload(sound_t* sound, int soundID);
 void SND_BACKEND_Init(void );
-void SND_BACKEND_Play(int sndId);
+void SND_BACKEND_Play(int sndId, float gain);
 #endif
@@ -0,0 +1,329 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  sound_mixer.c
+ *  dEngine
+ *
+ *  Software mixer for the sound effects.
+ *
+ */
+
+#include "sound_mixer.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define SND_MIXER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define SND_MIXER_NEON
+#endif
+
+// The command ring must publish a command before its index (and the reverse on the other side).
+#if defined(_MSC_VER)
+	#include <intrin.h>
+	#define SND_MIXER_BARRIER() _ReadWriteBarrier()
+#else
+	#define SND_MIXER_BARRIER() __sync_synchronize()
+#endif
+
+typedef struct snd_mixer_sample_t
+{
+	short* data;		// One extra zero sample at the end for the interpolation.
+	uint numSamples;
+	uint rate;
+} snd_mixer_sample_t;
+
+static snd_mixer_sample_t samples[NUM_SOURCES];
+
+void SND_MIXER_Upload(const sound_t* sound, int soundId)
+{
+	snd_mixer_sample_t* sample;
+	uint i, c, numChannels, bytesPerSample;
+	int value;
+	const uchar* src;
+
+	if (soundId < 0 || soundId >= NUM_SOURCES || !sound->data)
+		return;
+
+	sample = &samples[soundId];
+	if (sample->data)
+		return;
+
+	//metaData.sample_size is the size of a frame (all channels).
+	numChannels = sound->metaData.channels ? sound->metaData.channels : 1;
+	bytesPerSample = sound->metaData.sample_size / numChannels;
+	if (bytesPerSample != 1 && bytesPerSample != 2)
+	{
+		Log_Printf("[SND_MIXER_Upload] Sound %d: unsupported sample size %lu.\n",soundId,sound->metaData.sample_size);
+		return;
+	}
+
+	sample->numSamples = sound->metaData.samples;
+	sample->rate = sound->metaData.sample_rate;
+	sample->data = calloc(sample->numSamples + 1, sizeof(short));
+
+	//Mono 16 bits, channels are averaged.
+	src = sound->data;
+	for (i=0; i < sample->numSamples; i++)
+	{
+		value = 0;
+		for (c=0; c < numChannels; c++, src += bytesPerSample)
+		{
+			if (bytesPerSample == 1)
+				value += (src[0] - 128) << 8;
+			else
+				value += (short)(src[0] | (src[1] << 8));
+		}
+		sample->data[i] = value / (int)numChannels;
+	}
+}
+
+void SND_MIXER_Init(snd_mixer_t* mixer, uint rate)
+{
+	memset(mixer, 0, sizeof(snd_mixer_t));
+	mixer->rate = rate;
+}
+
+char SND_MIXER_Play(snd_mixer_t* mixer, int soundId, float gain)
+{
+	snd_mixer_command_t* command;
+	uint head;
+
+	head = mixer->commandHead;
+	if (head - mixer->commandTail == SND_MIXER_QUEUE_SIZE)
+		return 0;
+
+	gain = gain < 0 ? 0 : gain;
+	gain = gain > 7.99f ? 7.99f : gain;
+
+	command = &mixer->commands[head & (SND_MIXER_QUEUE_SIZE-1)];
+	command->soundId = soundId;
+	command->gain = (short)(gain * (1 << SND_MIXER_GAIN_BITS));
+
+	SND_MIXER_BARRIER();
+	mixer->commandHead = head + 1;
+
+	return 1;
+}
+
+static void SND_MIXER_StartVoice(snd_mixer_t* mixer, const snd_mixer_command_t* command)
+{
+	snd_mixer_voice_t* voice;
+	snd_mixer_voice_t* candidate;
+	const snd_mixer_sample_t* sample;
+
+	if (command->soundId < 0 || command->soundId >= NUM_SOURCES)
+		return;
+
+	sample = &samples[command->soundId];
+	if (!sample->data || sample->numSamples == 0)
+		return;
+
+	//A free voice, or the oldest one.
+	voice = &mixer->voices[0];
+	for (candidate = mixer->voices; candidate < mixer->voices + SND_MIXER_MAX_VOICES; candidate++)
+	{
+		if (!candidate->samples)
+		{
+			voice = candidate;
+			break;
+		}
+		if (mixer->numStarted - candidate->startOrder > mixer->numStarted - voice->startOrder)
+			voice = candidate;
+	}
+
+	voice->samples = sample->data;
+	voice->numSamples = sample->numSamples;
+	voice->position = 0;
+	voice->step = (uint)(((unsigned long long)sample->rate << SND_MIXER_FRAC_BITS) / mixer->rate);
+	voice->gain = command->gain;
+	voice->startOrder = mixer->numStarted++;
+}
+
+static void SND_MIXER_ProcessCommands(snd_mixer_t* mixer)
+{
+	uint tail, head;
+
+	head = mixer->commandHead;
+	SND_MIXER_BARRIER();
+
+	for (tail = mixer->commandTail; tail != head; tail++)
+		SND_MIXER_StartVoice(mixer, &mixer->commands[tail & (SND_MIXER_QUEUE_SIZE-1)]);
+
+	SND_MIXER_BARRIER();
+	mixer->commandTail = tail;
+}
+
+// Voice at the output rate: straight multiply-add.
+static void SND_MIXER_AccumulateUnity(int* accumulator, const short* src, uint numFrames, short gain)
+{
+	uint i = 0;
+
+#if defined(SND_MIXER_SSE2)
+	__m128i gains, s, lo, hi;
+
+	gains = _mm_set1_epi16(gain);
+	for (; i + 8 <= numFrames; i += 8)
+	{
+		s = _mm_loadu_si128((const __m128i*)(src + i));
+		lo = _mm_mullo_epi16(s, gains);
+		hi = _mm_mulhi_epi16(s, gains);
+		_mm_storeu_si128((__m128i*)(accumulator + i), _mm_add_epi32(_mm_loadu_si128((__m128i*)(accumulator + i)), _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), SND_MIXER_GAIN_BITS)));
+		_mm_storeu_si128((__m128i*)(accumulator + i + 4), _mm_add_epi32(_mm_loadu_si128((__m128i*)(accumulator + i + 4)), _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), SND_MIXER_GAIN_BITS)));
+	}
+#elif defined(SND_MIXER_NEON)
+	int16x4_t gains;
+	int16x8_t s;
+
+	gains = vdup_n_s16(gain);
+	for (; i + 8 <= numFrames; i += 8)
+	{
+		s = vld1q_s16(src + i);
+		vst1q_s32(accumulator + i, vaddq_s32(vld1q_s32(accumulator + i), vshrq_n_s32(vmull_s16(vget_low_s16(s), gains), SND_MIXER_GAIN_BITS)));
+		vst1q_s32(accumulator + i + 4, vaddq_s32(vld1q_s32(accumulator + i + 4), vshrq_n_s32(vmull_s16(vget_high_s16(s), gains), SND_MIXER_GAIN_BITS)));
+	}
+#endif
+
+	for (; i < numFrames; i++)
+		accumulator[i] += (src[i] * gain) >> SND_MIXER_GAIN_BITS;
+}
+
+// Other rates: linear interpolation, reads one sample past the position (the zero padding at the end).
+static void SND_MIXER_AccumulateResampled(int* accumulator, const short* src, unsigned long long position, uint step, uint numFrames, short gain)
+{
+	uint i, index;
+	int frac, value;
+
+	for (i=0; i < numFrames; i++, position += step)
+	{
+		index = (uint)(position >> SND_MIXER_FRAC_BITS);
+		frac = (int)(position & ((1 << SND_MIXER_FRAC_BITS) - 1)) >> 1;
+		value = src[index] + (((src[index+1] - src[index]) * frac) >> (SND_MIXER_FRAC_BITS - 1));
+		accumulator[i] += (value * gain) >> SND_MIXER_GAIN_BITS;
+	}
+}
+
+static void SND_MIXER_MixVoice(snd_mixer_voice_t* voice, int* accumulator, uint numFrames)
+{
+	unsigned long long end, remaining;
+
+	end = (unsigned long long)voice->numSamples << SND_MIXER_FRAC_BITS;
+	remaining = (end - voice->position + voice->step - 1) / voice->step;
+	if (remaining < numFrames)
+		numFrames = (uint)remaining;
+
+	if (voice->step == 1 << SND_MIXER_FRAC_BITS)
+		SND_MIXER_AccumulateUnity(accumulator, voice->samples + (voice->position >> SND_MIXER_FRAC_BITS), numFrames, voice->gain);
+	else
+		SND_MIXER_AccumulateResampled(accumulator, voice->samples, voice->position, voice->step, numFrames, voice->gain);
+
+	voice->position += (unsigned long long)numFrames * voice->step;
+	if (voice->position >= end)
+		voice->samples = NULL;
+}
+
+static short SND_MIXER_Saturate(int value)
+{
+	value = value > 32767 ? 32767 : value;
+	value = value < -32768 ? -32768 : value;
+	return (short)value;
+}
+
+// stream += accumulator, the mono accumulator goes to every channel.
+static void SND_MIXER_Resolve(const int* accumulator, short* stream, uint numFrames, uint numChannels)
+{
+	uint i = 0, c;
+
+#if defined(SND_MIXER_SSE2)
+	__m128i a, s;
+
+	if (numChannels == 1)
+	{
+		for (; i + 8 <= numFrames; i += 8)
+		{
+			s = _mm_loadu_si128((const __m128i*)(stream + i));
+			_mm_storeu_si128((__m128i*)(stream + i), _mm_packs_epi32(
+				_mm_add_epi32(_mm_loadu_si128((const __m128i*)(accumulator + i)), _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)),
+				_mm_add_epi32(_mm_loadu_si128((const __m128i*)(accumulator + i + 4)), _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16))));
+		}
+	}
+	else if (numChannels == 2)
+	{
+		for (; i + 4 <= numFrames; i += 4)
+		{
+			a = _mm_loadu_si128((const __m128i*)(accumulator + i));
+			s = _mm_loadu_si128((const __m128i*)(stream + i * 2));
+			_mm_storeu_si128((__m128i*)(stream + i * 2), _mm_packs_epi32(
+				_mm_add_epi32(_mm_unpacklo_epi32(a, a), _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16)),
+				_mm_add_epi32(_mm_unpackhi_epi32(a, a), _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16))));
+		}
+	}
+#elif defined(SND_MIXER_NEON)
+	int32x4x2_t a;
+	int16x8_t s;
+
+	if (numChannels == 1)
+	{
+		for (; i + 8 <= numFrames; i += 8)
+		{
+			s = vld1q_s16(stream + i);
+			vst1q_s16(stream + i, vcombine_s16(
+				vqmovn_s32(vaddq_s32(vld1q_s32(accumulator + i), vmovl_s16(vget_low_s16(s)))),
+				vqmovn_s32(vaddq_s32(vld1q_s32(accumulator + i + 4), vmovl_s16(vget_high_s16(s))))));
+		}
+	}
+	else if (numChannels == 2)
+	{
+		for (; i + 4 <= numFrames; i += 4)
+		{
+			a = vzipq_s32(vld1q_s32(accumulator + i), vld1q_s32(accumulator + i));
+			s = vld1q_s16(stream + i * 2);
+			vst1q_s16(stream + i * 2, vcombine_s16(
+				vqmovn_s32(vaddq_s32(a.val[0], vmovl_s16(vget_low_s16(s)))),
+				vqmovn_s32(vaddq_s32(a.val[1], vmovl_s16(vget_high_s16(s))))));
+		}
+	}
+#endif
+
+	for (; i < numFrames; i++)
+		for (c=0; c < numChannels; c++)
+			stream[i * numChannels + c] = SND_MIXER_Saturate(stream[i * numChannels + c] + accumulator[i]);
+}
+
+void SND_MIXER_Render(snd_mixer_t* mixer, short* stream, uint numFrames, uint numChannels)
+{
+	snd_mixer_voice_t* voice;
+	uint blockFrames;
+
+	SND_MIXER_ProcessCommands(mixer);
+
+	while (numFrames > 0)
+	{
+		blockFrames = numFrames < SND_MIXER_BLOCK_FRAMES ? numFrames : SND_MIXER_BLOCK_FRAMES;
+
+		memset(mixer->accumulator, 0, blockFrames * sizeof(int));
+
+		for (voice = mixer->voices; voice < mixer->voices + SND_MIXER_MAX_VOICES; voice++)
+			if (voice->samples)
+				SND_MIXER_MixVoice(voice, mixer->accumulator, blockFrames);
+
+		SND_MIXER_Resolve(mixer->accumulator, stream, blockFrames, numChannels);
+
+		stream += blockFrames * numChannels;
+		numFrames -= blockFrames;
+	}
+}
@@ -0,0 +1,100 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  sound_mixer.h
+ *  dEngine
+ *
+ *  Software mixer for the sound effects.
+ *
+ */
+
+#ifndef DE_SOUND_MIXER
+#define DE_SOUND_MIXER
+
+#include "globals.h"
+#include "sounds.h"
+
+/*
+	Platforms without an OpenAL/OpenSL backend mix the sound effects
+	themselves, and GENERATE_VIDEO uses a second mixer to render the
+	soundtrack offline.
+
+	Sounds are converted once to mono 16 bits at upload and shared by every
+	mixer. A mixer owns a pool of SND_MIXER_MAX_VOICES voices, each with its
+	own gain and resampling step (16.16 fixed point, linear interpolation).
+	When every voice is busy the oldest one is stolen.
+
+	SND_MIXER_Play only pushes a command in a single producer / single
+	consumer ring: the game thread never touches the voices and the audio
+	thread never waits on a lock. Commands are applied at the start of the
+	next SND_MIXER_Render.
+
+	Mixing runs per block of SND_MIXER_BLOCK_FRAMES into 32 bits
+	accumulators: the length a voice plays in a block is computed once, so
+	the sample loops have no branch. Voices at the output rate and the final
+	saturation use SSE2 or NEON when available.
+*/
+
+#define SND_MIXER_MAX_VOICES	16
+#define SND_MIXER_QUEUE_SIZE	64		// Power of two.
+#define SND_MIXER_BLOCK_FRAMES	256
+
+#define SND_MIXER_GAIN_BITS		12		// Gains are Q12: 1.0 is 4096, up to 7.99.
+#define SND_MIXER_FRAC_BITS		16
+
+typedef struct snd_mixer_command_t
+{
+	int soundId;
+	short gain;
+} snd_mixer_command_t;
+
+typedef struct snd_mixer_voice_t
+{
+	const short* samples;				// NULL when the voice is free.
+	uint numSamples;
+	unsigned long long position;		// 16.16 in samples.
+	uint step;							// 16.16, source rate / output rate.
+	short gain;
+	uint startOrder;
+} snd_mixer_voice_t;
+
+typedef struct snd_mixer_t
+{
+	uint rate;
+
+	snd_mixer_voice_t voices[SND_MIXER_MAX_VOICES];
+	uint numStarted;
+
+	snd_mixer_command_t commands[SND_MIXER_QUEUE_SIZE];
+	volatile uint commandHead;			// Written by SND_MIXER_Play only.
+	volatile uint commandTail;			// Written by SND_MIXER_Render only.
+
+	int accumulator[SND_MIXER_BLOCK_FRAMES];
+} snd_mixer_t;
+
+// Converts a loaded wav, sound->data is not kept. Does nothing if the sound is already uploaded.
+void SND_MIXER_Upload(const sound_t* sound, int soundId);
+
+void SND_MIXER_Init(snd_mixer_t* mixer, uint rate);
+
+// Game thread. Returns 0 if the command queue is full.
+char SND_MIXER_Play(snd_mixer_t* mixer, int soundId, float gain);
+
+// Audio thread. Adds the voices to numFrames interleaved frames of stream, saturated to 16 bits.
+void SND_MIXER_Render(snd_mixer_t* mixer, short* stream, uint numFrames, uint numChannels);
+
+#endif
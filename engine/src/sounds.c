@@ -29,19 +29,25 @@
 #include "dEngine.h"
 #include "timer.h"
 #include "sound_backend.h"
+#include "sound_mixer.h"
 
 
-sound_t sounds[8];
+sound_t sounds[NUM_SOURCES];
 
+snd_frame_counters_t frameCounters;
 
 
 
 
-void SND_Load(char* filename,int soundID)
+
+void SND_Load(char* filename,int soundID,int priority,int restartDelay)
 {
     
     sound_t* sound = &sounds[soundID] ;
 	
+	sound->priority = priority;
+	sound->restartDelay = restartDelay;
+	
 	if (!LoadWavInfo(filename, &sound->data, &sound->metaData ))
 			Log_Printf("[SND_Load] Unable to load sound: '%s'.\n",filename);
 	
@@ -82,13 +88,12 @@ void SND_Load(char* filename,int soundID)
 	
 	SND_BACKEND_Upload(sound,soundID);
 	
+#ifdef GENERATE_VIDEO
+	SND_MIXER_Upload(sound,soundID);
+#endif
 	
-#ifndef GENERATE_VIDEO
 	free(sound->data);
 	sound->data=0;
-#else
-	Log_Printf("Warning, not freeing WAV after openAL upload.\n");
-#endif
     
     Log_Printf("Sound %s has been loaded (%d bytes).\n",filename,sound->size);
 }
@@ -98,10 +103,11 @@ void SND_Load(char* filename,int soundID)
 
 void SND_LoadsSoundLibrary(void )
 {
-	SND_Load("data/sfx/plasma.wav", SND_PLASMA);
-	SND_Load("data/sfx/explosionShort.wav", SND_EXPLOSION);
-	SND_Load("data/sfx/ghostLauch.wav", SND_GHOST_LAUNCH);
-	SND_Load("data/sfx/enemy_shot.wav", SND_ENEMY_SHOT);
+	//Player actions first, they answer an input.
+	SND_Load("data/sfx/plasma.wav", SND_PLASMA, 2, 0);
+	SND_Load("data/sfx/explosionShort.wav", SND_EXPLOSION, 1, 120);
+	SND_Load("data/sfx/ghostLauch.wav", SND_GHOST_LAUNCH, 3, 0);
+	SND_Load("data/sfx/enemy_shot.wav", SND_ENEMY_SHOT, 0, 80);
 }
 
 
@@ -123,196 +129,139 @@ int SND_Init(void)
 }
 
 
+#ifdef GENERATE_VIDEO
+// The soundtrack is mixed offline, in step with the simulation, by a mixer of its own.
+#define SND_RECORD_RATE		44100
+#define SND_RECORD_FILENAME	"audioTrack.wav"
+
+char recordStarted;
+snd_mixer_t recordMixer;
+wavWriter_t recordWriter;
+short recordBuffer[SND_MIXER_BLOCK_FRAMES];
+unsigned long long recordedTime;		//In ms, sum of the frames timediff.
+unsigned long long recordedFrames;
+#endif
+
+
 //char currentChannel=0;
 void SND_PlaySound(int sndId)
 {
-    sound_t* sound;
-    
-    sound = &sounds[sndId];
-    
-    sound->lastTimePlayed = simulationTime;
-    
-    SND_BACKEND_Play(sndId);
-    
+    sounds[sndId].pendingTriggers++;
 }
 
-
-uchar* audioTrack=0;
-unsigned int sizeAudioTrack ;
-
-void SND_UpdateRecord(void)
+// Sounds of re-simulated frames were already heard.
+void SND_ClearPendingSounds(void)
 {
-#ifdef GENERATE_VIDEO
-	
-	int numFrameToWrite= 0;
 	int i;
-	short sndValue;
-	char numActiveChannel=0;
 	
+	for (i=0; i < NUM_SOURCES; i++)
+		sounds[i].pendingTriggers = 0;
+}
 
-	// DEPRECATED, we now run timestep=16 and timestep = 17 in order to achieve (timestep 16.6666667ms)
-	// DEPRECATED, we now run timestep=16 and timestep = 17 in order to achieve (timestep 16.6666667ms)
-	// We are doing a few weird things here: The game simulate time at 16ms timestep but the iPhone screen runs at 60Hz (timestep 16.6666667ms)
-	// This is not an issue during the game but it is when generating a soundtrack frame by frame.
-	// Quicktime can only import at 60fps so we should not assume the video time with  timediff or simulationTime to generate the soundtrack.
-	// We need to generate sounds for the realtime of the frame not the simulation time.
-	// DEPRECATED, we now run timestep=16 and timestep = 17 in order to achieve (timestep 16.6666667ms)
-	// DEPRECATED, we now run timestep=16 and timestep = 17 in order to achieve (timestep 16.6666667ms)
-	// DEPRECATED, we now run timestep=16 and timestep = 17 in order to achieve (timestep 16.6666667ms)
+void SND_Update(void)
+{
+	int order[NUM_SOURCES];
+	int numPending;
+	int i, j;
+	sound_t* sound;
+	uint triggers;
+	long long elapsed;
+	float gain;
 	
-	numFrameToWrite = timediff * 22050/1000; 
-
+	memset(&frameCounters, 0, sizeof(frameCounters));
 	
-	if (audioTrack == 0)
+	//Pending sounds by decreasing priority.
+	numPending = 0;
+	for (i=0; i < NUM_SOURCES; i++)
 	{
-		audioTrack = malloc(22050*240 * sizeof(uchar));
-		memset(audioTrack,127,22050*240*sizeof(uchar));
+		if (!sounds[i].pendingTriggers)
+			continue;
+		
+		frameCounters.triggers += sounds[i].pendingTriggers;
+		
+		for (j=numPending; j > 0 && sounds[order[j-1]].priority < sounds[i].priority; j--)
+			order[j] = order[j-1];
+		order[j] = i;
+		numPending++;
 	}
-	//We need to generate the next frames for the amount timediff milliseconds.
-
-	//Log_Printf("%ld.\n",sounds[SND_PLASMA].metaData.samples);
-
-	/*
-	if (sounds[SND_PLASMA].lastTimePlayed > 0)
-	Log_Printf("(simulationTime - sounds[SND_PLASMA].lastTimePlayed) * (22050.0/1000)=%d\n",(simulationTime - sounds[SND_PLASMA].lastTimePlayed) * (22050/1000));
-	*/
 	
-	for (i=0; i < numFrameToWrite; i++) 
+	for (i=0; i < numPending; i++)
 	{
-		sndValue = 0;
-		numActiveChannel=0;
-		// Generate sound's frame position and mix them
-		if (((simulationTime - sounds[SND_PLASMA].lastTimePlayed) * (22050.0/1000)+i) < sounds[SND_PLASMA].metaData.samples) 
-		{
-			sndValue = sounds[SND_PLASMA].data[((simulationTime - sounds[SND_PLASMA].lastTimePlayed)*22050/1000)+i];
-			numActiveChannel++;
-			//Log_Printf("Writing plasma [%i]\n",sounds[SND_PLASMA].data[((simulationTime - sounds[SND_PLASMA].lastTimePlayed)*22050/1000)+i);
-		}
-
-		if (((simulationTime - sounds[SND_EXPLOSION].lastTimePlayed) * (22050.0/1000)+i) < sounds[SND_EXPLOSION].metaData.samples)
-		{
-			sndValue += sounds[SND_EXPLOSION].data[((simulationTime - sounds[SND_EXPLOSION].lastTimePlayed)*22050/1000)+i];
-			numActiveChannel++;
-			//Log_Printf("Writing plasma [ %d/%ld]\n",((simulationTime - sounds[SND_PLASMA].lastTimePlayed)*22050/1000)+i,sounds[SND_PLASMA].metaData.samples);
-		}
+		sound = &sounds[order[i]];
 		
-		if (((simulationTime - sounds[SND_GHOST_LAUNCH].lastTimePlayed) * (22050.0/1000)+i) < sounds[SND_GHOST_LAUNCH].metaData.samples)
-		{
-			sndValue += sounds[SND_GHOST_LAUNCH].data[((simulationTime - sounds[SND_GHOST_LAUNCH].lastTimePlayed)*22050/1000)+i];
-			numActiveChannel++;
-			//Log_Printf("Writing plasma [ %d/%ld]\n",((simulationTime - sounds[SND_PLASMA].lastTimePlayed)*22050/1000)+i,sounds[SND_PLASMA].metaData.samples);
-		}
+		triggers = sound->pendingTriggers < SND_COALESCE_MAX ? sound->pendingTriggers : SND_COALESCE_MAX;
+		sound->pendingTriggers = 0;
 		
-		if (((simulationTime - sounds[SND_ENEMY_SHOT].lastTimePlayed) * (22050.0/1000)+i) < sounds[SND_ENEMY_SHOT].metaData.samples)
+		elapsed = (long long)simulationTime - sound->lastTimePlayed;
+		
+		if (frameCounters.plays == SND_MAX_PLAYS_PER_FRAME ||
+			(elapsed >= 0 && elapsed < sound->restartDelay && triggers <= sound->playingTriggers))
 		{
-			sndValue += sounds[SND_ENEMY_SHOT].data[((simulationTime - sounds[SND_ENEMY_SHOT].lastTimePlayed)*22050/1000)+i];
-			numActiveChannel++;
-			//Log_Printf("Writing plasma [ %d/%ld]\n",((simulationTime - sounds[SND_PLASMA].lastTimePlayed)*22050/1000)+i,sounds[SND_PLASMA].metaData.samples);
+			frameCounters.dropped++;
+			continue;
 		}
 		
-		if (numActiveChannel)
-			sndValue /= numActiveChannel;												   
-		else {
-			sndValue = 127;
-		}
-
-		//Log_Printf("Writing %uc\n",sndValue);
-		audioTrack[simulationTime * 22050/1000 +i] = sndValue ;
+		gain = SND_DEFAULT_GAIN * (1 + SND_COALESCE_BOOST * (triggers - 1));
+		
+		sound->lastTimePlayed = simulationTime;
+		sound->playingTriggers = triggers;
 		
+		SND_BACKEND_Play(order[i], gain);
+#ifdef GENERATE_VIDEO
+		SND_MIXER_Play(&recordMixer, order[i], gain);
+#endif
+		frameCounters.plays++;
 	}
-	sizeAudioTrack+=i;
-	
-	
-#endif	
 }
 
-#define WAVE_FORMAT_PCM			0x0001		
-#define WAVE_FORMAT_IEEE_FLOAT	0x0003	
-#define WAVE_FORMAT_ALAW		0x0006	
-#define WAVE_FORMAT_MULAW		0x0007
-#define WAVE_FORMAT_EXTENSIBLE	0xFFFE
-
-typedef struct master_riff_chnk_t
-{
-	char			ckID[4];
-	unsigned int	cksize;
-	char			WAVEID[4];
-} master_riff_chnk_t;
-
-typedef struct fmt_chunk_t
+const snd_frame_counters_t* SND_GetFrameCounters(void)
 {
-	char			ckID[4];
-	unsigned int	cksize;
-	unsigned short	wFormatTag;//	 2	 WAVE_FORMAT_PCM
-	unsigned short	nChannels;//	 2	Nc
-	unsigned int	nSamplesPerSec;//	 4	F
-	unsigned int	nAvgBytesPerSec;//	 4	F * M * Nc
-	unsigned short	nBlockAlign	;// 2	M * Nc
-	unsigned short	wBitsPerSample;//	 2	rounds up to 8 * M
-	
-} fmt_chunk_t;
+	return &frameCounters;
+}
 
-typedef struct basic_chunk_t
-{
-	char			ckID[4];
-	unsigned int	cksize;
-} basic_chunk_t;
 
-typedef struct wave_file_t
-{
-	master_riff_chnk_t riff;
-	fmt_chunk_t fmt;
-	basic_chunk_t dataChunk;
-} wave_file_t ;
 
-#define SOUND_TRACK_LOCATION "/Users/fabiensanglard/Pictures/dEngine/audioTrack.wav"
-
-void SND_FinalizeRecord(void)
+void SND_UpdateRecord(void)
 {
-#ifdef GENERATE_VIDEO	
-	wave_file_t waveFile;
-	filehandle_t* f;
-	
-	
-	
-	memset(&waveFile,0,sizeof(waveFile));
-	
-	waveFile.riff.cksize =  4 + 24 + (8 + sizeAudioTrack);  //4(dataChunk header) + 24(fmt header) + 8 (riff header) + data payload
-	memcpy(waveFile.riff.ckID,"RIFF",4);
-    memcpy(waveFile.riff.WAVEID,"WAVE",4);
-	
-	waveFile.dataChunk.cksize = sizeAudioTrack;
-	memcpy(waveFile.dataChunk.ckID,"data",4);
-	
-	memcpy(waveFile.fmt.ckID,"fmt ",4);
-	waveFile.fmt.cksize = 16;
-	waveFile.fmt.wFormatTag = WAVE_FORMAT_PCM;
-	waveFile.fmt.nChannels = 1;
-	waveFile.fmt.nSamplesPerSec = 22050;
-	waveFile.fmt.wBitsPerSample = 8;
-	waveFile.fmt.nBlockAlign = waveFile.fmt.wBitsPerSample/8 * waveFile.fmt.nChannels;
-	waveFile.fmt.nAvgBytesPerSec = waveFile.fmt.nSamplesPerSec * waveFile.fmt.wBitsPerSample/8 * waveFile.fmt.nChannels;
-
-	
+#ifdef GENERATE_VIDEO
+	unsigned long long targetFrames;
+	uint numFrames;
 	
+	if (!recordStarted)
+	{
+		recordStarted = 1;
+		SND_MIXER_Init(&recordMixer, SND_RECORD_RATE);
+		if (!Wav_OpenWriter(&recordWriter, SND_RECORD_FILENAME, SND_RECORD_RATE, 1))
+			Log_Printf("[SND_UpdateRecord] Could not create '%s', no soundtrack.\n",SND_RECORD_FILENAME);
+	}
 	
+	if (!recordWriter.file)
+		return;
 	
-	//Write file on disk
-	f = FS_OpenFile(SOUND_TRACK_LOCATION, "wb");
+	//Timesteps alternate 16 and 17ms, the track follows the exact sum instead of 60Hz frames.
+	//Sounds played during the frame start at the first sample after this one.
+	recordedTime += timediff;
+	targetFrames = recordedTime * SND_RECORD_RATE / 1000;
 	
-	if (!f)
+	while (recordedFrames < targetFrames)
 	{
-		Log_Printf("Error creating file %s .\n",SOUND_TRACK_LOCATION);
+		numFrames = (uint)(targetFrames - recordedFrames);
+		if (numFrames > SND_MIXER_BLOCK_FRAMES)
+			numFrames = SND_MIXER_BLOCK_FRAMES;
+		
+		memset(recordBuffer, 0, numFrames * sizeof(short));
+		SND_MIXER_Render(&recordMixer, recordBuffer, numFrames, 1);
+		Wav_Write(&recordWriter, recordBuffer, numFrames);
+		
+		recordedFrames += numFrames;
 	}
-	
-	FS_Write(&waveFile, 1, sizeof(wave_file_t), f);
-	//fwrite(&waveFile.fmt, 1, sizeof(fmt_chunk_t), f);
-	FS_Write(audioTrack, 1, sizeAudioTrack, f);
-	FS_CloseFile(f);
-	
-	//free(audioTrack);
-	//audioTrack=0;
-#endif
+#endif	
 }
 
-
+//The track is complete at every pause, recording goes on after.
+void SND_FinalizeRecord(void)
+{
+#ifdef GENERATE_VIDEO	
+	Wav_UpdateHeader(&recordWriter);
+#endif
+}
@@ -39,6 +39,18 @@
 
 #define NUM_SOURCES 8
 
+/*
+	SND_PlaySound only counts a trigger, SND_Update plays them once per
+	frame: identical triggers of a frame become one louder play, the sounds
+	are started by priority, at most SND_MAX_PLAYS_PER_FRAME backend calls.
+	A sound still in its restart delay can only be cut by a trigger
+	louder than the one playing, the others are dropped.
+*/
+#define SND_MAX_PLAYS_PER_FRAME	3
+#define SND_DEFAULT_GAIN		0.5f
+#define SND_COALESCE_BOOST		0.15f		// Gain added per extra trigger...
+#define SND_COALESCE_MAX		4			// ...up to this many triggers.
+
 
 #define SND_FORMAT_STEREO16 0
 #define SND_FORMAT_MONO16   1
@@ -60,12 +72,28 @@ typedef struct sound_t
 
 	int lastTimePlayed ;
 	
+	int priority;			// Played first when over budget.
+	int restartDelay;		// ms during which a play cannot be cut by a quieter one.
+	uint pendingTriggers;	// This frame.
+	uint playingTriggers;	// Triggers behind the play in progress.
+	
 } sound_t;
 
+typedef struct snd_frame_counters_t
+{
+	uint triggers;			// SND_PlaySound calls.
+	uint plays;				// Backend calls.
+	uint dropped;			// Sounds not played, over budget or in their restart delay.
+} snd_frame_counters_t;
+
 
 int SND_Init(void);
 void SND_UpdateRecord(void);
 void SND_FinalizeRecord(void);
 void SND_PlaySound(int sndId);
+void SND_Update(void);
+void SND_ClearPendingSounds(void);
+// Of the last SND_Update.
+const snd_frame_counters_t* SND_GetFrameCounters(void);
 
 #endif
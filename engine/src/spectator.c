@@ -0,0 +1,235 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  spectator.c
+ *  dEngine
+ *
+ *  Watching a multiplayer session through its relay.
+ *
+ */
+
+#include "spectator.h"
+#include "rollback.h"
+#include "dEngine.h"
+#include "timer.h"
+
+struct spectator_t
+{
+	net_transport_t transport;
+	uchar numPlayers;
+
+	uint nextBlock;					// First block not decoded.
+	uchar window[SPEC_WINDOW][NETT_MTU];	// Blocks ahead of it, by index % SPEC_WINDOW.
+	uint windowSizes[SPEC_WINDOW];	// 0 for an empty slot.
+	uint windowBlocks[SPEC_WINDOW];
+
+	command_t* frames;				// Decoded and not handed out, by frame then by player.
+	uint firstFrame;				// Of frames[0].
+	uint numFrames;					// Every frame before firstFrame + numFrames was decoded.
+	uint capacity;
+	uint readFrame;					// Next frame to hand out.
+
+	unsigned long long hash;
+};
+
+// Shared by every spectator, only used while a block is decoded.
+static netp_block_t decoded;
+
+spectator_t* SPEC_New(const net_transport_t* transport)
+{
+	spectator_t* spectator;
+
+	spectator = calloc(1, sizeof(spectator_t));
+	spectator->transport = *transport;
+	spectator->hash = NETP_HASH_OFFSET;
+
+	return spectator;
+}
+
+void SPEC_Free(spectator_t* spectator)
+{
+	if (!spectator)
+		return;
+
+	spectator->transport.Close(&spectator->transport);
+	free(spectator->frames);
+	free(spectator);
+}
+
+static void SPEC_AddFrames(spectator_t* spectator, const netp_block_t* block)
+{
+	uint used;
+	uint i;
+
+	//The frames handed out are dropped before the buffer grows.
+	used = spectator->readFrame - spectator->firstFrame;
+	if (used)
+	{
+		memmove(spectator->frames, spectator->frames + used * spectator->numPlayers,
+				(spectator->numFrames - used) * spectator->numPlayers * sizeof(command_t));
+		spectator->firstFrame += used;
+		spectator->numFrames -= used;
+	}
+
+	if (spectator->numFrames + block->numFrames > spectator->capacity)
+	{
+		spectator->capacity = spectator->capacity ? spectator->capacity * 2 : 4 * NETP_MAX_BLOCK_FRAMES;
+		if (spectator->capacity < spectator->numFrames + block->numFrames)
+			spectator->capacity = spectator->numFrames + block->numFrames;
+		spectator->frames = realloc(spectator->frames, spectator->capacity * spectator->numPlayers * sizeof(command_t));
+	}
+
+	//netp_block_t rows are MAX_NUM_PLAYERS wide, the buffer only numPlayers.
+	for (i=0; i < block->numFrames; i++)
+		memcpy(spectator->frames + (spectator->numFrames + i) * spectator->numPlayers, block->commands[i],
+			   spectator->numPlayers * sizeof(command_t));
+	spectator->numFrames += block->numFrames;
+}
+
+// Returns 0 if the block does not follow the previous one.
+static char SPEC_DecodeBlock(spectator_t* spectator, const uchar* buffer, uint size)
+{
+	if (!NETP_DecodeBlock(&decoded, buffer, size) || decoded.index != spectator->nextBlock ||
+		decoded.firstFrame != spectator->firstFrame + spectator->numFrames ||
+		(spectator->numPlayers && decoded.numPlayers != spectator->numPlayers))
+	{
+		Log_Printf("[SPEC_DecodeBlock] Block %u cannot be decoded, dropped.\n",spectator->nextBlock);
+		return 0;
+	}
+
+	spectator->numPlayers = decoded.numPlayers;
+	SPEC_AddFrames(spectator, &decoded);
+	spectator->nextBlock++;
+
+	return 1;
+}
+
+void SPEC_Update(spectator_t* spectator)
+{
+	uchar buffers[NETT_RECV_BATCH][NETT_MTU];
+	int sizes[NETT_RECV_BATCH];
+	uchar ack[NETP_MAX_BLOCK_ACK_SIZE];
+	uint index;
+	uint slot;
+	uint size;
+	char received = 0;
+	int numReceived;
+	int i;
+
+	do
+	{
+		numReceived = spectator->transport.Receive(&spectator->transport, buffers, sizes, NETT_RECV_BATCH);
+
+		for (i=0; i < numReceived; i++)
+		{
+			//Blocks are only decoded once, in order.
+			if (!NETP_DecodeBlockIndex(&index, buffers[i], sizes[i]))
+				continue;
+
+			received = 1;
+
+			if (index < spectator->nextBlock || index >= spectator->nextBlock + SPEC_WINDOW)
+				continue;
+
+			if (index == spectator->nextBlock)
+			{
+				SPEC_DecodeBlock(spectator, buffers[i], sizes[i]);
+				continue;
+			}
+
+			slot = index % SPEC_WINDOW;
+			memcpy(spectator->window[slot], buffers[i], sizes[i]);
+			spectator->windowSizes[slot] = sizes[i];
+			spectator->windowBlocks[slot] = index;
+		}
+	} while (numReceived == NETT_RECV_BATCH);
+
+	//The ones that arrived ahead.
+	for (;;)
+	{
+		slot = spectator->nextBlock % SPEC_WINDOW;
+		if (!spectator->windowSizes[slot] || spectator->windowBlocks[slot] != spectator->nextBlock)
+			break;
+
+		size = spectator->windowSizes[slot];
+		spectator->windowSizes[slot] = 0;
+		if (!SPEC_DecodeBlock(spectator, spectator->window[slot], size))
+			break;
+	}
+
+	//Duplicates are acked too: the previous ack may have been lost.
+	if (received)
+		spectator->transport.Send(&spectator->transport, ack, NETP_EncodeBlockAck(spectator->nextBlock, ack));
+}
+
+uchar SPEC_GetNumPlayers(const spectator_t* spectator)
+{
+	return spectator->numPlayers;
+}
+
+uint SPEC_GetPendingFrames(const spectator_t* spectator)
+{
+	return spectator->firstFrame + spectator->numFrames - spectator->readFrame;
+}
+
+char SPEC_NextFrame(spectator_t* spectator, command_t* commands)
+{
+	const command_t* frame;
+
+	if (spectator->readFrame == spectator->firstFrame + spectator->numFrames)
+		return 0;
+
+	frame = spectator->frames + (spectator->readFrame - spectator->firstFrame) * spectator->numPlayers;
+	memcpy(commands, frame, spectator->numPlayers * sizeof(command_t));
+
+	spectator->hash = NETP_HashCommands(spectator->hash, frame, spectator->numPlayers);
+	spectator->readFrame++;
+
+	return 1;
+}
+
+uint SPEC_GetFrame(const spectator_t* spectator)
+{
+	return spectator->readFrame;
+}
+
+unsigned long long SPEC_GetHash(const spectator_t* spectator)
+{
+	return spectator->hash;
+}
+
+char SPEC_SimulateFrame(spectator_t* spectator)
+{
+	command_t commands[MAX_NUM_PLAYERS];
+	uint frame;
+	int i;
+
+	frame = spectator->readFrame;
+
+	if (!SPEC_NextFrame(spectator, commands))
+		return 0;
+
+	//Played like on the peers, once every command is confirmed.
+	for (i=0; i < spectator->numPlayers; i++)
+		RB_AddRemoteCommand(frame, &commands[i]);
+
+	Timer_Step();
+	RB_BeginFrame();
+	dEngine_SimulateFrame();
+
+	return 1;
+}
@@ -0,0 +1,73 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  spectator.h
+ *  dEngine
+ *
+ *  Watching a multiplayer session through its relay.
+ *
+ */
+
+#ifndef DE_SPECTATOR
+#define DE_SPECTATOR
+
+#include "globals.h"
+#include "nettransport.h"
+#include "netpacket.h"
+
+/*
+	The blocks of the relay (relay.h) are received, put back in order and
+	acked, then handed out one frame at a time: the command of every
+	player, as the peers simulated it.
+
+	A spectator starts from the scene as loaded, with its rollback context
+	started as RB_SPECTATOR, and runs SPEC_SimulateFrame for each frame.
+	One that joins late has the whole log coming and catches up by
+	simulating several frames per host frame, nothing is rendered
+	meanwhile.
+*/
+
+#define SPEC_WINDOW		32		// Blocks kept when they arrive ahead of the missing one, RELAY_WINDOW.
+
+typedef struct spectator_t spectator_t;
+
+// Owns the transport it is given.
+spectator_t* SPEC_New(const net_transport_t* transport);
+void SPEC_Free(spectator_t* spectator);
+
+// Receives the blocks and acks them.
+void SPEC_Update(spectator_t* spectator);
+
+// 0 until the first block arrived.
+uchar SPEC_GetNumPlayers(const spectator_t* spectator);
+
+// Frames received and not handed out yet.
+uint SPEC_GetPendingFrames(const spectator_t* spectator);
+
+// Copies the command of each player of the next frame. Returns 0 if it did not arrive yet.
+char SPEC_NextFrame(spectator_t* spectator, command_t* commands);
+
+// Frames handed out so far.
+uint SPEC_GetFrame(const spectator_t* spectator);
+
+// NETP_HashCommands of the frames handed out.
+unsigned long long SPEC_GetHash(const spectator_t* spectator);
+
+// Steps the timer and runs the next frame, if it arrived. Returns 0 otherwise.
+char SPEC_SimulateFrame(spectator_t* spectator);
+
+#endif
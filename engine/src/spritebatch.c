@@ -0,0 +1,279 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  spritebatch.c
+ *  dEngine
+ *
+ *  Batches the 2D sprites of a frame into one vertex stream.
+ *
+ */
+
+#include "spritebatch.h"
+#include "renderer.h"
+#include "atlas.h"
+
+#define SPR_MAX_BATCHES 64
+
+static xf_sprite_t stream[SPR_MAX_QUADS*4];
+static int numQuads;
+
+static ushort quadIndices[SPR_MAX_QUADS*SPR_QUAD_INDICES];
+
+static spr_batch_t batches[SPR_MAX_BATCHES];
+static int numBatches;
+
+static const texture_t* currentTexture;
+static uint currentTextureId;
+static uchar currentBlend;
+
+void SPR_Init(void)
+{
+	int i;
+	ushort* index;
+
+	// 0  3
+	// 1  2
+	index = quadIndices;
+	for (i=0; i < SPR_MAX_QUADS; i++,index += SPR_QUAD_INDICES)
+	{
+		index[0] = i*4+0;
+		index[1] = i*4+1;
+		index[2] = i*4+2;
+		index[3] = i*4+0;
+		index[4] = i*4+2;
+		index[5] = i*4+3;
+	}
+
+	numQuads = 0;
+	numBatches = 0;
+}
+
+void SPR_Begin(void)
+{
+	numQuads = 0;
+	numBatches = 0;
+
+	currentTexture = NULL;
+	currentTextureId = 0;
+	currentBlend = SPR_BLEND_ALPHA;
+}
+
+void SPR_SetState(const texture_t* texture, uchar blend)
+{
+	currentTexture = texture;
+	currentTextureId = texture->textureId;
+	currentBlend = blend;
+}
+
+void SPR_Flush(void)
+{
+	if (numQuads != 0)
+		renderer.RenderSprites(stream, numQuads, quadIndices, batches, numBatches);
+
+	numQuads = 0;
+	numBatches = 0;
+}
+
+// Returns the 4 vertices of the next quad, opening a batch if the state changed.
+static xf_sprite_t* SPR_AllocQuad(void)
+{
+	spr_batch_t* batch;
+
+	batch = numBatches ? &batches[numBatches-1] : NULL;
+
+	if (numQuads == SPR_MAX_QUADS ||
+		(numBatches == SPR_MAX_BATCHES && (batch->textureId != currentTextureId || batch->blend != currentBlend)))
+	{
+		SPR_Flush();
+		batch = NULL;
+	}
+
+	if (batch == NULL || batch->textureId != currentTextureId || batch->blend != currentBlend)
+	{
+		batch = &batches[numBatches++];
+		batch->textureId = currentTextureId;
+		batch->blend = currentBlend;
+		batch->firstQuad = numQuads;
+		batch->numQuads = 0;
+	}
+
+	batch->numQuads++;
+
+	return &stream[4 * numQuads++];
+}
+
+// Moves the UVs of a quad into the atlas page of the current texture.
+static void SPR_RemapQuad(xf_sprite_t* quad)
+{
+	if (currentTexture == NULL || !currentTexture->inAtlas)
+		return;
+
+	ATL_RemapUV(currentTexture, quad[0].text);
+	ATL_RemapUV(currentTexture, quad[1].text);
+	ATL_RemapUV(currentTexture, quad[2].text);
+	ATL_RemapUV(currentTexture, quad[3].text);
+}
+
+static void SPR_CopyColorless(xf_sprite_t* dst, const xf_colorless_sprite_t* src)
+{
+	dst->pos[X] = src->pos[X];
+	dst->pos[Y] = src->pos[Y];
+	dst->text[X] = src->text[X];
+	dst->text[Y] = src->text[Y];
+	dst->color[R] = dst->color[G] = dst->color[B] = dst->color[A] = 255;
+}
+
+void SPR_AddQuads(const xf_sprite_t* vertices, int count)
+{
+	xf_sprite_t* quad;
+
+	for ( ; count > 0 ; count--, vertices += 4)
+	{
+		quad = SPR_AllocQuad();
+		memcpy(quad, vertices, 4 * sizeof(xf_sprite_t));
+		SPR_RemapQuad(quad);
+	}
+}
+
+void SPR_AddColorlessQuads(const xf_colorless_sprite_t* vertices, int count)
+{
+	xf_sprite_t* quad;
+
+	for ( ; count > 0 ; count--, vertices += 4)
+	{
+		quad = SPR_AllocQuad();
+		SPR_CopyColorless(&quad[0], &vertices[0]);
+		SPR_CopyColorless(&quad[1], &vertices[1]);
+		SPR_CopyColorless(&quad[2], &vertices[2]);
+		SPR_CopyColorless(&quad[3], &vertices[3]);
+		SPR_RemapQuad(quad);
+	}
+}
+
+static char SPR_HasIndex(const ushort* triangle, ushort index)
+{
+	return triangle[0] == index || triangle[1] == index || triangle[2] == index;
+}
+
+/*
+	Reads the next quad of a triangle list. Two consecutive triangles sharing an
+	edge become one quad whose 0-2 diagonal is that edge, so the rasterization is
+	unchanged. A lone triangle becomes a quad with a degenerate second half.
+	Returns the number of indices consumed, 0 at the end of the list.
+*/
+static int SPR_NextQuad(const ushort* indices, int numIndices, ushort quad[4])
+{
+	const ushort* t1;
+	const ushort* t2;
+	int i, u1, u2, numShared;
+	ushort shared[3];
+
+	if (numIndices < 3)
+		return 0;
+
+	t1 = indices;
+
+	if (numIndices >= 6)
+	{
+		t2 = indices + 3;
+
+		numShared = 0;
+		u1 = u2 = -1;
+		for (i=0; i < 3; i++)
+		{
+			if (SPR_HasIndex(t2, t1[i]))
+				shared[numShared++] = t1[i];
+			else
+				u1 = t1[i];
+
+			if (!SPR_HasIndex(t1, t2[i]))
+				u2 = t2[i];
+		}
+
+		if (numShared == 2 && u1 != -1 && u2 != -1)
+		{
+			quad[0] = shared[0];
+			quad[1] = u1;
+			quad[2] = shared[1];
+			quad[3] = u2;
+			return 6;
+		}
+	}
+
+	quad[0] = t1[0];
+	quad[1] = t1[1];
+	quad[2] = t1[2];
+	quad[3] = t1[2];
+	return 3;
+}
+
+void SPR_AddIndexed(const xf_sprite_t* vertices, const ushort* indices, int numIndices)
+{
+	xf_sprite_t* quad;
+	ushort quadVertices[4];
+	int consumed;
+
+	while ((consumed = SPR_NextQuad(indices, numIndices, quadVertices)))
+	{
+		quad = SPR_AllocQuad();
+		quad[0] = vertices[quadVertices[0]];
+		quad[1] = vertices[quadVertices[1]];
+		quad[2] = vertices[quadVertices[2]];
+		quad[3] = vertices[quadVertices[3]];
+		SPR_RemapQuad(quad);
+
+		indices += consumed;
+		numIndices -= consumed;
+	}
+}
+
+void SPR_AddColorlessIndexed(const xf_colorless_sprite_t* vertices, const ushort* indices, int numIndices)
+{
+	xf_sprite_t* quad;
+	ushort quadVertices[4];
+	int consumed;
+
+	while ((consumed = SPR_NextQuad(indices, numIndices, quadVertices)))
+	{
+		quad = SPR_AllocQuad();
+		SPR_CopyColorless(&quad[0], &vertices[quadVertices[0]]);
+		SPR_CopyColorless(&quad[1], &vertices[quadVertices[1]]);
+		SPR_CopyColorless(&quad[2], &vertices[quadVertices[2]]);
+		SPR_CopyColorless(&quad[3], &vertices[quadVertices[3]]);
+		SPR_RemapQuad(quad);
+
+		indices += consumed;
+		numIndices -= consumed;
+	}
+}
+
+void SPR_AddColorlessStrip(const xf_colorless_sprite_t* vertices, int numVertices)
+{
+	xf_sprite_t* quad;
+
+	// 0  1
+	// 2  3   Each step of the strip is split along 1-2, like GL_TRIANGLE_STRIP does.
+	for ( ; numVertices >= 4 ; numVertices -= 2, vertices += 2)
+	{
+		quad = SPR_AllocQuad();
+		SPR_CopyColorless(&quad[0], &vertices[1]);
+		SPR_CopyColorless(&quad[1], &vertices[3]);
+		SPR_CopyColorless(&quad[2], &vertices[2]);
+		SPR_CopyColorless(&quad[3], &vertices[0]);
+		SPR_RemapQuad(quad);
+	}
+}
@@ -0,0 +1,72 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  spritebatch.h
+ *  dEngine
+ *
+ *  Batches the 2D sprites of a frame into one vertex stream.
+ *
+ */
+
+#ifndef DE_SPRITEBATCH
+#define DE_SPRITEBATCH
+
+#include "globals.h"
+#include "fx.h"
+#include "texture.h"
+
+/*
+	Everything is converted to quads (4 vertices, colored) and appended to a
+	single stream. All quads share the same index pattern (SPR_QUAD_INDICES
+	per quad) so the renderer uploads the indices once and only streams the
+	vertices. A new batch starts only when the texture or the blend mode
+	changes; SPR_Flush draws all of them. UVs are relative to the texture
+	given to SPR_SetState and are moved into its atlas page if it has one.
+*/
+
+#define SPR_MAX_QUADS		8192
+#define SPR_QUAD_INDICES	6
+
+#define SPR_BLEND_ALPHA		0		// GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+#define SPR_BLEND_ADD		1		// GL_SRC_ALPHA, GL_ONE
+
+typedef struct spr_batch_t
+{
+	uint textureId;
+	uchar blend;
+	ushort firstQuad;
+	ushort numQuads;
+} spr_batch_t;
+
+void SPR_Init(void);
+
+void SPR_Begin(void);
+void SPR_SetState(const texture_t* texture, uchar blend);
+
+void SPR_AddQuads(const xf_sprite_t* vertices, int count);
+void SPR_AddColorlessQuads(const xf_colorless_sprite_t* vertices, int count);
+
+// Arbitrary triangle lists: triangles sharing an edge are merged back into quads.
+void SPR_AddIndexed(const xf_sprite_t* vertices, const ushort* indices, int numIndices);
+void SPR_AddColorlessIndexed(const xf_colorless_sprite_t* vertices, const ushort* indices, int numIndices);
+
+// Triangle strip made of vertex pairs (ghost trails).
+void SPR_AddColorlessStrip(const xf_colorless_sprite_t* vertices, int numVertices);
+
+void SPR_Flush(void);
+
+#endif
@@ -30,17 +30,24 @@
 #include "timer.h"
 #include "texture.h"
 #include "netchannel.h"
+#include "sounds.h"
+#include "rollback.h"
 
 unsigned int triCount = 0;
 unsigned int textSwitchCount = 0;
 unsigned int shaderSwitchCount = 0;
 unsigned int blendingSwitchCount = 0;
+unsigned int drawnEntityCount = 0;
+unsigned int culledEntityCount = 0;
 
 char fpsText[40]; 
 char teSwText[40]; 
 char drPkText[40]; 
-char netSentText[40];
-char netReceivedText[40];
+char netSentText[64];
+char netReceivedText[64];
+char culledText[40];
+char soundsText[40];
+char rollbackText[64];
 char polCnText[40]; 
 char msText[40]; 
 
@@ -50,6 +57,8 @@ void STATS_Begin()
 	textSwitchCount = 0;
 	shaderSwitchCount = 0;
 	blendingSwitchCount=0;
+	drawnEntityCount = 0;
+	culledEntityCount = 0;
 }
 
 void STATS_AddTriangles(int count)
@@ -60,6 +69,8 @@ void STATS_AddTriangles(int count)
 void STATS_AddTexSwitch(){textSwitchCount++;}
 void STATS_AddShaderSwitch(){shaderSwitchCount++;}
 void STATS_AddBlendingSwitch(){blendingSwitchCount++;}
+void STATS_AddDrawnEntity(void){drawnEntityCount++;}
+void STATS_AddCulledEntity(void){culledEntityCount++;}
 
 #define STATS_FONT_SIZE 2
 void STATS_Render(void)
@@ -77,8 +88,11 @@ void STATS_Render(void)
 	sprintf(drPkText, "Dropped Packets: %u", NET_GetDropedPackets());
 
 
-	sprintf(netSentText,     "Net_Sent: %d", net.lastSentSequenceNumber);
-	sprintf(netReceivedText, "Net_Rcvd: %d", net.lastReceivedSequenceNumber);
+	sprintf(netSentText,     "Net_Sent: %u B/s %u pk/s", net.stats.bytesSent, net.stats.packetsSent);
+	sprintf(netReceivedText, "Net_Rcvd: %u B/s lost %u/%u", net.stats.bytesReceived, net.stats.packetsLost, net.stats.packetsReceived + net.stats.packetsLost);
+	sprintf(culledText, "Culled: %u/%u", culledEntityCount, drawnEntityCount + culledEntityCount);
+	sprintf(soundsText, "Sounds: %u/%u drop %u", SND_GetFrameCounters()->plays, SND_GetFrameCounters()->triggers, SND_GetFrameCounters()->dropped);
+	sprintf(rollbackText, "Rollback: %u/%u max %u stall %u", RB_GetStats()->rollbacks, RB_GetStats()->resimulatedFrames, RB_GetStats()->maxRollback, RB_GetStats()->stalls);
 	
 	
 	
@@ -93,7 +107,10 @@ void STATS_Render(void)
 	SCR_ConvertTextToVertices(drPkText ,STATS_FONT_SIZE,-300,280,TEXT_NOT_CENTERED);
 	SCR_ConvertTextToVertices(netSentText ,STATS_FONT_SIZE,-300,250,TEXT_NOT_CENTERED);
 	SCR_ConvertTextToVertices(netReceivedText ,STATS_FONT_SIZE,-300,220,TEXT_NOT_CENTERED);
+	SCR_ConvertTextToVertices(culledText ,STATS_FONT_SIZE,-300,190,TEXT_NOT_CENTERED);
+	SCR_ConvertTextToVertices(soundsText ,STATS_FONT_SIZE,-300,160,TEXT_NOT_CENTERED);
+	SCR_ConvertTextToVertices(rollbackText ,STATS_FONT_SIZE,-300,130,TEXT_NOT_CENTERED);
 	
-	SCR_RenderText();
+	SCR_BatchText();
 }
 
@@ -31,6 +31,8 @@ void STATS_AddTriangles(int count);
 void STATS_AddTexSwitch();
 void STATS_AddShaderSwitch();
 void STATS_AddBlendingSwitch();
+void STATS_AddDrawnEntity(void);
+void STATS_AddCulledEntity(void);
 
 void STATS_Render();
 
@@ -0,0 +1,222 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  texcache.c
+ *  dEngine
+ *
+ *  Disk cache of the decoded png textures.
+ *
+ */
+
+#include "texcache.h"
+#include "filesystem.h"
+
+#define TCACHE_FNV_OFFSET	0xcbf29ce484222325ULL
+#define TCACHE_FNV_PRIME	0x100000001b3ULL
+
+static char cacheUnavailable;		//The writable directory refused a file: no more attempts this run.
+
+static void TCACHE_GetPath(const tcache_key_t* key, char* path)
+{
+	sprintf(path, "texcache_%08x%08x_%x.tch", (uint)(key->hash >> 32), (uint)(key->hash & 0xFFFFFFFF), key->size);
+}
+
+static void TCACHE_HashFile(const char* pngPath, tcache_key_t* key)
+{
+	filehandle_t* file;
+	const uchar* cursor;
+
+	key->hash = TCACHE_FNV_OFFSET;
+	key->size = 0;
+
+	file = FS_OpenFile(pngPath, "rb");
+	if (!file)
+		return;
+
+	if (FS_UploadToRAM(file))
+	{
+		for (cursor = file->ptrStart; cursor < file->ptrEnd; cursor++)
+			key->hash = (key->hash ^ *cursor) * TCACHE_FNV_PRIME;
+
+		key->size = file->filesize;
+	}
+
+	FS_CloseFile(file);
+}
+
+static uint TCACHE_LevelSize(uint width, uint height, uint bpp)
+{
+	return (width * height * bpp + 3) & ~3;
+}
+
+static char TCACHE_IsPowerOfTwo(uint value)
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+// data[0] owns every level: the renderers free only this pointer for uncompressed textures.
+static void TCACHE_SetLevels(texture_t* texture, ubyte* data, uint numLevels)
+{
+	uint i, width, height;
+
+	texture->numMipmaps = numLevels;
+	texture->data = malloc(numLevels * sizeof(ubyte*));
+
+	width = texture->width;
+	height = texture->height;
+	for (i=0; i < numLevels; i++)
+	{
+		texture->data[i] = data;
+		data += TCACHE_LevelSize(width, height, texture->bpp);
+
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+}
+
+char TCACHE_Load(texture_t* texture, tcache_key_t* key)
+{
+	char path[64];
+	filehandle_t* file;
+	tcache_header_t header;
+	ubyte* data;
+
+	TCACHE_HashFile(texture->path, key);
+
+	if (key->size == 0 || cacheUnavailable)
+		return 0;
+
+	TCACHE_GetPath(key, path);
+
+	file = FS_OpenWritableFile(path, "rb");
+	if (!file)
+		return 0;
+
+	if (FS_Read(&header, sizeof(header), 1, file) != 1 ||
+		memcmp(header.magic, TCACHE_MAGIC, 4) ||
+		header.version != TCACHE_VERSION ||
+		header.sourceHash != key->hash ||
+		header.sourceSize != key->size ||
+		header.numLevels == 0 || header.numLevels > TCACHE_MAX_LEVELS ||
+		header.dataSize != file->filesize - sizeof(header))
+	{
+		Log_Printf("[TCACHE_Load] Ignoring '%s', it does not match '%s'.\n",path,texture->path);
+		FS_CloseFile(file);
+		return 0;
+	}
+
+	//Texels are read in place, no decode and no copy before the upload.
+	data = malloc(header.dataSize);
+	if (FS_Read(data, header.dataSize, 1, file) != 1)
+	{
+		free(data);
+		FS_CloseFile(file);
+		return 0;
+	}
+
+	FS_CloseFile(file);
+
+	texture->width = header.width;
+	texture->height = header.height;
+	texture->bpp = header.bpp;
+	texture->format = header.format;
+
+	TCACHE_SetLevels(texture, data, header.numLevels);
+
+	return 1;
+}
+
+void TCACHE_Store(texture_t* texture, const tcache_key_t* key)
+{
+	char path[64];
+	filehandle_t* file;
+	tcache_header_t header;
+	ubyte* data;
+	ubyte* level;
+	ubyte* nextLevel;
+	uint numLevels, width, height;
+
+	if (texture->format != TEXTURE_GL_RGB && texture->format != TEXTURE_GL_RGBA)
+		return;
+
+	if (texture->numMipmaps != 1 || key->size == 0)
+		return;
+
+	//Full chain size.
+	numLevels = 1;
+	header.dataSize = TCACHE_LevelSize(texture->width, texture->height, texture->bpp);
+#ifdef TCACHE_MIPMAPS
+	if (TCACHE_IsPowerOfTwo(texture->width) && TCACHE_IsPowerOfTwo(texture->height))
+	{
+		width = texture->width;
+		height = texture->height;
+		while (numLevels < TCACHE_MAX_LEVELS && (width > 1 || height > 1))
+		{
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+			header.dataSize += TCACHE_LevelSize(width, height, texture->bpp);
+			numLevels++;
+		}
+	}
+#endif
+
+	data = malloc(header.dataSize);
+	memcpy(data, texture->data[0], texture->width * texture->height * texture->bpp);
+
+	free(texture->data[0]);
+	free(texture->data);
+	TCACHE_SetLevels(texture, data, numLevels);
+
+	width = texture->width;
+	height = texture->height;
+	for (level = data; numLevels > 1 && level != texture->data[numLevels-1]; level = nextLevel)
+	{
+		nextLevel = level + TCACHE_LevelSize(width, height, texture->bpp);
+		TEX_Downsample(level, width, height, texture->bpp, nextLevel);
+
+		width = width > 1 ? width / 2 : 1;
+		height = height > 1 ? height / 2 : 1;
+	}
+
+	if (cacheUnavailable)
+		return;
+
+	TCACHE_GetPath(key, path);
+
+	file = FS_OpenWritableFile(path, "wb");
+	if (!file)
+	{
+		Log_Printf("[TCACHE_Store] Could not create '%s', decoded textures will not be cached.\n",path);
+		cacheUnavailable = 1;
+		return;
+	}
+
+	memcpy(header.magic, TCACHE_MAGIC, 4);
+	header.version = TCACHE_VERSION;
+	header.sourceHash = key->hash;
+	header.sourceSize = key->size;
+	header.format = texture->format;
+	header.width = texture->width;
+	header.height = texture->height;
+	header.bpp = texture->bpp;
+	header.numLevels = numLevels;
+
+	FS_Write(&header, sizeof(header), 1, file);
+	FS_Write(data, header.dataSize, 1, file);
+
+	FS_CloseFile(file);
+}
@@ -0,0 +1,83 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  texcache.h
+ *  dEngine
+ *
+ *  Disk cache of the decoded png textures.
+ *
+ */
+
+#ifndef DE_TEXCACHE
+#define DE_TEXCACHE
+
+#include "globals.h"
+#include "texture.h"
+
+/*
+	Decoding a png through libpng is the slowest part of a scene load, and
+	TEXT_ClearTextureLibrary drops every texture between scenes. The first
+	time a png is decoded its texels are written to the writable directory,
+	in a file named after a hash of the png content. The next loads, in this
+	run or a later one, read the texels back in one go instead of decoding.
+
+	File layout (native endianness, like the bundles):
+
+		tcache_header_t
+		ubyte         data[dataSize]    Level 0 first, each level 4 bytes aligned.
+
+	With TCACHE_MIPMAPS the whole mip chain of power of two textures is
+	stored and uploaded, GLES 2.0 has no GL_GENERATE_MIPMAP.
+
+	Platforms without a writable directory (android, wasm) decode every time.
+	Files of pngs that changed are not deleted, the cache can be emptied by
+	removing the texcache_* files.
+*/
+
+#define TCACHE_MAGIC		"TCH1"
+#define TCACHE_VERSION		1
+
+#define TCACHE_MIPMAPS
+#define TCACHE_MAX_LEVELS	16
+
+typedef struct tcache_key_t
+{
+	unsigned long long hash;	// FNV-1a of the png file.
+	uint size;					// Of the png file, 0 if it could not be read.
+} tcache_key_t;
+
+typedef struct tcache_header_t
+{
+	char magic[4];
+	int version;
+	unsigned long long sourceHash;
+	uint sourceSize;
+	uint format;				// TEXTURE_GL_RGB or TEXTURE_GL_RGBA.
+	uint width;
+	uint height;
+	uint bpp;
+	uint numLevels;
+	uint dataSize;
+} tcache_header_t;
+
+// Fills key from the png and loads the cached texels. Returns 0 if the texture has to be decoded.
+char TCACHE_Load(texture_t* texture, tcache_key_t* key);
+
+// After a decode: adds the mip chain to the texture and writes it in the cache.
+void TCACHE_Store(texture_t* texture, const tcache_key_t* key);
+
+#endif
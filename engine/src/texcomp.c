@@ -0,0 +1,652 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  texcomp.c
+ *  dEngine
+ *
+ *  GPU compressed versions of the material textures.
+ *
+ */
+
+#include "texcomp.h"
+#include "renderer.h"
+#include "filesystem.h"
+
+const ubyte ktxIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+char TEXC_GetCompressedPath(const char* pngPath, int format, char* dest)
+{
+	const char* suffix;
+	char* extension;
+
+	switch (format)
+	{
+		case TEXTURE_FORMAT_S3TC: suffix = "s3tc.ktx"; break;
+		case TEXTURE_FORMAT_ETC1: suffix = "etc1.ktx"; break;
+		default: return 0;
+	}
+
+	if (strlen(pngPath) + strlen(suffix) >= TEXC_MAX_PATH)
+		return 0;
+
+	strcpy(dest, pngPath);
+	extension = FS_GetExtensionAddress(dest);
+	strcpy(extension, suffix);
+
+	return 1;
+}
+
+#ifdef COMPILE_TEXTURES
+
+#define TEXC_MAX_LEVELS		16
+
+typedef ubyte texc_block_t[16][4];		// 4x4 RGBA texels, row major.
+
+typedef struct texc_level_t
+{
+	int width;
+	int height;
+	ubyte* rgba;
+} texc_level_t;
+
+static int TEXC_Clamp255(int value)
+{
+	if (value < 0)
+		return 0;
+	if (value > 255)
+		return 255;
+	return value;
+}
+
+// Edge texels are repeated for the levels smaller than a block.
+static void TEXC_ReadBlock(const texc_level_t* level, int bx, int by, texc_block_t block)
+{
+	int x, y, sx, sy;
+
+	for (y=0; y < 4; y++)
+	{
+		sy = by * 4 + y;
+		if (sy >= level->height)
+			sy = level->height - 1;
+
+		for (x=0; x < 4; x++)
+		{
+			sx = bx * 4 + x;
+			if (sx >= level->width)
+				sx = level->width - 1;
+
+			memcpy(block[y*4+x], level->rgba + (sy * level->width + sx) * 4, 4);
+		}
+	}
+}
+
+static void TEXC_Downsample(const texc_level_t* src, texc_level_t* dst)
+{
+	dst->width = src->width > 1 ? src->width / 2 : 1;
+	dst->height = src->height > 1 ? src->height / 2 : 1;
+	dst->rgba = malloc(dst->width * dst->height * 4);
+
+	TEX_Downsample(src->rgba, src->width, src->height, 4, dst->rgba);
+}
+
+/*
+	S3TC
+*/
+
+static ushort TEXC_To565(const int color[3])
+{
+	return ((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255);
+}
+
+static void TEXC_From565(ushort packed, int color[3])
+{
+	color[0] = (packed >> 11) & 31;
+	color[1] = (packed >> 5) & 63;
+	color[2] = packed & 31;
+
+	color[0] = (color[0] << 3) | (color[0] >> 2);
+	color[1] = (color[1] << 2) | (color[1] >> 4);
+	color[2] = (color[2] << 3) | (color[2] >> 2);
+}
+
+static int TEXC_ColorDistance(const ubyte* texel, const int color[3])
+{
+	int dr, dg, db;
+
+	dr = texel[0] - color[0];
+	dg = texel[1] - color[1];
+	db = texel[2] - color[2];
+
+	return dr*dr + dg*dg + db*db;
+}
+
+/*
+	DXT1 color block, always in the 4 colors mode (color0 > color1). Endpoints
+	are the corners of the bounding box, inset by 1/16, along the diagonal
+	that follows the correlation of the channels with the widest one.
+*/
+static void TEXC_EncodeDXTColor(texc_block_t block, ubyte* dest)
+{
+	int minColor[3], maxColor[3];
+	int mean[3];
+	int covariance[3];
+	int palette[4][3];
+	ushort c0, c1;
+	uint indices;
+	int i, c, tmp, inset, widest;
+	int best, bestDistance, distance;
+
+	for (c=0; c < 3; c++)
+	{
+		minColor[c] = 255;
+		maxColor[c] = 0;
+		mean[c] = 0;
+	}
+
+	for (i=0; i < 16; i++)
+	{
+		for (c=0; c < 3; c++)
+		{
+			if (block[i][c] < minColor[c]) minColor[c] = block[i][c];
+			if (block[i][c] > maxColor[c]) maxColor[c] = block[i][c];
+			mean[c] += block[i][c];
+		}
+	}
+
+	widest = 0;
+	for (c=0; c < 3; c++)
+	{
+		mean[c] /= 16;
+		if (maxColor[c] - minColor[c] > maxColor[widest] - minColor[widest])
+			widest = c;
+	}
+
+	for (c=0; c < 3; c++)
+	{
+		covariance[c] = 0;
+		for (i=0; i < 16; i++)
+			covariance[c] += (block[i][c] - mean[c]) * (block[i][widest] - mean[widest]);
+	}
+
+	for (c=0; c < 3; c++)
+	{
+		inset = (maxColor[c] - minColor[c]) / 16;
+		minColor[c] += inset;
+		maxColor[c] -= inset;
+
+		if (covariance[c] < 0)
+		{
+			tmp = minColor[c];
+			minColor[c] = maxColor[c];
+			maxColor[c] = tmp;
+		}
+	}
+
+	c0 = TEXC_To565(maxColor);
+	c1 = TEXC_To565(minColor);
+	if (c0 < c1)
+	{
+		tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+	}
+
+	dest[0] = c0 & 0xFF;
+	dest[1] = c0 >> 8;
+	dest[2] = c1 & 0xFF;
+	dest[3] = c1 >> 8;
+
+	indices = 0;
+
+	//Single color: index 0 is color0 in both modes.
+	if (c0 != c1)
+	{
+		TEXC_From565(c0, palette[0]);
+		TEXC_From565(c1, palette[1]);
+		for (c=0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (i=0; i < 16; i++)
+		{
+			best = 0;
+			bestDistance = TEXC_ColorDistance(block[i], palette[0]);
+			for (c=1; c < 4; c++)
+			{
+				distance = TEXC_ColorDistance(block[i], palette[c]);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = c;
+				}
+			}
+
+			indices |= best << (i * 2);
+		}
+	}
+
+	dest[4] = indices & 0xFF;
+	dest[5] = (indices >> 8) & 0xFF;
+	dest[6] = (indices >> 16) & 0xFF;
+	dest[7] = indices >> 24;
+}
+
+// DXT5 alpha block, 8 alphas mode (alpha0 > alpha1).
+static void TEXC_EncodeDXTAlpha(texc_block_t block, ubyte* dest)
+{
+	int minAlpha, maxAlpha;
+	int palette[8];
+	int i, j, best, bestDistance, distance;
+	uint indicesLow, indicesHigh;
+
+	minAlpha = 255;
+	maxAlpha = 0;
+	for (i=0; i < 16; i++)
+	{
+		if (block[i][3] < minAlpha) minAlpha = block[i][3];
+		if (block[i][3] > maxAlpha) maxAlpha = block[i][3];
+	}
+
+	dest[0] = maxAlpha;
+	dest[1] = minAlpha;
+
+	memset(dest + 2, 0, 6);
+
+	if (maxAlpha == minAlpha)
+		return;
+
+	palette[0] = maxAlpha;
+	palette[1] = minAlpha;
+	for (j=2; j < 8; j++)
+		palette[j] = ((8 - j) * maxAlpha + (j - 1) * minAlpha) / 7;
+
+	//48 bits of indices, 3 per texel: the first 8 texels in indicesLow.
+	indicesLow = indicesHigh = 0;
+	for (i=0; i < 16; i++)
+	{
+		best = 0;
+		bestDistance = 256;
+		for (j=0; j < 8; j++)
+		{
+			distance = block[i][3] - palette[j];
+			if (distance < 0)
+				distance = -distance;
+
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = j;
+			}
+		}
+
+		if (i < 8)
+			indicesLow |= best << (i * 3);
+		else
+			indicesHigh |= best << ((i - 8) * 3);
+	}
+
+	dest[2] = indicesLow & 0xFF;
+	dest[3] = (indicesLow >> 8) & 0xFF;
+	dest[4] = (indicesLow >> 16) & 0xFF;
+	dest[5] = indicesHigh & 0xFF;
+	dest[6] = (indicesHigh >> 8) & 0xFF;
+	dest[7] = (indicesHigh >> 16) & 0xFF;
+}
+
+/*
+	ETC1: two sub blocks (2x4 or 4x2, the flip bit), each one a base color plus
+	one of 8 modifier tables. Base colors are either 444 each (individual) or
+	555 plus a 333 signed delta (differential). The encoder takes the average
+	of each sub block as base color and keeps the best table, mode and flip.
+*/
+
+static const int etc1Modifiers[8][2] =
+{
+	{ 2,   8}, { 5,  17}, { 9,  29}, {13,  42},
+	{18,  60}, {24,  80}, {33, 106}, {47, 183}
+};
+
+typedef struct texc_etc1_fit_t
+{
+	int error;
+	int table;
+	int indices[8];		// Pixel index value: 0 +a, 1 +b, 2 -a, 3 -b.
+} texc_etc1_fit_t;
+
+// Texels of sub block 0 or 1, as block offsets.
+static void TEXC_GetETC1SubBlock(int flip, int subBlock, int texels[8])
+{
+	int i, x, y;
+
+	for (i=0; i < 8; i++)
+	{
+		if (flip)
+		{
+			x = i % 4;
+			y = i / 4 + subBlock * 2;
+		}
+		else
+		{
+			x = i / 4 + subBlock * 2;
+			y = i % 4;
+		}
+
+		texels[i] = y * 4 + x;
+	}
+}
+
+static void TEXC_FitETC1SubBlock(texc_block_t block, const int texels[8], const int base[3], texc_etc1_fit_t* fit)
+{
+	int table, i, j, c;
+	int modifier, error, best, bestError, distance;
+	int indices[8];
+
+	fit->error = 0x7FFFFFFF;
+
+	for (table=0; table < 8; table++)
+	{
+		error = 0;
+		for (i=0; i < 8; i++)
+		{
+			best = 0;
+			bestError = 0x7FFFFFFF;
+			for (j=0; j < 4; j++)
+			{
+				modifier = etc1Modifiers[table][j & 1];
+				if (j & 2)
+					modifier = -modifier;
+
+				distance = 0;
+				for (c=0; c < 3; c++)
+					distance += (block[texels[i]][c] - TEXC_Clamp255(base[c] + modifier)) * (block[texels[i]][c] - TEXC_Clamp255(base[c] + modifier));
+
+				if (distance < bestError)
+				{
+					bestError = distance;
+					best = j;
+				}
+			}
+
+			indices[i] = best;
+			error += bestError;
+		}
+
+		if (error < fit->error)
+		{
+			fit->error = error;
+			fit->table = table;
+			memcpy(fit->indices, indices, sizeof(indices));
+		}
+	}
+}
+
+static void TEXC_EncodeETC1(texc_block_t block, ubyte* dest)
+{
+	int flip, subBlock, i, c, bit;
+	int texels[2][8];
+	int average[2][3];
+	int quantized[2][3];
+	int base[2][3];
+	int delta[3];
+	int diff;
+	texc_etc1_fit_t fits[2];
+	int error, bestError;
+	uint high, low, bestHigh;
+	int bestTexels[2][8];
+	texc_etc1_fit_t bestFits[2];
+
+	bestError = 0x7FFFFFFF;
+	bestHigh = 0;
+
+	for (flip=0; flip < 2; flip++)
+	{
+		for (subBlock=0; subBlock < 2; subBlock++)
+		{
+			TEXC_GetETC1SubBlock(flip, subBlock, texels[subBlock]);
+
+			for (c=0; c < 3; c++)
+			{
+				average[subBlock][c] = 0;
+				for (i=0; i < 8; i++)
+					average[subBlock][c] += block[texels[subBlock][i]][c];
+				average[subBlock][c] = (average[subBlock][c] + 4) / 8;
+			}
+		}
+
+		for (diff=0; diff < 2; diff++)
+		{
+			for (subBlock=0; subBlock < 2; subBlock++)
+			{
+				for (c=0; c < 3; c++)
+				{
+					if (diff)
+					{
+						quantized[subBlock][c] = (average[subBlock][c] * 31 + 127) / 255;
+						base[subBlock][c] = (quantized[subBlock][c] << 3) | (quantized[subBlock][c] >> 2);
+					}
+					else
+					{
+						quantized[subBlock][c] = (average[subBlock][c] * 15 + 127) / 255;
+						base[subBlock][c] = quantized[subBlock][c] * 17;
+					}
+				}
+			}
+
+			if (diff)
+			{
+				for (c=0; c < 3; c++)
+				{
+					delta[c] = quantized[1][c] - quantized[0][c];
+					if (delta[c] < -4 || delta[c] > 3)
+						break;
+				}
+
+				if (c < 3)
+					continue;
+			}
+
+			TEXC_FitETC1SubBlock(block, texels[0], base[0], &fits[0]);
+			TEXC_FitETC1SubBlock(block, texels[1], base[1], &fits[1]);
+
+			error = fits[0].error + fits[1].error;
+			if (error >= bestError)
+				continue;
+
+			bestError = error;
+			memcpy(bestFits, fits, sizeof(fits));
+			memcpy(bestTexels, texels, sizeof(texels));
+
+			if (diff)
+				high = quantized[0][0] << 27 | (delta[0] & 7) << 24 |
+					   quantized[0][1] << 19 | (delta[1] & 7) << 16 |
+					   quantized[0][2] << 11 | (delta[2] & 7) << 8;
+			else
+				high = quantized[0][0] << 28 | quantized[1][0] << 24 |
+					   quantized[0][1] << 20 | quantized[1][1] << 16 |
+					   quantized[0][2] << 12 | quantized[1][2] << 8;
+
+			bestHigh = high | fits[0].table << 5 | fits[1].table << 2 | diff << 1 | flip;
+		}
+	}
+
+	//Pixel index bits are column major: texel (x,y) is bit x*4+y, MSB in the upper half.
+	low = 0;
+	for (subBlock=0; subBlock < 2; subBlock++)
+	{
+		for (i=0; i < 8; i++)
+		{
+			bit = (bestTexels[subBlock][i] % 4) * 4 + bestTexels[subBlock][i] / 4;
+			low |= (bestFits[subBlock].indices[i] >> 1) << (16 + bit);
+			low |= (bestFits[subBlock].indices[i] & 1) << bit;
+		}
+	}
+
+	dest[0] = bestHigh >> 24;
+	dest[1] = (bestHigh >> 16) & 0xFF;
+	dest[2] = (bestHigh >> 8) & 0xFF;
+	dest[3] = bestHigh & 0xFF;
+	dest[4] = low >> 24;
+	dest[5] = (low >> 16) & 0xFF;
+	dest[6] = (low >> 8) & 0xFF;
+	dest[7] = low & 0xFF;
+}
+
+static void TEXC_WriteKTX(const char* pngPath, int format, uint glInternalFormat, uint glBaseInternalFormat, const texc_level_t* levels, int numLevels)
+{
+	char path[TEXC_MAX_PATH];
+	filehandle_t* file;
+	ktx_header_t header;
+	texc_block_t block;
+	ubyte* data;
+	uint imageSize;
+	int blockSize;
+	int level, bx, by, blocksWide, blocksHigh;
+	int totalSize;
+	ubyte* dest;
+
+	if (!TEXC_GetCompressedPath(pngPath, format, path))
+		return;
+
+	file = FS_OpenFile(path, "wb");
+	if (!file)
+	{
+		Log_Printf("[TEXC_Compile] Could not create '%s'.\n",path);
+		return;
+	}
+
+	blockSize = glInternalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : 8;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, ktxIdentifier, sizeof(ktxIdentifier));
+	header.endianness = TEXC_KTX_ENDIANNESS;
+	header.glTypeSize = 1;
+	header.glInternalFormat = glInternalFormat;
+	header.glBaseInternalFormat = glBaseInternalFormat;
+	header.pixelWidth = levels[0].width;
+	header.pixelHeight = levels[0].height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = numLevels;
+
+	FS_Write(&header, sizeof(header), 1, file);
+
+	totalSize = 0;
+	for (level=0; level < numLevels; level++)
+	{
+		blocksWide = (levels[level].width + 3) / 4;
+		blocksHigh = (levels[level].height + 3) / 4;
+		imageSize = blocksWide * blocksHigh * blockSize;
+
+		data = malloc(imageSize);
+		dest = data;
+
+		for (by=0; by < blocksHigh; by++)
+		{
+			for (bx=0; bx < blocksWide; bx++,dest += blockSize)
+			{
+				TEXC_ReadBlock(&levels[level], bx, by, block);
+
+				switch (glInternalFormat)
+				{
+					case GL_ETC1_RGB8_OES:
+						TEXC_EncodeETC1(block, dest);
+						break;
+					case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+						TEXC_EncodeDXTColor(block, dest);
+						break;
+					case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+						TEXC_EncodeDXTAlpha(block, dest);
+						TEXC_EncodeDXTColor(block, dest + 8);
+						break;
+				}
+			}
+		}
+
+		//Block sizes are multiples of 4 bytes: no mip padding.
+		FS_Write(&imageSize, sizeof(imageSize), 1, file);
+		FS_Write(data, imageSize, 1, file);
+
+		totalSize += imageSize;
+		free(data);
+	}
+
+	FS_CloseFile(file);
+
+	Log_Printf("[TEXC_Compile] Wrote '%s': %dx%d, %d levels, %d bytes.\n",path,levels[0].width,levels[0].height,numLevels,totalSize);
+}
+
+void TEXC_Compile(const texture_t* texture)
+{
+	texc_level_t levels[TEXC_MAX_LEVELS];
+	int numLevels;
+	int i, numTexels;
+	char opaque;
+	const ubyte* src;
+
+	if (texture->format != TEXTURE_GL_RGB && texture->format != TEXTURE_GL_RGBA)
+		return;
+
+	numTexels = texture->width * texture->height;
+
+	levels[0].width = texture->width;
+	levels[0].height = texture->height;
+	levels[0].rgba = malloc(numTexels * 4);
+
+	opaque = 1;
+	src = texture->data[0];
+	for (i=0; i < numTexels; i++)
+	{
+		levels[0].rgba[i*4+0] = src[0];
+		levels[0].rgba[i*4+1] = src[1];
+		levels[0].rgba[i*4+2] = src[2];
+
+		if (texture->format == TEXTURE_GL_RGBA)
+		{
+			levels[0].rgba[i*4+3] = src[3];
+			if (src[3] != 255)
+				opaque = 0;
+			src += 4;
+		}
+		else
+		{
+			levels[0].rgba[i*4+3] = 255;
+			src += 3;
+		}
+	}
+
+	//Full chain down to 1x1, as glCompressedTexImage2D needs every level for the mipmap filters.
+	numLevels = 1;
+	while (numLevels < TEXC_MAX_LEVELS && (levels[numLevels-1].width > 1 || levels[numLevels-1].height > 1))
+	{
+		TEXC_Downsample(&levels[numLevels-1], &levels[numLevels]);
+		numLevels++;
+	}
+
+	if (opaque)
+	{
+		TEXC_WriteKTX(texture->path, TEXTURE_FORMAT_S3TC, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, TEXTURE_GL_RGB, levels, numLevels);
+		TEXC_WriteKTX(texture->path, TEXTURE_FORMAT_ETC1, GL_ETC1_RGB8_OES, TEXTURE_GL_RGB, levels, numLevels);
+	}
+	else
+		TEXC_WriteKTX(texture->path, TEXTURE_FORMAT_S3TC, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, TEXTURE_GL_RGBA, levels, numLevels);
+
+	for (i=0; i < numLevels; i++)
+		free(levels[i].rgba);
+}
+
+#endif
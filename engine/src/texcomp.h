@@ -0,0 +1,89 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  texcomp.h
+ *  dEngine
+ *
+ *  GPU compressed versions of the material textures.
+ *
+ */
+
+#ifndef DE_TEXCOMP
+#define DE_TEXCOMP
+
+#include "globals.h"
+#include "texture.h"
+
+/*
+	Material textures are authored as png. A build with COMPILE_TEXTURES
+	defined (globals.h, "make textures" on linux) transcodes the diffuse and
+	specular maps it loads, with their full mip chain, next to the png in the
+	writable directory:
+
+		<name>.s3tc.ktx    DXT1, or DXT5 when the texture has alpha.
+		<name>.etc1.ktx    ETC1, opaque textures only.
+
+	At runtime a compressible texture (texture_t.compressible) is looked for
+	in the formats the GPU supports, S3TC first, and falls back to the png.
+	ATITC is detected but no file is produced for it.
+
+	Files are KTX 1.1, native endianness, no key/value data:
+
+		ktx_header_t
+		for each mip level:
+			uint          imageSize
+			ubyte         data[imageSize]
+*/
+
+#define TEXC_KTX_ENDIANNESS		0x04030201
+
+#define TEXC_MAX_PATH			256
+
+// Compressed formats, as given to glCompressedTexImage2D.
+#define GL_ETC1_RGB8_OES					0x8D64
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT		0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT	0x83F3
+
+typedef struct ktx_header_t
+{
+	ubyte identifier[12];
+	uint endianness;
+	uint glType;				// 0 for compressed formats.
+	uint glTypeSize;
+	uint glFormat;				// 0 for compressed formats.
+	uint glInternalFormat;
+	uint glBaseInternalFormat;
+	uint pixelWidth;
+	uint pixelHeight;
+	uint pixelDepth;
+	uint numberOfArrayElements;
+	uint numberOfFaces;
+	uint numberOfMipmapLevels;
+	uint bytesOfKeyValueData;
+} ktx_header_t;
+
+extern const ubyte ktxIdentifier[12];
+
+// Path of the KTX sibling of a png for one TEXTURE_FORMAT_*, returns 0 if the format has none.
+char TEXC_GetCompressedPath(const char* pngPath, int format, char* dest);
+
+#ifdef COMPILE_TEXTURES
+// texture holds a decoded png (RGB or RGBA, one level).
+void TEXC_Compile(const texture_t* texture);
+#endif
+
+#endif
@@ -117,5 +117,5 @@ void DYN_TEXT_Render(void)
 	for (i=0; i < textLib.numTexts; i++) 
 		SCR_ConvertTextToVertices(textLib.texts[i].text,textLib.texts[i].size,textLib.texts[i].ss_pos[X],textLib.texts[i].ss_pos[Y],TEXT_CENTERED);
 	
-	SCR_RenderText();
+	SCR_BatchText();
 }
\ No newline at end of file
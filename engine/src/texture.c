@@ -27,6 +27,8 @@
 #include "ItextureLoader.h"
 #include "filesystem.h"
 #include "renderer.h"
+#include "texcomp.h"
+#include "texcache.h"
 
 
 
@@ -230,6 +232,35 @@ void TEXT_RemoveFromCache(texture_t* texture)
 	}
 }
 */
+void TEX_Downsample(const ubyte* src, uint width, uint height, uint bpp, ubyte* dest)
+{
+	uint destWidth, destHeight;
+	uint x, y, c;
+	uint x0, x1, y0, y1;
+	
+	destWidth = width > 1 ? width / 2 : 1;
+	destHeight = height > 1 ? height / 2 : 1;
+	
+	//Odd sizes reuse their last row/column.
+	for (y=0; y < destHeight; y++)
+	{
+		y0 = y * 2;
+		y1 = y0 + 1 < height ? y0 + 1 : y0;
+		
+		for (x=0; x < destWidth; x++)
+		{
+			x0 = x * 2;
+			x1 = x0 + 1 < width ? x0 + 1 : x0;
+			
+			for (c=0; c < bpp; c++)
+				*dest++ = (src[(y0 * width + x0) * bpp + c] +
+						   src[(y0 * width + x1) * bpp + c] +
+						   src[(y1 * width + x0) * bpp + c] +
+						   src[(y1 * width + x1) * bpp + c] + 2) / 4;
+		}
+	}
+}
+
 void TEX_MakeStaticAvailable(texture_t* texture)
 {
 	if (!texture)
@@ -240,9 +271,37 @@ void TEX_MakeStaticAvailable(texture_t* texture)
 	TEX_MakeAvailable(texture);
 }
 
+#ifndef COMPILE_TEXTURES
+// Compressed version of a png in the best format the GPU supports, returns 0 if there is none.
+static char TEX_LoadCompressed(texture_t* tmpTex)
+{
+	static const int formats[] = { TEXTURE_FORMAT_S3TC, TEXTURE_FORMAT_ETC1 };
+	char path[TEXC_MAX_PATH];
+	int i;
+	
+	for (i=0; i < (int)(sizeof(formats)/sizeof(formats[0])); i++)
+	{
+		if (!renderer.IsTextureCompressionSupported(formats[i]))
+			continue;
+		
+		if (!TEXC_GetCompressedPath(tmpTex->path, formats[i], path))
+			continue;
+		
+		loadNativeKTX(tmpTex, path);
+		if (tmpTex->format != TEXTURE_TYPE_UNKNOWN)
+			return 1;
+	}
+	
+	return 0;
+}
+#endif
+
 void TEX_LoadFromDiskAndUploadToGPU(texture_t* tmpTex)
 {
 	char* extension; 
+#ifndef COMPILE_TEXTURES
+	tcache_key_t key;
+#endif
 	
 	extension = FS_GetExtensionAddress(tmpTex->path);
 	
@@ -258,7 +317,20 @@ void TEX_LoadFromDiskAndUploadToGPU(texture_t* tmpTex)
 	}
 	else if (strcmp(extension, "png") == 0)
 	{
+#ifdef COMPILE_TEXTURES
 		loadNativePNG(tmpTex);
+		if (tmpTex->compressible)
+			TEXC_Compile(tmpTex);
+#else
+		if (!tmpTex->compressible || !TEX_LoadCompressed(tmpTex))
+		{
+			if (!TCACHE_Load(tmpTex,&key))
+			{
+				loadNativePNG(tmpTex);
+				TCACHE_Store(tmpTex,&key);
+			}
+		}
+#endif
 	}
 	
 	if (tmpTex->format == TEXTURE_TYPE_UNKNOWN)
@@ -327,8 +399,10 @@ void TEX_UnloadTexture(texture_t* texture)
 		Log_Printf("[TEX_UnloadTexture] Nothing to unload.\n");
 		return;
 	}
-	
-	renderer.FreeGPUTexture(texture);
+
+	//The GPU texture is the atlas page, shared with other sprites.
+	if (!texture->inAtlas)
+		renderer.FreeGPUTexture(texture);
 	
 
 	texture->memLocation = TEXT_MEM_LOC_DISK;
@@ -57,6 +57,10 @@ typedef struct  {
 	uchar cachable;
 	uchar memLocation;
 	uchar memStatic;       //This texture should never be freed, even between levels.
+	uchar compressible;    //A png that may be replaced by its GPU compressed version, see texcomp.h
+	
+	uchar inAtlas;         //Packed in a sprite atlas page: textureId is the page's one, see atlas.h
+	short atlasRect[4];    //u, v, width, height of the texture in its page (SHRT_MAX units).
 	
 } texture_t;
 
@@ -72,4 +76,7 @@ void TEXT_ClearTextureLibrary(void);
 
 void TEXT_PrintCache(void);
 
+// Next mip level of 8 bits per channel texels, box filtered. dest holds max(width/2,1) x max(height/2,1) texels.
+void TEX_Downsample(const ubyte* src, uint width, uint height, uint bpp, ubyte* dest);
+
 #endif
\ No newline at end of file
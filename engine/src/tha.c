@@ -117,7 +117,7 @@ void THA_FireBullet(float ssPosX, float ssPosY,enemy_t* enemy)
 	
 	
 	
-	random[X] = (rand() - (RAND_MAX >> 1)) / (float)(RAND_MAX >> 1);
+	random[X] = (randomNext() - (RANDOM_MAX >> 1)) / (float)(RANDOM_MAX >> 1);
 	random[Y] = enemy->parameters[PARAMETER_THA_FIRING_DIRECTION];
 	normalize2(random);
 	FX_GetParticule(enemy->ss_position,random,0.015*PARTICULE_SIZE_GLOBAL,PARTICULE_TRAVEL_DIST*0.3f,PARTICULE_TYPE_EXPLOSION, PARTICULE_COLOR_RED,3);
@@ -53,6 +53,16 @@ int E_Sys_Milliseconds( void )
 	
 	return (tp.tv_sec - secbase) * 1000 + tp.tv_usec / 1000;
 }
+
+// Wraps around every 71 minutes, only differences make sense.
+uint E_Sys_Microseconds( void )
+{
+	struct timeval tp;
+	
+	gettimeofday( &tp, 0 );
+	
+	return (uint)tp.tv_sec * 1000000 + tp.tv_usec;
+}
 #else
 #include "windows.h"
 #include "MMSystem.h"
@@ -60,6 +70,17 @@ int E_Sys_Milliseconds( void )
 {
 	return (int)timeGetTime();
 }
+
+uint E_Sys_Microseconds( void )
+{
+	LARGE_INTEGER frequency;
+	LARGE_INTEGER counter;
+	
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	
+	return (uint)(counter.QuadPart / frequency.QuadPart * 1000000 + counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
 #endif
 
 unsigned char paused = 1;
@@ -87,6 +108,17 @@ void Timer_Resume(void)
 
 int frameCounter=0;
 float extraPrecision=0;
+
+// 16ms and 17ms frames for 60Hz, wall clock not involved: re-simulated frames step it too.
+void Timer_Step(void)
+{
+	extraPrecision += 0.6666667f;
+	timediff =16+(int)extraPrecision;
+	extraPrecision -= timediff-16;
+	
+	simulationTime += timediff;
+}
+
 void Timer_tick(void)
 {
 	//Log_Printf("t=%d\n",simulationTime);
@@ -116,20 +148,8 @@ void Timer_tick(void)
 	timediff = 16;
 	simulationTime += timediff;
 	*/
-	if (engine.mode == DE_MODE_SINGLEPLAYER)
-	{
-		extraPrecision += 0.6666667f;
-		timediff =16+(int)extraPrecision;
-		extraPrecision -= timediff-16;
-	}
-	else 
-	{
-		timediff = currentTime - lastTime;
-	}
-
-	//timediff = currentTime - lastTime;
-		
-	simulationTime += timediff;
+	//Multiplayer too: both peers have to step the same simulation time (rollback.h).
+	Timer_Step();
 	
 	//Log_Printf("%d\n",timediff);
 	
@@ -30,6 +30,7 @@
 
 void Timer_resetTime(void);
 void Timer_tick(void);
+void Timer_Step(void);
 
 void Timer_Pause(void);
 void Timer_Resume(void);
@@ -37,9 +38,12 @@ void Timer_Resume(void);
 void Timer_ForceTimeIncrement(int ms);
 
 int E_Sys_Milliseconds( void );
+uint E_Sys_Microseconds( void );
 
 extern int fps;
 extern  int simulationTime;
 extern int timediff;
+extern int frameCounter;
+extern float extraPrecision;
 
 #endif
\ No newline at end of file
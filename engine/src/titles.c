@@ -30,6 +30,7 @@
 #include <limits.h>
 #include "text.h"
 #include "dEngine.h"
+#include "atlas.h"
 
 
 uchar title_mode = MODE_UNKNOWN;
@@ -200,10 +201,19 @@ void TITLE_Show_epilog(int tr)
 
 void TITLE_RenderCompletedTitle(void)
 {
+	xf_colorless_sprite_t vertices[4];
+	int i;
+	
 	renderer.SetTexture(pointersTexture.textureId);
 	
+	//pointersTexture may live in the sprite atlas.
+	for (i=0; i < 4; i++)
+	{
+		vertices[i] = v_CompletedSprite[i];
+		ATL_RemapUV(&pointersTexture, vertices[i].text);
+	}
 	
-	renderer.RenderColorlessSprites(v_CompletedSprite,6,i_CompletedSprite);
+	renderer.RenderColorlessSprites(vertices,6,i_CompletedSprite);
 	
 }
 
@@ -217,6 +227,9 @@ void TITLE_Render(void)
 	if (timeRemaining <= 0)
 		return;
 	
+	//Sprites batched so far are drawn under the title.
+	SPR_Flush();
+	
 	renderer.StartCleanFrame();
 	
 	
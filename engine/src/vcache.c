@@ -0,0 +1,290 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  vcache.c
+ *  dEngine
+ *
+ *  Triangle ordering for the post-transform vertex cache.
+ *
+ */
+
+#include "vcache.h"
+#include "math.h"
+
+//Forsyth's tuning values, the decay power is 1.5 and the valence power -0.5.
+#define VCACHE_LAST_TRI_SCORE	0.75f
+#define VCACHE_VALENCE_SCALE	2.0f
+
+typedef struct vcache_vertex_t
+{
+	int cachePosition;			// -1 when not in the cache.
+	int numActiveTriangles;		// Triangles using this vertex not emitted yet.
+	int firstTriangle;			// In the triangle adjacency list.
+	float score;
+} vcache_vertex_t;
+
+static float VCACHE_VertexScore(const vcache_vertex_t* vertex)
+{
+	float score;
+	float x;
+
+	if (vertex->numActiveTriangles == 0)
+		return -1;
+
+	score = 0;
+
+	if (vertex->cachePosition >= 0)
+	{
+		//The 3 vertices of the last triangle get a fixed score: using them again is not better than using the next ones.
+		if (vertex->cachePosition < 3)
+			score = VCACHE_LAST_TRI_SCORE;
+		else
+		{
+			x = 1.0f - (vertex->cachePosition - 3) / (float)(VCACHE_SIZE - 3);
+			score = x * x * InvSqrt(x);
+		}
+	}
+
+	//Vertices with few triangles left are finished first, so they do not linger.
+	score += VCACHE_VALENCE_SCALE * InvSqrt((float)vertex->numActiveTriangles);
+
+	return score;
+}
+
+static void VCACHE_ComputeOrder(const ushort* indices, int numIndices, int numVertices, ushort* order)
+{
+	vcache_vertex_t* vertices;
+	int* adjacency;
+	int* adjacencyCursor;
+	float* triangleScores;
+	uchar* triangleEmitted;
+	int cache[VCACHE_SIZE+3];
+	int numCache, newNumCache;
+	int newCache[VCACHE_SIZE+3];
+	int numTriangles;
+	int bestTriangle;
+	float bestScore;
+	int scanCursor;
+	int i, j, k, t, v;
+	vcache_vertex_t* vertex;
+
+	numTriangles = numIndices / 3;
+	if (numTriangles == 0)
+		return;
+
+	vertices = calloc(numVertices, sizeof(vcache_vertex_t));
+	adjacency = malloc(numIndices * sizeof(int));
+	adjacencyCursor = calloc(numVertices, sizeof(int));
+	triangleScores = malloc(numTriangles * sizeof(float));
+	triangleEmitted = calloc(numTriangles, sizeof(uchar));
+
+	//Triangles of each vertex.
+	for (i=0; i < numIndices; i++)
+		vertices[indices[i]].numActiveTriangles++;
+
+	for (i=0, k=0; i < numVertices; i++)
+	{
+		vertices[i].firstTriangle = k;
+		vertices[i].cachePosition = -1;
+		k += vertices[i].numActiveTriangles;
+	}
+
+	for (i=0; i < numIndices; i++)
+	{
+		vertex = &vertices[indices[i]];
+		adjacency[vertex->firstTriangle + adjacencyCursor[indices[i]]++] = i / 3;
+	}
+
+	for (i=0; i < numVertices; i++)
+		vertices[i].score = VCACHE_VertexScore(&vertices[i]);
+
+	for (t=0; t < numTriangles; t++)
+		triangleScores[t] = vertices[indices[3*t]].score + vertices[indices[3*t+1]].score + vertices[indices[3*t+2]].score;
+
+	numCache = 0;
+	scanCursor = 0;
+	bestTriangle = -1;
+
+	for (i=0; i < numTriangles; i++)
+	{
+		//No candidate around the cache: best triangle among the ones left.
+		if (bestTriangle == -1)
+		{
+			while (triangleEmitted[scanCursor])
+				scanCursor++;
+
+			bestTriangle = scanCursor;
+			bestScore = triangleScores[scanCursor];
+			for (t=scanCursor+1; t < numTriangles; t++)
+			{
+				if (!triangleEmitted[t] && triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		order[i] = bestTriangle;
+		triangleEmitted[bestTriangle] = 1;
+
+		//Triangle vertices go to the front of the cache, the others are pushed back.
+		newNumCache = 0;
+		for (j=0; j < 3; j++)
+		{
+			v = indices[3*bestTriangle+j];
+			vertex = &vertices[v];
+
+			//Remove the triangle from the vertex active list.
+			for (k=0; k < vertex->numActiveTriangles; k++)
+			{
+				if (adjacency[vertex->firstTriangle + k] == bestTriangle)
+				{
+					adjacency[vertex->firstTriangle + k] = adjacency[vertex->firstTriangle + vertex->numActiveTriangles - 1];
+					break;
+				}
+			}
+			vertex->numActiveTriangles--;
+
+			newCache[newNumCache++] = v;
+		}
+
+		for (j=0; j < numCache; j++)
+		{
+			v = cache[j];
+			if (v != newCache[0] && v != newCache[1] && v != newCache[2])
+				newCache[newNumCache++] = v;
+		}
+
+		//Update the scores of everything that was or is in the cache.
+		for (j=0; j < newNumCache; j++)
+		{
+			vertex = &vertices[newCache[j]];
+			vertex->cachePosition = j < VCACHE_SIZE ? j : -1;
+			vertex->score = VCACHE_VertexScore(vertex);
+		}
+
+		bestTriangle = -1;
+		bestScore = -1;
+		for (j=0; j < newNumCache; j++)
+		{
+			vertex = &vertices[newCache[j]];
+
+			for (k=0; k < vertex->numActiveTriangles; k++)
+			{
+				t = adjacency[vertex->firstTriangle + k];
+
+				triangleScores[t] = vertices[indices[3*t]].score + vertices[indices[3*t+1]].score + vertices[indices[3*t+2]].score;
+
+				if (triangleScores[t] > bestScore)
+				{
+					bestScore = triangleScores[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		numCache = newNumCache < VCACHE_SIZE ? newNumCache : VCACHE_SIZE;
+		memcpy(cache, newCache, numCache * sizeof(int));
+	}
+
+	free(vertices);
+	free(adjacency);
+	free(adjacencyCursor);
+	free(triangleScores);
+	free(triangleEmitted);
+}
+
+char VCACHE_Optimize(ushort* indices, int numIndices, int numVertices, ushort* order)
+{
+	ushort* newOrder;
+	ushort* source;
+	int numTriangles;
+	int i;
+	char improved;
+
+	numTriangles = numIndices / 3;
+
+	newOrder = malloc(numTriangles * sizeof(ushort));
+	for (i=0; i < numTriangles; i++)
+		newOrder[i] = i;
+
+	improved = 0;
+
+	if (numTriangles > 1)
+	{
+		source = malloc(numIndices * sizeof(ushort));
+		memcpy(source, indices, numIndices * sizeof(ushort));
+
+		VCACHE_ComputeOrder(source, numIndices, numVertices, newOrder);
+
+		for (i=0; i < numTriangles; i++)
+		{
+			indices[3*i+0] = source[3*newOrder[i]+0];
+			indices[3*i+1] = source[3*newOrder[i]+1];
+			indices[3*i+2] = source[3*newOrder[i]+2];
+		}
+
+		//Already well ordered meshes (small fans) can come out slightly worse.
+		improved = VCACHE_ComputeACMR(indices, numIndices, numVertices) < VCACHE_ComputeACMR(source, numIndices, numVertices);
+
+		if (!improved)
+		{
+			memcpy(indices, source, numIndices * sizeof(ushort));
+			for (i=0; i < numTriangles; i++)
+				newOrder[i] = i;
+		}
+
+		free(source);
+	}
+
+	if (order)
+		memcpy(order, newOrder, numTriangles * sizeof(ushort));
+
+	free(newOrder);
+
+	return improved;
+}
+
+float VCACHE_ComputeACMR(const ushort* indices, int numIndices, int numVertices)
+{
+	int* insertedAt;
+	int numMisses;
+	int i;
+
+	if (numIndices < 3)
+		return 0;
+
+	insertedAt = malloc(numVertices * sizeof(int));
+	for (i=0; i < numVertices; i++)
+		insertedAt[i] = -VCACHE_FIFO_SIZE - 1;
+
+	//FIFO: a hit does not refresh the entry, a vertex stays VCACHE_FIFO_SIZE misses.
+	numMisses = 0;
+	for (i=0; i < numIndices; i++)
+	{
+		if (numMisses - insertedAt[indices[i]] > VCACHE_FIFO_SIZE)
+		{
+			insertedAt[indices[i]] = numMisses;
+			numMisses++;
+		}
+	}
+
+	free(insertedAt);
+
+	return numMisses / (float)(numIndices / 3);
+}
@@ -0,0 +1,54 @@
+/*
+	This file is part of SHMUP.
+
+    SHMUP is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    SHMUP is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with SHMUP.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ *  vcache.h
+ *  dEngine
+ *
+ *  Triangle ordering for the post-transform vertex cache.
+ *
+ */
+
+#ifndef DE_VCACHE
+#define DE_VCACHE
+
+#include "globals.h"
+
+/*
+	A GPU keeps the last transformed vertices in a small cache: an index list
+	where triangles sharing vertices follow each other shades fewer vertices
+	for the same triangle count. VCACHE_Optimize reorders the triangles with
+	Tom Forsyth's linear-speed algorithm (LRU cache of VCACHE_SIZE entries).
+
+	The quality of an order is its ACMR, average cache miss ratio: vertices
+	shaded per triangle, 3.0 worst, around 0.6 for a regular grid. It is
+	measured with a FIFO cache of VCACHE_FIFO_SIZE entries, the kind found
+	in the PowerVR and Adreno GPUs.
+
+	Build with REPORT_ACMR defined (globals.h, "make acmr" on linux) to log
+	the ACMR of every mesh and every baked visibility set before and after.
+*/
+
+#define VCACHE_SIZE			32
+#define VCACHE_FIFO_SIZE	16
+
+// Reorders the triangles of an index list in place, if it lowers the ACMR. When order
+// is not NULL, order[i] receives the old position of the i-th triangle. Returns 1 if reordered.
+char VCACHE_Optimize(ushort* indices, int numIndices, int numVertices, ushort* order);
+
+float VCACHE_ComputeACMR(const ushort* indices, int numIndices, int numVertices);
+
+#endif
@@ -235,3 +235,114 @@ char LoadWavInfo( const char *filename, unsigned char **wav, soundInfo_t *info )
 	return 1;
 }
 
+
+#define WAVE_FORMAT_PCM			0x0001
+
+typedef struct master_riff_chnk_t
+{
+	char			ckID[4];
+	unsigned int	cksize;
+	char			WAVEID[4];
+} master_riff_chnk_t;
+
+typedef struct fmt_chunk_t
+{
+	char			ckID[4];
+	unsigned int	cksize;
+	unsigned short	wFormatTag;//	 2	 WAVE_FORMAT_PCM
+	unsigned short	nChannels;//	 2	Nc
+	unsigned int	nSamplesPerSec;//	 4	F
+	unsigned int	nAvgBytesPerSec;//	 4	F * M * Nc
+	unsigned short	nBlockAlign	;// 2	M * Nc
+	unsigned short	wBitsPerSample;//	 2	rounds up to 8 * M
+	
+} fmt_chunk_t;
+
+typedef struct basic_chunk_t
+{
+	char			ckID[4];
+	unsigned int	cksize;
+} basic_chunk_t;
+
+typedef struct wave_file_t
+{
+	master_riff_chnk_t riff;
+	fmt_chunk_t fmt;
+	basic_chunk_t dataChunk;
+} wave_file_t ;
+
+
+static void Wav_WriteHeader( wavWriter_t *writer )
+{
+	wave_file_t waveFile;
+	
+	memset(&waveFile,0,sizeof(waveFile));
+	
+	waveFile.riff.cksize =  4 + 24 + (8 + writer->dataSize);  //4(dataChunk header) + 24(fmt header) + 8 (riff header) + data payload
+	memcpy(waveFile.riff.ckID,"RIFF",4);
+	memcpy(waveFile.riff.WAVEID,"WAVE",4);
+	
+	waveFile.dataChunk.cksize = writer->dataSize;
+	memcpy(waveFile.dataChunk.ckID,"data",4);
+	
+	memcpy(waveFile.fmt.ckID,"fmt ",4);
+	waveFile.fmt.cksize = 16;
+	waveFile.fmt.wFormatTag = WAVE_FORMAT_PCM;
+	waveFile.fmt.nChannels = writer->channels;
+	waveFile.fmt.nSamplesPerSec = writer->sample_rate;
+	waveFile.fmt.wBitsPerSample = 16;
+	waveFile.fmt.nBlockAlign = waveFile.fmt.wBitsPerSample/8 * waveFile.fmt.nChannels;
+	waveFile.fmt.nAvgBytesPerSec = waveFile.fmt.nSamplesPerSec * waveFile.fmt.nBlockAlign;
+	
+	FS_Write(&waveFile, 1, sizeof(wave_file_t), writer->file);
+}
+
+char Wav_OpenWriter( wavWriter_t *writer, const char *filename, unsigned long sample_rate, unsigned long channels )
+{
+	writer->file = FS_OpenFile(filename, "wb");
+	writer->sample_rate = sample_rate;
+	writer->channels = channels;
+	writer->dataSize = 0;
+	
+	if (!writer->file)
+		return 0;
+	
+	//Sizes are unknown yet, Wav_CloseWriter rewrites the header.
+	Wav_WriteHeader(writer);
+	
+	return 1;
+}
+
+void Wav_Write( wavWriter_t *writer, const short *frames, unsigned long numFrames )
+{
+	if (!writer->file)
+		return;
+	
+	writer->dataSize += FS_Write(frames, sizeof(short) * writer->channels, numFrames, writer->file) * sizeof(short) * writer->channels;
+}
+
+void Wav_UpdateHeader( wavWriter_t *writer )
+{
+	if (!writer->file)
+		return;
+	
+	if (FS_Seek(writer->file, 0, SEEK_SET) != 0)
+	{
+		Log_Printf("[Wav_UpdateHeader] Could not rewrite the header, sizes are wrong.\n");
+		return;
+	}
+	
+	Wav_WriteHeader(writer);
+	FS_Seek(writer->file, 0, SEEK_END);
+}
+
+void Wav_CloseWriter( wavWriter_t *writer )
+{
+	if (!writer->file)
+		return;
+	
+	Wav_UpdateHeader(writer);
+	
+	FS_CloseFile(writer->file);
+	writer->file = NULL;
+}
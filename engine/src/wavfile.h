@@ -27,6 +27,7 @@
 #ifndef __WAV_H__
 #define __WAV_H__
 
+#include "filesystem.h"
 
 // Structure used to describe a sound.
 typedef struct 
@@ -45,4 +46,21 @@ typedef struct
 
 extern char LoadWavInfo( const char *filename, unsigned char **wav, soundInfo_t *info );
 
+
+// 16 bits PCM written as it is produced, the sizes in the header are patched on close.
+typedef struct
+{
+	filehandle_t*	file;
+	unsigned long	sample_rate;
+	unsigned long	channels;
+	unsigned long	dataSize;
+	
+} wavWriter_t;
+
+char Wav_OpenWriter( wavWriter_t *writer, const char *filename, unsigned long sample_rate, unsigned long channels );
+void Wav_Write( wavWriter_t *writer, const short *frames, unsigned long numFrames );
+// Makes the file complete so far, writing can go on.
+void Wav_UpdateHeader( wavWriter_t *writer );
+void Wav_CloseWriter( wavWriter_t *writer );
+
 #endif /* __WAV_H__ */
@@ -34,8 +34,11 @@
 #include "player.h"
 #include "event.h"
 #include "titles.h"
+#include "bundle.h"
+#include "music.h"
 
 light_t light;
+uint lightVersion;
 
 
 
@@ -47,11 +50,11 @@ void World_ReadMatrix(matrix_t target)
 {
 	int i,j ;
 	
-	LE_readToken(); //{
+	LE_skipToken(); //{
 	for(i=0 ; i < 4 ; i++)
 		for(j=0 ; j < 4 ; j++)
 			target[j*4+i] = LE_readReal();
-	LE_readToken(); //}
+	LE_skipToken(); //}
 	
 	
 }
@@ -70,52 +73,80 @@ void World_ClearWorldMap(void)
 	num_map_entities=0;
 }
 
-void World_ReadMD5s(matrix_t currentMatrix)
+void World_AddMapEntity(const char* model, matrix_t matrix)
 {
 	entity_t* currentEntity;
 	
+	if (num_map_entities+1 == MAX_NUM_ENTITIES)
+	{
+		Log_Printf("Too many entities in the map.\n");
+		exit(0);
+	}
+	
+	currentEntity = &map[num_map_entities];
 	
-	LE_readToken(); // {
-	LE_readToken();
-	while (LE_hasMoreData() && strcmp(LE_getCurrentToken(), "}"))
+	if (!ENT_LoadEntity(currentEntity,model,ENT_PARTIAL_DRAW) )
 	{
-		if (!strcmp("model",LE_getCurrentToken()))
+		Log_Printf("[World_AddMapEntity] Could not load entity: %s.\n",model);
+	}
+	else
+	{				
+		matrixCopy(matrix, currentEntity->matrix);
+		ENT_InvalidateRenderCache(currentEntity);
+		
+		currentEntity->uid = num_map_entities;
+		
+#ifdef COMPILE_BUNDLES
+		BDL_AddMapEntity(currentEntity->uid, model, matrix);
+#endif
+		
+		ENT_GenerateWorldSpaceBBox(currentEntity);
+		
+		num_map_entities++ ;
+	}
+}
+
+void World_ReadMD5s(matrix_t currentMatrix)
+{
+	LE_skipToken(); // {
+	LE_readSpan();
+	while (LE_hasMoreData() && !LE_spanEquals(LE_getCurrentSpan(), "}"))
+	{
+		if (LE_spanEquals(LE_getCurrentSpan(), "model"))
 		{
 			LE_readToken();
-			
-			if (num_map_entities+1 == MAX_NUM_ENTITIES)
-			{
-				Log_Printf("Too many entities in the map.\n");
-				exit(0);
-			}
-			
-			currentEntity = &map[num_map_entities];
-			
-			if (!ENT_LoadEntity(currentEntity,LE_getCurrentToken(),ENT_PARTIAL_DRAW) )
-			{
-				Log_Printf("[World_ReadMD5s] Could not load entity: %s.\n",LE_getCurrentToken());
-			}
-			else
-			{				
-				matrixCopy(currentMatrix, currentEntity->matrix);
-	
-				currentEntity->uid = num_map_entities;
-				
-				
-				ENT_GenerateWorldSpaceBBox(currentEntity);
-				
-				num_map_entities++ ;
-			}
+			World_AddMapEntity(LE_getCurrentToken(), currentMatrix);
 		}
 		
-		LE_readToken();	
+		LE_readSpan();	
 	}	
 }
 
+enum { MAP_KW_MATRIX, MAP_KW_NUM_BACKGROUND_ENTITIES, MAP_KW_ENTITIES };
+static const char* mapWords[] = { "matrix", "numBackgroundEntities", "entities" };
+static le_keywords_t mapKeywords;
+
+enum
+{
+	SCENE_KW_MAP, SCENE_KW_FOG, SCENE_KW_PLAYER, SCENE_KW_LIGHT, SCENE_KW_CAMERA, SCENE_KW_ENEMIES, SCENE_KW_EVENTS,
+	SCENE_KW_TEXTS_EVENTS, SCENE_KW_MUSIC, SCENE_KW_PLAYBACK, SCENE_KW_DEFAULT_MENU, SCENE_KW_SHOW_FINGERS, SCENE_KW_TITLE
+};
+static const char* sceneWords[] = 
+{
+	"map", "fog", "player", "light", "camera", "enemies", "events",
+	"texts_events", "music", "playback", "defaultMenu", "showFingers", "title"
+};
+static le_keywords_t sceneKeywords;
+
+// Blocks found while parsing the text scene, recorded in the compiled bundle.
+static int   sceneSections;
+static uchar scenePlayersMask;
+
 void World_Loadmap(char* mapFileName)
 {
 	filehandle_t* mapFile ;
 	matrix_t currentMatrix;
+	int keyword;
 	
 	mapFile = FS_OpenFile(mapFileName, "rt");
 	FS_UploadToRAM(mapFile);
@@ -128,28 +159,30 @@ void World_Loadmap(char* mapFileName)
 	
 	Log_Printf("[World_Loadmap] Found map: '%s'.\n",mapFileName);
 	
+	if (!mapKeywords.numKeywords)
+		LE_InitKeywords(&mapKeywords, mapWords, sizeof(mapWords)/sizeof(char*));
+	
 	LE_pushLexer();
 	LE_init(mapFile);
 	
 	while(LE_hasMoreData())
 	{
-		LE_readToken();
+		keyword = LE_readKeyword(&mapKeywords);
 		
-		if (!strcmp(LE_getCurrentToken(), "matrix"))
+		if (keyword == MAP_KW_MATRIX)
 		{
 			World_ReadMatrix(currentMatrix);
 			//Log_Printf("Read matrix:\n");
 			//matrix_print(currentMatrix);
 		}
-		else if (!strcmp(LE_getCurrentToken(), "numBackgroundEntities"))
+		else if (keyword == MAP_KW_NUM_BACKGROUND_ENTITIES)
 		{
 			numBackgroundEntities = LE_readReal();
 		}
-		else if (!strcmp(LE_getCurrentToken(), "entities"))
+		else if (keyword == MAP_KW_ENTITIES)
 		{
-			LE_readToken(); // OBJ or MD5 ?
-			
-			if (!strcmp("MD5",LE_getCurrentToken()))
+			// OBJ or MD5 ?
+			if (LE_spanEquals(LE_readSpan(), "MD5"))
 			{
 				World_ReadMD5s(currentMatrix);
 				//ENT_DumpEntityCache();
@@ -170,14 +203,28 @@ void World_OpenScene(char* filename)
 	filehandle_t*	sceneFile;
 	uchar			currentPlayerId;
 	int				i,j;
-	event_t* event;
+	event_t			event;
+	int				keyword;
 	
 	
 	event_title_payload_t* titleEventPayload;
 	event_req_scene_t* ev_requestAct_payload;
 	event_req_menu_t* ev_requestMenu_payload;
+	char			bundlePath[256];
+	
 	camera.pathFilename[0] = 0;
 	
+	//The scene (text or bundle) sets a new light.
+	lightVersion++;
+	
+	BDL_GetBundlePath(filename, bundlePath);
+	if (BDL_LoadScene(bundlePath))
+	{
+		EV_BuildTimeline();
+		Log_Printf("[World_OpenScene] Loaded compiled scene: '%s'.\n",bundlePath);
+		return;
+	}
+	
 	sceneFile = FS_OpenFile(filename, "rt");
 	
 
@@ -191,18 +238,28 @@ void World_OpenScene(char* filename)
 	
     FS_UploadToRAM(sceneFile);
     
+	if (!sceneKeywords.numKeywords)
+		LE_InitKeywords(&sceneKeywords, sceneWords, sizeof(sceneWords)/sizeof(char*));
+	
 	LE_pushLexer();
 	LE_init(sceneFile);
 	
+	sceneSections = 0;
+	scenePlayersMask = 0;
+#ifdef COMPILE_BUNDLES
+	BDL_BeginScene();
+#endif
+	
 	//Init events
 	
 	
 	while (LE_hasMoreData()) 
 	{
-		LE_readToken();
+		keyword = LE_readKeyword(&sceneKeywords);
 		
-		if (!strcmp("map", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_MAP)
 		{
+			sceneSections |= BDL_SECTION_MAP;
 			LE_readToken();	//{
 			LE_readToken();
 			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
@@ -234,8 +291,9 @@ void World_OpenScene(char* filename)
 		 
 		 */
 		else
-		if (!strcmp("fog", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_FOG)
 		{
+			sceneSections |= BDL_SECTION_FOG;
 			LE_readToken();	//{
 			LE_readToken();
 			while (strcmp("}", LE_getCurrentToken()))
@@ -285,8 +343,9 @@ void World_OpenScene(char* filename)
 			}
 		}
 		else
-		if (!strcmp("player", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_PLAYER)
 		{
+			sceneSections |= BDL_SECTION_PLAYER;
 			
 			LE_readToken();	//{
 			LE_readToken();
@@ -295,6 +354,7 @@ void World_OpenScene(char* filename)
 				if (!strcmp("id", LE_getCurrentToken()))
 				{
 					currentPlayerId = LE_readReal();
+					scenePlayersMask |= 1 << currentPlayerId;
 				}
 				else 
 				if (!strcmp("matrix", LE_getCurrentToken()))
@@ -313,8 +373,9 @@ void World_OpenScene(char* filename)
 			}
 		}
 		else 
-		if (!strcmp("light", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_LIGHT)
 		{
+			sceneSections |= BDL_SECTION_LIGHT;
 			LE_readToken(); // {
 			LE_readToken();
 			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
@@ -387,8 +448,9 @@ void World_OpenScene(char* filename)
 			}
 		}
 		else 
-		if (!strcmp("camera", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_CAMERA)
 		{
+			sceneSections |= BDL_SECTION_CAMERA;
 			LE_readToken(); // {
 			LE_readToken();
 			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
@@ -421,20 +483,20 @@ void World_OpenScene(char* filename)
 				else 
 				if (!strcmp("attachAt", LE_getCurrentToken()))
 				{
-					event = calloc(1, sizeof(event_t));
-					event->time = LE_readReal();
-					event->type = EV_ATTACH_PLAYER;
+					memset(&event, 0, sizeof(event_t));
+					event.time = LE_readReal();
+					event.type = EV_ATTACH_PLAYER;
 					
-					EV_AddEvent(event);
+					EV_AddEvent(&event);
 				}
 				else 
 				if (!strcmp("detachAt", LE_getCurrentToken()))
 				{
-					event = calloc(1, sizeof(event_t));
-					event->type = EV_DETACH_PLAYER;
-					event->time = LE_readReal();
+					memset(&event, 0, sizeof(event_t));
+					event.type = EV_DETACH_PLAYER;
+					event.time = LE_readReal();
 					
-					EV_AddEvent(event);
+					EV_AddEvent(&event);
 				}
 				
 				LE_readToken();
@@ -442,12 +504,12 @@ void World_OpenScene(char* filename)
 			camera.aspect = 320/(float)480;
 		}
 		else 
-		if (!strcmp("enemies", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_ENEMIES)
 		{
 			EV_ReadEnemiesEvents();
 		}
 		else 
-		if (!strcmp("events", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_EVENTS)
 		{
 			LE_readToken(); // {
 			LE_readToken();
@@ -455,8 +517,8 @@ void World_OpenScene(char* filename)
 			{
 				if (!strcmp("at", LE_getCurrentToken()))
 				{
-					event = calloc(1, sizeof(event_t));
-					event->time = LE_readReal();
+					memset(&event, 0, sizeof(event_t));
+					event.time = LE_readReal();
 					
 					LE_readToken();
 					
@@ -464,58 +526,55 @@ void World_OpenScene(char* filename)
 					//at 45000 setPlayback play 0
 					if (!strcmp("finishAct", LE_getCurrentToken()))
 					{
-						event->type = EV_REQUEST_SCENE;
-						ev_requestAct_payload = (event_req_scene_t*)calloc(1, sizeof(event_req_scene_t));
+						event.type = EV_REQUEST_SCENE;
+						ev_requestAct_payload = &event.payload.reqScene;
 						LE_readToken(); // nextAct
 						ev_requestAct_payload->sceneId = LE_readReal() ;
-						event->payload = ev_requestAct_payload;
 					}
 					else
 					if (!strcmp("stopPlayback", LE_getCurrentToken()))
 					{
-						event->type = EV_STOP_PLAYBACK;					
+						event.type = EV_STOP_PLAYBACK;					
 					}
 					else
 					if (!strcmp("setMenu", LE_getCurrentToken()))
 					{
-						event->type = EV_REQUEST_MENU;	
-						ev_requestMenu_payload = (event_req_menu_t* )calloc(1, sizeof(event_req_menu_t));
+						event.type = EV_REQUEST_MENU;	
+						ev_requestMenu_payload = &event.payload.reqMenu;
 						ev_requestMenu_payload->menuId = LE_readReal();
-						event->payload = ev_requestMenu_payload;
 					}
 					else
 					if (!strcmp("uploadScore", LE_getCurrentToken()))
 					{
-							event->type = EV_SAVE_SCORE;	
-						event->payload = 0;
+							event.type = EV_SAVE_SCORE;	
 					}
 					else
                     if (!strcmp("clearTitle", LE_getCurrentToken()))
                     {
-                        event->type = EV_CLEAR_TITLE;	
-                        event->payload = 0;
+                        event.type = EV_CLEAR_TITLE;	
                     }
 					
                     /*
-                    if(event->type == 0)
+                    if(event.type == 0)
                     {
                         free(event);
                     }
 					else
                     */
-                        EV_AddEvent(event);
+                        EV_AddEvent(&event);
 				}
 				LE_readToken();
 			}
 		}
 		else
-		if (!strcmp("texts_events", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_TEXTS_EVENTS)
 		{
 			EV_ReadTextsEvents();
 		}
 		else
-		if (!strcmp("music", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_MUSIC)
 		{
+			sceneSections |= BDL_SECTION_MUSIC;
 			LE_readToken(); // {
 			LE_readToken();
 			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
@@ -529,6 +588,9 @@ void World_OpenScene(char* filename)
 					strcat(engine.musicFilename, FS_Gamedir());
 					strcat(engine.musicFilename,"/");
 					strcat(engine.musicFilename, LE_getCurrentToken());
+					
+					//Opens in the background while the rest of the scene loads.
+					SND_PrefetchSoundTrack(engine.musicFilename);
 				}
 				else
 				if (!strcmp("startMusicAt", LE_getCurrentToken()))
@@ -540,8 +602,9 @@ void World_OpenScene(char* filename)
 			
 		}
 		else
-		if (!strcmp("playback", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_PLAYBACK)
 		{
+			sceneSections |= BDL_SECTION_PLAYBACK;
 			LE_readToken(); // {
 			LE_readToken();
 			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
@@ -576,18 +639,21 @@ void World_OpenScene(char* filename)
 			
 		}
 		else
-		if (!strcmp("defaultMenu", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_DEFAULT_MENU)
 		{
+			sceneSections |= BDL_SECTION_DEFAULT_MENU;
 			engine.scenes[engine.sceneId].defaultMenuId = LE_readReal();
 		}
 		else 
-		if (!strcmp("showFingers", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_SHOW_FINGERS)
 		{
+			sceneSections |= BDL_SECTION_SHOW_FINGERS;
 			engine.showFingers = LE_readReal();
 		}
 		else
-		if (!strcmp("title", LE_getCurrentToken()))
+		if (keyword == SCENE_KW_TITLE)
 		{
+			sceneSections |= BDL_SECTION_TITLE;
 			LE_readToken(); // {
 			LE_readToken();
 			while (LE_hasMoreData() && strcmp("}", LE_getCurrentToken()))
@@ -604,46 +670,44 @@ void World_OpenScene(char* filename)
 				if (!strcmp("prolog", LE_getCurrentToken()))
 				{
 					LE_readToken();	//start 
-					event = calloc(1, sizeof(event_t));
-					event->time = LE_readReal();
+					memset(&event, 0, sizeof(event_t));
+					event.time = LE_readReal();
 					LE_readToken();	//duration();  
-					titleEventPayload = calloc(1, sizeof(event_title_payload_t));
+					titleEventPayload = &event.payload.title;
 							  
-					event->payload = titleEventPayload;			   
 					titleEventPayload->duration = LE_readReal();
 					
-					event->type = EV_SHOW_PROLOG;
+					event.type = EV_SHOW_PROLOG;
 								   
-					EV_AddEvent(event);
+					EV_AddEvent(&event);
 					
 					
 				}
 				else if (!strcmp("epilog", LE_getCurrentToken()))
 				{
 					LE_readToken();	//start 
-					event = calloc(1, sizeof(event_t));
-					event->time = LE_readReal();
+					memset(&event, 0, sizeof(event_t));
+					event.time = LE_readReal();
 					LE_readToken();	//duration();  
-					titleEventPayload = calloc(1, sizeof(event_title_payload_t));
+					titleEventPayload = &event.payload.title;
 					
-					event->payload = titleEventPayload;			   
 					titleEventPayload->duration = LE_readReal();
 					
-					event->type = EV_SHOW_EPILOG;
+					event.type = EV_SHOW_EPILOG;
 					
-					EV_AddEvent(event);		
+					EV_AddEvent(&event);		
 					
 				}
 				//at 130000 movePlayersToDefautlSSLocation
 				else if (!strcmp("at", LE_getCurrentToken()))
 				{
-					event = calloc(1, sizeof(event_t));
-					event->time = LE_readReal();
-					event->type = EV_AUTOPILOT_PL;
+					memset(&event, 0, sizeof(event_t));
+					event.time = LE_readReal();
+					event.type = EV_AUTOPILOT_PL;
 					//movePlayersToDefautlSSLocation
 					LE_readToken();
 					
-					EV_AddEvent(event);	
+					EV_AddEvent(&event);	
 					
 					
 				}
@@ -654,6 +718,12 @@ void World_OpenScene(char* filename)
 	}
 
 	LE_popLexer();
+	
+	EV_BuildTimeline();
+	
+#ifdef COMPILE_BUNDLES
+	BDL_CompileScene(bundlePath, sceneSections, scenePlayersMask);
+#endif
 }
 
 
@@ -673,7 +743,7 @@ void World_Update(void)
 		
 		vectorCopy(camera.up,light.upVector);
 		
-		
+		lightVersion++;
 	}
 	else 
 	{
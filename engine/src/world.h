@@ -52,9 +52,13 @@ typedef struct light_t {
 void World_OpenScene(char* filename);
 void World_Update(void);
 void World_ClearWorldMap(void);
+void World_AddMapEntity(const char* model, matrix_t matrix);
 
 extern light_t light;
 
+//Incremented every time the light moves, render caches compare against it.
+extern uint lightVersion;
+
 extern entity_t map[MAX_NUM_ENTITIES];
 extern uchar num_map_entities;
 extern int numBackgroundEntities;
@@ -0,0 +1,21 @@
+precision highp float; 
+
+
+uniform mat4 modelViewProjectionMatrix ;
+attribute vec3 a_vertex; 
+attribute vec2 a_texcoord0; 
+attribute vec4 a_color; 
+
+varying vec2 v_texcoord; 
+varying vec4 v_color; 
+
+
+void main(void) 
+{
+   // Transform output position 
+   gl_Position =  modelViewProjectionMatrix *    vec4(a_vertex,1.0) ;
+   
+   // Pass through texture coordinate and sprite color 
+   v_texcoord = a_texcoord0.xy; 
+   v_color = a_color; 
+}
\ No newline at end of file
@@ -15,9 +15,16 @@ uniform vec3 cameraPosition;
 
 
 attribute vec3 a_vertex; 
-attribute vec3 a_normal; 
 attribute vec2 a_texcoord0; 
 
+#ifdef COMPACT_VERTEX
+	//Position normalized in the mesh bbox, normal and tangent octahedron encoded.
+	uniform vec4 dequantization;
+	attribute vec2 a_normal;
+#else
+	attribute vec3 a_normal; 
+#endif
+
 
 varying vec3 lightVec; 
 varying vec3 halfVec;
@@ -26,32 +33,65 @@ varying vec2 v_texcoord;
 
 
 #ifdef BUMP_MAPPING
-	attribute vec3 a_tangent;
+	#ifdef COMPACT_VERTEX
+		attribute vec2 a_tangent;
+	#else
+		attribute vec3 a_tangent;
+	#endif
 #else
 	varying vec3 v_normal ;
 #endif
 
+#ifdef COMPACT_VERTEX
+vec3 octahedronDecode(vec2 e)
+{
+	vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+	
+	if (v.z < 0.0)
+	{
+		v.x = (1.0 - abs(e.y)) * (e.x >= 0.0 ? 1.0 : -1.0);
+		v.y = (1.0 - abs(e.x)) * (e.y >= 0.0 ? 1.0 : -1.0);
+	}
+	
+	return normalize(v);
+}
+#endif
+
 void main(void) 
 {
 	vec3 tmpVec;
 	
+	#ifdef COMPACT_VERTEX
+		vec3 vertex = a_vertex * dequantization.w + dequantization.xyz;
+		vec3 normal = octahedronDecode(a_normal);
+		#ifdef BUMP_MAPPING
+			vec3 tangent = octahedronDecode(a_tangent);
+		#endif
+	#else
+		vec3 vertex = a_vertex;
+		vec3 normal = a_normal;
+		#ifdef BUMP_MAPPING
+			vec3 tangent = a_tangent;
+		#endif
+	#endif
+	
 	#ifdef BUMP_MAPPING
 		
-		vec3 a_bitangent = cross(a_normal,a_tangent);
+		vec3 bitangent = cross(normal,tangent);
 	
-		tmpVec =  lightPosition - a_vertex  ;
+		tmpVec =  lightPosition - vertex  ;
 	
-		lightVec.x = dot(tmpVec, a_tangent);
-		lightVec.y = dot(tmpVec, a_bitangent);
-		lightVec.z = dot(tmpVec, a_normal);
+		lightVec.x = dot(tmpVec, tangent);
+		lightVec.y = dot(tmpVec, bitangent);
+		lightVec.z = dot(tmpVec, normal);
 		lightVec = normalize(lightVec);
 	
-		tmpVec = cameraPosition - a_vertex ;
+		tmpVec = cameraPosition - vertex ;
 
 	
-		halfVec.x = dot(tmpVec, a_tangent);
-		halfVec.y = dot(tmpVec, a_bitangent);
-		halfVec.z = dot(tmpVec, a_normal);
+		halfVec.x = dot(tmpVec, tangent);
+		halfVec.y = dot(tmpVec, bitangent);
+		halfVec.z = dot(tmpVec, normal);
 
 		halfVec = normalize(halfVec);
 	
@@ -60,12 +100,12 @@ void main(void)
 		halfVec = normalize(halfVec);
 	
 	#else
-		v_normal = a_normal ;
+		v_normal = normal ;
 		
-		lightVec = lightPosition - a_vertex ;
+		lightVec = lightPosition - vertex ;
 		lightVec = normalize(lightVec);
 		
-		halfVec  = cameraPosition - a_vertex ;
+		halfVec  = cameraPosition - vertex ;
 		halfVec = (halfVec + lightVec) /2.0;
 		halfVec = normalize(halfVec);
 		
@@ -75,9 +115,9 @@ void main(void)
    v_texcoord = a_texcoord0.xy; 
       
       // Transform output position 
-   gl_Position =   modelViewProjectionMatrix*    vec4(a_vertex,1.0) ;
+   gl_Position =   modelViewProjectionMatrix*    vec4(vertex,1.0) ;
    
 	#ifdef SHADO_MAPPING
-		lightPOVPosition  = lightPOVPVMMatrix    *    vec4(a_vertex,1.0) ;
+		lightPOVPosition  = lightPOVPVMMatrix    *    vec4(vertex,1.0) ;
 	#endif
 }
\ No newline at end of file
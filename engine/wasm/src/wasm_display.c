@@ -19,6 +19,7 @@ static void WASM_Stub_UpLoadEntityToGPU(entity_t* entity) {}
 static uint WASM_Stub_UploadVerticesToGPU(void* vertices, uint mem_size) { return 0; }
 static void WASM_Stub_FreeGPUBuffer(uint buffer) {}
 static void WASM_Stub_RenderColorlessSprites(xf_colorless_sprite_t* vertices, ushort numIndices, ushort* indices) {}
+static void WASM_Stub_RenderSprites(const xf_sprite_t* vertices, int numQuads, const ushort* quadIndices, const spr_batch_t* batches, int numBatches) {}
 static void WASM_Stub_FadeScreen(float alpha) {}
 static void WASM_Stub_SetMaterialTextureBlending(char modulate) {}
 static void WASM_Stub_SetTransparency(float alpha) {}
@@ -233,8 +234,7 @@ void wasm_display_bind_renderer_methods(renderer_t* renderer) {
     renderer->StopRendition = WASM_Stub_Void;
     renderer->SetTexture = WASM_Stub_SetTexture;
     renderer->Set2D = WASM_Stub_Void;
-    renderer->RenderPlayersBullets = WASM_Stub_Void;
-    renderer->RenderFXSprites = WASM_Stub_Void;
+    renderer->RenderSprites = WASM_Stub_RenderSprites;
     renderer->RenderString = WASM_Stub_RenderString;
     renderer->GetColorBuffer = WASM_Stub_GetColorBuffer;
     renderer->UpLoadEntityToGPU = WASM_Stub_UpLoadEntityToGPU;
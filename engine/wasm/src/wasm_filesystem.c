@@ -36,6 +36,11 @@ filehandle_t* FS_OpenFile( const char *filename, char* mode ) {
     return fhandle;
 }
 
+filehandle_t* FS_OpenWritableFile( const char *filename, char* mode ) {
+    // No persistent writable directory in the browser.
+    return NULL;
+}
+
 int FS_UploadToRAM(filehandle_t *fhandle) {
     if (!fhandle || !fhandle->hFile) {
         return 0; // Failure
@@ -134,6 +139,11 @@ SW32 FS_Write( const void * buffer, W32 size, W32 count, filehandle_t * stream )
     return 0;
 }
 
+int FS_Seek( filehandle_t *fhandle, SW32 offset, int origin ) {
+    // Nothing is opened for writing.
+    return -1;
+}
+
 void *FS_GetLoadedFilePointer( filehandle_t *fhandle, W32 origin ) {
     // The engine expects this to return a pointer to the in-memory file data.
     if (fhandle && fhandle->bLoaded && fhandle->filedata) {
@@ -12,4 +12,7 @@ char NET_IsRunning(void){return 0;}
 void NET_OnNextLevelLoad(void){}
 void Net_SendDie(command_t* command){}
 uint NET_GetDropedPackets(void){return 0;}
-char NET_IsInitialized(void) {return 0;}
\ No newline at end of file
+char NET_IsInitialized(void) {return 0;}
+void NET_SendJoin(int udpSocket, const struct sockaddr_in* server, uint nonce){}
+char NET_ReceiveWelcome(int udpSocket, const struct sockaddr_in* server, uint nonce, netp_welcome_t* welcome){return 0;}
+void NET_StartSession(int udpSocket, const struct sockaddr_in* server, const netp_welcome_t* welcome){}
\ No newline at end of file
@@ -10,11 +10,13 @@ net_channel_t net;
 void SND_InitSoundTrack(char* filename,unsigned int startAt) {}
 void SND_StartSoundTrack(void) {}
 void SND_StopSoundTrack(void) {}
+void SND_PrefetchSoundTrack(char* filename) {}
+void SND_SeekSoundTrack(unsigned int ms) {}
 void Native_UploadScore(int score) {}
 
 void SND_BACKEND_Upload(sound_t* sound, int soundID) {}
 void SND_BACKEND_Init(void) {}
-void SND_BACKEND_Play(int soundID) {}
+void SND_BACKEND_Play(int soundID, float gain) {}
 
 void loadNativePNG(texture_t* tex) {}
 int dEngine_resize(int width, int height) {return 0;}
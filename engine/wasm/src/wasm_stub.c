@@ -25,7 +25,7 @@ void SND_StartSoundTrack(void) {}
 void SND_StopSoundTrack(void) {}
 void SND_BACKEND_Upload(void* data, int size) {}
 void SND_BACKEND_Init(void) {}
-void SND_BACKEND_Play(int id) {}
+void SND_BACKEND_Play(int id, float gain) {}
 
 // 其他
 void Native_UploadScore(int score) {}